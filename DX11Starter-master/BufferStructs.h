@@ -1,11 +1,31 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include "ShaderConstants.h"
+#include "Lights.h"
+#include "ShadowCascades.h"
+#include "ShadowAtlas.h"
 
-struct VertexShaderExternalData
-{
-	DirectX::XMFLOAT4 colorTint;
-	DirectX::XMFLOAT4X4 world;
-	DirectX::XMFLOAT4X4 view;
-	DirectX::XMFLOAT4X4 projection;
-};
+// --------------------------------------------------------
+// The shaders' constant buffers, split by how often they
+// change:
+// - Frame: camera, light cluster grid and shadows, set once per
+//   frame (the lights themselves are structured buffers, see
+//   LightManager.h and LightClusterer.h)
+// - Material: set once each time the material changes
+// - Object: set per draw (the main pass gets this through
+//   the instance buffer instead, see InstanceData), with
+//   the matrices already multiplied together on the CPU
+//
+// The structs themselves are generated from the HLSL into
+// ShaderConstants.h, which checks every offset
+// --------------------------------------------------------
+
+// Array sizes come from the shaders' #defines, which have to
+// agree with the C++ ones
+static_assert(sizeof(PixelFrameConstants::ShadowCascades) == sizeof(DirectX::XMFLOAT4X4) * SHADOW_CASCADE_COUNT,
+	"SHADOW_CASCADE_COUNT must match ShaderHelper.hlsli");
+static_assert(sizeof(PixelFrameConstants::AtlasMatrices) == sizeof(DirectX::XMFLOAT4X4) * MAX_ATLAS_TILES,
+	"MAX_ATLAS_TILES must match ShaderHelper.hlsli");
+static_assert(sizeof(PixelFrameConstants::AtlasRects) == sizeof(DirectX::XMFLOAT4) * MAX_ATLAS_TILES,
+	"MAX_ATLAS_TILES must match ShaderHelper.hlsli");
@@ -0,0 +1,209 @@
+#include "CommandBuffer.h"
+#include <cstring>
+
+CommandBuffer::CommandBuffer()
+{
+}
+
+CommandBuffer::~CommandBuffer()
+{
+}
+
+void CommandBuffer::Reset()
+{
+	commands.clear();
+	constantData.clear();
+	resourceLists.clear();
+}
+
+// --------------------------------------------------------
+// Commands keep their order, constant data and resource list
+// offsets are moved past this buffer's own data
+// --------------------------------------------------------
+void CommandBuffer::Append(const CommandBuffer& other)
+{
+	unsigned int dataOffset = (unsigned int)constantData.size();
+	constantData.insert(constantData.end(), other.constantData.begin(), other.constantData.end());
+
+	unsigned int listOffset = (unsigned int)resourceLists.size();
+	resourceLists.insert(resourceLists.end(), other.resourceLists.begin(), other.resourceLists.end());
+
+	size_t first = commands.size();
+	commands.insert(commands.end(), other.commands.begin(), other.commands.end());
+	for (size_t i = first; i < commands.size(); i++)
+	{
+		CommandType type = commands[i].Type;
+		if (type == CommandType::UpdateConstants || type == CommandType::SetConstants)
+			commands[i].Args[0] += dataOffset;
+		else if (type == CommandType::SetShaderResources || type == CommandType::SetSamplers)
+			commands[i].Args[1] += listOffset;
+	}
+}
+
+Command& CommandBuffer::Push(CommandType type)
+{
+	Command command = {};
+	command.Type = type;
+	commands.push_back(command);
+	return commands.back();
+}
+
+void CommandBuffer::SetInputLayout(const void* inputLayout)
+{
+	Push(CommandType::SetInputLayout).Resource = inputLayout;
+}
+
+void CommandBuffer::SetShader(ShaderStage stage, const void* shader)
+{
+	Command& command = Push(CommandType::SetShader);
+	command.Stage = stage;
+	command.Resource = shader;
+}
+
+void CommandBuffer::SetVertexBuffer(unsigned int slot, const void* buffer, unsigned int stride, unsigned int offset)
+{
+	Command& command = Push(CommandType::SetVertexBuffer);
+	command.Slot = (unsigned short)slot;
+	command.Args[0] = stride;
+	command.Args[1] = offset;
+	command.Resource = buffer;
+}
+
+void CommandBuffer::SetIndexBuffer(const void* buffer)
+{
+	Push(CommandType::SetIndexBuffer).Resource = buffer;
+}
+
+void CommandBuffer::UpdateConstants(const void* buffer, const void* data, unsigned int size)
+{
+	unsigned int offset = (unsigned int)constantData.size();
+	constantData.resize(offset + size);
+	memcpy(constantData.data() + offset, data, size);
+
+	Command& command = Push(CommandType::UpdateConstants);
+	command.Args[0] = offset;
+	command.Args[1] = size;
+	command.Resource = buffer;
+}
+
+void CommandBuffer::SetConstantBuffer(ShaderStage stage, unsigned int slot, const void* buffer)
+{
+	Command& command = Push(CommandType::SetConstantBuffer);
+	command.Stage = stage;
+	command.Slot = (unsigned short)slot;
+	command.Resource = buffer;
+}
+
+// --------------------------------------------------------
+// Binds a copy of the data to a slot without naming a buffer.
+// The executor decides where it lives (D3D11CommandExecutor
+// suballocates it from a per frame ring), so there's no
+// buffer to update per draw.
+// --------------------------------------------------------
+void CommandBuffer::SetConstants(ShaderStage stage, unsigned int slot, const void* data, unsigned int size)
+{
+	unsigned int offset = (unsigned int)constantData.size();
+	constantData.resize(offset + size);
+	memcpy(constantData.data() + offset, data, size);
+
+	Command& command = Push(CommandType::SetConstants);
+	command.Stage = stage;
+	command.Slot = (unsigned short)slot;
+	command.Args[0] = offset;
+	command.Args[1] = size;
+}
+
+void CommandBuffer::SetShaderResource(ShaderStage stage, unsigned int slot, const void* srv)
+{
+	Command& command = Push(CommandType::SetShaderResource);
+	command.Stage = stage;
+	command.Slot = (unsigned short)slot;
+	command.Resource = srv;
+}
+
+void CommandBuffer::SetSampler(ShaderStage stage, unsigned int slot, const void* sampler)
+{
+	Command& command = Push(CommandType::SetSampler);
+	command.Stage = stage;
+	command.Slot = (unsigned short)slot;
+	command.Resource = sampler;
+}
+
+void CommandBuffer::SetShaderResources(ShaderStage stage, unsigned int startSlot, unsigned int count, const void* const* srvs)
+{
+	Command& command = Push(CommandType::SetShaderResources);
+	command.Stage = stage;
+	command.Slot = (unsigned short)startSlot;
+	command.Args[0] = count;
+	command.Args[1] = (unsigned int)resourceLists.size();
+	resourceLists.insert(resourceLists.end(), srvs, srvs + count);
+}
+
+void CommandBuffer::SetSamplers(ShaderStage stage, unsigned int startSlot, unsigned int count, const void* const* samplers)
+{
+	Command& command = Push(CommandType::SetSamplers);
+	command.Stage = stage;
+	command.Slot = (unsigned short)startSlot;
+	command.Args[0] = count;
+	command.Args[1] = (unsigned int)resourceLists.size();
+	resourceLists.insert(resourceLists.end(), samplers, samplers + count);
+}
+
+void CommandBuffer::SetRasterizerState(const void* state)
+{
+	Push(CommandType::SetRasterizerState).Resource = state;
+}
+
+void CommandBuffer::SetDepthStencilState(const void* state)
+{
+	Push(CommandType::SetDepthStencilState).Resource = state;
+}
+
+void CommandBuffer::SetPipeline(const PipelineState* pipeline)
+{
+	Push(CommandType::SetPipeline).Resource = pipeline;
+}
+
+void CommandBuffer::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	Command& command = Push(CommandType::DrawIndexed);
+	command.Args[0] = indexCount;
+	command.Args[1] = startIndex;
+	command.Args[2] = (unsigned int)baseVertex;
+}
+
+void CommandBuffer::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+	unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	Command& command = Push(CommandType::DrawIndexedInstanced);
+	command.Args[0] = indexCount;
+	command.Args[1] = instanceCount;
+	command.Args[2] = startIndex;
+	command.Args[3] = (unsigned int)baseVertex;
+	command.Args[4] = startInstance;
+}
+
+const std::vector<Command>& CommandBuffer::GetCommands() const
+{
+	return commands;
+}
+
+const unsigned char* CommandBuffer::GetConstantData() const
+{
+	return constantData.data();
+}
+
+unsigned int CommandBuffer::GetConstantDataSize() const
+{
+	return (unsigned int)constantData.size();
+}
+
+const void* const* CommandBuffer::GetResourceLists() const
+{
+	return resourceLists.data();
+}
+
+unsigned int CommandBuffer::GetResourceListSize() const
+{
+	return (unsigned int)resourceLists.size();
+}
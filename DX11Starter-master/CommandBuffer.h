@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+
+struct PipelineState;
+
+// Shader stages a command can target
+enum class ShaderStage : unsigned char
+{
+	Vertex,
+	Pixel
+};
+
+enum class CommandType : unsigned char
+{
+	SetInputLayout,
+	SetShader,
+	SetVertexBuffer,
+	SetIndexBuffer,
+	UpdateConstants,
+	SetConstantBuffer,
+	SetConstants,
+	SetShaderResource,
+	SetSampler,
+	SetShaderResources,
+	SetSamplers,
+	SetRasterizerState,
+	SetDepthStencilState,
+	SetPipeline,
+	DrawIndexed,
+	DrawIndexedInstanced,
+	Count
+};
+
+// --------------------------------------------------------
+// One recorded command, fixed size so the buffer is a flat array
+//
+// Args by type:
+//  SetVertexBuffer:      stride, offset
+//  UpdateConstants,
+//  SetConstants:         offset into constant data, size
+//  SetShaderResources,
+//  SetSamplers:          count, offset into the resource lists
+//  DrawIndexed:          indexCount, startIndex, baseVertex
+//  DrawIndexedInstanced: indexCount, instanceCount, startIndex, baseVertex, startInstance
+// --------------------------------------------------------
+struct Command
+{
+	CommandType Type;
+	ShaderStage Stage;
+	unsigned short Slot;
+	unsigned int Args[5];
+	const void* Resource; // Shader, buffer, view, state or pipeline the command refers to (unused by lists)
+};
+
+// --------------------------------------------------------
+// Records a frame's pipeline work as a linear list of commands
+// instead of calling the device context directly
+//
+// - Resources are opaque pointers, so recording doesn't need
+//   Direct3D and can run (and be timed) headless
+// - Constant data and resource lists are copied into the
+//   buffer at record time, callers can reuse their memory
+//   straight away
+// - Played back by an ICommandExecutor
+// - Several buffers can be recorded on different threads and
+//   joined with Append(), in whatever order they should run
+// --------------------------------------------------------
+class CommandBuffer
+{
+public:
+	CommandBuffer();
+	~CommandBuffer();
+
+	// Drops all recorded commands, keeping the memory
+	void Reset();
+
+	// Copies another buffer's commands onto the end of this one
+	void Append(const CommandBuffer& other);
+
+	//Recording
+	void SetInputLayout(const void* inputLayout);
+	void SetShader(ShaderStage stage, const void* shader);
+	void SetVertexBuffer(unsigned int slot, const void* buffer, unsigned int stride, unsigned int offset);
+	void SetIndexBuffer(const void* buffer); // 32 bit indices
+	void UpdateConstants(const void* buffer, const void* data, unsigned int size);
+	void SetConstantBuffer(ShaderStage stage, unsigned int slot, const void* buffer);
+	void SetConstants(ShaderStage stage, unsigned int slot, const void* data, unsigned int size); // Executor picks the buffer
+	void SetShaderResource(ShaderStage stage, unsigned int slot, const void* srv);
+	void SetSampler(ShaderStage stage, unsigned int slot, const void* sampler);
+	void SetShaderResources(ShaderStage stage, unsigned int startSlot, unsigned int count, const void* const* srvs);
+	void SetSamplers(ShaderStage stage, unsigned int startSlot, unsigned int count, const void* const* samplers);
+	void SetRasterizerState(const void* state);
+	void SetDepthStencilState(const void* state);
+	void SetPipeline(const PipelineState* pipeline); // Shaders, input layout, fixed function state and topology
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+		unsigned int startIndex, int baseVertex, unsigned int startInstance);
+
+	//Getters
+	const std::vector<Command>& GetCommands() const;
+	const unsigned char* GetConstantData() const;
+	unsigned int GetConstantDataSize() const;
+	const void* const* GetResourceLists() const;
+	unsigned int GetResourceListSize() const;
+
+private:
+	std::vector<Command> commands;
+	std::vector<unsigned char> constantData;
+	std::vector<const void*> resourceLists; // Copied pointer arrays for the list commands
+
+	Command& Push(CommandType type);
+};
+
+// --------------------------------------------------------
+// Plays back a command buffer
+// --------------------------------------------------------
+class ICommandExecutor
+{
+public:
+	virtual ~ICommandExecutor() {}
+	virtual void Execute(const CommandBuffer& commands) = 0;
+};
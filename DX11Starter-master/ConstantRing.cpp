@@ -0,0 +1,119 @@
+#include "ConstantRing.h"
+
+ConstantRing::ConstantRing(unsigned int capacity)
+{
+	this->capacity = capacity / CONSTANT_RING_ALIGNMENT * CONSTANT_RING_ALIGNMENT;
+	head = 0;
+	tail = 0;
+	used = 0;
+	frameBytes = 0;
+	failedCount = 0;
+}
+
+ConstantRing::~ConstantRing()
+{
+}
+
+void ConstantRing::Retire(unsigned long long completedFence)
+{
+	while (!frames.empty() && frames.front().Fence <= completedFence)
+	{
+		tail = frames.front().End;
+		used -= frames.front().Bytes;
+		frames.pop_front();
+	}
+
+	//Nothing in flight, so start over at the front
+	if (used == 0 && frameBytes == 0)
+	{
+		head = 0;
+		tail = 0;
+	}
+}
+
+void ConstantRing::BeginFrame()
+{
+	frameBytes = 0;
+	failedCount = 0;
+}
+
+void ConstantRing::EndFrame(unsigned long long fence)
+{
+	if (frameBytes == 0)
+		return;
+
+	FrameRegion frame = {};
+	frame.Fence = fence;
+	frame.End = head;
+	frame.Bytes = frameBytes;
+	frames.push_back(frame);
+	frameBytes = 0;
+}
+
+// --------------------------------------------------------
+// Free space is [head, tail) going round the end. If the
+// allocation doesn't fit before the end but does at the
+// front, the rest of the end is given up and counted as
+// used, so it's freed along with this frame.
+// --------------------------------------------------------
+bool ConstantRing::Allocate(unsigned int size, unsigned int& offset)
+{
+	unsigned int aligned = (size + CONSTANT_RING_ALIGNMENT - 1) / CONSTANT_RING_ALIGNMENT * CONSTANT_RING_ALIGNMENT;
+	if (size == 0 || aligned > capacity - used)
+	{
+		failedCount++;
+		return false;
+	}
+
+	unsigned int skipped = 0;
+	if (head >= tail)
+	{
+		//Free space runs to the end, then from the front up to tail
+		if (capacity - head < aligned)
+		{
+			if (tail < aligned)
+			{
+				failedCount++;
+				return false;
+			}
+			skipped = capacity - head;
+			head = 0;
+		}
+	}
+	else if (tail - head < aligned)
+	{
+		failedCount++;
+		return false;
+	}
+
+	offset = head;
+	head = (head + aligned) % capacity;
+	used += skipped + aligned;
+	frameBytes += skipped + aligned;
+	return true;
+}
+
+unsigned int ConstantRing::GetCapacity()
+{
+	return capacity;
+}
+
+unsigned int ConstantRing::GetUsedBytes()
+{
+	return used;
+}
+
+unsigned int ConstantRing::GetFrameBytes()
+{
+	return frameBytes;
+}
+
+unsigned int ConstantRing::GetFramesInFlight()
+{
+	return (unsigned int)frames.size();
+}
+
+unsigned int ConstantRing::GetFailedCount()
+{
+	return failedCount;
+}
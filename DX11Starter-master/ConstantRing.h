@@ -0,0 +1,59 @@
+#pragma once
+
+#include <deque>
+
+// Offsets given to VSSetConstantBuffers1/PSSetConstantBuffers1
+// must be multiples of 16 constants (256 bytes)
+#define CONSTANT_RING_ALIGNMENT 256
+
+// --------------------------------------------------------
+// Hands out space in one big constant buffer, front to back,
+// wrapping around to the start when it reaches the end
+//
+// - Allocations are 256 byte aligned and never straddle the
+//   end of the buffer (the tail is skipped instead)
+// - Everything allocated between BeginFrame() and EndFrame()
+//   belongs to that frame, tagged with a fence value
+// - Space only comes back once Retire() is told the frame's
+//   fence has completed, so the GPU is never written under
+// - Knows nothing about Direct3D: offsets only
+// --------------------------------------------------------
+class ConstantRing
+{
+public:
+	ConstantRing(unsigned int capacity); // Rounded down to the alignment
+	~ConstantRing();
+
+	// Frees every frame whose fence is <= completedFence
+	void Retire(unsigned long long completedFence);
+
+	// Frame bracketing
+	void BeginFrame();
+	void EndFrame(unsigned long long fence);
+
+	// Returns false (and leaves offset alone) if there's no room
+	bool Allocate(unsigned int size, unsigned int& offset);
+
+	//Getters
+	unsigned int GetCapacity();
+	unsigned int GetUsedBytes(); // Including skipped tails
+	unsigned int GetFrameBytes(); // Allocated since BeginFrame()
+	unsigned int GetFramesInFlight();
+	unsigned int GetFailedCount(); // Allocations refused since BeginFrame()
+
+private:
+	struct FrameRegion
+	{
+		unsigned long long Fence;
+		unsigned int End; // Where the next frame's space starts
+		unsigned int Bytes;
+	};
+
+	unsigned int capacity;
+	unsigned int head; // Next free byte
+	unsigned int tail; // Oldest byte still in use
+	unsigned int used;
+	unsigned int frameBytes;
+	unsigned int failedCount;
+	std::deque<FrameRegion> frames;
+};
@@ -0,0 +1,68 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+static void Cpuid(int function, int subFunction, unsigned int registers[4])
+{
+#if defined(_MSC_VER)
+	int r[4];
+	__cpuidex(r, function, subFunction);
+	for (int i = 0; i < 4; i++)
+		registers[i] = (unsigned int)r[i];
+#else
+	__cpuid_count(function, subFunction, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// --------------------------------------------------------
+// AVX2 needs the CPU bit and the OS saving the upper halves
+// of the YMM registers, otherwise the first AVX instruction
+// faults
+// --------------------------------------------------------
+static bool DetectAVX2()
+{
+	unsigned int r[4];
+	Cpuid(0, 0, r);
+	if (r[0] < 7)
+		return false;
+
+	//OSXSAVE and AVX
+	Cpuid(1, 0, r);
+	if ((r[2] & (1u << 27)) == 0 || (r[2] & (1u << 28)) == 0)
+		return false;
+
+	//XMM and YMM state enabled by the OS
+#if defined(_MSC_VER)
+	unsigned long long xcr0 = _xgetbv(0);
+#else
+	unsigned int xcr0Low, xcr0High;
+	__asm__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+	unsigned long long xcr0 = ((unsigned long long)xcr0High << 32) | xcr0Low;
+#endif
+	if ((xcr0 & 6) != 6)
+		return false;
+
+	Cpuid(7, 0, r);
+	return (r[1] & (1u << 5)) != 0;
+}
+
+#else
+
+static bool DetectAVX2()
+{
+	return false;
+}
+
+#endif
+
+bool CpuHasAVX2()
+{
+	static const bool hasAVX2 = DetectAVX2();
+	return hasAVX2;
+}
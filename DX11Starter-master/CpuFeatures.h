@@ -0,0 +1,10 @@
+#pragma once
+
+// --------------------------------------------------------
+// Instruction sets the CPU (and OS) can run, checked once
+//
+// The project builds for plain x64. Only the files with an
+// AVX2 suffix are compiled with AVX2, and their functions
+// must only be called when this says it's available.
+// --------------------------------------------------------
+bool CpuHasAVX2();
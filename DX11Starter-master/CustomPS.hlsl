@@ -1,8 +1,12 @@
 #include "ShaderHelper.hlsli"
 
-cbuffer ExternalData : register(b0)
+// Same layout as PixelShader's, so materials can use either
+cbuffer PerMaterial : register(b1) // C++: MaterialConstants
 {
     float4 colorTint;
+    float2 scale;
+    float2 offset;
+    float roughness;
 }
 
 // --------------------------------------------------------
@@ -0,0 +1,357 @@
+#include "D3D11CommandExecutor.h"
+#include <cstring>
+#include <climits>
+
+D3D11CommandExecutor::D3D11CommandExecutor(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+	: constantRing(CONSTANT_RING_SIZE)
+{
+	this->device = device;
+	this->context = context;
+	filterRedundant = true;
+	uploadedBytes = 0;
+	ringMapped = false;
+	nextFence = 1;
+	completedFence = 0;
+	fallbackCount = 0;
+	memset(fallbackSizes, 0, sizeof(fallbackSizes));
+
+	//The ring needs offset binds and no-overwrite maps on constant buffers (11.1)
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) ||
+		!options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer ||
+		FAILED(context.As(&context1)))
+		return;
+
+	D3D11_BUFFER_DESC ringDesc = {};
+	ringDesc.ByteWidth = constantRing.GetCapacity();
+	ringDesc.Usage = D3D11_USAGE_DYNAMIC;
+	ringDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	ringDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (FAILED(device->CreateBuffer(&ringDesc, 0, ringBuffer.GetAddressOf())))
+		return;
+
+	D3D11_QUERY_DESC queryDesc = {};
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	for (unsigned int i = 0; i < CONSTANT_RING_FRAMES; i++)
+	{
+		if (FAILED(device->CreateQuery(&queryDesc, frameQueries[i].GetAddressOf())))
+		{
+			ringBuffer.Reset();
+			return;
+		}
+	}
+}
+
+D3D11CommandExecutor::~D3D11CommandExecutor()
+{
+}
+
+void D3D11CommandExecutor::Execute(const CommandBuffer& commands)
+{
+	const unsigned char* constantData = commands.GetConstantData();
+	const void* const* resourceLists = commands.GetResourceLists();
+	stateCache.Invalidate();
+	stateCache.ResetStats();
+	uploadedBytes = 0;
+	PlaceConstants(commands);
+	unsigned int setConstantsIndex = 0;
+
+	for (const Command& c : commands.GetCommands())
+	{
+		if (filterRedundant && !stateCache.Filter(c, resourceLists))
+			continue;
+
+		//The executor never owns anything, so these are plain casts
+		void* resource = const_cast<void*>(c.Resource);
+
+		switch (c.Type)
+		{
+		case CommandType::SetInputLayout:
+			context->IASetInputLayout((ID3D11InputLayout*)resource);
+			break;
+
+		case CommandType::SetShader:
+			if (c.Stage == ShaderStage::Vertex) context->VSSetShader((ID3D11VertexShader*)resource, 0, 0);
+			else context->PSSetShader((ID3D11PixelShader*)resource, 0, 0);
+			break;
+
+		case CommandType::SetVertexBuffer:
+		{
+			ID3D11Buffer* buffer = (ID3D11Buffer*)resource;
+			UINT stride = c.Args[0];
+			UINT offset = c.Args[1];
+			context->IASetVertexBuffers(c.Slot, 1, &buffer, &stride, &offset);
+			break;
+		}
+
+		case CommandType::SetIndexBuffer:
+			context->IASetIndexBuffer((ID3D11Buffer*)resource, DXGI_FORMAT_R32_UINT, 0);
+			break;
+
+		case CommandType::UpdateConstants:
+		{
+			//Constant buffers are dynamic, so each update discards the old contents
+			D3D11_MAPPED_SUBRESOURCE mapped = {};
+			if (FAILED(context->Map((ID3D11Buffer*)resource, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+				break;
+			memcpy(mapped.pData, constantData + c.Args[0], c.Args[1]);
+			context->Unmap((ID3D11Buffer*)resource, 0);
+			uploadedBytes += c.Args[1];
+			break;
+		}
+
+		case CommandType::SetConstantBuffer:
+		{
+			ID3D11Buffer* buffer = (ID3D11Buffer*)resource;
+			if (c.Stage == ShaderStage::Vertex) context->VSSetConstantBuffers(c.Slot, 1, &buffer);
+			else context->PSSetConstantBuffers(c.Slot, 1, &buffer);
+			break;
+		}
+
+		case CommandType::SetConstants:
+		{
+			unsigned int ringOffset = ringOffsets[setConstantsIndex++];
+			if (ringOffset == UINT_MAX)
+			{
+				SetFallbackConstants(c, constantData);
+				break;
+			}
+
+			//Offsets and sizes are in 16 byte constants, both multiples of 16
+			ID3D11Buffer* buffer = ringBuffer.Get();
+			UINT firstConstant = ringOffset / 16;
+			UINT constantCount = (c.Args[1] + CONSTANT_RING_ALIGNMENT - 1) / CONSTANT_RING_ALIGNMENT * (CONSTANT_RING_ALIGNMENT / 16);
+			if (c.Stage == ShaderStage::Vertex) context1->VSSetConstantBuffers1(c.Slot, 1, &buffer, &firstConstant, &constantCount);
+			else context1->PSSetConstantBuffers1(c.Slot, 1, &buffer, &firstConstant, &constantCount);
+			break;
+		}
+
+		case CommandType::SetShaderResource:
+		{
+			ID3D11ShaderResourceView* srv = (ID3D11ShaderResourceView*)resource;
+			if (c.Stage == ShaderStage::Vertex) context->VSSetShaderResources(c.Slot, 1, &srv);
+			else context->PSSetShaderResources(c.Slot, 1, &srv);
+			break;
+		}
+
+		case CommandType::SetSampler:
+		{
+			ID3D11SamplerState* sampler = (ID3D11SamplerState*)resource;
+			if (c.Stage == ShaderStage::Vertex) context->VSSetSamplers(c.Slot, 1, &sampler);
+			else context->PSSetSamplers(c.Slot, 1, &sampler);
+			break;
+		}
+
+		case CommandType::SetShaderResources:
+		{
+			ID3D11ShaderResourceView* const* srvs = (ID3D11ShaderResourceView* const*)(resourceLists + c.Args[1]);
+			if (c.Stage == ShaderStage::Vertex) context->VSSetShaderResources(c.Slot, c.Args[0], srvs);
+			else context->PSSetShaderResources(c.Slot, c.Args[0], srvs);
+			break;
+		}
+
+		case CommandType::SetSamplers:
+		{
+			ID3D11SamplerState* const* samplers = (ID3D11SamplerState* const*)(resourceLists + c.Args[1]);
+			if (c.Stage == ShaderStage::Vertex) context->VSSetSamplers(c.Slot, c.Args[0], samplers);
+			else context->PSSetSamplers(c.Slot, c.Args[0], samplers);
+			break;
+		}
+
+		case CommandType::SetRasterizerState:
+			context->RSSetState((ID3D11RasterizerState*)resource);
+			break;
+
+		case CommandType::SetDepthStencilState:
+			context->OMSetDepthStencilState((ID3D11DepthStencilState*)resource, 0);
+			break;
+
+		case CommandType::SetPipeline:
+		{
+			const PipelineState* pipeline = (const PipelineState*)c.Resource;
+			if (!pipeline)
+				break;
+
+			//Only the parts that differ from what's bound
+			unsigned int changes = filterRedundant ? stateCache.GetPipelineChanges() : PIPELINE_ALL;
+			if (changes & PIPELINE_VERTEX_SHADER) context->VSSetShader((ID3D11VertexShader*)pipeline->VertexShader, 0, 0);
+			if (changes & PIPELINE_PIXEL_SHADER) context->PSSetShader((ID3D11PixelShader*)pipeline->PixelShader, 0, 0);
+			if (changes & PIPELINE_INPUT_LAYOUT) context->IASetInputLayout((ID3D11InputLayout*)pipeline->InputLayout);
+			if (changes & PIPELINE_RASTERIZER) context->RSSetState((ID3D11RasterizerState*)pipeline->RasterizerState);
+			if (changes & PIPELINE_BLEND) context->OMSetBlendState((ID3D11BlendState*)pipeline->BlendState, 0, 0xFFFFFFFF);
+			if (changes & PIPELINE_DEPTH_STENCIL) context->OMSetDepthStencilState((ID3D11DepthStencilState*)pipeline->DepthStencilState, 0);
+			if (changes & PIPELINE_TOPOLOGY) context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)pipeline->Topology);
+			break;
+		}
+
+		case CommandType::DrawIndexed:
+			context->DrawIndexed(c.Args[0], c.Args[1], (INT)c.Args[2]);
+			break;
+
+		case CommandType::DrawIndexedInstanced:
+			context->DrawIndexedInstanced(c.Args[0], c.Args[1], c.Args[2], (INT)c.Args[3], c.Args[4]);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Reclaims ring space from frames the GPU has finished,
+// waiting for the oldest one if too many are in flight
+// --------------------------------------------------------
+void D3D11CommandExecutor::BeginFrame()
+{
+	fallbackCount = 0;
+	if (!ringBuffer)
+		return;
+
+	//Fences finish in order, so stop at the first one still running
+	while (completedFence + 1 < nextFence &&
+		context->GetData(frameQueries[(completedFence + 1) % CONSTANT_RING_FRAMES].Get(), 0, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK)
+	{
+		completedFence++;
+	}
+
+	//Every query is in use, the oldest has to finish before its slot is reused
+	if (nextFence - 1 - completedFence >= CONSTANT_RING_FRAMES)
+	{
+		while (context->GetData(frameQueries[(completedFence + 1) % CONSTANT_RING_FRAMES].Get(), 0, 0, 0) != S_OK) {}
+		completedFence++;
+	}
+
+	constantRing.Retire(completedFence);
+	constantRing.BeginFrame();
+}
+
+void D3D11CommandExecutor::EndFrame()
+{
+	if (!ringBuffer)
+		return;
+
+	unsigned long long fence = nextFence++;
+	constantRing.EndFrame(fence);
+	context->End(frameQueries[fence % CONSTANT_RING_FRAMES].Get());
+}
+
+// --------------------------------------------------------
+// Finds ring space for every SetConstants up front, so they
+// can all be written with one Map. No-overwrite is safe since
+// the ring never hands out space the GPU might still read.
+// --------------------------------------------------------
+void D3D11CommandExecutor::PlaceConstants(const CommandBuffer& commands)
+{
+	ringOffsets.clear();
+	bool anyPlaced = false;
+	for (const Command& c : commands.GetCommands())
+	{
+		if (c.Type != CommandType::SetConstants)
+			continue;
+
+		unsigned int offset = UINT_MAX;
+		if (ringBuffer)
+			constantRing.Allocate(c.Args[1], offset);
+		anyPlaced |= offset != UINT_MAX;
+		ringOffsets.push_back(offset);
+	}
+	if (!anyPlaced)
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(ringBuffer.Get(), 0, ringMapped ? D3D11_MAP_WRITE_NO_OVERWRITE : D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		ringOffsets.assign(ringOffsets.size(), UINT_MAX);
+		return;
+	}
+	ringMapped = true;
+
+	const unsigned char* constantData = commands.GetConstantData();
+	unsigned int index = 0;
+	for (const Command& c : commands.GetCommands())
+	{
+		if (c.Type != CommandType::SetConstants)
+			continue;
+
+		unsigned int offset = ringOffsets[index++];
+		if (offset == UINT_MAX)
+			continue;
+		memcpy((unsigned char*)mapped.pData + offset, constantData + c.Args[0], c.Args[1]);
+		uploadedBytes += c.Args[1];
+	}
+	context->Unmap(ringBuffer.Get(), 0);
+}
+
+// --------------------------------------------------------
+// SetConstants without the ring: a dynamic buffer per stage
+// and slot, mapped for every command
+// --------------------------------------------------------
+void D3D11CommandExecutor::SetFallbackConstants(const Command& c, const unsigned char* constantData)
+{
+	if (c.Slot >= MAX_CONSTANT_BUFFER_SLOTS)
+		return;
+
+	unsigned int stage = c.Stage == ShaderStage::Vertex ? 0 : 1;
+	unsigned int size = (c.Args[1] + 15) / 16 * 16;
+	Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer = fallbackBuffers[stage][c.Slot];
+	if (!buffer || fallbackSizes[stage][c.Slot] < size)
+	{
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = size;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		buffer.Reset();
+		if (FAILED(device->CreateBuffer(&desc, 0, buffer.GetAddressOf())))
+			return;
+		fallbackSizes[stage][c.Slot] = size;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, constantData + c.Args[0], c.Args[1]);
+	context->Unmap(buffer.Get(), 0);
+	uploadedBytes += c.Args[1];
+	fallbackCount++;
+
+	ID3D11Buffer* bound = buffer.Get();
+	if (c.Stage == ShaderStage::Vertex) context->VSSetConstantBuffers(c.Slot, 1, &bound);
+	else context->PSSetConstantBuffers(c.Slot, 1, &bound);
+}
+
+bool D3D11CommandExecutor::GetFilterRedundant()
+{
+	return filterRedundant;
+}
+
+unsigned int D3D11CommandExecutor::GetUploadedBytes()
+{
+	return uploadedBytes;
+}
+
+bool D3D11CommandExecutor::GetRingSupported()
+{
+	return ringBuffer.Get() != 0;
+}
+
+ConstantRing& D3D11CommandExecutor::GetConstantRing()
+{
+	return constantRing;
+}
+
+unsigned int D3D11CommandExecutor::GetFallbackCount()
+{
+	return fallbackCount;
+}
+
+StateCache& D3D11CommandExecutor::GetStateCache()
+{
+	return stateCache;
+}
+
+void D3D11CommandExecutor::SetFilterRedundant(bool filterRedundant)
+{
+	this->filterRedundant = filterRedundant;
+}
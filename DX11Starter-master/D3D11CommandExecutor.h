@@ -0,0 +1,79 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include "StateCache.h"
+#include "ConstantRing.h"
+#include <d3d11_1.h>
+#include <wrl/client.h>
+#include <vector>
+
+#define CONSTANT_RING_SIZE (4 * 1024 * 1024)
+#define CONSTANT_RING_FRAMES 3 // Frames the GPU can fall behind before BeginFrame() waits
+
+// --------------------------------------------------------
+// Plays a command buffer back on a Direct3D 11 context
+//
+// Resources in the buffer must be the matching ID3D11 objects
+// (shader pointers for SetShader, buffers for the buffer
+// commands, and so on)
+//
+// Bindings that match what's already bound are skipped (see
+// StateCache). The cache is cleared at the start of every
+// Execute, since the context may be used directly in between.
+//
+// SetConstants data is suballocated from one big ring buffer
+// (see ConstantRing), written with a single Map per Execute
+// and bound by offset with *SetConstantBuffers1. Space is
+// reused once an event query shows the GPU finished the
+// frame, so BeginFrame()/EndFrame() must bracket each frame.
+// Without Direct3D 11.1 offsets, or if the ring is full, each
+// SetConstants maps a small per slot buffer instead.
+// --------------------------------------------------------
+class D3D11CommandExecutor : public ICommandExecutor
+{
+public:
+	D3D11CommandExecutor(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	~D3D11CommandExecutor();
+
+	void Execute(const CommandBuffer& commands) override;
+
+	// Frame bracketing for the constant ring
+	void BeginFrame();
+	void EndFrame();
+
+	//Getters
+	bool GetFilterRedundant();
+	StateCache& GetStateCache(); // Stats are for the last Execute
+	unsigned int GetUploadedBytes(); // Constant bytes written in the last Execute
+	bool GetRingSupported();
+	ConstantRing& GetConstantRing();
+	unsigned int GetFallbackCount(); // SetConstants that missed the ring this frame
+
+	//Setters
+	void SetFilterRedundant(bool filterRedundant);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	StateCache stateCache;
+	bool filterRedundant;
+	unsigned int uploadedBytes;
+
+	//Constant ring
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> ringBuffer;
+	ConstantRing constantRing;
+	bool ringMapped; //First map has to discard
+	std::vector<unsigned int> ringOffsets; //Per SetConstants in the current Execute, UINT_MAX if not in the ring
+	Microsoft::WRL::ComPtr<ID3D11Query> frameQueries[CONSTANT_RING_FRAMES];
+	unsigned long long nextFence;
+	unsigned long long completedFence;
+
+	//Fallback
+	Microsoft::WRL::ComPtr<ID3D11Buffer> fallbackBuffers[2][MAX_CONSTANT_BUFFER_SLOTS];
+	unsigned int fallbackSizes[2][MAX_CONSTANT_BUFFER_SLOTS];
+	unsigned int fallbackCount;
+
+	void PlaceConstants(const CommandBuffer& commands);
+	void SetFallbackConstants(const Command& command, const unsigned char* constantData);
+};
@@ -0,0 +1,82 @@
+#include "D3D11PipelineFactory.h"
+
+//The defaults in PipelineState.h are these values
+static_assert(D3D11_FILL_SOLID == 3 && D3D11_CULL_BACK == 3, "Rasterizer defaults don't match D3D11");
+static_assert(D3D11_DEPTH_WRITE_MASK_ALL == 1 && D3D11_COMPARISON_LESS == 2 && D3D11_COMPARISON_ALWAYS == 8 &&
+	D3D11_STENCIL_OP_KEEP == 1, "Depth-stencil defaults don't match D3D11");
+static_assert(D3D11_BLEND_ONE == 2 && D3D11_BLEND_ZERO == 1 && D3D11_BLEND_OP_ADD == 1 &&
+	D3D11_COLOR_WRITE_ENABLE_ALL == 0xF, "Blend defaults don't match D3D11");
+static_assert(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST == 4, "Topology default doesn't match D3D11");
+
+D3D11PipelineFactory::D3D11PipelineFactory(Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	this->device = device;
+}
+
+D3D11PipelineFactory::~D3D11PipelineFactory()
+{
+}
+
+const void* D3D11PipelineFactory::CreateRasterizerState(const RasterizerStateDesc& desc)
+{
+	D3D11_RASTERIZER_DESC rastDesc = {};
+	rastDesc.FillMode = (D3D11_FILL_MODE)desc.FillMode;
+	rastDesc.CullMode = (D3D11_CULL_MODE)desc.CullMode;
+	rastDesc.FrontCounterClockwise = desc.FrontCounterClockwise;
+	rastDesc.DepthBias = desc.DepthBias;
+	rastDesc.DepthBiasClamp = desc.DepthBiasClamp;
+	rastDesc.SlopeScaledDepthBias = desc.SlopeScaledDepthBias;
+	rastDesc.DepthClipEnable = desc.DepthClipEnable;
+	rastDesc.ScissorEnable = desc.ScissorEnable;
+	rastDesc.MultisampleEnable = desc.MultisampleEnable;
+	rastDesc.AntialiasedLineEnable = desc.AntialiasedLineEnable;
+
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> state;
+	device->CreateRasterizerState(&rastDesc, state.GetAddressOf());
+	rasterizerStates.push_back(state);
+	return state.Get();
+}
+
+const void* D3D11PipelineFactory::CreateBlendState(const BlendStateDesc& desc)
+{
+	D3D11_BLEND_DESC blendDesc = {};
+	blendDesc.AlphaToCoverageEnable = desc.AlphaToCoverageEnable;
+	blendDesc.IndependentBlendEnable = false;
+	blendDesc.RenderTarget[0].BlendEnable = desc.BlendEnable;
+	blendDesc.RenderTarget[0].SrcBlend = (D3D11_BLEND)desc.SrcBlend;
+	blendDesc.RenderTarget[0].DestBlend = (D3D11_BLEND)desc.DestBlend;
+	blendDesc.RenderTarget[0].BlendOp = (D3D11_BLEND_OP)desc.BlendOp;
+	blendDesc.RenderTarget[0].SrcBlendAlpha = (D3D11_BLEND)desc.SrcBlendAlpha;
+	blendDesc.RenderTarget[0].DestBlendAlpha = (D3D11_BLEND)desc.DestBlendAlpha;
+	blendDesc.RenderTarget[0].BlendOpAlpha = (D3D11_BLEND_OP)desc.BlendOpAlpha;
+	blendDesc.RenderTarget[0].RenderTargetWriteMask = (UINT8)desc.RenderTargetWriteMask;
+
+	Microsoft::WRL::ComPtr<ID3D11BlendState> state;
+	device->CreateBlendState(&blendDesc, state.GetAddressOf());
+	blendStates.push_back(state);
+	return state.Get();
+}
+
+const void* D3D11PipelineFactory::CreateDepthStencilState(const DepthStencilStateDesc& desc)
+{
+	D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+	depthDesc.DepthEnable = desc.DepthEnable;
+	depthDesc.DepthWriteMask = (D3D11_DEPTH_WRITE_MASK)desc.DepthWriteMask;
+	depthDesc.DepthFunc = (D3D11_COMPARISON_FUNC)desc.DepthFunc;
+	depthDesc.StencilEnable = desc.StencilEnable;
+	depthDesc.StencilReadMask = (UINT8)desc.StencilReadMask;
+	depthDesc.StencilWriteMask = (UINT8)desc.StencilWriteMask;
+	depthDesc.FrontFace.StencilFailOp = (D3D11_STENCIL_OP)desc.FrontFace.StencilFailOp;
+	depthDesc.FrontFace.StencilDepthFailOp = (D3D11_STENCIL_OP)desc.FrontFace.StencilDepthFailOp;
+	depthDesc.FrontFace.StencilPassOp = (D3D11_STENCIL_OP)desc.FrontFace.StencilPassOp;
+	depthDesc.FrontFace.StencilFunc = (D3D11_COMPARISON_FUNC)desc.FrontFace.StencilFunc;
+	depthDesc.BackFace.StencilFailOp = (D3D11_STENCIL_OP)desc.BackFace.StencilFailOp;
+	depthDesc.BackFace.StencilDepthFailOp = (D3D11_STENCIL_OP)desc.BackFace.StencilDepthFailOp;
+	depthDesc.BackFace.StencilPassOp = (D3D11_STENCIL_OP)desc.BackFace.StencilPassOp;
+	depthDesc.BackFace.StencilFunc = (D3D11_COMPARISON_FUNC)desc.BackFace.StencilFunc;
+
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> state;
+	device->CreateDepthStencilState(&depthDesc, state.GetAddressOf());
+	depthStencilStates.push_back(state);
+	return state.Get();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "PipelineState.h"
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Makes the Direct3D 11 state objects behind a PipelineCache
+//
+// Descs are copied field for field into the D3D11 ones (the
+// enum values are the same), and every object is kept alive
+// here until the factory goes away. Blend states use the
+// same setup for every render target.
+// --------------------------------------------------------
+class D3D11PipelineFactory : public IPipelineStateFactory
+{
+public:
+	D3D11PipelineFactory(Microsoft::WRL::ComPtr<ID3D11Device> device);
+	~D3D11PipelineFactory();
+
+	const void* CreateRasterizerState(const RasterizerStateDesc& desc) override;
+	const void* CreateBlendState(const BlendStateDesc& desc) override;
+	const void* CreateDepthStencilState(const DepthStencilStateDesc& desc) override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11RasterizerState>> rasterizerStates;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11BlendState>> blendStates;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11DepthStencilState>> depthStencilStates;
+};
@@ -0,0 +1,123 @@
+#include "D3D11RenderGraphBackend.h"
+
+// --------------------------------------------------------
+// Typeless depth formats need a typed format for each view
+// --------------------------------------------------------
+static DXGI_FORMAT GetDepthViewFormat(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32_TYPELESS: return DXGI_FORMAT_D32_FLOAT;
+	case DXGI_FORMAT_R24G8_TYPELESS: return DXGI_FORMAT_D24_UNORM_S8_UINT;
+	case DXGI_FORMAT_R16_TYPELESS: return DXGI_FORMAT_D16_UNORM;
+	default: return format;
+	}
+}
+
+static DXGI_FORMAT GetShaderViewFormat(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32_TYPELESS: return DXGI_FORMAT_R32_FLOAT;
+	case DXGI_FORMAT_R24G8_TYPELESS: return DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+	case DXGI_FORMAT_R16_TYPELESS: return DXGI_FORMAT_R16_UNORM;
+	default: return format;
+	}
+}
+
+D3D11RenderGraphBackend::D3D11RenderGraphBackend(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	this->device = device;
+	this->context = context;
+	unbindCount = 0;
+}
+
+D3D11RenderGraphBackend::~D3D11RenderGraphBackend()
+{
+}
+
+void* D3D11RenderGraphBackend::CreateTexture(const RenderGraphTextureDesc& desc, unsigned int usage)
+{
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width = desc.Width;
+	textureDesc.Height = desc.Height;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = (DXGI_FORMAT)desc.Format;
+	textureDesc.MipLevels = 1;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	if (usage & RENDER_GRAPH_USAGE_SHADER_RESOURCE) textureDesc.BindFlags |= D3D11_BIND_SHADER_RESOURCE;
+	if (usage & RENDER_GRAPH_USAGE_RENDER_TARGET) textureDesc.BindFlags |= D3D11_BIND_RENDER_TARGET;
+	if (usage & RENDER_GRAPH_USAGE_DEPTH) textureDesc.BindFlags |= D3D11_BIND_DEPTH_STENCIL;
+
+	D3D11RenderGraphTexture* texture = new D3D11RenderGraphTexture();
+	device->CreateTexture2D(&textureDesc, 0, texture->Texture.GetAddressOf());
+	if (!texture->Texture)
+		return texture;
+
+	if (usage & RENDER_GRAPH_USAGE_RENDER_TARGET)
+		device->CreateRenderTargetView(texture->Texture.Get(), 0, texture->RTV.GetAddressOf());
+
+	if (usage & RENDER_GRAPH_USAGE_DEPTH)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = GetDepthViewFormat(textureDesc.Format);
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		device->CreateDepthStencilView(texture->Texture.Get(), &dsvDesc, texture->DSV.GetAddressOf());
+	}
+
+	if (usage & RENDER_GRAPH_USAGE_SHADER_RESOURCE)
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = GetShaderViewFormat(textureDesc.Format);
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = 1;
+		device->CreateShaderResourceView(texture->Texture.Get(), &srvDesc, texture->SRV.GetAddressOf());
+	}
+	return texture;
+}
+
+void D3D11RenderGraphBackend::ReleaseTexture(void* texture)
+{
+	delete (D3D11RenderGraphTexture*)texture;
+}
+
+// --------------------------------------------------------
+// One unbind of each kind covers every barrier before a pass
+// --------------------------------------------------------
+void D3D11RenderGraphBackend::Barriers(const RenderGraphBarrier* barriers, unsigned int count)
+{
+	bool unbindTargets = false;
+	bool unbindResources = false;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		bool wasWritten = barriers[i].Before == RenderGraphAccess::RenderTarget || barriers[i].Before == RenderGraphAccess::DepthWrite;
+		bool willBeWritten = barriers[i].After == RenderGraphAccess::RenderTarget || barriers[i].After == RenderGraphAccess::DepthWrite;
+		if (wasWritten && barriers[i].After == RenderGraphAccess::ShaderResource)
+			unbindTargets = true;
+		if (barriers[i].Before == RenderGraphAccess::ShaderResource && willBeWritten)
+			unbindResources = true;
+	}
+
+	if (unbindTargets)
+	{
+		context->OMSetRenderTargets(0, 0, 0);
+		unbindCount++;
+	}
+	if (unbindResources)
+	{
+		ID3D11ShaderResourceView* nullSRVs[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = {};
+		context->PSSetShaderResources(0, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, nullSRVs);
+		unbindCount++;
+	}
+}
+
+unsigned int D3D11RenderGraphBackend::GetUnbindCount()
+{
+	return unbindCount;
+}
+
+void D3D11RenderGraphBackend::ResetStats()
+{
+	unbindCount = 0;
+}
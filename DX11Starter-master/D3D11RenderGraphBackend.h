@@ -0,0 +1,48 @@
+#pragma once
+
+#include "RenderGraph.h"
+#include <d3d11.h>
+#include <wrl/client.h>
+
+// --------------------------------------------------------
+// What RenderGraph::GetTexture() points at with this backend.
+// Views are only made for the ways the graph saw it used.
+// Imported textures are one of these too, filled in by hand.
+// --------------------------------------------------------
+struct D3D11RenderGraphTexture
+{
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> RTV;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DSV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+};
+
+// --------------------------------------------------------
+// Makes the Direct3D 11 textures behind a RenderGraph
+//
+// Direct3D 11 has no explicit barriers, but it won't bind a
+// texture for reading and writing at once (the runtime quietly
+// unbinds one side). So a barrier from writing to reading
+// unbinds the render targets, and one from reading to writing
+// unbinds the pixel shader's resources, before the pass binds
+// its own.
+// --------------------------------------------------------
+class D3D11RenderGraphBackend : public IRenderGraphBackend
+{
+public:
+	D3D11RenderGraphBackend(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	~D3D11RenderGraphBackend();
+
+	void* CreateTexture(const RenderGraphTextureDesc& desc, unsigned int usage) override;
+	void ReleaseTexture(void* texture) override;
+	void Barriers(const RenderGraphBarrier* barriers, unsigned int count) override;
+
+	//Stats
+	unsigned int GetUnbindCount(); // Since the last ResetStats()
+	void ResetStats();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	unsigned int unbindCount;
+};
@@ -0,0 +1,39 @@
+#include "Lighting.hlsli"
+#include "GBuffer.hlsli"
+
+struct VertexToPixel
+{
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD0;
+};
+
+//Written by GBufferPS.hlsl
+Texture2D GBuffer0 : register(t0);
+Texture2D GBuffer1 : register(t1);
+Texture2D<float> GBufferDepth : register(t2);
+
+// --------------------------------------------------------
+// Lights the G-buffer in one full screen pass
+// - Lights come from the same clusters as the forward path,
+//   so each pixel only loops over what reaches it
+// - Pixels nothing was drawn to are left for the sky
+// --------------------------------------------------------
+float4 main(VertexToPixel input) : SV_TARGET
+{
+    int3 pixel = int3(input.position.xy, 0);
+    float depth = GBufferDepth.Load(pixel);
+    clip(depth < 1.0f ? 1.0f : -1.0f);
+
+    float3 albedo, normal;
+    float roughness, metalness;
+    UnpackGBuffer(GBuffer0.Load(pixel), GBuffer1.Load(pixel), albedo, normal, roughness, metalness);
+    albedo = pow(albedo, 2.2f);
+
+    float viewDepth;
+    float3 worldPosition = ReconstructWorldPosition(inverseViewProjection, input.uv, depth, viewDepth);
+
+    float3 light = ShadeClusteredLights(input.position.xy, viewDepth, worldPosition,
+                                        normal, albedo, roughness, metalness);
+
+    return float4(pow(light * albedo, 1.0f / 2.2f), 1);
+}
@@ -0,0 +1,175 @@
+#include "DepthComplexity.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Constructor
+//
+// width, height - Size of the grid in cells. Each cell stands
+//                 for a block of screen pixels, so a few
+//                 thousand cells are plenty.
+// --------------------------------------------------------
+DepthComplexityEstimator::DepthComplexityEstimator(unsigned int width, unsigned int height)
+{
+	this->width = width;
+	this->height = height;
+	layers.assign((width + 1) * (height + 1), 0);
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+	boxCount = 0;
+	overdraw = 0.0f;
+	coverage = 0.0f;
+	maxLayers = 0;
+	estimateSeconds = 0.0;
+}
+
+void DepthComplexityEstimator::Begin(const DirectX::XMFLOAT4X4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	std::fill(layers.begin(), layers.end(), 0);
+	boxCount = 0;
+	estimateSeconds = 0.0;
+}
+
+// --------------------------------------------------------
+// Adds the box's screen rectangle as four corner deltas, so
+// any size of box costs the same
+// - Boxes crossing the near plane cover the whole screen,
+//   as there's no sensible rectangle for them
+// --------------------------------------------------------
+void DepthComplexityEstimator::AddBox(const DirectX::BoundingBox& worldBounds)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	boxCount++;
+
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	worldBounds.GetCorners(corners);
+
+	const XMFLOAT4X4& m = viewProjection;
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	bool fullScreen = false;
+
+	for (size_t i = 0; i < BoundingBox::CORNER_COUNT; i++)
+	{
+		const XMFLOAT3& p = corners[i];
+		float cx = p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41;
+		float cy = p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42;
+		float cz = p.x * m._13 + p.y * m._23 + p.z * m._33 + m._43;
+		float cw = p.x * m._14 + p.y * m._24 + p.z * m._34 + m._44;
+
+		if (cz < 0.0f || cw <= 0.0f)
+		{
+			fullScreen = true;
+			break;
+		}
+
+		float invW = 1.0f / cw;
+		float sx = (cx * invW * 0.5f + 0.5f) * width;
+		float sy = (0.5f - cy * invW * 0.5f) * height;
+		minX = std::min(minX, sx);
+		maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy);
+		maxY = std::max(maxY, sy);
+	}
+
+	//Cells touched, end exclusive
+	unsigned int x0 = 0, y0 = 0, x1 = width, y1 = height;
+	if (!fullScreen)
+	{
+		x0 = (unsigned int)std::min((float)width, std::max(0.0f, std::floor(minX)));
+		x1 = (unsigned int)std::min((float)width, std::max(0.0f, std::ceil(maxX)));
+		y0 = (unsigned int)std::min((float)height, std::max(0.0f, std::floor(minY)));
+		y1 = (unsigned int)std::min((float)height, std::max(0.0f, std::ceil(maxY)));
+	}
+
+	if (x0 < x1 && y0 < y1)
+	{
+		unsigned int pitch = width + 1;
+		layers[y0 * pitch + x0]++;
+		layers[y0 * pitch + x1]--;
+		layers[y1 * pitch + x0]--;
+		layers[y1 * pitch + x1]++;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	estimateSeconds += std::chrono::duration<double>(end - start).count();
+}
+
+// --------------------------------------------------------
+// Sums the corner deltas along rows then columns, which
+// leaves each cell with the number of rectangles over it
+// --------------------------------------------------------
+void DepthComplexityEstimator::Resolve()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	unsigned int pitch = width + 1;
+	for (unsigned int y = 0; y < height; y++)
+	{
+		int* row = &layers[y * pitch];
+		for (unsigned int x = 1; x < width; x++)
+			row[x] += row[x - 1];
+	}
+
+	unsigned long long total = 0;
+	unsigned int covered = 0;
+	maxLayers = 0;
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			if (y > 0)
+				layers[y * pitch + x] += layers[(y - 1) * pitch + x];
+
+			unsigned int count = (unsigned int)layers[y * pitch + x];
+			total += count;
+			covered += count > 0 ? 1 : 0;
+			maxLayers = std::max(maxLayers, count);
+		}
+	}
+
+	overdraw = covered > 0 ? (float)((double)total / covered) : 0.0f;
+	coverage = (float)covered / (width * height);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	estimateSeconds += std::chrono::duration<double>(end - start).count();
+}
+
+unsigned int DepthComplexityEstimator::GetWidth()
+{
+	return width;
+}
+
+unsigned int DepthComplexityEstimator::GetHeight()
+{
+	return height;
+}
+
+unsigned int DepthComplexityEstimator::GetBoxCount()
+{
+	return boxCount;
+}
+
+float DepthComplexityEstimator::GetOverdraw()
+{
+	return overdraw;
+}
+
+float DepthComplexityEstimator::GetCoverage()
+{
+	return coverage;
+}
+
+unsigned int DepthComplexityEstimator::GetMaxLayers()
+{
+	return maxLayers;
+}
+
+double DepthComplexityEstimator::GetEstimateSeconds()
+{
+	return estimateSeconds;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Rough CPU estimate of how many times each pixel gets
+// shaded, to decide whether a depth pre-pass pays off
+//
+// Every opaque box adds its screen rectangle to a coarse
+// grid of counters. Rectangles overstate what a mesh really
+// covers, so the numbers are only good for comparing frames
+// against a threshold, not as an exact overdraw figure.
+//
+// Usage per frame:
+//  Begin() -> AddBox() ... -> Resolve() -> GetOverdraw()
+// --------------------------------------------------------
+class DepthComplexityEstimator
+{
+public:
+	DepthComplexityEstimator(unsigned int width, unsigned int height);
+
+	// Clears the grid and sets the camera for this frame
+	void Begin(const DirectX::XMFLOAT4X4& viewProjection);
+
+	// Counts one layer over the screen rectangle of a world space box
+	void AddBox(const DirectX::BoundingBox& worldBounds);
+
+	// Turns the rectangles into per cell layer counts and totals them
+	void Resolve();
+
+	//Getters
+	unsigned int GetWidth();
+	unsigned int GetHeight();
+	unsigned int GetBoxCount();
+	float GetOverdraw(); // Layers per covered cell, 0 if nothing is covered
+	float GetCoverage(); // Fraction of cells covered at least once
+	unsigned int GetMaxLayers();
+	double GetEstimateSeconds();
+
+private:
+	unsigned int width;
+	unsigned int height;
+	DirectX::XMFLOAT4X4 viewProjection;
+
+	//(width + 1) x (height + 1) so rectangle edges never need a
+	//bounds check. Holds corner deltas until Resolve() sums them.
+	std::vector<int> layers;
+
+	unsigned int boxCount;
+	float overdraw;
+	float coverage;
+	unsigned int maxLayers;
+	double estimateSeconds;
+};
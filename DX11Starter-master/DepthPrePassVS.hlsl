@@ -0,0 +1,26 @@
+#include "ShaderHelper.hlsli"
+
+// Only the first rows of InstanceData. The input layout is built
+// from this struct, so the rest of each instance is skipped over.
+struct InstanceInput
+{
+    float4 worldViewProjection0 : WORLD_VIEW_PROJECTION_PER_INSTANCE0;
+    float4 worldViewProjection1 : WORLD_VIEW_PROJECTION_PER_INSTANCE1;
+    float4 worldViewProjection2 : WORLD_VIEW_PROJECTION_PER_INSTANCE2;
+    float4 worldViewProjection3 : WORLD_VIEW_PROJECTION_PER_INSTANCE3;
+};
+
+// --------------------------------------------------------
+// Depth pre-pass, position only
+// - Must produce exactly the depth VertexShader.hlsl does, as
+//   the main pass then tests for equality. Same math in the
+//   same order, and precise so neither gets reordered.
+// --------------------------------------------------------
+float4 main( VertexShaderInput input, InstanceInput instance ) : SV_POSITION
+{
+    matrix wvp = transpose(float4x4(instance.worldViewProjection0, instance.worldViewProjection1,
+        instance.worldViewProjection2, instance.worldViewProjection3));
+
+    precise float4 screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+    return screenPosition;
+}
@@ -5,6 +5,8 @@ Entity::Entity(std::shared_ptr<Mesh> mesh , std::shared_ptr<Material> material)
     this->mesh = mesh;
     this->material = material;
     transform = std::make_shared<Transform>();
+    isOccluder = false;
+    isStatic = false;
 }
 
 Entity::~Entity()
@@ -26,7 +28,36 @@ std::shared_ptr<Material> Entity::GetMaterial()
     return material;
 }
 
+DirectX::BoundingBox Entity::GetWorldBounds()
+{
+    DirectX::XMFLOAT4X4 world = transform->GetWorldMatrix();
+
+    DirectX::BoundingBox worldBounds;
+    mesh->GetBounds().Transform(worldBounds, DirectX::XMLoadFloat4x4(&world));
+    return worldBounds;
+}
+
+bool Entity::GetIsOccluder()
+{
+    return isOccluder;
+}
+
+bool Entity::GetIsStatic()
+{
+    return isStatic;
+}
+
 void Entity::SetMaterial(std::shared_ptr<Material> material)
 {
     this->material = material;
 }
+
+void Entity::SetIsOccluder(bool isOccluder)
+{
+    this->isOccluder = isOccluder;
+}
+
+void Entity::SetIsStatic(bool isStatic)
+{
+    this->isStatic = isStatic;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <DirectXCollision.h>
 #include "Transform.h"
 #include "Mesh.h"
 #include "Material.h"
@@ -15,13 +16,20 @@ public:
 	std::shared_ptr<Transform> GetTransform();
 	std::shared_ptr<Mesh> GetMesh();
 	std::shared_ptr<Material> GetMaterial();
+	DirectX::BoundingBox GetWorldBounds();
+	bool GetIsOccluder();
+	bool GetIsStatic();
 
 	//Setters
 	void SetMaterial(std::shared_ptr<Material> material);
+	void SetIsOccluder(bool isOccluder);
+	void SetIsStatic(bool isStatic);
 
 private:
 	std::shared_ptr<Transform> transform;
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
+	bool isOccluder;
+	bool isStatic; //Static casters are drawn into the cached shadow map
 };
 
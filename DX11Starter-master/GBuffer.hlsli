@@ -0,0 +1,81 @@
+#ifndef __GBUFFER_INCLUDES__
+#define __GBUFFER_INCLUDES__
+
+// --------------------------------------------------------
+// G-buffer layout and packing, mirrored in C++ by
+// GBufferPacking.h/.cpp (keep the two in step)
+//
+// Two R8G8B8A8_UNORM targets:
+// - Target 0: albedo as sampled (gamma space), metalness
+// - Target 1: octahedral normal, 12 bits per axis over RGB,
+//   and roughness
+// Position is rebuilt from the depth buffer.
+// --------------------------------------------------------
+
+#define OCTAHEDRAL_MAX 4095.0f
+
+struct GBufferOutput
+{
+    float4 target0 : SV_TARGET0;
+    float4 target1 : SV_TARGET1;
+};
+
+// Unit vector to the [0, 1] square, lower half folded over the diagonals
+float2 EncodeOctahedral(float3 normal)
+{
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    if (normal.z < 0.0f)
+        normal.xy = (1.0f - abs(normal.yx)) * (normal.xy >= 0.0f ? 1.0f : -1.0f);
+    return normal.xy * 0.5f + 0.5f;
+}
+
+float3 DecodeOctahedral(float2 encoded)
+{
+    encoded = encoded * 2.0f - 1.0f;
+    float3 normal = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float t = saturate(-normal.z);
+    normal.xy += normal.xy >= 0.0f ? -t : t;
+    return normalize(normal);
+}
+
+// x's top 8 bits, x's low 4 with y's top 4, y's low 8
+float3 PackOctahedral12(float2 encoded)
+{
+    uint2 q = (uint2)(saturate(encoded) * OCTAHEDRAL_MAX + 0.5f);
+    return float3(q.x >> 4, ((q.x & 0xF) << 4) | (q.y >> 8), q.y & 0xFF) / 255.0f;
+}
+
+float2 UnpackOctahedral12(float3 packed)
+{
+    uint3 b = (uint3)(saturate(packed) * 255.0f + 0.5f);
+    return float2((b.x << 4) | (b.y >> 4), ((b.y & 0xF) << 8) | b.z) / OCTAHEDRAL_MAX;
+}
+
+GBufferOutput PackGBuffer(float3 albedo, float3 normal, float roughness, float metalness)
+{
+    GBufferOutput output;
+    output.target0 = float4(albedo, metalness);
+    output.target1 = float4(PackOctahedral12(EncodeOctahedral(normal)), roughness);
+    return output;
+}
+
+void UnpackGBuffer(float4 target0, float4 target1,
+                   out float3 albedo, out float3 normal, out float roughness, out float metalness)
+{
+    albedo = target0.rgb;
+    metalness = target0.a;
+    normal = DecodeOctahedral(UnpackOctahedral12(target1.rgb));
+    roughness = target1.a;
+}
+
+// World position of a pixel from its depth buffer value
+// - uv is 0 to 1 across the screen, (0, 0) top left
+// - viewDepth comes out as SV_Position.w would have been
+float3 ReconstructWorldPosition(matrix inverseViewProjection, float2 uv, float depth, out float viewDepth)
+{
+    float4 h = mul(inverseViewProjection, float4(uv.x * 2.0f - 1.0f, 1.0f - uv.y * 2.0f, depth, 1.0f));
+    viewDepth = 1.0f / h.w;
+    return h.xyz / h.w;
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include "ShaderHelper.hlsli"
+#include "GBuffer.hlsli"
+
+// Feature switches, set per variant (see ShaderVariants.h).
+// Shadows are the lighting pass's business, so only these two
+// matter here.
+#ifndef USE_NORMAL_MAP
+#define USE_NORMAL_MAP 1
+#endif
+#ifndef USE_ALPHA_TEST
+#define USE_ALPHA_TEST 0
+#endif
+
+#define ALPHA_TEST_THRESHOLD 0.5f
+
+// Same registers as PixelShader.hlsl, so a material's
+// binding tables work for either shader
+cbuffer PerMaterial : register(b1) // C++: MaterialConstants
+{
+    float4 colorTint;
+    float2 scale;
+    float2 offset;
+    float roughness;
+}
+
+SamplerState BasicSampler : register(s0);
+
+//Textures
+Texture2D Albedo : register(t0);
+Texture2D NormalMap : register(t1);
+Texture2D RoughnessMap : register(t2);
+Texture2D MetalnessMap : register(t3);
+
+// --------------------------------------------------------
+// Writes the surface to the G-buffer for the deferred path.
+// Does the same texture work as PixelShader.hlsl, and none
+// of the lighting.
+// --------------------------------------------------------
+GBufferOutput main(VertexToPixel input)
+{
+    //Scale
+    float2 scaleCenter = float2(0.5f, 0.5f);
+    input.uv = (input.uv - scaleCenter) * scale + scaleCenter;
+
+    //Offset
+    input.uv += offset;
+
+    float4 albedoSample = Albedo.Sample(BasicSampler, input.uv);
+#if USE_ALPHA_TEST
+    clip(albedoSample.a - ALPHA_TEST_THRESHOLD);
+#endif
+
+    //Normal
+#if USE_NORMAL_MAP
+    float3 unpackedNormal = normalize(NormalMap.Sample(BasicSampler, input.uv).rgb * 2 - 1);
+    float3 N = normalize(input.normal);
+    float3 T = normalize(input.tangent);
+    T = normalize(T - N * dot(T, N));
+    float3 B = cross(T, N);
+    float3x3 TBN = float3x3(T, B, N);
+    float3 normal = normalize(mul(unpackedNormal, TBN));
+#else
+    float3 normal = normalize(input.normal);
+#endif
+
+    //Albedo stays as sampled, 8 bits go further in gamma space
+    return PackGBuffer(albedoSample.rgb, normal,
+        RoughnessMap.Sample(BasicSampler, input.uv).r,
+        MetalnessMap.Sample(BasicSampler, input.uv).r);
+}
@@ -0,0 +1,128 @@
+#include "GBufferPacking.h"
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Largest value of a 12 bit channel
+#define OCTAHEDRAL_MAX 4095.0f
+
+// Same as the GPU's float to UNORM conversion
+static unsigned int ToUnorm8(float value)
+{
+	value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	return (unsigned int)floorf(value * 255.0f + 0.5f);
+}
+
+static float FromUnorm8(unsigned int value)
+{
+	return (value & 0xFF) / 255.0f;
+}
+
+static float SignNotZero(float value)
+{
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+// --------------------------------------------------------
+// Projects onto the octahedron |x| + |y| + |z| = 1, folding
+// the lower half over the diagonals so it fills the square
+// --------------------------------------------------------
+XMFLOAT2 EncodeOctahedral(XMFLOAT3 normal)
+{
+	float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	float x = normal.x / length;
+	float y = normal.y / length;
+	if (normal.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+		float foldedY = (1.0f - fabsf(x)) * SignNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+	return XMFLOAT2(x * 0.5f + 0.5f, y * 0.5f + 0.5f);
+}
+
+XMFLOAT3 DecodeOctahedral(XMFLOAT2 encoded)
+{
+	float x = encoded.x * 2.0f - 1.0f;
+	float y = encoded.y * 2.0f - 1.0f;
+	float z = 1.0f - fabsf(x) - fabsf(y);
+
+	//Unfold the lower half
+	float t = z < 0.0f ? -z : 0.0f;
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	float length = sqrtf(x * x + y * y + z * z);
+	return XMFLOAT3(x / length, y / length, z / length);
+}
+
+// --------------------------------------------------------
+// x's top 8 bits, x's low 4 with y's top 4, y's low 8
+// --------------------------------------------------------
+XMFLOAT3 PackOctahedral12(XMFLOAT2 encoded)
+{
+	float clampedX = encoded.x < 0.0f ? 0.0f : (encoded.x > 1.0f ? 1.0f : encoded.x);
+	float clampedY = encoded.y < 0.0f ? 0.0f : (encoded.y > 1.0f ? 1.0f : encoded.y);
+	unsigned int x = (unsigned int)floorf(clampedX * OCTAHEDRAL_MAX + 0.5f);
+	unsigned int y = (unsigned int)floorf(clampedY * OCTAHEDRAL_MAX + 0.5f);
+	return XMFLOAT3(
+		(x >> 4) / 255.0f,
+		(((x & 0xF) << 4) | (y >> 8)) / 255.0f,
+		(y & 0xFF) / 255.0f);
+}
+
+XMFLOAT2 UnpackOctahedral12(XMFLOAT3 packed)
+{
+	unsigned int r = ToUnorm8(packed.x);
+	unsigned int g = ToUnorm8(packed.y);
+	unsigned int b = ToUnorm8(packed.z);
+	unsigned int x = (r << 4) | (g >> 4);
+	unsigned int y = ((g & 0xF) << 8) | b;
+	return XMFLOAT2(x / OCTAHEDRAL_MAX, y / OCTAHEDRAL_MAX);
+}
+
+GBufferTexel PackGBuffer(const GBufferSurface& surface)
+{
+	XMFLOAT3 normal = PackOctahedral12(EncodeOctahedral(surface.Normal));
+
+	GBufferTexel texel;
+	texel.Target0 = ToUnorm8(surface.Albedo.x) | (ToUnorm8(surface.Albedo.y) << 8) |
+		(ToUnorm8(surface.Albedo.z) << 16) | (ToUnorm8(surface.Metalness) << 24);
+	texel.Target1 = ToUnorm8(normal.x) | (ToUnorm8(normal.y) << 8) |
+		(ToUnorm8(normal.z) << 16) | (ToUnorm8(surface.Roughness) << 24);
+	return texel;
+}
+
+GBufferSurface UnpackGBuffer(const GBufferTexel& texel)
+{
+	GBufferSurface surface;
+	surface.Albedo = XMFLOAT3(FromUnorm8(texel.Target0), FromUnorm8(texel.Target0 >> 8), FromUnorm8(texel.Target0 >> 16));
+	surface.Metalness = FromUnorm8(texel.Target0 >> 24);
+
+	XMFLOAT3 normal(FromUnorm8(texel.Target1), FromUnorm8(texel.Target1 >> 8), FromUnorm8(texel.Target1 >> 16));
+	surface.Normal = DecodeOctahedral(UnpackOctahedral12(normal));
+	surface.Roughness = FromUnorm8(texel.Target1 >> 24);
+	return surface;
+}
+
+// --------------------------------------------------------
+// Un-projects the pixel. The homogeneous w that comes out
+// is 1 / view depth, since projecting multiplied by it.
+// --------------------------------------------------------
+XMFLOAT3 ReconstructWorldPosition(const XMFLOAT4X4& inverseViewProjection, XMFLOAT2 uv, float depth, float* viewDepth)
+{
+	float ndc[4] = { uv.x * 2.0f - 1.0f, 1.0f - uv.y * 2.0f, depth, 1.0f };
+	float h[4];
+	for (int column = 0; column < 4; column++)
+	{
+		h[column] = 0.0f;
+		for (int row = 0; row < 4; row++)
+			h[column] += ndc[row] * inverseViewProjection.m[row][column];
+	}
+
+	if (viewDepth)
+		*viewDepth = 1.0f / h[3];
+	return XMFLOAT3(h[0] / h[3], h[1] / h[3], h[2] / h[3]);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// The deferred path's G-buffer layout, and a CPU copy of the
+// packing the shaders do (GBuffer.hlsli), line for line, so
+// the layout can be checked and reasoned about off the GPU
+//
+// Two R8G8B8A8_UNORM targets, 8 bytes a pixel:
+// - Target 0: albedo as sampled (gamma space), metalness
+// - Target 1: normal, octahedral with 12 bits per axis split
+//   over RGB, and roughness
+// Position isn't stored: it comes back from the depth buffer
+// and the inverse view-projection matrix.
+// --------------------------------------------------------
+
+// What the lighting pass needs about a surface
+struct GBufferSurface
+{
+	DirectX::XMFLOAT3 Albedo;
+	DirectX::XMFLOAT3 Normal; // World space, unit length
+	float Roughness;
+	float Metalness;
+};
+
+// One pixel of each target, red in the low byte (as DXGI lays out R8G8B8A8)
+struct GBufferTexel
+{
+	unsigned int Target0;
+	unsigned int Target1;
+};
+
+// Unit vector to the [0, 1] square and back
+DirectX::XMFLOAT2 EncodeOctahedral(DirectX::XMFLOAT3 normal);
+DirectX::XMFLOAT3 DecodeOctahedral(DirectX::XMFLOAT2 encoded);
+
+// Octahedral coordinates to 12 + 12 bits in three 8 bit channels ([0, 1] each) and back
+DirectX::XMFLOAT3 PackOctahedral12(DirectX::XMFLOAT2 encoded);
+DirectX::XMFLOAT2 UnpackOctahedral12(DirectX::XMFLOAT3 packed);
+
+GBufferTexel PackGBuffer(const GBufferSurface& surface);
+GBufferSurface UnpackGBuffer(const GBufferTexel& texel);
+
+// World position of a pixel from its depth buffer value
+// uv        - 0 to 1 across the screen, (0, 0) top left
+// viewDepth - Set to the view space depth, as SV_Position.w would be
+DirectX::XMFLOAT3 ReconstructWorldPosition(const DirectX::XMFLOAT4X4& inverseViewProjection,
+	DirectX::XMFLOAT2 uv, float depth, float* viewDepth = 0);
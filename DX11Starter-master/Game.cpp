@@ -4,8 +4,12 @@
 #include "Input.h"
 #include "PathHelpers.h"
 #include "BufferStructs.h"
+#include "MatrixBatch.h"
+#include "GBufferPacking.h"
 #include <memory>
 #include <vector>
+#include <algorithm>
+#include <chrono>
 
 #include "WICTextureLoader.h"
 
@@ -58,9 +62,51 @@ Game::Game(HINSTANCE hInstance)
 
 	cameras = { camera, camera1, camera2 };
 
-	shadowMapRes = 1024.0f;
+	//Four 512 cascades use the same memory as a single 1024 map
+	shadowMapRes = 512.0f;
+	shadowCascades = std::make_unique<ShadowCascades>(shadowMapRes);
+	shadowCacheEnabled = true;
+	cachedStaticVersion = 0;
+	cachedLightDirection = XMFLOAT3(0, 0, 0);
+	staticShadowRedraws = 0;
+	for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+	{
+		shadowCacheValid[i] = false;
+		XMStoreFloat4x4(&cachedCascadeMatrices[i], XMMatrixIdentity());
+	}
 
 	blurRadius = 5;
+
+	instanceBufferCapacity = 0;
+	lightBufferCapacity = 0;
+	lightsUploaded = 0;
+
+	//One pool of worker threads for all CPU side frame work
+	threadPool = std::make_unique<ThreadPool>();
+
+	//120 pixel tiles at 1080p, depth split into 24 exponential slices
+	lightClusterer = std::make_unique<LightClusterer>(16, 9, 24, threadPool.get());
+	clusterIndexCapacity = 0;
+
+	//Forward until switched in ImGui
+	deferredShading = false;
+	gBufferBatchCount = 0;
+	frameMilliseconds[0] = 0.0f;
+	frameMilliseconds[1] = 0.0f;
+
+	//Overdraw is estimated on a grid of 16 pixel cells at 720p
+	depthComplexity = std::make_unique<DepthComplexityEstimator>(80, 45);
+	depthPrePassPipeline = 0;
+	depthPrePassMode = DEPTH_PRE_PASS_AUTO;
+	overdrawThreshold = 1.5f;
+	depthPrePassActive = false;
+
+	validateCommands = false;
+	recordSeconds = 0.0;
+
+	//Low resolution software depth buffer for occlusion culling
+	occlusionCuller = std::make_unique<OcclusionCuller>(320, 180, threadPool.get());
+	occlusionCullingEnabled = true;
 }
 
 // --------------------------------------------------------
@@ -89,11 +135,22 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	//Pipelines are built while loading, so the cache comes first
+	pipelineFactory = std::make_unique<D3D11PipelineFactory>(device);
+	pipelineCache = std::make_unique<PipelineCache>(pipelineFactory.get());
+
+	//Screen sized targets come from the render graph's pool
+	renderGraphBackend = std::make_unique<D3D11RenderGraphBackend>(device, context);
+	frameGraph = std::make_unique<RenderGraph>(renderGraphBackend.get());
+
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
 	LoadShaders();
 	CreateGeometry();
+
+	//Plays back the recorded scene each frame
+	commandExecutor = std::make_unique<D3D11CommandExecutor>(device, context);
 	
 	// Set initial graphics API state
 	//  - These settings persist until we change them
@@ -114,17 +171,6 @@ void Game::Init()
 		//    these calls will need to happen multiple times per frame
 	}
 
-	//Get the constant buffer size
-	unsigned int size = sizeof(VertexShaderExternalData);
-	size = (size + 15) / 16 * 16;
-
-	//Describe the constant buffer
-	D3D11_BUFFER_DESC cbDesc	= {};
-	cbDesc.BindFlags			= D3D11_BIND_CONSTANT_BUFFER;
-	cbDesc.ByteWidth			= size;
-	cbDesc.CPUAccessFlags		= D3D10_CPU_ACCESS_WRITE;
-	cbDesc.Usage				= D3D11_USAGE_DYNAMIC;
-
 	//Initialize Colortint and offset shader
 	IMGUI_colorTint = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	IMGUI_world = XMFLOAT4X4(
@@ -136,43 +182,40 @@ void Game::Init()
 	//Lights
 	ambientColor = XMFLOAT3(0.969f, 0.6f, 0.0f);
 
-	directionalLight = {};
-	directionalLight.Type = LIGHT_TYPE_DIRECTIONAL;
-	directionalLight.Direction = XMFLOAT3(0.5f, -0.5f, 0.5f);
-	directionalLight.Color = XMFLOAT3(1.0f, 0.0f, 0.0f);
-	directionalLight.Intensity = 5.0f;
-
-	directionalLight2 = {};
-	directionalLight2.Type = LIGHT_TYPE_DIRECTIONAL;
-	directionalLight2.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
-	directionalLight2.Color = XMFLOAT3(0.0f, 1.0f, 0.0f);
-	directionalLight2.Intensity = 5.0f;
-
-	directionalLight3 = {};
-	directionalLight3.Type = LIGHT_TYPE_DIRECTIONAL;
-	directionalLight3.Direction = XMFLOAT3(-1.0f, 0.0f, 0.0f);
-	directionalLight3.Color = XMFLOAT3(0.0f, 0.0f, 1.0f);
-	directionalLight3.Intensity = 5.0f;
-	
-	pointLight = {};
-	pointLight.Type = LIGHT_TYPE_POINT;
-	pointLight.Position = XMFLOAT3(-3.0f, 2.0f, -2.0f);
-	pointLight.Color = XMFLOAT3(0.0f, 0.5f, 0.8f);
-	pointLight.Intensity = 5.0f;
-	pointLight.Range = 10.0f;
-
-	pointLight2 = {};
-	pointLight2.Type = LIGHT_TYPE_POINT;
-	pointLight2.Position = XMFLOAT3(3.0f, -2.0f, -2.0f);
-	pointLight2.Color = XMFLOAT3(0.8f, 0.5f, 0.0f);
-	pointLight2.Intensity = 5.0f;
-	pointLight.Range = 10.0f;
-
-	//Shadow Map
+	Light light = {};
+	light.Type = LIGHT_TYPE_DIRECTIONAL;
+	light.Direction = XMFLOAT3(0.5f, -0.5f, 0.5f);
+	light.Color = XMFLOAT3(1.0f, 0.0f, 0.0f);
+	light.Intensity = 5.0f;
+	light.ShadowTile = -1;
+	cascadeLight = lightManager.Add(light);
+
+	light.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+	light.Color = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	lightManager.Add(light);
+
+	light.Direction = XMFLOAT3(-1.0f, 0.0f, 0.0f);
+	light.Color = XMFLOAT3(0.0f, 0.0f, 1.0f);
+	lightManager.Add(light);
+
+	light = {};
+	light.Type = LIGHT_TYPE_POINT;
+	light.Position = XMFLOAT3(-3.0f, 2.0f, -2.0f);
+	light.Color = XMFLOAT3(0.0f, 0.5f, 0.8f);
+	light.Intensity = 5.0f;
+	light.Range = 10.0f;
+	light.ShadowTile = -1;
+	LightHandle pointLight = lightManager.Add(light);
+
+	light.Position = XMFLOAT3(3.0f, -2.0f, -2.0f);
+	light.Color = XMFLOAT3(0.8f, 0.5f, 0.0f);
+	LightHandle pointLight2 = lightManager.Add(light);
+
+	//Shadow Map, one array slice per cascade
 	D3D11_TEXTURE2D_DESC shadowDesc = {};
 	shadowDesc.Width = shadowMapRes;
 	shadowDesc.Height = shadowMapRes;
-	shadowDesc.ArraySize = 1;
+	shadowDesc.ArraySize = SHADOW_CASCADE_COUNT;
 	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
 	shadowDesc.CPUAccessFlags = 0;
 	shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS;
@@ -181,38 +224,48 @@ void Game::Init()
 	shadowDesc.SampleDesc.Count = 1;
 	shadowDesc.SampleDesc.Quality = 0;
 	shadowDesc.Usage = D3D11_USAGE_DEFAULT;
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
 	device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
 
-	D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
-	shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-	shadowDSDesc.Texture2D.MipSlice = 0;
-	device->CreateDepthStencilView(shadowTexture.Get(), &shadowDSDesc, shadowDSV.GetAddressOf());
+	//Same layout again, holding only the static casters
+	device->CreateTexture2D(&shadowDesc, 0, staticShadowTexture.GetAddressOf());
+
+	for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+	{
+		D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
+		shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
+		shadowDSDesc.Texture2DArray.MipSlice = 0;
+		shadowDSDesc.Texture2DArray.FirstArraySlice = i;
+		shadowDSDesc.Texture2DArray.ArraySize = 1;
+		device->CreateDepthStencilView(shadowTexture.Get(), &shadowDSDesc, shadowDSVs[i].GetAddressOf());
+		device->CreateDepthStencilView(staticShadowTexture.Get(), &shadowDSDesc, staticShadowDSVs[i].GetAddressOf());
+	}
 
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MipLevels = 1;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ArraySize = SHADOW_CASCADE_COUNT;
 	device->CreateShaderResourceView(shadowTexture.Get(), &srvDesc, shadowSRV.GetAddressOf());
 
-	//Creating light matricies
-	XMVECTOR direction = XMVectorSet(directionalLight.Direction.x, directionalLight.Direction.y, directionalLight.Direction.z, 0.0f);
-	XMMATRIX lightView = XMMatrixLookToLH(-direction * 20, direction, XMVectorSet(0, 1, 0, 0));
-	XMStoreFloat4x4(&lightViewMatrix, lightView);
+	//Light matricies are rebuilt every frame in UpdateShadowCascades()
 
-	float lightProjectionSize = 15.0f;
-	XMMATRIX lightProjection = XMMatrixOrthographicLH(lightProjectionSize, lightProjectionSize, 1.0f, 100.0f);
-	XMStoreFloat4x4(&lightProjectMatrix, lightProjection);
+	//Depth only, biased against acne
+	PipelineDesc shadowDesc;
+	shadowDesc.VertexShader = shadowVS->GetDirectXShader().Get();
+	shadowDesc.InputLayout = shadowVS->GetInputLayout().Get();
+	shadowDesc.Rasterizer.DepthBias = 1000;
+	shadowDesc.Rasterizer.SlopeScaledDepthBias = 1.0f;
+	shadowPipeline = pipelineCache->GetPipeline(shadowDesc);
 
-	D3D11_RASTERIZER_DESC shadowRastDesc = {};
-	shadowRastDesc.FillMode = D3D11_FILL_SOLID;
-	shadowRastDesc.CullMode = D3D11_CULL_BACK;
-	shadowRastDesc.DepthClipEnable = true;
-	shadowRastDesc.DepthBias = 1000;
-	shadowRastDesc.SlopeScaledDepthBias = 1.0f;
-	device->CreateRasterizerState(&shadowRastDesc, shadowRasterizer.GetAddressOf());
+	//Depth only, and no colour writes to whatever target is bound
+	PipelineDesc prePassDesc;
+	prePassDesc.VertexShader = depthPrePassVS->GetDirectXShader().Get();
+	prePassDesc.InputLayout = depthPrePassVS->GetInputLayout().Get();
+	prePassDesc.Blend.RenderTargetWriteMask = 0;
+	depthPrePassPipeline = pipelineCache->GetPipeline(prePassDesc);
 
 	D3D11_SAMPLER_DESC shadowSampDesc = {};
 	shadowSampDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR;
@@ -223,6 +276,46 @@ void Game::Init()
 	shadowSampDesc.BorderColor[0] = 1.0f;
 	device->CreateSamplerState(&shadowSampDesc, shadowSampler.GetAddressOf());
 
+	//Shadow atlas, shared by every shadowed point light
+	shadowAtlas = std::make_unique<ShadowAtlas>(4096, 64, 1024);
+
+	D3D11_TEXTURE2D_DESC atlasDesc = shadowDesc;
+	atlasDesc.Width = shadowAtlas->GetAtlasSize();
+	atlasDesc.Height = shadowAtlas->GetAtlasSize();
+	atlasDesc.ArraySize = 1;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> atlasTexture;
+	device->CreateTexture2D(&atlasDesc, 0, atlasTexture.GetAddressOf());
+
+	D3D11_DEPTH_STENCIL_VIEW_DESC atlasDSDesc = {};
+	atlasDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	atlasDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	atlasDSDesc.Texture2D.MipSlice = 0;
+	device->CreateDepthStencilView(atlasTexture.Get(), &atlasDSDesc, shadowAtlasDSV.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC atlasSRVDesc = {};
+	atlasSRVDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	atlasSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	atlasSRVDesc.Texture2D.MipLevels = 1;
+	atlasSRVDesc.Texture2D.MostDetailedMip = 0;
+	device->CreateShaderResourceView(atlasTexture.Get(), &atlasSRVDesc, shadowAtlasSRV.GetAddressOf());
+
+	//Tiles are cleared one at a time by drawing a triangle forced to the far plane
+	D3D11_DEPTH_STENCIL_DESC atlasClearDesc = {};
+	atlasClearDesc.DepthEnable = true;
+	atlasClearDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+	atlasClearDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+	device->CreateDepthStencilState(&atlasClearDesc, shadowAtlasClearState.GetAddressOf());
+
+	shadowedLights.clear();
+	for (LightHandle handle : { pointLight, pointLight2 })
+	{
+		ShadowedLight shadowed = {};
+		shadowed.Source = handle;
+		shadowed.FirstTile = -1;
+		shadowedLights.push_back(shadowed);
+	}
+	atlasTilesRendered = 0;
+
 	//Post Process Sampler
 	D3D11_SAMPLER_DESC ppSampDesc = {};
 	ppSampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
@@ -232,30 +325,19 @@ void Game::Init()
 	ppSampDesc.MaxLOD = D3D11_FLOAT32_MAX;
 	device->CreateSamplerState(&ppSampDesc, ppSampler.GetAddressOf());
 
-	D3D11_TEXTURE2D_DESC textureDesc = {};
-	textureDesc.Width = windowWidth;
-	textureDesc.Height = windowHeight;
-	textureDesc.ArraySize = 1;
-	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-	textureDesc.CPUAccessFlags = 0;
-	textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	textureDesc.MipLevels = 1;
-	textureDesc.MiscFlags = 0;
-	textureDesc.SampleDesc.Count = 1;
-	textureDesc.SampleDesc.Quality = 0;
-	textureDesc.Usage = D3D11_USAGE_DEFAULT;
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> ppTexture;
-	device->CreateTexture2D(&textureDesc, 0, ppTexture.GetAddressOf());
-
-	//Create Render Target View
-	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-	rtvDesc.Format = textureDesc.Format;
-	rtvDesc.Texture2D.MipSlice = 0;
-	rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-	device->CreateRenderTargetView(ppTexture.Get(), &rtvDesc, ppRTV.ReleaseAndGetAddressOf());
-	
-	//Create SRV
-	device->CreateShaderResourceView(ppTexture.Get(), 0, ppSRV.ReleaseAndGetAddressOf());
+	//Occlusion culling debug view
+	D3D11_TEXTURE2D_DESC occlusionDesc = {};
+	occlusionDesc.Width = occlusionCuller->GetWidth();
+	occlusionDesc.Height = occlusionCuller->GetHeight();
+	occlusionDesc.ArraySize = 1;
+	occlusionDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	occlusionDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	occlusionDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	occlusionDesc.MipLevels = 1;
+	occlusionDesc.SampleDesc.Count = 1;
+	occlusionDesc.Usage = D3D11_USAGE_DYNAMIC;
+	device->CreateTexture2D(&occlusionDesc, 0, occlusionDebugTexture.GetAddressOf());
+	device->CreateShaderResourceView(occlusionDebugTexture.Get(), 0, occlusionDebugSRV.GetAddressOf());
 
 	// Initialize ImGui itself & platform/renderer backends
 	IMGUI_CHECKVERSION();
@@ -278,12 +360,18 @@ void Game::LoadShaders()
 {
 	vertexShader = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VertexShader.cso").c_str());
 	pixelShader = std::make_shared<SimplePixelShader>(device, context, FixPath(L"PixelShader.cso").c_str());
+	pixelShaderVariants = std::make_shared<PixelShaderVariants>(device, context, FixPath(L"../../PixelShader.hlsl"), FixPath(L""), pixelShader);
 	psCustom = std::make_shared<SimplePixelShader>(device, context, FixPath(L"CustomPS.cso").c_str());
 	skyPixelShader = std::make_shared<SimplePixelShader>(device, context, FixPath(L"SkyPixelShader.cso").c_str());
 	skyVertexShader = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"SkyVertexShader.cso").c_str());
 	shadowVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"ShadowVertexShader.cso").c_str());
+	shadowObjectSlot = shadowVS->GetBufferInfo("PerObject")->BindIndex;
 	ppVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"FullscreenVertexShader.cso").c_str());
 	ppPS = std::make_shared < SimplePixelShader > (device, context, FixPath(L"PostProcessPixelShader.cso").c_str());
+	gBufferPS = std::make_shared<SimplePixelShader>(device, context, FixPath(L"GBufferPS.cso").c_str());
+	gBufferVariants = std::make_shared<PixelShaderVariants>(device, context, FixPath(L"../../GBufferPS.hlsl"), FixPath(L""), gBufferPS);
+	deferredLightingPS = std::make_shared<SimplePixelShader>(device, context, FixPath(L"DeferredLightingPS.cso").c_str());
+	depthPrePassVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"DepthPrePassVS.cso").c_str());
 }
 
 
@@ -342,6 +430,7 @@ void Game::CreateGeometry()
 		context,
 		skyVertexShader,
 		skyPixelShader,
+		*pipelineCache,
 		FixPath(L"../../Assets/Skies/Planet/right.png").c_str(),
 		FixPath(L"../../Assets/Skies/Planet/left.png").c_str(),
 		FixPath(L"../../Assets/Skies/Planet/up.png").c_str(),
@@ -386,6 +475,14 @@ void Game::CreateGeometry()
 		pixelShader,
 		vertexShader);
 
+	//Each material picks its own variant of the pixel shader,
+	//and of the G-buffer shader for the deferred path
+	for (std::shared_ptr<Material> m : { material, material1, material2, material3, material4 })
+	{
+		m->SetShaderVariants(pixelShaderVariants);
+		m->SetGBufferVariants(gBufferVariants);
+	}
+
 	//Add Textures and Samplers to Materials
 	//Samplers
 	material->AddSampler("BasicSampler", sampler);
@@ -439,6 +536,10 @@ void Game::CreateGeometry()
 
 	//Scale entities
 	entity4->GetTransform()->SetScale(XMFLOAT3(10.0, 10.0, 10.0));
+
+	//The big cube hides things behind it and never moves on its own
+	entity4->SetIsOccluder(true);
+	entity4->SetIsStatic(true);
 	
 	//Add all entities to the entity vector
 	entities.push_back(entity);
@@ -456,6 +557,9 @@ void Game::CreateGeometry()
 // --------------------------------------------------------
 void Game::OnResize()
 {
+	//The swap chain can't resize while the graph's copy of the view holds the back buffer
+	backBufferTarget = D3D11RenderGraphTexture();
+
 	// Handle base-level DX resize stuff
 	DXCore::OnResize();
 
@@ -463,6 +567,8 @@ void Game::OnResize()
 	{
 		cameras[i]->UpdateProjectionMatrix((float)this->windowWidth / this->windowHeight);
 	}
+
+	//Screen sized targets are remade by the render graph next frame
 }
 
 // --------------------------------------------------------
@@ -471,6 +577,7 @@ void Game::OnResize()
 void Game::Update(float deltaTime, float totalTime)
 {
 	ImGuiUpdate(deltaTime, totalTime);
+	SelectShaderVariants();
 
 	rotate += 0.01; //deltaTime just isnt working for some reason
 
@@ -488,11 +595,32 @@ void Game::Update(float deltaTime, float totalTime)
 		Quit();
 }
 
+// --------------------------------------------------------
+// Gives every material the pixel shader variant for its
+// features, so maps that aren't there cost nothing.
+// Variants are only built the first time they're needed.
+// --------------------------------------------------------
+void Game::SelectShaderVariants()
+{
+	for (std::shared_ptr<Entity> entity : entities)
+	{
+		entity->GetMaterial()->SelectShaderVariant();
+		entity->GetMaterial()->ResolvePipeline(*pipelineCache);
+	}
+}
+
 // --------------------------------------------------------
 // Clear the screen, redraw everything, present to the user
+// - Everything the CPU decides comes first, then the GPU
+//   work runs as a render graph (see BuildFrameGraph())
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	//Smoothed per path, so the two can be compared by switching
+	float& frameTime = frameMilliseconds[deferredShading ? 1 : 0];
+	float milliseconds = deltaTime * 1000.0f;
+	frameTime = frameTime > 0.0f ? frameTime * 0.95f + milliseconds * 0.05f : milliseconds;
+
 	// Frame START
 	// - These things should happen ONCE PER FRAME
 	// - At the beginning of Game::Draw() before drawing *anything*
@@ -501,137 +629,1058 @@ void Game::Draw(float deltaTime, float totalTime)
 		const float bgColor[4] = { 0.4f, 0.6f, 0.75f, 1.0f }; // Cornflower Blue
 		context->ClearRenderTargetView(backBufferRTV.Get(), bgColor);
 
-		// Clear the depth buffer (resets per-pixel occlusion information)
-		context->ClearDepthStencilView(depthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		//Constant upload stats are per frame
+		ISimpleShader::BytesUploaded = 0;
+		ISimpleShader::BytesChanged = 0;
+		ISimpleShader::UploadsSkipped = 0;
+		commandExecutor->BeginFrame();
+		renderGraphBackend->ResetStats();
+
+		//Work out what the camera sees and which casters can shadow it
+		CullEntities();
+		UpdateShadowCascades();
+		UpdateShadowAtlas();
+	}
 
-		//Clear Shadow Map
-		context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+	//Group entities that can share a draw call
+	BuildInstanceBatches();
+	UploadLights();
+	AssignLightClusters();
 
-		//Setup output merger state
-		ID3D11RenderTargetView* nullRTV{};
-		context->OMSetRenderTargets(1, &nullRTV, shadowDSV.Get());
+	//Record the scene and check it if asked
+	RecordScene();
+	if (validateCommands && deferredShading)
+	{
+		validationCommands.Reset();
+		validationCommands.Append(gBufferCommands);
+		validationCommands.Append(frameCommands);
+		commandValidator.Execute(validationCommands);
+	}
+	else if (validateCommands)
+		commandValidator.Execute(frameCommands);
 
-		//Deactivate Pixel Shader
-		context->PSSetShader(0, 0, 0);
+	//Then play it all back
+	BuildFrameGraph();
+	frameGraph->Execute();
+	commandExecutor->EndFrame();
 
-		//Change viewport
-		D3D11_VIEWPORT viewport = {};
-		viewport.Width = (float)shadowMapRes;
-		viewport.Height = (float)shadowMapRes;
-		viewport.MaxDepth = 1.0f;
-		context->RSSetViewports(1, &viewport);
-		context->RSSetState(shadowRasterizer.Get());
+	// Frame END
+	// - These should happen exactly ONCE PER FRAME
+	// - At the very end of the frame (after drawing *everything*)
+	{
+		// Present the back buffer to the user
+		//  - Puts the results of what we've drawn onto the window
+		//  - Without this, the user never sees anything
+		bool vsyncNecessary = vsync || !deviceSupportsTearing || isFullscreen;
+		swapChain->Present(
+			vsyncNecessary ? 1 : 0,
+			vsyncNecessary ? 0 : DXGI_PRESENT_ALLOW_TEARING);
 
-		shadowVS->SetShader();
-		shadowVS->SetMatrix4x4("view", lightViewMatrix);
-		shadowVS->SetMatrix4x4("projection", lightProjectMatrix);
-		shadowVS->SetSamplerState("ShadowSampler", shadowSampler);
+		// Must re-bind buffers after presenting, as they become unbound
+		context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
 		
+		//Unbind the shadow map
+		ID3D11ShaderResourceView* nullSRVs[128] = {};
+		context->PSSetShaderResources(0, 128, nullSRVs);
+	}
+}
+
+// --------------------------------------------------------
+// Describes this frame's passes and what they touch, then
+// compiles it
+// - Shadow maps are imported, as they're cached across frames
+// - Scene color, depth and the G-buffer belong to the graph:
+//   made at the window's size when first needed and pooled,
+//   so a resize remakes them and nothing else
+// - Passes run in the order they're added
+// --------------------------------------------------------
+void Game::BuildFrameGraph()
+{
+	//ComPtr copies, and the back buffer changes on resize
+	backBufferTarget.RTV = backBufferRTV;
+	shadowMapTarget.SRV = shadowSRV;
+	shadowAtlasTarget.SRV = shadowAtlasSRV;
+
+	RenderGraphTextureDesc colorDesc;
+	colorDesc.Width = windowWidth;
+	colorDesc.Height = windowHeight;
+	colorDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	//Typeless, so it can be both written as depth and read as a float
+	RenderGraphTextureDesc depthDesc = colorDesc;
+	depthDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+
+	frameGraph->Reset();
+	frameResources.BackBuffer = frameGraph->ImportTexture("BackBuffer", &backBufferTarget);
+	frameResources.ShadowMap = frameGraph->ImportTexture("ShadowMap", &shadowMapTarget);
+	frameResources.ShadowAtlas = frameGraph->ImportTexture("ShadowAtlas", &shadowAtlasTarget);
+	frameResources.SceneColor = frameGraph->CreateTexture("SceneColor", colorDesc);
+	frameResources.SceneDepth = frameGraph->CreateTexture("SceneDepth", depthDesc);
+
+	RenderGraphPass shadows = frameGraph->AddPass("Shadows", [this](RenderGraph&) { RenderShadows(); });
+	frameGraph->Write(shadows, frameResources.ShadowMap, RenderGraphAccess::DepthWrite);
+	frameGraph->Write(shadows, frameResources.ShadowAtlas, RenderGraphAccess::DepthWrite);
+
+	if (deferredShading)
+	{
+		frameResources.GBuffer0 = frameGraph->CreateTexture("GBuffer0", colorDesc);
+		frameResources.GBuffer1 = frameGraph->CreateTexture("GBuffer1", colorDesc);
+
+		RenderGraphPass gBuffer = frameGraph->AddPass("GBuffer", [this](RenderGraph&) { RenderGBuffer(); });
+		frameGraph->Write(gBuffer, frameResources.GBuffer0);
+		frameGraph->Write(gBuffer, frameResources.GBuffer1);
+		frameGraph->Write(gBuffer, frameResources.SceneDepth, RenderGraphAccess::DepthWrite);
+
+		RenderGraphPass lighting = frameGraph->AddPass("DeferredLighting", [this](RenderGraph&) { RenderDeferredLighting(); });
+		frameGraph->Read(lighting, frameResources.GBuffer0);
+		frameGraph->Read(lighting, frameResources.GBuffer1);
+		frameGraph->Read(lighting, frameResources.SceneDepth);
+		frameGraph->Read(lighting, frameResources.ShadowMap);
+		frameGraph->Read(lighting, frameResources.ShadowAtlas);
+		frameGraph->Write(lighting, frameResources.SceneColor);
+	}
+
+	RenderGraphPass forward = frameGraph->AddPass("Forward", [this](RenderGraph&) { RenderForward(); });
+	frameGraph->Read(forward, frameResources.ShadowMap);
+	frameGraph->Read(forward, frameResources.ShadowAtlas);
+	frameGraph->Write(forward, frameResources.SceneColor);
+	frameGraph->Write(forward, frameResources.SceneDepth, RenderGraphAccess::DepthWrite);
+
+	RenderGraphPass postProcess = frameGraph->AddPass("PostProcess", [this](RenderGraph&) { RenderPostProcess(); });
+	frameGraph->Read(postProcess, frameResources.SceneColor);
+	frameGraph->Write(postProcess, frameResources.BackBuffer);
+
+	RenderGraphPass ui = frameGraph->AddPass("ImGui", [this](RenderGraph&)
+	{
+		context->OMSetRenderTargets(1, GetFrameTexture(frameResources.BackBuffer)->RTV.GetAddressOf(), 0);
+		ImGui::Render();
+		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	});
+	frameGraph->Write(ui, frameResources.BackBuffer);
+
+	frameGraph->Compile();
+}
+
+D3D11RenderGraphTexture* Game::GetFrameTexture(RenderGraphResource resource)
+{
+	return (D3D11RenderGraphTexture*)frameGraph->GetTexture(resource);
+}
+
+// --------------------------------------------------------
+// Shadow pass: each cascade, then the point light atlas.
+// Leaves the viewport and rasterizer at the screen's.
+// --------------------------------------------------------
+void Game::RenderShadows()
+{
+	//Deactivate Pixel Shader
+	context->PSSetShader(0, 0, 0);
+
+	//Change viewport
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)shadowMapRes;
+	viewport.Height = (float)shadowMapRes;
+	viewport.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &viewport);
+
+	//Render each cascade with only the casters that can reach it
+	ID3D11RenderTargetView* nullRTV{};
+	staticShadowRedraws = 0;
+	for (unsigned int c = 0; c < SHADOW_CASCADE_COUNT; c++)
+	{
+		if (!shadowCacheEnabled)
+		{
+			context->ClearDepthStencilView(shadowDSVs[c].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+			context->OMSetRenderTargets(1, &nullRTV, shadowDSVs[c].Get());
+			DrawShadowCasters(c, true);
+			DrawShadowCasters(c, false);
+			continue;
+		}
+
+		//Static casters only get redrawn when something invalidated the cache
+		if (!shadowCacheValid[c])
+		{
+			context->ClearDepthStencilView(staticShadowDSVs[c].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+			context->OMSetRenderTargets(1, &nullRTV, staticShadowDSVs[c].Get());
+			DrawShadowCasters(c, true);
+			shadowCacheValid[c] = true;
+			staticShadowRedraws++;
+		}
+
+		//Start from the cached depth and add the dynamic casters on top
+		context->OMSetRenderTargets(1, &nullRTV, 0);
+		unsigned int subresource = D3D11CalcSubresource(0, c, 1);
+		context->CopySubresourceRegion(shadowTexture.Get(), subresource, 0, 0, 0, staticShadowTexture.Get(), subresource, 0);
+		context->OMSetRenderTargets(1, &nullRTV, shadowDSVs[c].Get());
+		DrawShadowCasters(c, false);
+	}
+
+	//Point light shadows
+	RenderShadowAtlas();
+
+	//Reset Pipeline
+	viewport.Width = (float)this->windowWidth;
+	viewport.Height = (float)this->windowHeight;
+	context->RSSetViewports(1, &viewport);
+	context->RSSetState(0);
+}
+
+// --------------------------------------------------------
+// Rasterizes occluders into the software depth buffer and
+// fills visibleEntities with everything that passes the test
+// --------------------------------------------------------
+void Game::CullEntities()
+{
+	visibleEntities.clear();
+
+	std::shared_ptr<Camera> camera = cameras[activeCameraIndex];
+	occlusionCuller->BeginFrame(camera->GetViewMatrix(), camera->GetProjectionMatrix());
+
+	if (!occlusionCullingEnabled)
+	{
+		visibleEntities = entities;
+		return;
+	}
+
+	for (auto& e : entities)
+	{
+		if (!e->GetIsOccluder() || e->GetMesh()->GetIndices().empty())
+			continue;
 
-		//Drawing each entity
-		for (int i = 0; i < entities.size(); i++)
+		std::shared_ptr<Mesh> mesh = e->GetMesh();
+		occlusionCuller->AddOccluder(&mesh->GetPositions()[0], &mesh->GetIndices()[0],
+			(unsigned int)mesh->GetIndices().size(), e->GetTransform()->GetWorldMatrix());
+	}
+	occlusionCuller->RasterizeOccluders();
+
+	//Bounds are gathered here since they may update transforms, the tests run in parallel
+	std::vector<BoundingBox> bounds(entities.size());
+	for (unsigned int i = 0; i < entities.size(); i++)
+	{
+		bounds[i] = entities[i]->GetWorldBounds();
+	}
+
+	std::vector<unsigned char> visible;
+	occlusionCuller->TestVisibility(bounds, visible);
+	for (unsigned int i = 0; i < entities.size(); i++)
+	{
+		if (visible[i])
+			visibleEntities.push_back(entities[i]);
+	}
+}
+
+// --------------------------------------------------------
+// Splits the camera frustum into cascades, fits a light
+// matrix to each one and picks the casters each one needs
+// --------------------------------------------------------
+void Game::UpdateShadowCascades()
+{
+	std::vector<BoundingBox> casters;
+	for (auto& e : entities)
+	{
+		casters.push_back(e->GetWorldBounds());
+	}
+
+	//Without a light to follow the cascades keep the last direction
+	XMFLOAT3 lightDirection = cachedLightDirection;
+	if (lightManager.IsValid(cascadeLight))
+		lightDirection = lightManager.Get(cascadeLight).Direction;
+
+	std::shared_ptr<Camera> camera = cameras[activeCameraIndex];
+	shadowCascades->Update(lightDirection, camera->GetViewMatrix(), camera->GetProjectionMatrix(),
+		camera->GetNearPlane(), camera->GetFarPlane(), casters);
+
+	//Anything static moving or the light turning throws out every cached cascade
+	unsigned int staticVersion = 0;
+	for (auto& e : entities)
+	{
+		if (e->GetIsStatic())
+			staticVersion += e->GetTransform()->GetVersion() + 1;
+	}
+
+	bool lightChanged = lightDirection.x != cachedLightDirection.x ||
+		lightDirection.y != cachedLightDirection.y ||
+		lightDirection.z != cachedLightDirection.z;
+	if (staticVersion != cachedStaticVersion || lightChanged)
+	{
+		for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+			shadowCacheValid[i] = false;
+
+		cachedStaticVersion = staticVersion;
+		cachedLightDirection = lightDirection;
+	}
+
+	for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+	{
+		shadowCascadeMatrices[i] = shadowCascades->GetViewProjection(i);
+
+		//Cascade moved (camera crossed a texel or changed range)
+		if (memcmp(&shadowCascadeMatrices[i], &cachedCascadeMatrices[i], sizeof(XMFLOAT4X4)) != 0)
+		{
+			shadowCacheValid[i] = false;
+			cachedCascadeMatrices[i] = shadowCascadeMatrices[i];
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Draws either the static or the dynamic casters of a cascade
+// into whatever depth buffer is currently bound
+// --------------------------------------------------------
+void Game::DrawShadowCasters(unsigned int cascade, bool staticCasters)
+{
+	shadowCasterList.clear();
+	for (unsigned int i : shadowCascades->GetVisibleCasters(cascade))
+	{
+		if (entities[i]->GetIsStatic() == staticCasters)
+			shadowCasterList.push_back(i);
+	}
+	DrawShadowCasterList(shadowCasterList, shadowCascadeMatrices[cascade]);
+}
+
+// --------------------------------------------------------
+// Draws a list of casters with the shadow vertex shader
+// - Every caster's world-view-projection is worked out in
+//   one batched pass, so the shader just does one transform
+// - Each goes through SetConstants, so the executor writes
+//   them all with one Map
+// --------------------------------------------------------
+void Game::DrawShadowCasterList(const std::vector<unsigned int>& casters, const XMFLOAT4X4& viewProjection)
+{
+	unsigned int count = (unsigned int)casters.size();
+	shadowCasterWorlds.resize(count);
+	shadowCasterConstants.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		shadowCasterWorlds[i] = entities[casters[i]]->GetTransform()->GetWorldMatrix();
+	}
+	if (count > 0)
+	{
+		MultiplyMatrixBatch(
+			&shadowCasterWorlds[0], sizeof(XMFLOAT4X4),
+			viewProjection,
+			&shadowCasterConstants[0].WorldViewProjection, sizeof(ShadowObjectConstants),
+			count);
+	}
+
+	shadowCommands.Reset();
+	shadowCommands.SetPipeline(shadowPipeline);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		shadowCommands.SetConstants(ShaderStage::Vertex, shadowObjectSlot, &shadowCasterConstants[i], sizeof(ShadowObjectConstants));
+		entities[casters[i]]->GetMesh()->RecordDraw(shadowCommands);
+	}
+	commandExecutor->Execute(shadowCommands);
+}
+
+// --------------------------------------------------------
+// Assigns atlas tiles to the shadowed lights for this frame
+// - Lights covering more of the screen get bigger tiles and
+//   get to pick first
+// - A tile only needs re-rendering when it's new, its light
+//   moved or a caster in the light's range changed
+// --------------------------------------------------------
+void Game::UpdateShadowAtlas()
+{
+	//Cube faces: +X, -X, +Y, -Y, +Z, -Z (same order as the pixel shader)
+	static const XMFLOAT3 faceDirections[6] = {
+		XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0), XMFLOAT3(0, 1, 0),
+		XMFLOAT3(0, -1, 0), XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1) };
+	static const XMFLOAT3 faceUps[6] = {
+		XMFLOAT3(0, 1, 0), XMFLOAT3(0, 1, 0), XMFLOAT3(0, 0, -1),
+		XMFLOAT3(0, 0, 1), XMFLOAT3(0, 1, 0), XMFLOAT3(0, 1, 0) };
+
+	shadowAtlas->BeginFrame();
+	atlasDraws.clear();
+
+	std::shared_ptr<Camera> camera = cameras[activeCameraIndex];
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	XMFLOAT4X4 cameraProjection = camera->GetProjectionMatrix();
+
+	//Projected radius of each light's range, as a fraction of the screen height
+	std::vector<std::pair<float, unsigned int>> order;
+	const XMFLOAT3* positions = lightManager.GetPositions();
+	const float* ranges = lightManager.GetRanges();
+	for (unsigned int i = 0; i < shadowedLights.size(); i++)
+	{
+		shadowedLights[i].FirstTile = -1;
+		if (!lightManager.IsValid(shadowedLights[i].Source))
+			continue;
+
+		unsigned int index = lightManager.GetIndex(shadowedLights[i].Source);
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&positions[index]) - XMLoadFloat3(&cameraPosition)));
+		float coverage = distance <= ranges[index] ? 1.0f : ranges[index] * cameraProjection._22 / distance;
+		order.push_back(std::make_pair(coverage, i));
+	}
+	std::sort(order.begin(), order.end(), [](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b) { return a.first > b.first; });
+
+	//As many cubes as the shader's arrays hold, biggest on screen first
+	std::vector<std::pair<float, unsigned int>> candidates;
+	for (auto& o : order)
+	{
+		unsigned int index = lightManager.GetIndex(shadowedLights[o.second].Source);
+		if (ranges[index] > 0.0f && (candidates.size() + 1) * 6 <= MAX_ATLAS_TILES)
+			candidates.push_back(o);
+	}
+
+	//Whole cubes at a time. Everything that fits as it is goes first,
+	//then what didn't (or came out smaller than asked) may evict tiles
+	//no light has asked for this frame, so no light pushes out one
+	//that just hasn't asked yet
+	std::vector<ShadowAtlasTile> tiles(candidates.size() * 6);
+	std::vector<unsigned char> placed(candidates.size(), 0);
+	std::vector<unsigned char> isNew(candidates.size(), 0);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (unsigned int c = 0; c < candidates.size(); c++)
 		{
-			shadowVS->SetMatrix4x4("world", entities[i]->GetTransform()->GetWorldMatrix());
-			shadowVS->CopyAllBufferData();
+			unsigned int tileSize = shadowAtlas->SizeFromCoverage(candidates[c].first);
+			if (placed[c] && tiles[c * 6].Size == tileSize)
+				continue;
 
-			entities[i]->GetMesh()->Draw();
+			bool tilesNew = false;
+			placed[c] = shadowAtlas->Request(candidates[c].second * 6, 6, tileSize, pass == 1, &tiles[c * 6], tilesNew);
+			isNew[c] = tilesNew;
 		}
+	}
+
+	for (unsigned int c = 0; c < candidates.size(); c++)
+	{
+		if (!placed[c])
+			continue;
+
+		ShadowedLight& shadowed = shadowedLights[candidates[c].second];
+		unsigned int index = lightManager.GetIndex(shadowed.Source);
+		XMFLOAT3 lightPosition = positions[index];
+		float lightRange = ranges[index];
+
+		//Casters within reach, and a hash to notice when any of them change
+		std::vector<unsigned int> casters;
+		unsigned int casterHash = 0;
+		BoundingSphere reach(lightPosition, lightRange);
+		for (unsigned int i = 0; i < entities.size(); i++)
+		{
+			if (!reach.Intersects(entities[i]->GetWorldBounds()))
+				continue;
+
+			casters.push_back(i);
+			casterHash = casterHash * 31 + i;
+			casterHash = casterHash * 31 + entities[i]->GetTransform()->GetVersion();
+		}
+
+		bool lightChanged = lightPosition.x != shadowed.CachedPosition.x ||
+			lightPosition.y != shadowed.CachedPosition.y ||
+			lightPosition.z != shadowed.CachedPosition.z ||
+			lightRange != shadowed.CachedRange ||
+			casterHash != shadowed.CachedCasterHash;
+		shadowed.CachedPosition = lightPosition;
+		shadowed.CachedRange = lightRange;
+		shadowed.CachedCasterHash = casterHash;
+
+		shadowed.FirstTile = (int)atlasDraws.size();
+		XMMATRIX faceProjection = XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 0.1f, lightRange);
+		for (unsigned int face = 0; face < 6; face++)
+		{
+			AtlasTileDraw draw = {};
+			draw.Tile = tiles[c * 6 + face];
+			XMMATRIX faceView = XMMatrixLookToLH(XMLoadFloat3(&lightPosition),
+				XMLoadFloat3(&faceDirections[face]), XMLoadFloat3(&faceUps[face]));
+			XMStoreFloat4x4(&draw.ViewProjection, XMMatrixMultiply(faceView, faceProjection));
+			draw.Casters = casters;
+			draw.NeedsRender = isNew[c] || lightChanged;
+			atlasDraws.push_back(draw);
+		}
+	}
+
+	//Tiles live on the lights themselves, touched only when they move
+	for (ShadowedLight& shadowed : shadowedLights)
+	{
+		if (lightManager.IsValid(shadowed.Source) && lightManager.Get(shadowed.Source).ShadowTile != shadowed.FirstTile)
+			lightManager.SetShadowTile(shadowed.Source, shadowed.FirstTile);
+	}
+
+	//Shader side copy: matrix and atlas UV rect (offset xy, scale zw) per tile
+	float atlasSize = (float)shadowAtlas->GetAtlasSize();
+	for (unsigned int i = 0; i < atlasDraws.size(); i++)
+	{
+		const ShadowAtlasTile& tile = atlasDraws[i].Tile;
+		atlasMatrices[i] = atlasDraws[i].ViewProjection;
+		atlasRects[i] = XMFLOAT4(tile.X / atlasSize, tile.Y / atlasSize, tile.Size / atlasSize, tile.Size / atlasSize);
+	}
+}
 
-		//Reset Pipeline
-		viewport.Width = (float)this->windowWidth;
-		viewport.Height = (float)this->windowHeight;
+// --------------------------------------------------------
+// Re-renders the atlas tiles that changed this frame
+// --------------------------------------------------------
+void Game::RenderShadowAtlas()
+{
+	ID3D11RenderTargetView* nullRTV{};
+	context->OMSetRenderTargets(1, &nullRTV, shadowAtlasDSV.Get());
+
+	atlasTilesRendered = 0;
+	for (auto& draw : atlasDraws)
+	{
+		if (!draw.NeedsRender)
+			continue;
+
+		D3D11_VIEWPORT viewport = {};
+		viewport.TopLeftX = (float)draw.Tile.X;
+		viewport.TopLeftY = (float)draw.Tile.Y;
+		viewport.Width = (float)draw.Tile.Size;
+		viewport.Height = (float)draw.Tile.Size;
+
+		//Clear only this tile: squash the viewport's depth range onto the far plane
+		viewport.MinDepth = 1.0f;
+		viewport.MaxDepth = 1.0f;
 		context->RSSetViewports(1, &viewport);
-		context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
-		context->RSSetState(0);
+		context->OMSetDepthStencilState(shadowAtlasClearState.Get(), 0);
+		ppVS->SetShader();
+		context->Draw(3, 0);
 
-		//Clear the render target
-		context->ClearRenderTargetView(ppRTV.Get(), bgColor);
+		viewport.MinDepth = 0.0f;
+		context->RSSetViewports(1, &viewport);
+		context->OMSetDepthStencilState(0, 0);
 
-		//Swap active render target
-		context->OMSetRenderTargets(1, ppRTV.GetAddressOf(), depthBufferDSV.Get());
+		DrawShadowCasterList(draw.Casters, draw.ViewProjection);
+
+		atlasTilesRendered++;
+	}
+}
+
+// --------------------------------------------------------
+// Batches the visible entities by mesh, material and shader
+// and uploads every instance's matrices in one go
+// --------------------------------------------------------
+void Game::BuildInstanceBatches()
+{
+	std::shared_ptr<Camera> camera = cameras[activeCameraIndex];
+	XMFLOAT4X4 viewMatrix = camera->GetViewMatrix();
+	XMFLOAT4X4 projectionMatrix = camera->GetProjectionMatrix();
+	XMMATRIX view = XMLoadFloat4x4(&viewMatrix);
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(view, XMLoadFloat4x4(&projectionMatrix)));
+	float nearPlane = camera->GetNearPlane();
+	float depthRange = camera->GetFarPlane() - nearPlane;
+
+	//Sort keys: pass, state, then view depth of the bounds center.
+	//When deferred, what goes through the G-buffer is layer 0 so
+	//its batches all come first.
+	//What the pre-pass would draw also goes into the overdraw estimate.
+	renderQueue.Begin();
+	depthComplexity->Begin(viewProjection);
+	visibleDepths.resize(visibleEntities.size());
+	for (unsigned int i = 0; i < visibleEntities.size(); i++)
+	{
+		std::shared_ptr<Entity> e = visibleEntities[i];
+		std::shared_ptr<Material> mat = e->GetMaterial();
+		bool gBuffer = deferredShading && mat->GetIsDeferrable();
+
+		XMFLOAT3 center = e->GetWorldBounds().Center;
+		float depth = XMVectorGetZ(XMVector3TransformCoord(XMLoadFloat3(&center), view));
+		visibleDepths[i] = depth;
+		if (InDepthPrePass(mat.get()))
+			depthComplexity->AddBox(e->GetWorldBounds());
+
+		unsigned long long key = RenderQueue::MakeKey(
+			mat->GetIsTransparent() ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE,
+			deferredShading && !gBuffer ? 1 : 0,
+			renderQueue.GetResourceId(gBuffer ? mat->GetGBufferShader().get() : mat->GetPixelShader().get()),
+			renderQueue.GetResourceId(mat.get()),
+			renderQueue.GetResourceId(e->GetMesh().get()),
+			(depth - nearPlane) / depthRange);
+		renderQueue.Add(key, i);
 	}
+	renderQueue.Sort();
 
+	depthComplexity->Resolve();
+	depthPrePassActive = depthPrePassMode == DEPTH_PRE_PASS_ON ||
+		(depthPrePassMode == DEPTH_PRE_PASS_AUTO && depthComplexity->GetOverdraw() > overdrawThreshold);
 
+	//Neighbouring packets with the same state become one instanced draw
+	instanceBatcher.Begin();
+	for (const DrawPacket& packet : renderQueue.GetPackets())
+	{
+		std::shared_ptr<Entity> e = visibleEntities[packet.Item];
+		std::shared_ptr<Material> mat = e->GetMaterial();
+		bool gBuffer = deferredShading && mat->GetIsDeferrable();
+		instanceBatcher.Add(packet.Item, e->GetMesh().get(), mat.get(),
+			gBuffer ? mat->GetGBufferShader().get() : mat->GetPixelShader().get(),
+			e->GetTransform()->GetWorldMatrix(), e->GetTransform()->GetWorldInverseTransposeMatrix());
+	}
+	instanceBatcher.Build(viewProjection);
 
-	//Drawing each entity
-	for (int i = 0; i < entities.size(); i++)
+	//A material is deferred or not as a whole, so batches never mix the two
+	gBufferBatchCount = 0;
+	if (deferredShading)
 	{
-		std::shared_ptr<Material> mat = entities[i]->GetMaterial();
-		
-		std::shared_ptr<SimpleVertexShader> vs = mat->GetVertexShader();
-		vs->SetMatrix4x4("world", entities[i]->GetTransform()->GetWorldMatrix());
-		vs->SetMatrix4x4("worldInverseTranspose", entities[i]->GetTransform()->GetWorldInverseTransposeMatrix());
-		vs->SetMatrix4x4("view", cameras[activeCameraIndex]->GetViewMatrix());
-		vs->SetMatrix4x4("projection", cameras[activeCameraIndex]->GetProjectionMatrix());
-		vs->SetMatrix4x4("lightView", lightViewMatrix);
-		vs->SetMatrix4x4("lightProjection", lightProjectMatrix);
+		for (const InstanceBatch& batch : instanceBatcher.GetBatches())
+		{
+			if (!visibleEntities[batch.FirstItem]->GetMaterial()->GetIsDeferrable())
+				break;
+			gBufferBatchCount++;
+		}
+	}
+
+	const std::vector<InstanceData>& instances = instanceBatcher.GetInstances();
+	if (instances.empty())
+		return;
+
+	//Grow the buffer when needed, doubling so it rarely happens
+	if (instances.size() > instanceBufferCapacity)
+	{
+		instanceBufferCapacity *= 2;
+		if (instanceBufferCapacity < instances.size())
+			instanceBufferCapacity = (unsigned int)instances.size();
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = instanceBufferCapacity * sizeof(InstanceData);
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		device->CreateBuffer(&desc, 0, instanceBuffer.ReleaseAndGetAddressOf());
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+
+	memcpy(mapped.pData, &instances[0], instances.size() * sizeof(InstanceData));
+	context->Unmap(instanceBuffer.Get(), 0);
+}
+
+// --------------------------------------------------------
+// Copies the lights that changed since last frame into the
+// light buffer, in one call however many lights there are
+// - The buffer grows by doubling, and a new one gets every
+//   light copied in
+// --------------------------------------------------------
+void Game::UploadLights()
+{
+	unsigned int first, count;
+	lightManager.PackChanges(first, count);
+	lightsUploaded = 0;
+
+	unsigned int lightCount = lightManager.GetCount();
+	if (lightCount > lightBufferCapacity)
+	{
+		lightBufferCapacity *= 2;
+		if (lightBufferCapacity < lightCount)
+			lightBufferCapacity = lightCount;
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = lightBufferCapacity * sizeof(Light);
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = sizeof(Light);
+		device->CreateBuffer(&desc, 0, lightBuffer.ReleaseAndGetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = lightBufferCapacity;
+		device->CreateShaderResourceView(lightBuffer.Get(), &srvDesc, lightSRV.ReleaseAndGetAddressOf());
+
+		first = 0;
+		count = lightCount;
+	}
+
+	if (count == 0)
+		return;
+
+	D3D11_BOX box = {};
+	box.left = first * sizeof(Light);
+	box.right = (first + count) * sizeof(Light);
+	box.bottom = 1;
+	box.back = 1;
+	context->UpdateSubresource(lightBuffer.Get(), 0, &box, lightManager.GetPackedLights() + first, 0, 0);
+	lightsUploaded = count;
+}
+
+// --------------------------------------------------------
+// Assigns the lights to the camera's clusters and uploads
+// the cluster ranges and light index list
+// - Both are rewritten whole every frame, since any camera
+//   movement changes them
+// - The index buffer grows by doubling
+// --------------------------------------------------------
+void Game::AssignLightClusters()
+{
+	std::shared_ptr<Camera> camera = cameras[activeCameraIndex];
+	lightClusterer->Assign(camera->GetViewMatrix(), camera->GetProjectionMatrix(),
+		camera->GetNearPlane(), camera->GetFarPlane(),
+		lightManager.GetTypes(), lightManager.GetPositions(), lightManager.GetRanges(), lightManager.GetCount());
+
+	const std::vector<ClusterRange>& clusters = lightClusterer->GetClusters();
+	const std::vector<unsigned int>& indices = lightClusterer->GetLightIndices();
 
-		vs->CopyAllBufferData();
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+
+	//The cluster count never changes
+	if (!clusterRangeBuffer)
+	{
+		desc.ByteWidth = (UINT)(clusters.size() * sizeof(ClusterRange));
+		desc.StructureByteStride = sizeof(ClusterRange);
+		device->CreateBuffer(&desc, 0, clusterRangeBuffer.GetAddressOf());
+
+		srvDesc.Buffer.NumElements = (UINT)clusters.size();
+		device->CreateShaderResourceView(clusterRangeBuffer.Get(), &srvDesc, clusterRangeSRV.GetAddressOf());
+	}
+
+	//Never empty, so there's always something to bind
+	unsigned int indexCount = indices.empty() ? 1 : (unsigned int)indices.size();
+	if (indexCount > clusterIndexCapacity)
+	{
+		clusterIndexCapacity *= 2;
+		if (clusterIndexCapacity < indexCount)
+			clusterIndexCapacity = indexCount;
+
+		desc.ByteWidth = clusterIndexCapacity * sizeof(unsigned int);
+		desc.StructureByteStride = sizeof(unsigned int);
+		device->CreateBuffer(&desc, 0, clusterIndexBuffer.ReleaseAndGetAddressOf());
+
+		srvDesc.Buffer.NumElements = clusterIndexCapacity;
+		device->CreateShaderResourceView(clusterIndexBuffer.Get(), &srvDesc, clusterIndexSRV.ReleaseAndGetAddressOf());
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (SUCCEEDED(context->Map(clusterRangeBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		memcpy(mapped.pData, clusters.data(), clusters.size() * sizeof(ClusterRange));
+		context->Unmap(clusterRangeBuffer.Get(), 0);
+	}
+	if (!indices.empty() && SUCCEEDED(context->Map(clusterIndexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		memcpy(mapped.pData, indices.data(), indices.size() * sizeof(unsigned int));
+		context->Unmap(clusterIndexBuffer.Get(), 0);
+	}
+}
+
+// --------------------------------------------------------
+// Records the instanced batches and the sky into
+// frameCommands. Nothing here touches the context, so the
+// cost of building the frame can be measured on its own.
+//
+// - Per frame constants are filled in once and written to
+//   each shader's PerFrame buffer, then recorded once ahead
+//   of every chunk (and only if they changed)
+// - Batches are split into fixed size chunks, each recorded
+//   into its own command buffer on the thread pool
+// - Chunks are appended in order, so the result doesn't
+//   depend on the thread count or on which thread ran what
+// - The depth pre-pass, if on, goes ahead of every chunk
+// --------------------------------------------------------
+void Game::RecordScene()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	std::shared_ptr<Camera> camera = cameras[activeCameraIndex];
+	const std::vector<InstanceBatch>& batches = instanceBatcher.GetBatches();
+
+	//Values shared by every batch (the vertex shader only needs
+	//the per instance matrices), and by the deferred lighting pass
+	XMFLOAT4X4 viewMatrix = camera->GetViewMatrix();
+	XMFLOAT4X4 projectionMatrix = camera->GetProjectionMatrix();
+	XMMATRIX viewProjection = XMMatrixMultiply(XMLoadFloat4x4(&viewMatrix), XMLoadFloat4x4(&projectionMatrix));
+
+	pixelFrame = {};
+	pixelFrame.CameraPos = camera->GetTransform()->GetPosition();
+	pixelFrame.CascadeLight = lightManager.IsValid(cascadeLight) ? (int)lightManager.GetIndex(cascadeLight) : -1;
+	pixelFrame.Ambient = ambientColor;
+	pixelFrame.ClusterSlices = lightClusterer->GetSliceCount();
+	pixelFrame.ClusterTileScale = XMFLOAT2((float)lightClusterer->GetTilesX() / windowWidth, (float)lightClusterer->GetTilesY() / windowHeight);
+	pixelFrame.ClusterSliceScale = lightClusterer->GetSliceScale();
+	pixelFrame.ClusterSliceBias = lightClusterer->GetSliceBias();
+	pixelFrame.ClusterTiles = XMUINT2(lightClusterer->GetTilesX(), lightClusterer->GetTilesY());
+	XMStoreFloat4x4(&pixelFrame.InverseViewProjection, XMMatrixInverse(0, viewProjection));
+	memcpy(pixelFrame.ShadowCascades, shadowCascadeMatrices, sizeof(shadowCascadeMatrices));
+	memcpy(pixelFrame.AtlasMatrices, atlasMatrices, sizeof(atlasMatrices));
+	memcpy(pixelFrame.AtlasRects, atlasRects, sizeof(atlasRects));
+
+	//Set on each shader only once. G-buffer shaders don't light
+	//anything, so they have no per frame values.
+	std::vector<ISimpleShader*> preparedShaders;
+	for (unsigned int b = gBufferBatchCount; b < batches.size(); b++)
+	{
+		std::shared_ptr<Material> mat = visibleEntities[batches[b].FirstItem]->GetMaterial();
 
 		std::shared_ptr<SimplePixelShader> ps = mat->GetPixelShader();
-		ps->SetFloat4("colorTint", mat->GetColorTint());
-		ps->SetFloat3("cameraPos", cameras[activeCameraIndex]->GetTransform()->GetPosition());
-		ps->SetFloat("roughness", mat->GetRoughness());
-		ps->SetFloat3("ambient", ambientColor);
-		ps->SetFloat2("scale", mat->GetScale());
-		ps->SetFloat2("offset", mat->GetOffset());
-		ps->SetData("directionalLight", &directionalLight, sizeof(Light));
-		ps->SetData("directionalLight2", &directionalLight2, sizeof(Light));
-		ps->SetData("directionalLight3", &directionalLight3, sizeof(Light));
-		ps->SetData("pointLight", &pointLight, sizeof(Light));
-		ps->SetData("pointLight2", &pointLight2, sizeof(Light));
-
-		mat->PrepareMaterial();
-
-		ps->CopyAllBufferData();
-		
-		vs->SetShader();
-		ps->SetShader();
-		ps->SetShaderResourceView("ShadowMap", shadowSRV);
-		ps->SetSamplerState("ShadowSampler", shadowSampler);
-		entities[i]->GetMesh()->Draw();
+		if (std::find(preparedShaders.begin(), preparedShaders.end(), ps.get()) == preparedShaders.end())
+		{
+			ps->SetData(ps->GetBufferHandle("PerFrame"), &pixelFrame, sizeof(PixelFrameConstants));
+			preparedShaders.push_back(ps.get());
+		}
+	}
+
+	//Frame constants go first, then each chunk's material
+	//and draw commands. The G-buffer batches get a buffer of
+	//their own, as they draw to different targets.
+	gBufferCommands.Reset();
+	gBufferCommands.SetVertexBuffer(1, instanceBuffer.Get(), sizeof(InstanceData), 0);
+	frameCommands.Reset();
+	frameCommands.SetVertexBuffer(1, instanceBuffer.Get(), sizeof(InstanceData), 0);
+	for (ISimpleShader* shader : preparedShaders)
+	{
+		shader->RecordAllBufferData(frameCommands);
+	}
+	RecordDepthPrePass();
+
+	//Record chunks in parallel, G-buffer chunks first
+	const unsigned int batchesPerChunk = 16;
+	unsigned int batchCount = (unsigned int)batches.size();
+	unsigned int gBufferChunkCount = (gBufferBatchCount + batchesPerChunk - 1) / batchesPerChunk;
+	unsigned int chunkCount = gBufferChunkCount + (batchCount - gBufferBatchCount + batchesPerChunk - 1) / batchesPerChunk;
+	if (recordChunks.size() < chunkCount)
+		recordChunks.resize(chunkCount);
+
+	threadPool->ParallelFor(chunkCount, [&](unsigned int c)
+	{
+		bool gBuffer = c < gBufferChunkCount;
+		unsigned int first = gBuffer ? c * batchesPerChunk : gBufferBatchCount + (c - gBufferChunkCount) * batchesPerChunk;
+		unsigned int remaining = (gBuffer ? gBufferBatchCount : batchCount) - first;
+		RecordBatches(c, first, remaining < batchesPerChunk ? remaining : batchesPerChunk, gBuffer);
+	});
+
+	//Merge in chunk order
+	for (unsigned int c = 0; c < chunkCount; c++)
+	{
+		(c < gBufferChunkCount ? gBufferCommands : frameCommands).Append(recordChunks[c].Commands);
 	}
 
 	//Drawing the sky
-	sky.Draw(cameras[activeCameraIndex]);
+	sky.Record(frameCommands, camera);
+
+	recordSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Records a run of batches into one chunk. Runs on worker
+// threads, so the shaders are only read: material values
+// go straight into the chunk with SetConstants.
+//
+// - Consecutive batches with the same material share one
+//   constant upload
+// - G-buffer batches use the material's G-buffer pipeline and
+//   bind nothing for lighting
+// - Batches already in the depth pre-pass only shade what
+//   matches its depth
+// --------------------------------------------------------
+void Game::RecordBatches(unsigned int chunkIndex, unsigned int firstBatch, unsigned int batchCount, bool gBuffer)
+{
+	const std::vector<InstanceBatch>& batches = instanceBatcher.GetBatches();
+	RecordChunk& chunk = recordChunks[chunkIndex];
+	chunk.Commands.Reset();
+	Material* boundMaterial = 0;
+
+	for (unsigned int b = firstBatch; b < firstBatch + batchCount; b++)
+	{
+		const InstanceBatch& batch = batches[b];
+		std::shared_ptr<Entity> entity = visibleEntities[batch.FirstItem];
+		std::shared_ptr<Material> mat = entity->GetMaterial();
+
+		std::shared_ptr<SimpleVertexShader> vs = mat->GetVertexShader();
+		std::shared_ptr<SimplePixelShader> ps = gBuffer ? mat->GetGBufferShader() : mat->GetPixelShader();
+
+		mat->RecordMaterial(chunk.Commands);
+
+		if (mat.get() != boundMaterial)
+		{
+			mat->RecordParameters(chunk.Commands);
+			boundMaterial = mat.get();
+		}
+
+		if (gBuffer)
+			chunk.Commands.SetPipeline(mat->GetGBufferPipeline());
+		else if (depthPrePassActive && InDepthPrePass(mat.get()))
+			chunk.Commands.SetPipeline(mat->GetDepthEqualPipeline());
+		else
+			chunk.Commands.SetPipeline(mat->GetPipeline());
+		vs->RecordConstantBuffers(chunk.Commands);
+		ps->RecordConstantBuffers(chunk.Commands);
+		if (!gBuffer)
+		{
+			ps->RecordShaderResourceView(chunk.Commands, "ShadowMap", shadowSRV);
+			ps->RecordShaderResourceView(chunk.Commands, "ShadowAtlas", shadowAtlasSRV);
+			ps->RecordShaderResourceView(chunk.Commands, "Lights", lightSRV);
+			ps->RecordShaderResourceView(chunk.Commands, "ClusterRanges", clusterRangeSRV);
+			ps->RecordShaderResourceView(chunk.Commands, "ClusterLightIndices", clusterIndexSRV);
+			ps->RecordSamplerState(chunk.Commands, "ShadowSampler", shadowSampler);
+		}
+		entity->GetMesh()->RecordDrawInstanced(chunk.Commands, batch.InstanceCount, batch.FirstInstance);
+	}
+}
+
+// --------------------------------------------------------
+// Records depth for the forward opaque batches, nearest batch
+// first, so the pre-pass itself rejects as much as it can
+// - Position only, no pixel shader, one draw per batch
+// - Against whatever depth is bound when frameCommands play,
+//   so when deferred it adds to the G-buffer's depth
+// --------------------------------------------------------
+void Game::RecordDepthPrePass()
+{
+	prePassBatches.clear();
+	if (!depthPrePassActive)
+		return;
+
+	//A batch's first item is its nearest, as batches are sorted by depth within a state
+	const std::vector<InstanceBatch>& batches = instanceBatcher.GetBatches();
+	for (unsigned int b = gBufferBatchCount; b < batches.size(); b++)
+	{
+		if (InDepthPrePass(visibleEntities[batches[b].FirstItem]->GetMaterial().get()))
+			prePassBatches.push_back(b);
+	}
+	std::sort(prePassBatches.begin(), prePassBatches.end(), [&](unsigned int a, unsigned int b)
+	{
+		return visibleDepths[batches[a].FirstItem] < visibleDepths[batches[b].FirstItem];
+	});
+
+	if (prePassBatches.empty())
+		return;
+
+	frameCommands.SetPipeline(depthPrePassPipeline);
+	for (unsigned int b : prePassBatches)
+	{
+		const InstanceBatch& batch = batches[b];
+		visibleEntities[batch.FirstItem]->GetMesh()->RecordDrawInstanced(frameCommands, batch.InstanceCount, batch.FirstInstance);
+	}
+}
+
+// --------------------------------------------------------
+// Whether a material's draws go through the depth pre-pass
+// - Opaque and forward shaded only
+// - Alpha tested surfaces would need their pixel shader to
+//   cut out holes, so they just depth test as usual
+// - The depth has to come out of the same vertex shader
+//   math, or the equal test would fail
+// --------------------------------------------------------
+bool Game::InDepthPrePass(Material* material)
+{
+	return !material->GetIsTransparent() && !material->GetIsAlphaTested()
+		&& !(deferredShading && material->GetIsDeferrable())
+		&& material->GetVertexShader() == vertexShader
+		&& material->GetDepthEqualPipeline();
+}
+
+// --------------------------------------------------------
+// Deferred, first half: opaque surfaces into the G-buffer.
+// Its depth is the frame's depth from here on.
+// --------------------------------------------------------
+void Game::RenderGBuffer()
+{
+	D3D11RenderGraphTexture* gBuffer0 = GetFrameTexture(frameResources.GBuffer0);
+	D3D11RenderGraphTexture* gBuffer1 = GetFrameTexture(frameResources.GBuffer1);
+	D3D11RenderGraphTexture* sceneDepth = GetFrameTexture(frameResources.SceneDepth);
+
+	const float clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	context->ClearRenderTargetView(gBuffer0->RTV.Get(), clearColor);
+	context->ClearRenderTargetView(gBuffer1->RTV.Get(), clearColor);
+	context->ClearDepthStencilView(sceneDepth->DSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+	ID3D11RenderTargetView* gBufferTargets[2] = { gBuffer0->RTV.Get(), gBuffer1->RTV.Get() };
+	context->OMSetRenderTargets(2, gBufferTargets, sceneDepth->DSV.Get());
+	commandExecutor->Execute(gBufferCommands);
+}
+
+// --------------------------------------------------------
+// Deferred, second half: one full screen triangle lights
+// every covered pixel with the same clusters as forward
+// shading, reading position back from depth. Pixels nothing
+// was drawn to keep the clear color for the sky.
+// --------------------------------------------------------
+void Game::RenderDeferredLighting()
+{
+	D3D11RenderGraphTexture* sceneColor = GetFrameTexture(frameResources.SceneColor);
+
+	const float bgColor[4] = { 0.4f, 0.6f, 0.75f, 1.0f }; // Cornflower Blue
+	context->ClearRenderTargetView(sceneColor->RTV.Get(), bgColor);
+	context->OMSetRenderTargets(1, sceneColor->RTV.GetAddressOf(), 0);
 
-	//Post-Render
-	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), 0);
+	deferredLightingPS->SetData(deferredLightingPS->GetBufferHandle("PerFrame"), &pixelFrame, sizeof(PixelFrameConstants));
+	deferredLightingPS->CopyAllBufferData();
+
+	ppVS->SetShader();
+	deferredLightingPS->SetShader();
+	deferredLightingPS->SetShaderResourceView("GBuffer0", GetFrameTexture(frameResources.GBuffer0)->SRV.Get());
+	deferredLightingPS->SetShaderResourceView("GBuffer1", GetFrameTexture(frameResources.GBuffer1)->SRV.Get());
+	deferredLightingPS->SetShaderResourceView("GBufferDepth", GetFrameTexture(frameResources.SceneDepth)->SRV.Get());
+	deferredLightingPS->SetShaderResourceView("ShadowMap", GetFrameTexture(frameResources.ShadowMap)->SRV.Get());
+	deferredLightingPS->SetShaderResourceView("ShadowAtlas", GetFrameTexture(frameResources.ShadowAtlas)->SRV.Get());
+	deferredLightingPS->SetShaderResourceView("Lights", lightSRV.Get());
+	deferredLightingPS->SetShaderResourceView("ClusterRanges", clusterRangeSRV.Get());
+	deferredLightingPS->SetShaderResourceView("ClusterLightIndices", clusterIndexSRV.Get());
+	deferredLightingPS->SetSamplerState("ShadowSampler", shadowSampler.Get());
+	context->Draw(3, 0);
+}
+
+// --------------------------------------------------------
+// Everything recorded into frameCommands: forward shaded
+// surfaces (after the depth pre-pass, if on), transparents
+// and the sky. When deferred it draws over the lit G-buffer
+// and tests against its depth, otherwise it starts clean.
+// --------------------------------------------------------
+void Game::RenderForward()
+{
+	D3D11RenderGraphTexture* sceneColor = GetFrameTexture(frameResources.SceneColor);
+	D3D11RenderGraphTexture* sceneDepth = GetFrameTexture(frameResources.SceneDepth);
+
+	if (!deferredShading)
+	{
+		const float bgColor[4] = { 0.4f, 0.6f, 0.75f, 1.0f }; // Cornflower Blue
+		context->ClearRenderTargetView(sceneColor->RTV.Get(), bgColor);
+		context->ClearDepthStencilView(sceneDepth->DSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+	}
+
+	context->OMSetRenderTargets(1, sceneColor->RTV.GetAddressOf(), sceneDepth->DSV.Get());
+	commandExecutor->Execute(frameCommands);
+}
+
+// --------------------------------------------------------
+// Blurs the scene into the back buffer
+// --------------------------------------------------------
+void Game::RenderPostProcess()
+{
+	context->OMSetRenderTargets(1, GetFrameTexture(frameResources.BackBuffer)->RTV.GetAddressOf(), 0);
 
-	ppPS->SetInt("blurRadius", blurRadius);
-	ppPS->SetFloat("pixelWidth", 1.0f / windowWidth);
-	ppPS->SetFloat("pixelHeight", 1.0f / windowHeight);
+	PostProcessConstants postProcess = {};
+	postProcess.BlurRadius = blurRadius;
+	postProcess.PixelWidth = 1.0f / windowWidth;
+	postProcess.PixelHeight = 1.0f / windowHeight;
+	ppPS->SetData(ppPS->GetBufferHandle("externalData"), &postProcess, sizeof(PostProcessConstants));
 	ppPS->CopyAllBufferData();
 
 	ppVS->SetShader();
 	ppPS->SetShader();
-	ppPS->SetShaderResourceView("Pixels", ppSRV.Get());
+	ppPS->SetShaderResourceView("Pixels", GetFrameTexture(frameResources.SceneColor)->SRV.Get());
 	ppPS->SetSamplerState("ClampSampler", ppSampler.Get());
 	context->Draw(3, 0);
+}
 
-	//ImGui
-	ImGui::Render();
-	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+// --------------------------------------------------------
+// Copies the software depth buffer into a texture for ImGui
+// --------------------------------------------------------
+void Game::UpdateOcclusionDebugTexture()
+{
+	occlusionCuller->GetDepthVisualization(occlusionDebugPixels);
 
-	// Frame END
-	// - These should happen exactly ONCE PER FRAME
-	// - At the very end of the frame (after drawing *everything*)
-	{
-		// Present the back buffer to the user
-		//  - Puts the results of what we've drawn onto the window
-		//  - Without this, the user never sees anything
-		bool vsyncNecessary = vsync || !deviceSupportsTearing || isFullscreen;
-		swapChain->Present(
-			vsyncNecessary ? 1 : 0,
-			vsyncNecessary ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(occlusionDebugTexture.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
 
-		// Must re-bind buffers after presenting, as they become unbound
-		context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
-		
-		//Unbind the shadow map
-		ID3D11ShaderResourceView* nullSRVs[128] = {};
-		context->PSSetShaderResources(0, 128, nullSRVs);
+	unsigned int rowBytes = occlusionCuller->GetWidth() * sizeof(unsigned int);
+	for (unsigned int y = 0; y < occlusionCuller->GetHeight(); y++)
+	{
+		memcpy((char*)mapped.pData + y * mapped.RowPitch, &occlusionDebugPixels[y * occlusionCuller->GetWidth()], rowBytes);
 	}
+
+	context->Unmap(occlusionDebugTexture.Get(), 0);
 }
 
 // Stuff done every frame for ImGui
@@ -806,42 +1855,213 @@ void Game::ImGuiUpdate(float deltaTime, float totalTime)
 		}
 	}
 
-	//Light colors
-	static float light[3] = { directionalLight.Color.x, directionalLight.Color.y, directionalLight.Color.z};
-	static float light2[3] = { directionalLight2.Color.x, directionalLight2.Color.y, directionalLight2.Color.z };
-	static float light3[3] = { directionalLight3.Color.x, directionalLight3.Color.y, directionalLight3.Color.z };
-	static float light4[3] = { pointLight.Color.x, pointLight.Color.y, pointLight.Color.z };
-	static float light5[3] = { pointLight2.Color.x, pointLight2.Color.y, pointLight2.Color.z };
-
 	if (ImGui::CollapsingHeader("Lights"))
 	{
-		if (ImGui::TreeNode("Light 0"))
+		ImGui::Text("Lights: (%u)", lightManager.GetCount());
+		ImGui::Text("Directional: (%u), Point: (%u)",
+			lightManager.GetCount(LIGHT_TYPE_DIRECTIONAL), lightManager.GetCount(LIGHT_TYPE_POINT));
+		ImGui::Text("Uploaded This Frame: (%u)", lightsUploaded);
+		ImGui::Text("Clusters: (%u x %u x %u)", lightClusterer->GetTilesX(), lightClusterer->GetTilesY(), lightClusterer->GetSliceCount());
+		ImGui::Text("Cluster Light Indices: (%u)", (unsigned int)lightClusterer->GetLightIndices().size());
+		ImGui::Text("Most Lights In A Cluster: (%u)", lightClusterer->GetMaxLightsPerCluster());
+		ImGui::Text("Assign Time: %.3f ms", lightClusterer->GetAssignSeconds() * 1000.0);
+
+		//Only edits mark a light for upload
+		for (unsigned int i = 0; i < lightManager.GetCount(); i++)
 		{
-			ImGui::ColorEdit3("Color", light);
+			if (!ImGui::TreeNode((void*)(size_t)i, "Light %u", i))
+				continue;
+
+			LightHandle handle = lightManager.GetHandle(i);
+			XMFLOAT3 color = lightManager.GetColors()[i];
+			float intensity = lightManager.GetIntensities()[i];
+			if (ImGui::ColorEdit3("Color", &color.x))
+				lightManager.SetColor(handle, color);
+			if (ImGui::DragFloat("Intensity", &intensity, 0.1f, 0.0f, 20.0f))
+				lightManager.SetIntensity(handle, intensity);
 			ImGui::TreePop();
 		}
-		if (ImGui::TreeNode("Light 1"))
+	}
+
+	if (ImGui::CollapsingHeader("Shadows"))
+	{
+		float lambda = shadowCascades->GetLambda();
+		if (ImGui::SliderFloat("Split Lambda", &lambda, 0.0f, 1.0f))
+			shadowCascades->SetLambda(lambda);
+
+		float shadowDistance = shadowCascades->GetShadowDistance();
+		if (ImGui::SliderFloat("Shadow Distance", &shadowDistance, 5.0f, 200.0f))
+			shadowCascades->SetShadowDistance(shadowDistance);
+
+		ImGui::Checkbox("Cache Static Shadows", &shadowCacheEnabled);
+		ImGui::Text("Static Cascades Redrawn: (%u)", staticShadowRedraws);
+
+		for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+		{
+			ImGui::Text("Cascade %u: %.2f - %.2f, Casters: (%u), Texel Size: (%f)", i,
+				shadowCascades->GetSplit(i), shadowCascades->GetSplit(i + 1),
+				(unsigned int)shadowCascades->GetVisibleCasters(i).size(), shadowCascades->GetTexelSize(i));
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Shadow Atlas"))
+	{
+		float atlasTexels = (float)shadowAtlas->GetAtlasSize() * shadowAtlas->GetAtlasSize();
+		ImGui::Text("Tiles: (%u)", shadowAtlas->GetAllocatedTileCount());
+		ImGui::Text("Usage: (%.1f%%)", 100.0f * shadowAtlas->GetAllocatedTexels() / atlasTexels);
+		ImGui::Text("Tiles Rendered: (%u)", atlasTilesRendered);
+		ImGui::Text("Evictions: (%u)", shadowAtlas->GetEvictionCount());
+
+		for (unsigned int i = 0; i < shadowedLights.size(); i++)
 		{
-			ImGui::ColorEdit3("Color", light2);
-			ImGui::TreePop();
+			int first = shadowedLights[i].FirstTile;
+			ImGui::Text("Point Light %u: %s (%u)", i, first < 0 ? "Unshadowed" : "Tile Size",
+				first < 0 ? 0 : atlasDraws[first].Tile.Size);
 		}
-		if (ImGui::TreeNode("Light 2"))
+		ImGui::Image(shadowAtlasSRV.Get(), ImVec2(256, 256));
+	}
+
+	if (ImGui::CollapsingHeader("Rendering Path"))
+	{
+		ImGui::Checkbox("Deferred Shading", &deferredShading);
+		ImGui::Text("Forward Frame: %.3f ms", frameMilliseconds[0]);
+		ImGui::Text("Deferred Frame: %.3f ms", frameMilliseconds[1]);
+		ImGui::Text("G-Buffer Draw Calls: (%u)", gBufferBatchCount);
+		ImGui::Text("G-Buffer: (%u bytes/pixel + depth)", (unsigned int)sizeof(GBufferTexel));
+	}
+
+	if (ImGui::CollapsingHeader("Render Graph"))
+	{
+		for (unsigned int p = 0; p < frameGraph->GetPassCount(); p++)
 		{
-			ImGui::ColorEdit3("Color", light3);
-			ImGui::TreePop();
+			ImGui::Text("%s: %s (%u barriers)", frameGraph->GetPassName(p).c_str(),
+				frameGraph->GetPassCulled(p) ? "Culled" : "Run", (unsigned int)frameGraph->GetPassBarriers(p).size());
+		}
+		ImGui::Text("Transient Textures: (%u)", frameGraph->GetTransientTextureCount());
+		ImGui::Text("Pooled Textures: (%u)", frameGraph->GetPhysicalTextureCount());
+		ImGui::Text("Textures Created: (%u)", frameGraph->GetTexturesCreated());
+		ImGui::Text("Textures Released: (%u)", frameGraph->GetTexturesReleased());
+		ImGui::Text("Unbinds: (%u)", renderGraphBackend->GetUnbindCount());
+		for (const std::string& error : frameGraph->GetErrors())
+			ImGui::Text("Error: %s", error.c_str());
+	}
+
+	if (ImGui::CollapsingHeader("Depth Pre-Pass"))
+	{
+		ImGui::Combo("Mode", &depthPrePassMode, "Off\0On\0Auto\0");
+		ImGui::SliderFloat("Overdraw Threshold", &overdrawThreshold, 1.0f, 4.0f);
+		ImGui::Text("Estimated Overdraw: %.2f (max %u)", depthComplexity->GetOverdraw(), depthComplexity->GetMaxLayers());
+		ImGui::Text("Screen Coverage: %.0f%%", depthComplexity->GetCoverage() * 100.0f);
+		ImGui::Text("Estimate: %.3f ms", depthComplexity->GetEstimateSeconds() * 1000.0);
+		ImGui::Text("Active: %s", depthPrePassActive ? "Yes" : "No");
+		ImGui::Text("Pre-Pass Draw Calls: (%u)", (unsigned int)prePassBatches.size());
+	}
+
+	if (ImGui::CollapsingHeader("Shader Variants"))
+	{
+		ImGui::Text("Variants: (%u)", pixelShaderVariants->GetVariantCount());
+		ImGui::Text("Compiled: (%u)", pixelShaderVariants->GetCompiledCount());
+		ImGui::Text("Loaded From Disk: (%u)", pixelShaderVariants->GetLoadedCount());
+		ImGui::Text("Fallbacks: (%u)", pixelShaderVariants->GetFallbackCount());
+		ImGui::Text("G-Buffer Variants: (%u)", gBufferVariants->GetVariantCount());
+	}
+
+	if (ImGui::CollapsingHeader("Pipelines"))
+	{
+		ImGui::Text("Pipelines: (%u)", pipelineCache->GetPipelineCount());
+		ImGui::Text("Rasterizer States: (%u)", pipelineCache->GetRasterizerStateCount());
+		ImGui::Text("Blend States: (%u)", pipelineCache->GetBlendStateCount());
+		ImGui::Text("Depth-Stencil States: (%u)", pipelineCache->GetDepthStencilStateCount());
+		ImGui::Text("Cache Hits: (%u)", pipelineCache->GetHitCount());
+		ImGui::Text("Cache Misses: (%u)", pipelineCache->GetMissCount());
+	}
+
+	if (ImGui::CollapsingHeader("Instancing"))
+	{
+		ImGui::Text("Visible Entities: (%u)", instanceBatcher.GetItemCount());
+		ImGui::Text("Draw Calls: (%u)", (unsigned int)instanceBatcher.GetBatches().size());
+	}
+
+	if (ImGui::CollapsingHeader("Render Queue"))
+	{
+		unsigned int unsortedChanges = renderQueue.GetStateChangesUnsorted();
+		unsigned int sortedChanges = renderQueue.GetStateChangesSorted();
+		ImGui::Text("Packets: (%u)", (unsigned int)renderQueue.GetPackets().size());
+		ImGui::Text("State Changes Unsorted: (%u)", unsortedChanges);
+		ImGui::Text("State Changes Sorted: (%u)", sortedChanges);
+		ImGui::Text("State Changes Saved: (%u)", unsortedChanges - sortedChanges);
+		ImGui::Text("Sort Time: %.3f ms", renderQueue.GetSortSeconds() * 1000.0);
+		if (renderQueue.GetResourceIdOverflows() > 0)
+			ImGui::Text("Resource Id Overflows: (%u)", renderQueue.GetResourceIdOverflows());
+	}
+
+	if (ImGui::CollapsingHeader("Command Buffer"))
+	{
+		ImGui::Text("Commands: (%u)", (unsigned int)frameCommands.GetCommands().size());
+		ImGui::Text("Constant Data: (%u bytes)", frameCommands.GetConstantDataSize());
+		ImGui::Text("Record Time: %.3f ms", recordSeconds * 1000.0);
+		ImGui::Text("Record Threads: (%u)", threadPool->GetThreadCount());
+		ImGui::Text("Constant Bytes Uploaded: (%u)", ISimpleShader::BytesUploaded + commandExecutor->GetUploadedBytes());
+		ImGui::Text("Constant Bytes Changed: (%u)", ISimpleShader::BytesChanged);
+		ImGui::Text("Constant Uploads Skipped: (%u)", ISimpleShader::UploadsSkipped);
+		if (commandExecutor->GetRingSupported())
+		{
+			ConstantRing& ring = commandExecutor->GetConstantRing();
+			ImGui::Text("Constant Ring: %u / %u KB", ring.GetUsedBytes() / 1024, ring.GetCapacity() / 1024);
+			ImGui::Text("Ring Frames In Flight: (%u)", ring.GetFramesInFlight());
 		}
-		if (ImGui::TreeNode("Light 3"))
+		else
+			ImGui::Text("Constant Ring: unsupported (needs 11.1)");
+		ImGui::Text("SetConstants Fallbacks: (%u)", commandExecutor->GetFallbackCount());
+
+		bool filterRedundant = commandExecutor->GetFilterRedundant();
+		if (ImGui::Checkbox("Skip Redundant State", &filterRedundant))
+			commandExecutor->SetFilterRedundant(filterRedundant);
+		if (filterRedundant)
 		{
-			ImGui::ColorEdit3("Color", light4);
-			ImGui::TreePop();
+			StateCache& cache = commandExecutor->GetStateCache();
+			ImGui::Text("Calls Issued: (%u)", cache.GetIssuedCount());
+			ImGui::Text("Calls Skipped: (%u)", cache.GetElidedCount());
+			ImGui::Text("  Shaders: (%u)", cache.GetElidedCount(CommandType::SetShader));
+			ImGui::Text("  Pipelines: (%u)", cache.GetElidedCount(CommandType::SetPipeline));
+			ImGui::Text("  Pipeline Parts: (%u)", cache.GetElidedPipelineParts());
+			ImGui::Text("  Constant Buffers: (%u)", cache.GetElidedCount(CommandType::SetConstantBuffer));
+			ImGui::Text("  Resources: (%u)", cache.GetElidedCount(CommandType::SetShaderResource));
+			ImGui::Text("  Samplers: (%u)", cache.GetElidedCount(CommandType::SetSampler));
+			ImGui::Text("  Vertex/Index Buffers: (%u)",
+				cache.GetElidedCount(CommandType::SetVertexBuffer) + cache.GetElidedCount(CommandType::SetIndexBuffer));
 		}
-		if (ImGui::TreeNode("Light 4"))
+
+		ImGui::Checkbox("Validate", &validateCommands);
+		if (validateCommands)
 		{
-			ImGui::ColorEdit3("Color", light5);
-			ImGui::TreePop();
+			ImGui::Text("Draws: (%u)", commandValidator.GetDrawCount());
+			ImGui::Text("Instances: (%u)", commandValidator.GetInstanceCount());
+			ImGui::Text("Constant Updates: (%u)", commandValidator.GetCommandCount(CommandType::UpdateConstants));
+			ImGui::Text("Resource Binds: (%u)", commandValidator.GetCommandCount(CommandType::SetShaderResource));
+			ImGui::Text("Redundant Binds: (%u)", commandValidator.GetRedundantCount());
+			ImGui::Text("Errors: (%u)", commandValidator.GetErrorCount());
+			if (commandValidator.GetErrorCount() > 0)
+				ImGui::TextWrapped("%s", commandValidator.GetFirstError().c_str());
 		}
 	}
 
+	if (ImGui::CollapsingHeader("Occlusion Culling"))
+	{
+		ImGui::Checkbox("Enabled", &occlusionCullingEnabled);
+
+		double rasterSeconds = occlusionCuller->GetRasterizeSeconds();
+		double testSeconds = occlusionCuller->GetTestSeconds();
+		ImGui::Text("Occluder Triangles: (%u)", occlusionCuller->GetOccluderTriangleCount());
+		ImGui::Text("Occludee Tests: (%u)", occlusionCuller->GetOccludeeTestCount());
+		ImGui::Text("Culled: (%u)", occlusionCuller->GetCulledCount());
+		ImGui::Text("Triangles/s: (%g)", rasterSeconds > 0.0 ? occlusionCuller->GetOccluderTriangleCount() / rasterSeconds : 0.0);
+		ImGui::Text("Tests/s: (%g)", testSeconds > 0.0 ? occlusionCuller->GetOccludeeTestCount() / testSeconds : 0.0);
+
+		UpdateOcclusionDebugTexture();
+		ImGui::Image(occlusionDebugSRV.Get(), ImVec2((float)occlusionCuller->GetWidth(), (float)occlusionCuller->GetHeight()));
+	}
+
 	static int blur = blurRadius;
 
 	if (ImGui::CollapsingHeader("Post Processing"))
@@ -875,27 +2095,6 @@ void Game::ImGuiUpdate(float deltaTime, float totalTime)
 	IMGUI_colorTint.z = vec4f[2];
 	IMGUI_colorTint.w = vec4f[3];
 
-	//Light colors
-	directionalLight.Color.x = light[0];
-	directionalLight.Color.y = light[1];
-	directionalLight.Color.z = light[2];
-
-	directionalLight2.Color.x = light2[0];
-	directionalLight2.Color.y = light2[1];
-	directionalLight2.Color.z = light2[2];
-
-	directionalLight3.Color.x = light3[0];
-	directionalLight3.Color.y = light3[1];
-	directionalLight3.Color.z = light3[2];
-
-	pointLight.Color.x = light4[0];
-	pointLight.Color.y = light4[1];
-	pointLight.Color.z = light4[2];
-
-	pointLight2.Color.x = light5[0];
-	pointLight2.Color.y = light5[1];
-	pointLight2.Color.z = light5[2];
-
 	//Blur
 	blurRadius = blur;
 
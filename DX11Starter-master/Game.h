@@ -13,8 +13,30 @@
 #include "Camera.h"
 #include "SimpleShader.h"
 #include "Material.h"
+#include "BufferStructs.h"
 #include "Lights.h"
+#include "LightManager.h"
+#include "LightClusterer.h"
 #include "Sky.h"
+#include "OcclusionCuller.h"
+#include "DepthComplexity.h"
+#include "ShadowCascades.h"
+#include "ShadowAtlas.h"
+#include "InstanceBatcher.h"
+#include "RenderQueue.h"
+#include "CommandBuffer.h"
+#include "D3D11CommandExecutor.h"
+#include "NullCommandExecutor.h"
+#include "PipelineState.h"
+#include "D3D11PipelineFactory.h"
+#include "RenderGraph.h"
+#include "D3D11RenderGraphBackend.h"
+#include "ThreadPool.h"
+
+// Depth pre-pass modes, Auto follows the overdraw estimate
+#define DEPTH_PRE_PASS_OFF 0
+#define DEPTH_PRE_PASS_ON 1
+#define DEPTH_PRE_PASS_AUTO 2
 
 class Game 
 	: public DXCore
@@ -39,6 +61,28 @@ private:
 	// Initialization helper methods - feel free to customize, combine, remove, etc.
 	void LoadShaders(); 
 	void CreateGeometry();
+	void SelectShaderVariants();
+	void CullEntities();
+	void UpdateShadowCascades();
+	void DrawShadowCasters(unsigned int cascade, bool staticCasters);
+	void DrawShadowCasterList(const std::vector<unsigned int>& casters, const DirectX::XMFLOAT4X4& viewProjection);
+	void UpdateShadowAtlas();
+	void UploadLights();
+	void AssignLightClusters();
+	void BuildInstanceBatches();
+	void RecordScene();
+	void RecordBatches(unsigned int chunkIndex, unsigned int firstBatch, unsigned int batchCount, bool gBuffer);
+	void RecordDepthPrePass();
+	bool InDepthPrePass(Material* material);
+	void RenderShadowAtlas();
+	void BuildFrameGraph();
+	D3D11RenderGraphTexture* GetFrameTexture(RenderGraphResource resource);
+	void RenderShadows();
+	void RenderGBuffer();
+	void RenderDeferredLighting();
+	void RenderForward();
+	void RenderPostProcess();
+	void UpdateOcclusionDebugTexture();
 
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -50,12 +94,14 @@ private:
 	//Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 	
 	// Shaders and shader-related constructs
-	std::shared_ptr<SimplePixelShader> pixelShader;
+	std::shared_ptr<SimplePixelShader> pixelShader; // Everything on, used when a variant can't be built
+	std::shared_ptr<PixelShaderVariants> pixelShaderVariants;
 	std::shared_ptr<SimplePixelShader> psCustom;
 	std::shared_ptr<SimpleVertexShader> vertexShader;
 	std::shared_ptr<SimplePixelShader> skyPixelShader;
 	std::shared_ptr<SimpleVertexShader> skyVertexShader;
 	std::shared_ptr<SimpleVertexShader> shadowVS;
+	unsigned int shadowObjectSlot; // Fed per caster with SetConstants
 
 	//Camera
 	std::vector<std::shared_ptr<Camera>> cameras;
@@ -63,6 +109,7 @@ private:
 
 	//List of meshes
 	std::vector<std::shared_ptr<Entity>> entities;
+	std::vector<std::shared_ptr<Entity>> visibleEntities;
 
 	//List of Materials
 	std::shared_ptr<Material> material;
@@ -73,11 +120,22 @@ private:
 
 	//Lights
 	DirectX::XMFLOAT3 ambientColor;
-	Light directionalLight;
-	Light directionalLight2;
-	Light directionalLight3;
-	Light pointLight;
-	Light pointLight2;
+	LightManager lightManager;
+	LightHandle cascadeLight; // The directional light the shadow cascades follow
+
+	//Shader copy of the lights, only the changed ones are copied each frame
+	Microsoft::WRL::ComPtr<ID3D11Buffer> lightBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> lightSRV;
+	unsigned int lightBufferCapacity;
+	unsigned int lightsUploaded;
+
+	//Clustered lighting: which lights reach each cluster, rebuilt every frame
+	std::unique_ptr<LightClusterer> lightClusterer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterRangeBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> clusterRangeSRV;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> clusterIndexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> clusterIndexSRV;
+	unsigned int clusterIndexCapacity;
 
 	//Textures
 	//-------------------------------------
@@ -118,22 +176,133 @@ private:
 	Sky sky;
 
 	//Shadows
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSVs[SHADOW_CASCADE_COUNT];
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
-	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
+	const PipelineState* shadowPipeline; // Shadow VS, no PS, depth biased
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
-	DirectX::XMFLOAT4X4 lightViewMatrix;
-	DirectX::XMFLOAT4X4 lightProjectMatrix;
+	DirectX::XMFLOAT4X4 shadowCascadeMatrices[SHADOW_CASCADE_COUNT];
 	float shadowMapRes;
+	std::unique_ptr<ShadowCascades> shadowCascades;
+
+	//Static shadow cache
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> staticShadowTexture;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> staticShadowDSVs[SHADOW_CASCADE_COUNT];
+	DirectX::XMFLOAT4X4 cachedCascadeMatrices[SHADOW_CASCADE_COUNT];
+	bool shadowCacheValid[SHADOW_CASCADE_COUNT];
+	unsigned int cachedStaticVersion;
+	DirectX::XMFLOAT3 cachedLightDirection;
+	bool shadowCacheEnabled;
+	unsigned int staticShadowRedraws;
+
+	//Scratch for drawing casters, kept to avoid reallocating
+	std::vector<unsigned int> shadowCasterList;
+	std::vector<DirectX::XMFLOAT4X4> shadowCasterWorlds;
+	std::vector<ShadowObjectConstants> shadowCasterConstants;
+
+	//Shadow atlas for local lights
+	struct AtlasTileDraw
+	{
+		ShadowAtlasTile Tile;
+		DirectX::XMFLOAT4X4 ViewProjection;
+		std::vector<unsigned int> Casters;
+		bool NeedsRender;
+	};
+	struct ShadowedLight
+	{
+		LightHandle Source;
+		DirectX::XMFLOAT3 CachedPosition;
+		float CachedRange;
+		unsigned int CachedCasterHash;
+		int FirstTile; //Index into atlasMatrices/atlasRects, -1 when unshadowed
+	};
+	std::unique_ptr<ShadowAtlas> shadowAtlas;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowAtlasDSV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowAtlasSRV;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> shadowAtlasClearState;
+	std::vector<ShadowedLight> shadowedLights;
+	std::vector<AtlasTileDraw> atlasDraws;
+	DirectX::XMFLOAT4X4 atlasMatrices[MAX_ATLAS_TILES];
+	DirectX::XMFLOAT4 atlasRects[MAX_ATLAS_TILES];
+	unsigned int atlasTilesRendered;
 
 	//Post Processing
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> ppSampler;
 	std::shared_ptr<SimpleVertexShader> ppVS;
 	std::shared_ptr<SimplePixelShader> ppPS;
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> ppRTV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ppSRV;
 	int blurRadius;
 
+	//Deferred shading: opaque surfaces go to the G-buffer (see
+	//GBufferPacking.h) and are lit in one full screen pass
+	std::shared_ptr<SimplePixelShader> gBufferPS; // Everything on, used when a variant can't be built
+	std::shared_ptr<PixelShaderVariants> gBufferVariants;
+	std::shared_ptr<SimplePixelShader> deferredLightingPS;
+	CommandBuffer gBufferCommands;
+	unsigned int gBufferBatchCount; // Leading batches drawn into the G-buffer
+	bool deferredShading;
+	float frameMilliseconds[2]; // Smoothed, forward then deferred
+	PixelFrameConstants pixelFrame; // Shared by the forward shaders and the lighting pass
+
+	//Depth pre-pass: forward opaques lay down depth front to back,
+	//then shade with an equal test so each pixel is shaded once
+	std::shared_ptr<SimpleVertexShader> depthPrePassVS;
+	const PipelineState* depthPrePassPipeline; // Position only VS, no PS
+	std::unique_ptr<DepthComplexityEstimator> depthComplexity;
+	std::vector<float> visibleDepths; // View depth per visible entity, for ordering the pre-pass
+	std::vector<unsigned int> prePassBatches;
+	int depthPrePassMode;
+	float overdrawThreshold; // Auto turns the pre-pass on above this
+	bool depthPrePassActive; // This frame
+
+	//Render Graph: the frame as passes (see BuildFrameGraph()),
+	//owning the screen sized targets
+	struct FrameResources
+	{
+		RenderGraphResource BackBuffer;
+		RenderGraphResource ShadowMap;
+		RenderGraphResource ShadowAtlas;
+		RenderGraphResource SceneColor; // Post-processed into the back buffer
+		RenderGraphResource SceneDepth;
+		RenderGraphResource GBuffer0; // Deferred only
+		RenderGraphResource GBuffer1;
+	};
+	std::unique_ptr<D3D11RenderGraphBackend> renderGraphBackend; // Before the graph, which releases through it
+	std::unique_ptr<RenderGraph> frameGraph;
+	FrameResources frameResources;
+	D3D11RenderGraphTexture backBufferTarget; // Imported textures
+	D3D11RenderGraphTexture shadowMapTarget;
+	D3D11RenderGraphTexture shadowAtlasTarget;
+
+	//Instancing
+	RenderQueue renderQueue;
+	InstanceBatcher instanceBatcher;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+	unsigned int instanceBufferCapacity;
+
+	//Command Buffer
+	struct RecordChunk
+	{
+		CommandBuffer Commands;
+	};
+
+	std::unique_ptr<ThreadPool> threadPool;
+	std::vector<RecordChunk> recordChunks;
+	CommandBuffer frameCommands;
+	CommandBuffer shadowCommands;
+	CommandBuffer validationCommands; // Deferred frames are checked as one buffer
+	std::unique_ptr<D3D11CommandExecutor> commandExecutor;
+	std::unique_ptr<D3D11PipelineFactory> pipelineFactory;
+	std::unique_ptr<PipelineCache> pipelineCache;
+	NullCommandExecutor commandValidator;
+	bool validateCommands;
+	double recordSeconds;
+
+	//Occlusion Culling
+	std::unique_ptr<OcclusionCuller> occlusionCuller;
+	bool occlusionCullingEnabled;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> occlusionDebugTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> occlusionDebugSRV;
+	std::vector<unsigned int> occlusionDebugPixels;
 
 	//Misc
 	float rotate;
@@ -0,0 +1,86 @@
+#include "InstanceBatcher.h"
+#include "MatrixBatch.h"
+
+InstanceBatcher::InstanceBatcher()
+{
+}
+
+InstanceBatcher::~InstanceBatcher()
+{
+}
+
+void InstanceBatcher::Begin()
+{
+	items.clear();
+	batches.clear();
+	instances.clear();
+}
+
+void InstanceBatcher::Add(unsigned int item, const void* mesh, const void* material, const void* shader,
+	const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose)
+{
+	Item newItem = {};
+	newItem.UserIndex = item;
+	newItem.Mesh = mesh;
+	newItem.Material = material;
+	newItem.Shader = shader;
+	newItem.Data.World = world;
+	newItem.Data.WorldInverseTranspose = worldInverseTranspose;
+	items.push_back(newItem);
+}
+
+void InstanceBatcher::Build(const DirectX::XMFLOAT4X4& viewProjection)
+{
+	batches.clear();
+	instances.resize(items.size());
+	for (unsigned int i = 0; i < items.size(); i++)
+	{
+		const Item& item = items[i];
+		instances[i] = item.Data;
+
+		//Same keys as the batch being built, just grow it
+		if (!batches.empty())
+		{
+			InstanceBatch& last = batches.back();
+			if (last.Shader == item.Shader && last.Material == item.Material && last.Mesh == item.Mesh)
+			{
+				last.InstanceCount++;
+				continue;
+			}
+		}
+
+		InstanceBatch batch = {};
+		batch.Mesh = item.Mesh;
+		batch.Material = item.Material;
+		batch.Shader = item.Shader;
+		batch.FirstInstance = i;
+		batch.InstanceCount = 1;
+		batch.FirstItem = item.UserIndex;
+		batches.push_back(batch);
+	}
+
+	//One batched pass, so the vertex shader doesn't multiply matrices per vertex
+	if (!instances.empty())
+	{
+		MultiplyMatrixBatch(
+			&instances[0].World, sizeof(InstanceData),
+			viewProjection,
+			&instances[0].WorldViewProjection, sizeof(InstanceData),
+			(unsigned int)instances.size());
+	}
+}
+
+const std::vector<InstanceBatch>& InstanceBatcher::GetBatches()
+{
+	return batches;
+}
+
+const std::vector<InstanceData>& InstanceBatcher::GetInstances()
+{
+	return instances;
+}
+
+unsigned int InstanceBatcher::GetItemCount()
+{
+	return (unsigned int)items.size();
+}
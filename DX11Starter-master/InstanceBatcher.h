@@ -0,0 +1,73 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Per instance vertex data, read by VertexShader.hlsl through the
+// WORLD_VIEW_PROJECTION_PER_INSTANCE, WORLD_PER_INSTANCE and
+// WORLD_INVERSE_TRANSPOSE_PER_INSTANCE semantics (in this order)
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 WorldViewProjection; // Filled in by Build()
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInverseTranspose;
+};
+
+// One instanced draw: a run of instances sharing mesh, material and shader
+struct InstanceBatch
+{
+	const void* Mesh;
+	const void* Material;
+	const void* Shader;
+	unsigned int FirstInstance; // Offset into the packed instance array
+	unsigned int InstanceCount;
+	unsigned int FirstItem;     // User index of the first item in the batch
+};
+
+// --------------------------------------------------------
+// Merges runs of draw items that share a mesh, material and
+// shader and packs their per instance data contiguously, so
+// each run can be drawn with a single DrawIndexedInstanced
+//
+// - Items are expected in draw order (see RenderQueue), only
+//   neighbours are merged so that order is preserved
+// - Mesh/material/shader are opaque keys (any pointer), so
+//   none of this depends on Direct3D
+// --------------------------------------------------------
+class InstanceBatcher
+{
+public:
+	InstanceBatcher();
+	~InstanceBatcher();
+
+	// Forgets last frame's items
+	void Begin();
+
+	// Queues one item
+	// item - Caller's own index, handed back through InstanceBatch::FirstItem
+	void Add(unsigned int item, const void* mesh, const void* material, const void* shader,
+		const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& worldInverseTranspose);
+
+	// Merges neighbouring items into batches, packs their instance
+	// data and works out every instance's world-view-projection
+	void Build(const DirectX::XMFLOAT4X4& viewProjection);
+
+	//Getters
+	const std::vector<InstanceBatch>& GetBatches();
+	const std::vector<InstanceData>& GetInstances();
+	unsigned int GetItemCount();
+
+private:
+	struct Item
+	{
+		unsigned int UserIndex;
+		const void* Mesh;
+		const void* Material;
+		const void* Shader;
+		InstanceData Data;
+	};
+
+	std::vector<Item> items;
+	std::vector<InstanceBatch> batches;
+	std::vector<InstanceData> instances;
+};
@@ -0,0 +1,389 @@
+#include "LightClusterer.h"
+#include "CpuFeatures.h"
+#include "Lights.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Lights bounded per job in the first pass
+#define CLUSTER_LIGHTS_PER_JOB 256
+
+// Columns a light's row has to cover for the AVX2 test to pay off
+#define CLUSTER_AVX2_MIN_COLUMNS 4
+
+// Bounds for the padding columns, so they never pass a test
+#define CLUSTER_NEVER 1e30f
+
+// --------------------------------------------------------
+// Constructor
+//
+// tilesX, tilesY - Screen tiles across and down
+// slices         - Depth slices between the near and far planes
+// threadPool     - Shared pool to assign with, must outlive
+//                  the clusterer
+// --------------------------------------------------------
+LightClusterer::LightClusterer(unsigned int tilesX, unsigned int tilesY, unsigned int slices, ThreadPool* threadPool)
+{
+	this->tilesX = tilesX;
+	this->tilesY = tilesY;
+	this->slices = slices;
+	paddedTilesX = (tilesX + 7) & ~7u;
+
+	memset(&cachedProjection, 0, sizeof(cachedProjection));
+	cachedNear = 0.0f;
+	cachedFar = 0.0f;
+	sliceScale = 0.0f;
+	sliceBias = 0.0f;
+
+	sliceClusterLights.resize(slices);
+	for (auto& slice : sliceClusterLights)
+	{
+		slice.resize(tilesX * tilesY);
+	}
+	sliceTotals.resize(slices);
+	clusters.resize(tilesX * tilesY * slices);
+
+	this->threadPool = threadPool;
+	useAVX2 = CpuHasAVX2();
+	maxLightsPerCluster = 0;
+	assignSeconds = 0.0;
+}
+
+LightClusterer::~LightClusterer()
+{
+}
+
+// --------------------------------------------------------
+// Bounds every light, bins them by slice, fills the slices
+// in parallel and packs the lists into one index array
+// --------------------------------------------------------
+void LightClusterer::Assign(const XMFLOAT4X4& view, const XMFLOAT4X4& projection, float nearPlane, float farPlane,
+	const int* types, const XMFLOAT3* positions, const float* ranges, unsigned int count)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (memcmp(&projection, &cachedProjection, sizeof(XMFLOAT4X4)) != 0 ||
+		nearPlane != cachedNear || farPlane != cachedFar)
+	{
+		BuildClusterBounds(projection, nearPlane, farPlane);
+	}
+
+	//Local lights get view space bounds, directional ones go everywhere
+	bounds.resize(count);
+	directionalLights.clear();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (types[i] == LIGHT_TYPE_DIRECTIONAL)
+			directionalLights.push_back(i);
+	}
+
+	unsigned int jobCount = (count + CLUSTER_LIGHTS_PER_JOB - 1) / CLUSTER_LIGHTS_PER_JOB;
+	threadPool->ParallelFor(jobCount, [&](unsigned int job)
+	{
+		unsigned int end = std::min(count, (job + 1) * CLUSTER_LIGHTS_PER_JOB);
+		for (unsigned int i = job * CLUSTER_LIGHTS_PER_JOB; i < end; i++)
+		{
+			if (types[i] == LIGHT_TYPE_DIRECTIONAL)
+			{
+				bounds[i].Slice0 = 1;
+				bounds[i].Slice1 = 0;
+				continue;
+			}
+			BoundLight(i, view, positions[i], ranges[i]);
+		}
+	});
+
+	//Counting sort into slice bins, keeping light order within each
+	sliceBinStarts.assign(slices + 1, 0);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		for (unsigned int s = bounds[i].Slice0; s <= bounds[i].Slice1 && s < slices; s++)
+			sliceBinStarts[s + 1]++;
+	}
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		sliceBinStarts[s + 1] += sliceBinStarts[s];
+	}
+	sliceBins.resize(sliceBinStarts[slices]);
+	std::vector<unsigned int> fill(sliceBinStarts.begin(), sliceBinStarts.end() - 1);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		for (unsigned int s = bounds[i].Slice0; s <= bounds[i].Slice1 && s < slices; s++)
+			sliceBins[fill[s]++] = i;
+	}
+
+	threadPool->ParallelFor(slices, [this](unsigned int s) { FillSlice(s); });
+
+	//Slices are packed in order, each one copying its own lists
+	unsigned int total = 0;
+	std::vector<unsigned int> sliceOffsets(slices);
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		sliceOffsets[s] = total;
+		total += sliceTotals[s];
+	}
+	lightIndices.resize(total);
+
+	std::vector<unsigned int> sliceMax(slices, 0);
+	threadPool->ParallelFor(slices, [&](unsigned int s)
+	{
+		unsigned int offset = sliceOffsets[s];
+		for (unsigned int tile = 0; tile < tilesX * tilesY; tile++)
+		{
+			const std::vector<unsigned int>& list = sliceClusterLights[s][tile];
+			ClusterRange& range = clusters[s * tilesX * tilesY + tile];
+			range.Offset = offset;
+			range.Count = (unsigned int)list.size();
+			if (!list.empty())
+				memcpy(&lightIndices[offset], list.data(), list.size() * sizeof(unsigned int));
+			offset += range.Count;
+			sliceMax[s] = std::max(sliceMax[s], range.Count);
+		}
+	});
+
+	maxLightsPerCluster = 0;
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		maxLightsPerCluster = std::max(maxLightsPerCluster, sliceMax[s]);
+	}
+
+	assignSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+const std::vector<ClusterRange>& LightClusterer::GetClusters()
+{
+	return clusters;
+}
+
+const std::vector<unsigned int>& LightClusterer::GetLightIndices()
+{
+	return lightIndices;
+}
+
+float LightClusterer::GetSliceScale()
+{
+	return sliceScale;
+}
+
+float LightClusterer::GetSliceBias()
+{
+	return sliceBias;
+}
+
+unsigned int LightClusterer::GetTilesX()
+{
+	return tilesX;
+}
+
+unsigned int LightClusterer::GetTilesY()
+{
+	return tilesY;
+}
+
+unsigned int LightClusterer::GetSliceCount()
+{
+	return slices;
+}
+
+unsigned int LightClusterer::GetClusterCount()
+{
+	return tilesX * tilesY * slices;
+}
+
+bool LightClusterer::GetUseAVX2()
+{
+	return useAVX2;
+}
+
+void LightClusterer::SetUseAVX2(bool useAVX2)
+{
+	this->useAVX2 = useAVX2 && CpuHasAVX2();
+}
+
+unsigned int LightClusterer::GetMaxLightsPerCluster()
+{
+	return maxLightsPerCluster;
+}
+
+double LightClusterer::GetAssignSeconds()
+{
+	return assignSeconds;
+}
+
+// --------------------------------------------------------
+// View space box around every cluster
+// - Slice k spans near * (far / near)^(k / slices) onwards
+// - A tile's sides are planes through the eye, so its x and
+//   y extents are widest at whichever end of the slice is
+//   farther from the center line
+// --------------------------------------------------------
+void LightClusterer::BuildClusterBounds(const XMFLOAT4X4& projection, float nearPlane, float farPlane)
+{
+	cachedProjection = projection;
+	cachedNear = nearPlane;
+	cachedFar = farPlane;
+
+	float logRatio = logf(farPlane / nearPlane);
+	sliceScale = slices / logRatio;
+	sliceBias = -(float)slices * logf(nearPlane) / logRatio;
+
+	sliceNear.resize(slices);
+	sliceFar.resize(slices);
+	clusterMinX.assign(slices * paddedTilesX, CLUSTER_NEVER);
+	clusterMaxX.assign(slices * paddedTilesX, CLUSTER_NEVER);
+	clusterMinY.resize(slices * tilesY);
+	clusterMaxY.resize(slices * tilesY);
+
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		float zNear = nearPlane * powf(farPlane / nearPlane, (float)s / slices);
+		float zFar = nearPlane * powf(farPlane / nearPlane, (float)(s + 1) / slices);
+		sliceNear[s] = zNear;
+		sliceFar[s] = zFar;
+
+		for (unsigned int x = 0; x < tilesX; x++)
+		{
+			float left = (-1.0f + 2.0f * x / tilesX) / projection._11;
+			float right = (-1.0f + 2.0f * (x + 1) / tilesX) / projection._11;
+			clusterMinX[s * paddedTilesX + x] = left * (left < 0.0f ? zFar : zNear);
+			clusterMaxX[s * paddedTilesX + x] = right * (right > 0.0f ? zFar : zNear);
+		}
+
+		//Rows go top to bottom, like pixels
+		for (unsigned int y = 0; y < tilesY; y++)
+		{
+			float top = (1.0f - 2.0f * y / tilesY) / projection._22;
+			float bottom = (1.0f - 2.0f * (y + 1) / tilesY) / projection._22;
+			clusterMinY[s * tilesY + y] = bottom * (bottom < 0.0f ? zFar : zNear);
+			clusterMaxY[s * tilesY + y] = top * (top > 0.0f ? zFar : zNear);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Works out which slices and tiles a light's sphere could
+// touch. The tile range comes from the sphere's view space
+// box over the part of the depth range it covers, which is
+// conservative; FillSlice() does the exact test per cluster.
+// --------------------------------------------------------
+void LightClusterer::BoundLight(unsigned int light, const XMFLOAT4X4& view, const XMFLOAT3& position, float range)
+{
+	LightBounds& b = bounds[light];
+	XMStoreFloat3(&b.Center, XMVector3TransformCoord(XMLoadFloat3(&position), XMLoadFloat4x4(&view)));
+	b.RadiusSquared = range * range;
+
+	//Nothing in the frustum's depth range? Then no slices at all
+	float zLow = std::max(b.Center.z - range, cachedNear);
+	float zHigh = std::min(b.Center.z + range, cachedFar);
+	if (range <= 0.0f || zLow > zHigh)
+	{
+		b.Slice0 = 1;
+		b.Slice1 = 0;
+		return;
+	}
+
+	float slice0 = floorf(logf(zLow) * sliceScale + sliceBias);
+	float slice1 = floorf(logf(zHigh) * sliceScale + sliceBias);
+	b.Slice0 = (unsigned int)std::min(std::max(slice0, 0.0f), (float)(slices - 1));
+	b.Slice1 = (unsigned int)std::min(std::max(slice1, 0.0f), (float)(slices - 1));
+
+	//Smallest and largest x / z (and y / z) over the box
+	float minX = b.Center.x - range, maxX = b.Center.x + range;
+	float minY = b.Center.y - range, maxY = b.Center.y + range;
+	float left = minX / (minX >= 0.0f ? zHigh : zLow) * cachedProjection._11;
+	float right = maxX / (maxX >= 0.0f ? zLow : zHigh) * cachedProjection._11;
+	float bottom = minY / (minY >= 0.0f ? zHigh : zLow) * cachedProjection._22;
+	float top = maxY / (maxY >= 0.0f ? zLow : zHigh) * cachedProjection._22;
+
+	float tileX0 = floorf((left + 1.0f) * 0.5f * tilesX);
+	float tileX1 = floorf((right + 1.0f) * 0.5f * tilesX);
+	float tileY0 = floorf((1.0f - top) * 0.5f * tilesY);
+	float tileY1 = floorf((1.0f - bottom) * 0.5f * tilesY);
+	if (tileX1 < 0.0f || tileX0 >= tilesX || tileY1 < 0.0f || tileY0 >= tilesY)
+	{
+		b.Slice0 = 1;
+		b.Slice1 = 0;
+		return;
+	}
+
+	b.TileX0 = (unsigned int)std::max(tileX0, 0.0f);
+	b.TileX1 = (unsigned int)std::min(tileX1, (float)(tilesX - 1));
+	b.TileY0 = (unsigned int)std::max(tileY0, 0.0f);
+	b.TileY1 = (unsigned int)std::min(tileY1, (float)(tilesY - 1));
+}
+
+// --------------------------------------------------------
+// Tests one slice's binned lights against its clusters
+// - Sphere vs box, done as the squared distance from the
+//   center to the box, built up one axis at a time so whole
+//   rows can be skipped early
+// - Runs on worker threads, touching only this slice's lists
+// --------------------------------------------------------
+void LightClusterer::FillSlice(unsigned int slice)
+{
+	std::vector<std::vector<unsigned int>>& lists = sliceClusterLights[slice];
+	for (auto& list : lists)
+	{
+		list.clear();
+		list.insert(list.end(), directionalLights.begin(), directionalLights.end());
+	}
+
+	float zNear = sliceNear[slice];
+	float zFar = sliceFar[slice];
+	const float* minXs = &clusterMinX[slice * paddedTilesX];
+	const float* maxXs = &clusterMaxX[slice * paddedTilesX];
+	const float* minYs = &clusterMinY[slice * tilesY];
+	const float* maxYs = &clusterMaxY[slice * tilesY];
+
+	for (unsigned int b = sliceBinStarts[slice]; b < sliceBinStarts[slice + 1]; b++)
+	{
+		unsigned int light = sliceBins[b];
+		const LightBounds& l = bounds[light];
+
+		float dz = std::max(0.0f, std::max(zNear - l.Center.z, l.Center.z - zFar));
+		float dzSquared = dz * dz;
+		if (dzSquared > l.RadiusSquared)
+			continue;
+
+		for (unsigned int y = l.TileY0; y <= l.TileY1; y++)
+		{
+			float dy = std::max(0.0f, std::max(minYs[y] - l.Center.y, l.Center.y - maxYs[y]));
+			float dyzSquared = dzSquared + dy * dy;
+			if (dyzSquared > l.RadiusSquared)
+				continue;
+
+			//Narrow rows would leave most of the 8 lanes masked off
+			std::vector<unsigned int>* row = &lists[y * tilesX];
+			if (useAVX2 && l.TileX1 - l.TileX0 >= CLUSTER_AVX2_MIN_COLUMNS - 1)
+				FillRowAVX2(minXs, maxXs, l, dyzSquared, light, row);
+			else
+				FillRow(minXs, maxXs, l, dyzSquared, light, row);
+		}
+	}
+
+	unsigned int total = 0;
+	for (auto& list : lists)
+	{
+		total += (unsigned int)list.size();
+	}
+	sliceTotals[slice] = total;
+}
+
+// --------------------------------------------------------
+// Adds the light to each cluster of a row, within its tile
+// range, that the sphere reaches
+// --------------------------------------------------------
+void LightClusterer::FillRow(const float* minXs, const float* maxXs, const LightBounds& l,
+	float dyzSquared, unsigned int light, std::vector<unsigned int>* row)
+{
+	for (unsigned int x = l.TileX0; x <= l.TileX1; x++)
+	{
+		float dx = std::max(0.0f, std::max(minXs[x] - l.Center.x, l.Center.x - maxXs[x]));
+		if (dyzSquared + dx * dx <= l.RadiusSquared)
+			row[x].push_back(light);
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "ThreadPool.h"
+
+// Where one cluster's lights sit in the light index list
+// (same layout as the shader's uint2)
+struct ClusterRange
+{
+	unsigned int Offset;
+	unsigned int Count;
+};
+
+// --------------------------------------------------------
+// Clustered forward light assignment, done on the CPU
+//
+// The view frustum is split into a grid of clusters: screen
+// tiles across and down, and depth slices that get thicker
+// exponentially with distance, so every cluster is roughly
+// as deep as it is wide. Each frame every light's bounding
+// sphere is tested against the clusters it could reach, and
+// the result is one compact list of light indices per
+// cluster, which the pixel shader looks up from its screen
+// position and view depth.
+//
+// - Point and spot lights are bounded by a sphere of their
+//   range (spot cones included whole). Directional lights
+//   reach everywhere and go in every cluster.
+// - Lights are first binned by the slices they overlap, then
+//   slices are filled in parallel, 8 clusters of a tile row
+//   per sphere test with AVX2 if the CPU has it
+// - Indices within a cluster stay in light order, so the
+//   output doesn't depend on the thread count
+//
+// Knows nothing about Direct3D
+// --------------------------------------------------------
+class LightClusterer
+{
+public:
+	LightClusterer(unsigned int tilesX, unsigned int tilesY, unsigned int slices, ThreadPool* threadPool);
+	~LightClusterer();
+
+	// Assigns this frame's lights to clusters
+	// view, projection - The camera's (left handed, symmetric perspective)
+	// types, positions, ranges - count lights, as laid out by LightManager
+	void Assign(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection,
+		float nearPlane, float farPlane,
+		const int* types, const DirectX::XMFLOAT3* positions, const float* ranges, unsigned int count);
+
+	// One per cluster: x fastest, then y (top row first), then slice
+	const std::vector<ClusterRange>& GetClusters();
+	const std::vector<unsigned int>& GetLightIndices();
+
+	// Slice of a view depth: floor(log(depth) * scale + bias)
+	float GetSliceScale();
+	float GetSliceBias();
+
+	// Turns the AVX2 path on or off, off if the CPU doesn't have it
+	void SetUseAVX2(bool useAVX2);
+
+	//Getters
+	unsigned int GetTilesX();
+	unsigned int GetTilesY();
+	unsigned int GetSliceCount();
+	unsigned int GetClusterCount();
+	bool GetUseAVX2();
+
+	//Stats
+	unsigned int GetMaxLightsPerCluster();
+	double GetAssignSeconds();
+
+private:
+	// A light's reach in view space and the clusters it might touch
+	struct LightBounds
+	{
+		DirectX::XMFLOAT3 Center;
+		float RadiusSquared;
+		unsigned int TileX0, TileX1;
+		unsigned int TileY0, TileY1;
+		unsigned int Slice0, Slice1;
+	};
+
+	unsigned int tilesX;
+	unsigned int tilesY;
+	unsigned int slices;
+	unsigned int paddedTilesX; // Rounded up to 8 for the AVX2 test
+
+	// Cluster bounds in view space, only rebuilt when the projection changes.
+	// x and y bounds depend on the slice as the tiles widen with depth.
+	DirectX::XMFLOAT4X4 cachedProjection;
+	float cachedNear;
+	float cachedFar;
+	std::vector<float> sliceNear; // Per slice
+	std::vector<float> sliceFar;
+	std::vector<float> clusterMinX; // Per slice, paddedTilesX each
+	std::vector<float> clusterMaxX;
+	std::vector<float> clusterMinY; // Per slice, tilesY each
+	std::vector<float> clusterMaxY;
+	float sliceScale;
+	float sliceBias;
+
+	// Per frame working data
+	std::vector<LightBounds> bounds;
+	std::vector<unsigned int> directionalLights;
+	std::vector<unsigned int> sliceBinStarts; // Lights overlapping each slice, via sliceBins
+	std::vector<unsigned int> sliceBins;
+	std::vector<std::vector<std::vector<unsigned int>>> sliceClusterLights; // [slice][tile] light lists
+	std::vector<unsigned int> sliceTotals;
+
+	// Output
+	std::vector<ClusterRange> clusters;
+	std::vector<unsigned int> lightIndices;
+
+	ThreadPool* threadPool;
+	bool useAVX2;
+
+	//Stats
+	unsigned int maxLightsPerCluster;
+	double assignSeconds;
+
+	void BuildClusterBounds(const DirectX::XMFLOAT4X4& projection, float nearPlane, float farPlane);
+	void BoundLight(unsigned int light, const DirectX::XMFLOAT4X4& view,
+		const DirectX::XMFLOAT3& position, float range);
+	void FillSlice(unsigned int slice);
+
+	// Tests one light against a row of a slice's clusters
+	static void FillRow(const float* minXs, const float* maxXs, const LightBounds& l,
+		float dyzSquared, unsigned int light, std::vector<unsigned int>* row);
+
+	// Same as above 8 clusters at a time. Defined in
+	// LightClustererAVX2.cpp, the only file built with AVX2.
+	static void FillRowAVX2(const float* minXs, const float* maxXs, const LightBounds& l,
+		float dyzSquared, unsigned int light, std::vector<unsigned int>* row);
+};
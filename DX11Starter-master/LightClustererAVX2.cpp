@@ -0,0 +1,40 @@
+#include "LightClusterer.h"
+#include <immintrin.h>
+
+// --------------------------------------------------------
+// The AVX2 path of LightClusterer. Like OcclusionCullerAVX2.cpp
+// this file alone is built with AVX2, and only runs once
+// CpuHasAVX2() said so.
+// --------------------------------------------------------
+
+// --------------------------------------------------------
+// 8 columns at a time, lanes outside the light's tile range
+// are masked off. The padding columns' bounds never pass.
+// --------------------------------------------------------
+void LightClusterer::FillRowAVX2(const float* minXs, const float* maxXs, const LightBounds& l,
+	float dyzSquared, unsigned int light, std::vector<unsigned int>* row)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 centerX = _mm256_set1_ps(l.Center.x);
+	const __m256 radiusSquared = _mm256_set1_ps(l.RadiusSquared);
+	const __m256 rowDistance = _mm256_set1_ps(dyzSquared);
+
+	for (unsigned int x = l.TileX0 & ~7u; x <= l.TileX1; x += 8)
+	{
+		__m256 dx = _mm256_max_ps(
+			_mm256_sub_ps(_mm256_loadu_ps(minXs + x), centerX),
+			_mm256_sub_ps(centerX, _mm256_loadu_ps(maxXs + x)));
+		dx = _mm256_max_ps(dx, zero);
+		__m256 distance = _mm256_add_ps(_mm256_mul_ps(dx, dx), rowDistance);
+		unsigned int mask = (unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(distance, radiusSquared, _CMP_LE_OQ));
+		if (mask == 0)
+			continue;
+
+		for (unsigned int lane = 0; lane < 8; lane++)
+		{
+			unsigned int column = x + lane;
+			if ((mask & (1u << lane)) && column >= l.TileX0 && column <= l.TileX1)
+				row[column].push_back(light);
+		}
+	}
+}
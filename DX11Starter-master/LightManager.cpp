@@ -0,0 +1,322 @@
+#include "LightManager.h"
+
+// The shader reads Lights as a structured buffer, which is
+// packed tightly, so the C++ struct has to have no gaps
+static_assert(sizeof(Light) == 64, "Light must match the shader's structured buffer stride");
+
+LightManager::LightManager()
+{
+	Clear();
+}
+
+LightManager::~LightManager()
+{
+}
+
+// --------------------------------------------------------
+// Appends the light, reusing a free handle slot if there is
+// one. Generations go odd on add and even on remove, so a
+// handle only matches while its light is alive.
+// --------------------------------------------------------
+LightHandle LightManager::Add(const Light& light)
+{
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slot = (unsigned int)slotIndices.size();
+		slotIndices.push_back(0);
+		slotGenerations.push_back(0);
+	}
+	slotGenerations[slot]++;
+
+	unsigned int index = (unsigned int)types.size();
+	types.push_back(0);
+	directions.push_back(DirectX::XMFLOAT3());
+	positions.push_back(DirectX::XMFLOAT3());
+	colors.push_back(DirectX::XMFLOAT3());
+	intensities.push_back(0.0f);
+	ranges.push_back(0.0f);
+	spotFalloffs.push_back(0.0f);
+	shadowTiles.push_back(-1);
+	indexSlots.push_back(slot);
+	packed.push_back(Light());
+	slotIndices[slot] = index;
+
+	typeCounts[0]++; //Counted as the placeholder type until Store()
+	Store(index, light);
+
+	LightHandle handle;
+	handle.Slot = slot;
+	handle.Generation = slotGenerations[slot];
+	return handle;
+}
+
+// --------------------------------------------------------
+// Fills the hole with the last light, so only that one index
+// needs uploading again. Anything past the new count is left
+// in the GPU copy, the shader never reads that far.
+// --------------------------------------------------------
+void LightManager::Remove(LightHandle handle)
+{
+	if (!IsValid(handle))
+		return;
+
+	unsigned int index = slotIndices[handle.Slot];
+	unsigned int last = (unsigned int)types.size() - 1;
+	typeCounts[types[index]]--;
+	if (index != last)
+		MoveIndex(last, index);
+
+	types.pop_back();
+	directions.pop_back();
+	positions.pop_back();
+	colors.pop_back();
+	intensities.pop_back();
+	ranges.pop_back();
+	spotFalloffs.pop_back();
+	shadowTiles.pop_back();
+	indexSlots.pop_back();
+	packed.pop_back();
+
+	slotGenerations[handle.Slot]++;
+	freeSlots.push_back(handle.Slot);
+}
+
+void LightManager::Clear()
+{
+	types.clear();
+	directions.clear();
+	positions.clear();
+	colors.clear();
+	intensities.clear();
+	ranges.clear();
+	spotFalloffs.clear();
+	shadowTiles.clear();
+	indexSlots.clear();
+	packed.clear();
+
+	//Generations carry on, so old handles stay invalid
+	freeSlots.clear();
+	for (unsigned int slot = 0; slot < slotGenerations.size(); slot++)
+	{
+		if (slotGenerations[slot] & 1)
+			slotGenerations[slot]++;
+		freeSlots.push_back(slot);
+	}
+
+	typeCounts[0] = typeCounts[1] = typeCounts[2] = 0;
+	changedFirst = 0;
+	changedEnd = 0;
+}
+
+bool LightManager::IsValid(LightHandle handle)
+{
+	return handle.Slot < slotGenerations.size() && slotGenerations[handle.Slot] == handle.Generation;
+}
+
+void LightManager::Set(LightHandle handle, const Light& light)
+{
+	Store(slotIndices[handle.Slot], light);
+}
+
+void LightManager::SetDirection(LightHandle handle, DirectX::XMFLOAT3 direction)
+{
+	unsigned int index = slotIndices[handle.Slot];
+	directions[index] = direction;
+	MarkChanged(index);
+}
+
+void LightManager::SetPosition(LightHandle handle, DirectX::XMFLOAT3 position)
+{
+	unsigned int index = slotIndices[handle.Slot];
+	positions[index] = position;
+	MarkChanged(index);
+}
+
+void LightManager::SetColor(LightHandle handle, DirectX::XMFLOAT3 color)
+{
+	unsigned int index = slotIndices[handle.Slot];
+	colors[index] = color;
+	MarkChanged(index);
+}
+
+void LightManager::SetIntensity(LightHandle handle, float intensity)
+{
+	unsigned int index = slotIndices[handle.Slot];
+	intensities[index] = intensity;
+	MarkChanged(index);
+}
+
+void LightManager::SetRange(LightHandle handle, float range)
+{
+	unsigned int index = slotIndices[handle.Slot];
+	ranges[index] = range;
+	MarkChanged(index);
+}
+
+void LightManager::SetShadowTile(LightHandle handle, int shadowTile)
+{
+	unsigned int index = slotIndices[handle.Slot];
+	shadowTiles[index] = shadowTile;
+	MarkChanged(index);
+}
+
+Light LightManager::Get(LightHandle handle)
+{
+	unsigned int index = slotIndices[handle.Slot];
+	Light light = {};
+	light.Type = types[index];
+	light.Direction = directions[index];
+	light.Range = ranges[index];
+	light.Position = positions[index];
+	light.Intensity = intensities[index];
+	light.Color = colors[index];
+	light.SpotFalloff = spotFalloffs[index];
+	light.ShadowTile = shadowTiles[index];
+	return light;
+}
+
+unsigned int LightManager::GetIndex(LightHandle handle)
+{
+	return slotIndices[handle.Slot];
+}
+
+LightHandle LightManager::GetHandle(unsigned int index)
+{
+	LightHandle handle;
+	handle.Slot = indexSlots[index];
+	handle.Generation = slotGenerations[handle.Slot];
+	return handle;
+}
+
+unsigned int LightManager::GetCount()
+{
+	return (unsigned int)types.size();
+}
+
+unsigned int LightManager::GetCount(int type)
+{
+	return type >= 0 && type < 3 ? typeCounts[type] : 0;
+}
+
+const int* LightManager::GetTypes()
+{
+	return types.data();
+}
+
+const DirectX::XMFLOAT3* LightManager::GetDirections()
+{
+	return directions.data();
+}
+
+const DirectX::XMFLOAT3* LightManager::GetPositions()
+{
+	return positions.data();
+}
+
+const DirectX::XMFLOAT3* LightManager::GetColors()
+{
+	return colors.data();
+}
+
+const float* LightManager::GetIntensities()
+{
+	return intensities.data();
+}
+
+const float* LightManager::GetRanges()
+{
+	return ranges.data();
+}
+
+const float* LightManager::GetSpotFalloffs()
+{
+	return spotFalloffs.data();
+}
+
+const int* LightManager::GetShadowTiles()
+{
+	return shadowTiles.data();
+}
+
+// --------------------------------------------------------
+// Only the changed range is rebuilt, so a frame where one
+// light moved costs one Light however many there are
+// --------------------------------------------------------
+bool LightManager::PackChanges(unsigned int& first, unsigned int& count)
+{
+	unsigned int end = changedEnd < GetCount() ? changedEnd : GetCount();
+	first = changedFirst;
+	count = end > first ? end - first : 0;
+	changedFirst = 0;
+	changedEnd = 0;
+
+	for (unsigned int i = first; i < end; i++)
+	{
+		Light& light = packed[i];
+		light.Type = types[i];
+		light.Direction = directions[i];
+		light.Range = ranges[i];
+		light.Position = positions[i];
+		light.Intensity = intensities[i];
+		light.Color = colors[i];
+		light.SpotFalloff = spotFalloffs[i];
+		light.ShadowTile = shadowTiles[i];
+	}
+	return count > 0;
+}
+
+const Light* LightManager::GetPackedLights()
+{
+	return packed.data();
+}
+
+void LightManager::MarkChanged(unsigned int index)
+{
+	if (changedFirst == changedEnd)
+	{
+		changedFirst = index;
+		changedEnd = index + 1;
+		return;
+	}
+
+	if (index < changedFirst) changedFirst = index;
+	if (index + 1 > changedEnd) changedEnd = index + 1;
+}
+
+void LightManager::Store(unsigned int index, const Light& light)
+{
+	int type = light.Type >= 0 && light.Type < 3 ? light.Type : LIGHT_TYPE_DIRECTIONAL;
+	typeCounts[types[index]]--;
+	typeCounts[type]++;
+
+	types[index] = type;
+	directions[index] = light.Direction;
+	positions[index] = light.Position;
+	colors[index] = light.Color;
+	intensities[index] = light.Intensity;
+	ranges[index] = light.Range;
+	spotFalloffs[index] = light.SpotFalloff;
+	shadowTiles[index] = light.ShadowTile;
+	MarkChanged(index);
+}
+
+void LightManager::MoveIndex(unsigned int from, unsigned int to)
+{
+	types[to] = types[from];
+	directions[to] = directions[from];
+	positions[to] = positions[from];
+	colors[to] = colors[from];
+	intensities[to] = intensities[from];
+	ranges[to] = ranges[from];
+	spotFalloffs[to] = spotFalloffs[from];
+	shadowTiles[to] = shadowTiles[from];
+	indexSlots[to] = indexSlots[from];
+	slotIndices[indexSlots[to]] = to;
+	MarkChanged(to);
+}
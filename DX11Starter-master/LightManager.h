@@ -0,0 +1,105 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Lights.h"
+
+// Names one light for as long as it lives. Slots are reused
+// after Remove(), the generation tells an old handle apart
+// from whatever light has the slot now.
+struct LightHandle
+{
+	unsigned int Slot = 0xFFFFFFFF;
+	unsigned int Generation = 0;
+};
+
+// --------------------------------------------------------
+// Every light in the scene, any number of them
+//
+// - Stored as one array per field (structure of arrays), so
+//   code that only looks at positions and ranges (culling,
+//   shadow selection) reads nothing else
+// - Lights are kept packed: index 0 to GetCount() - 1, which
+//   is also their index in the shader's light list. Removing
+//   moves the last light into the hole, so a light's index
+//   can change; its handle never does.
+// - Add, Remove and every setter are O(1) and mark only the
+//   touched index as changed. PackChanges() turns the changed
+//   range into the shader's Light layout for one upload.
+//
+// Knows nothing about Direct3D
+// --------------------------------------------------------
+class LightManager
+{
+public:
+	LightManager();
+	~LightManager();
+
+	LightHandle Add(const Light& light);
+	void Remove(LightHandle handle);
+	void Clear();
+	bool IsValid(LightHandle handle);
+
+	//Setters (handle must be valid)
+	void Set(LightHandle handle, const Light& light);
+	void SetDirection(LightHandle handle, DirectX::XMFLOAT3 direction);
+	void SetPosition(LightHandle handle, DirectX::XMFLOAT3 position);
+	void SetColor(LightHandle handle, DirectX::XMFLOAT3 color);
+	void SetIntensity(LightHandle handle, float intensity);
+	void SetRange(LightHandle handle, float range);
+	void SetShadowTile(LightHandle handle, int shadowTile);
+
+	//Getters (handle must be valid)
+	Light Get(LightHandle handle);
+	unsigned int GetIndex(LightHandle handle); // Index in the shader's light list
+	LightHandle GetHandle(unsigned int index);
+	unsigned int GetCount();
+	unsigned int GetCount(int type); // How many of one LIGHT_TYPE_
+
+	//Packed arrays, GetCount() long
+	const int* GetTypes();
+	const DirectX::XMFLOAT3* GetDirections();
+	const DirectX::XMFLOAT3* GetPositions();
+	const DirectX::XMFLOAT3* GetColors();
+	const float* GetIntensities();
+	const float* GetRanges();
+	const float* GetSpotFalloffs();
+	const int* GetShadowTiles();
+
+	// Writes every light changed since the last call into
+	// GetPackedLights(), in the shader's layout
+	// first, count - The range that needs copying to the GPU
+	// Returns false when nothing changed
+	bool PackChanges(unsigned int& first, unsigned int& count);
+
+	// Every light in the shader's layout, current as of the last PackChanges()
+	const Light* GetPackedLights();
+
+private:
+	//Per light, by index
+	std::vector<int> types;
+	std::vector<DirectX::XMFLOAT3> directions;
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT3> colors;
+	std::vector<float> intensities;
+	std::vector<float> ranges;
+	std::vector<float> spotFalloffs;
+	std::vector<int> shadowTiles;
+	std::vector<unsigned int> indexSlots; // Index -> handle slot
+
+	//Per handle slot
+	std::vector<unsigned int> slotIndices; // Slot -> index
+	std::vector<unsigned int> slotGenerations; // Odd while the slot is in use
+	std::vector<unsigned int> freeSlots;
+
+	unsigned int typeCounts[3];
+
+	//Shader copy and the index range that's out of date in it
+	std::vector<Light> packed;
+	unsigned int changedFirst;
+	unsigned int changedEnd;
+
+	void MarkChanged(unsigned int index);
+	void Store(unsigned int index, const Light& light);
+	void MoveIndex(unsigned int from, unsigned int to);
+};
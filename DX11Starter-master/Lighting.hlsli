@@ -0,0 +1,160 @@
+#ifndef __LIGHTING_INCLUDES__
+#define __LIGHTING_INCLUDES__
+
+#include "ShaderHelper.hlsli"
+
+// --------------------------------------------------------
+// Clustered lighting shared by the forward pixel shader and
+// the deferred lighting pass, so both light a surface the
+// same way. Only the surface inputs differ: interpolated in
+// one, read back from the G-buffer in the other.
+// --------------------------------------------------------
+
+#ifndef USE_SHADOWS
+#define USE_SHADOWS 1
+#endif
+
+// Split by how often it changes. The C++ structs are generated
+// into ShaderConstants.h from these declarations.
+cbuffer PerFrame : register(b0) // C++: PixelFrameConstants
+{
+    float3 cameraPos;
+    int cascadeLight; //Index into Lights of the light the cascades are for, -1 = none
+    float3 ambient;
+    uint clusterSlices;
+    float2 clusterTileScale; //Pixels to cluster tiles
+    float clusterSliceScale; //Slice = log(view depth) * scale + bias
+    float clusterSliceBias;
+    uint2 clusterTiles; //Across, down
+    matrix inverseViewProjection; //Deferred only: depth back to world space
+    matrix shadowCascades[SHADOW_CASCADE_COUNT];
+    matrix atlasMatrices[MAX_ATLAS_TILES];
+    float4 atlasRects[MAX_ATLAS_TILES]; //xy = offset, zw = scale (atlas UVs)
+}
+
+SamplerComparisonState ShadowSampler : register(s1);
+
+Texture2DArray ShadowMap : register(t4);
+Texture2D ShadowAtlas : register(t5);
+
+//Every light in the scene, uploaded once a frame (see LightManager.h)
+StructuredBuffer<Light> Lights : register(t6);
+
+//Which lights reach each cluster (see LightClusterer.h):
+//offset and count into ClusterLightIndices
+StructuredBuffer<uint2> ClusterRanges : register(t7);
+StructuredBuffer<uint> ClusterLightIndices : register(t8);
+
+// --------------------------------------------------------
+// Samples the finest cascade that covers this position
+// - Cascades are ordered near to far, so the first one whose
+//   map contains the position has the most texels to offer
+// - Anything outside every cascade is treated as lit
+// --------------------------------------------------------
+float SampleShadow(float3 worldPosition)
+{
+    [unroll]
+    for (int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+    {
+        float4 shadowPos = mul(shadowCascades[i], float4(worldPosition, 1.0f));
+        float2 shadowUV = shadowPos.xy * 0.5f + 0.5f;
+        shadowUV.y = 1 - shadowUV.y;
+
+        if (all(shadowUV > 0.0f) && all(shadowUV < 1.0f) && shadowPos.z < 1.0f)
+            return ShadowMap.SampleCmpLevelZero(ShadowSampler, float3(shadowUV, i), shadowPos.z).r;
+    }
+    return 1.0f;
+}
+
+// --------------------------------------------------------
+// Samples one tile of the shadow atlas
+// - UVs are clamped half a texel inside the tile so filtering
+//   never reads a neighbouring tile
+// --------------------------------------------------------
+float SampleAtlasTile(int tile, float3 worldPosition)
+{
+    float4 shadowPos = mul(atlasMatrices[tile], float4(worldPosition, 1.0f));
+    shadowPos.xyz /= shadowPos.w;
+
+    float2 shadowUV = shadowPos.xy * 0.5f + 0.5f;
+    shadowUV.y = 1 - shadowUV.y;
+
+    float width, height;
+    ShadowAtlas.GetDimensions(width, height);
+    float2 halfTexel = 0.5f / float2(width, height);
+
+    float4 rect = atlasRects[tile];
+    shadowUV = clamp(rect.xy + shadowUV * rect.zw, rect.xy + halfTexel, rect.xy + rect.zw - halfTexel);
+    return ShadowAtlas.SampleCmpLevelZero(ShadowSampler, shadowUV, shadowPos.z).r;
+}
+
+// --------------------------------------------------------
+// Point light shadow from 6 atlas tiles
+// - Faces are +X, -X, +Y, -Y, +Z, -Z (same order as Game.cpp)
+// --------------------------------------------------------
+float SamplePointShadow(int firstTile, float3 lightPosition, float3 worldPosition)
+{
+    if (firstTile < 0)
+        return 1.0f;
+
+    float3 toPixel = worldPosition - lightPosition;
+    float3 absToPixel = abs(toPixel);
+    int face;
+    if (absToPixel.x >= absToPixel.y && absToPixel.x >= absToPixel.z)
+        face = toPixel.x > 0 ? 0 : 1;
+    else if (absToPixel.y >= absToPixel.z)
+        face = toPixel.y > 0 ? 2 : 3;
+    else
+        face = toPixel.z > 0 ? 4 : 5;
+
+    return SampleAtlasTile(firstTile + face, worldPosition);
+}
+
+// --------------------------------------------------------
+// Adds up the lights that reach this pixel's cluster
+// - pixel is SV_Position.xy, viewDepth is the distance along
+//   the view direction (SV_Position.w when rasterizing)
+// - albedo is linear, the result still needs multiplying by it
+// --------------------------------------------------------
+float3 ShadeClusteredLights(float2 pixel, float viewDepth, float3 worldPosition, float3 normal,
+                            float3 albedo, float roughness, float metalness)
+{
+    float3 specularColor = lerp(F0_NON_METAL, albedo.rgb, metalness);
+    float3 toCamera = normalize(cameraPos - worldPosition);
+    float3 light = float3(0, 0, 0);
+
+    uint2 tile = min((uint2)(pixel * clusterTileScale), clusterTiles - 1);
+    uint slice = (uint)clamp(log(viewDepth) * clusterSliceScale + clusterSliceBias, 0.0f, clusterSlices - 1.0f);
+    uint2 cluster = ClusterRanges[(slice * clusterTiles.y + tile.y) * clusterTiles.x + tile.x];
+
+    for (uint c = 0; c < cluster.y; c++)
+    {
+        uint i = ClusterLightIndices[cluster.x + c];
+        Light current = Lights[i];
+        if (current.type == LIGHT_TYPE_DIRECTIONAL)
+        {
+            float3 directional = DiffuseSpecCalc(current, normal, current.direction, toCamera,
+                                     albedo, roughness, metalness, specularColor);
+#if USE_SHADOWS
+            if ((int)i == cascadeLight)
+                directional *= SampleShadow(worldPosition);
+#endif
+            light += directional;
+        }
+        else
+        {
+            float3 direction = normalize(worldPosition - current.position);
+            light += DiffuseSpecCalc(current, normal, direction, toCamera,
+                     albedo, roughness, metalness, specularColor)
+                     * Attenuate(current, worldPosition)
+#if USE_SHADOWS
+                     * SamplePointShadow(current.shadowTile, current.position, worldPosition)
+#endif
+                     ;
+        }
+    }
+
+    return light;
+}
+
+#endif
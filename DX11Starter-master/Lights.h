@@ -5,14 +5,5 @@
 
 #include <DirectXMath.h>
 
-struct Light
-{
-	int Type;
-	DirectX::XMFLOAT3 Direction;
-	float Range;
-	DirectX::XMFLOAT3 Position;
-	float Intensity;
-	DirectX::XMFLOAT3 Color;
-	float SpotFalloff;
-	DirectX::XMFLOAT3 Padding;
-};
\ No newline at end of file
+//Light itself is generated from ShaderHelper.hlsli
+#include "ShaderConstants.h"
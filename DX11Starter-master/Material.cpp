@@ -1,4 +1,5 @@
 #include "Material.h"
+#include <climits>
 
 Material::Material(DirectX::XMFLOAT4 colorTint, float roughness, DirectX::XMFLOAT2 scale, DirectX::XMFLOAT2 offset, std::shared_ptr<SimplePixelShader> pixelShader, std::shared_ptr<SimpleVertexShader> vertexShader)
 {
@@ -6,8 +7,17 @@ Material::Material(DirectX::XMFLOAT4 colorTint, float roughness, DirectX::XMFLOA
 	this->roughness = roughness;
 	this->scale = scale;
 	this->offset = offset;
+	this->isTransparent = false;
+	this->isAlphaTested = false;
+	this->receivesShadows = true;
 	this->pixelShader = pixelShader;
 	this->vertexShader = vertexShader;
+	this->srvTableStart = 0;
+	this->samplerTableStart = 0;
+	this->pipeline = 0;
+	this->depthEqualPipeline = 0;
+	this->gBufferPipeline = 0;
+	BuildBindingTables();
 }
 
 Material::~Material()
@@ -34,24 +44,57 @@ void Material::SetOffset(DirectX::XMFLOAT2 offset)
 	this->offset = offset;
 }
 
+void Material::SetIsTransparent(bool isTransparent)
+{
+	this->isTransparent = isTransparent;
+}
+
+void Material::SetIsAlphaTested(bool isAlphaTested)
+{
+	this->isAlphaTested = isAlphaTested;
+}
+
+void Material::SetReceivesShadows(bool receivesShadows)
+{
+	this->receivesShadows = receivesShadows;
+}
+
 void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> pixelShader)
 {
 	this->pixelShader = pixelShader;
+	pipeline = 0;
+	depthEqualPipeline = 0;
+	BuildBindingTables();
 }
 
 void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> vertexShader)
 {
 	this->vertexShader = vertexShader;
+	pipeline = 0;
+	depthEqualPipeline = 0;
+	gBufferPipeline = 0;
+}
+
+void Material::SetShaderVariants(std::shared_ptr<PixelShaderVariants> shaderVariants)
+{
+	this->shaderVariants = shaderVariants;
+}
+
+void Material::SetGBufferVariants(std::shared_ptr<PixelShaderVariants> gBufferVariants)
+{
+	this->gBufferVariants = gBufferVariants;
 }
 
 void Material::AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureSRV)
 {
 	textureSRVs.insert({ name, textureSRV });
+	BuildBindingTables();
 }
 
 void Material::AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
 {
 	samplers.insert({ name, sampler });
+	BuildBindingTables();
 }
 
 DirectX::XMFLOAT4 Material::GetColorTint()
@@ -74,6 +117,39 @@ DirectX::XMFLOAT2 Material::GetOffset()
 	return offset;
 }
 
+bool Material::GetIsTransparent()
+{
+	return isTransparent;
+}
+
+bool Material::GetIsAlphaTested()
+{
+	return isAlphaTested;
+}
+
+bool Material::GetReceivesShadows()
+{
+	return receivesShadows;
+}
+
+// --------------------------------------------------------
+// Transparent surfaces need what's behind them, and the
+// lighting pass shadows everything, so both stay forward
+// --------------------------------------------------------
+bool Material::GetIsDeferrable()
+{
+	return gBufferPipeline && !isTransparent && receivesShadows;
+}
+
+unsigned int Material::GetShaderFeatures()
+{
+	unsigned int features = 0;
+	if (receivesShadows) features |= SHADER_FEATURE_SHADOWS;
+	if (textureSRVs.find("NormalMap") != textureSRVs.end()) features |= SHADER_FEATURE_NORMAL_MAP;
+	if (isAlphaTested) features |= SHADER_FEATURE_ALPHA_TEST;
+	return features;
+}
+
 std::shared_ptr<SimplePixelShader> Material::GetPixelShader()
 {
 	return pixelShader;
@@ -84,8 +160,203 @@ std::shared_ptr<SimpleVertexShader> Material::GetVertexShader()
 	return vertexShader;
 }
 
-void Material::PrepareMaterial()
+const PipelineState* Material::GetPipeline()
 {
-	for (auto& t : textureSRVs) { pixelShader->SetShaderResourceView(t.first.c_str(), t.second); }
-	for (auto& t : samplers) { pixelShader->SetSamplerState(t.first.c_str(), t.second); }
+	return pipeline;
+}
+
+const PipelineState* Material::GetDepthEqualPipeline()
+{
+	return depthEqualPipeline;
+}
+
+std::shared_ptr<SimplePixelShader> Material::GetGBufferShader()
+{
+	return gBufferShader;
+}
+
+const PipelineState* Material::GetGBufferPipeline()
+{
+	return gBufferPipeline;
+}
+
+// --------------------------------------------------------
+// Binds the material's textures and samplers, one call each
+// --------------------------------------------------------
+void Material::PrepareMaterial(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	if (!srvTable.empty()) context->PSSetShaderResources(srvTableStart, (UINT)srvTable.size(), srvTable.data());
+	if (!samplerTable.empty()) context->PSSetSamplers(samplerTableStart, (UINT)samplerTable.size(), samplerTable.data());
+}
+
+void Material::RecordMaterial(CommandBuffer& commands)
+{
+	if (!srvTable.empty())
+		commands.SetShaderResources(ShaderStage::Pixel, srvTableStart, (unsigned int)srvTable.size(), (const void* const*)srvTable.data());
+	if (!samplerTable.empty())
+		commands.SetSamplers(ShaderStage::Pixel, samplerTableStart, (unsigned int)samplerTable.size(), (const void* const*)samplerTable.data());
+}
+
+// --------------------------------------------------------
+// Records the material's constants straight into the
+// PerMaterial slot. The shader's own buffer isn't touched,
+// so this is safe from any thread, and a material change
+// costs 48 bytes however big the shader's per frame data is.
+// --------------------------------------------------------
+void Material::RecordParameters(CommandBuffer& commands)
+{
+	if (constantsHandle.Size == 0)
+		return;
+
+	MaterialConstants constants = {};
+	constants.ColorTint = colorTint;
+	constants.Scale = scale;
+	constants.Offset = offset;
+	constants.Roughness = roughness;
+	commands.SetConstants(ShaderStage::Pixel, constantsSlot, &constants, sizeof(MaterialConstants));
+}
+
+// --------------------------------------------------------
+// Swaps in the variants for this material's features.
+// Binding tables are only rebuilt if that's actually a
+// different shader.
+// - The G-buffer shader doesn't shadow anything, so its key
+//   leaves that bit out rather than build the same variant
+//   twice
+// --------------------------------------------------------
+void Material::SelectShaderVariant()
+{
+	if (shaderVariants)
+	{
+		ShaderVariantKey key = MakeShaderVariantKey(GetShaderFeatures());
+		std::shared_ptr<SimplePixelShader> variant = shaderVariants->GetVariant(key);
+		if (variant != pixelShader)
+			SetPixelShader(variant);
+	}
+
+	if (gBufferVariants)
+	{
+		ShaderVariantKey key = MakeShaderVariantKey(GetShaderFeatures() & ~SHADER_FEATURE_SHADOWS);
+		std::shared_ptr<SimplePixelShader> variant = gBufferVariants->GetVariant(key);
+		if (variant != gBufferShader)
+		{
+			gBufferShader = variant;
+			gBufferPipeline = 0;
+
+			//Filled by RecordParameters(), same as the forward shader's
+			SimpleShaderHandle constants = gBufferShader->GetBufferHandle("PerMaterial");
+			if (constants.Size == sizeof(MaterialConstants))
+				gBufferShader->SetBufferStreamed(constants.ConstantBufferIndex, true);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Looks up the pipeline for the material's shaders, if it
+// doesn't have one yet. Materials that share shaders share
+// the pipeline, so switching between them binds nothing.
+// - The depth equal version is for after a depth pre-pass:
+//   only the nearest surface passes, and depth is already
+//   written, so it isn't written again
+// --------------------------------------------------------
+void Material::ResolvePipeline(PipelineCache& pipelines)
+{
+	if (!vertexShader)
+		return;
+
+	PipelineDesc desc;
+	desc.VertexShader = vertexShader->GetDirectXShader().Get();
+	desc.InputLayout = vertexShader->GetInputLayout().Get();
+
+	if (!pipeline && pixelShader)
+	{
+		desc.PixelShader = pixelShader->GetDirectXShader().Get();
+		pipeline = pipelines.GetPipeline(desc);
+	}
+
+	if (!depthEqualPipeline && pixelShader)
+	{
+		PipelineDesc equalDesc = desc;
+		equalDesc.PixelShader = pixelShader->GetDirectXShader().Get();
+		equalDesc.DepthStencil.DepthFunc = 3; // D3D11_COMPARISON_EQUAL
+		equalDesc.DepthStencil.DepthWriteMask = 0; // D3D11_DEPTH_WRITE_MASK_ZERO
+		depthEqualPipeline = pipelines.GetPipeline(equalDesc);
+	}
+
+	if (!gBufferPipeline && gBufferShader)
+	{
+		desc.PixelShader = gBufferShader->GetDirectXShader().Get();
+		gBufferPipeline = pipelines.GetPipeline(desc);
+	}
+}
+
+// --------------------------------------------------------
+// Resolves everything the material sets by name against the
+// pixel shader, once:
+// - Textures and samplers become register tables. Slots
+//   between used ones are left null, names the shader
+//   doesn't have are dropped.
+// - Material variables become one handle to their buffer,
+//   which is marked streamed on the shader
+// --------------------------------------------------------
+void Material::BuildBindingTables()
+{
+	srvTable.clear();
+	samplerTable.clear();
+	srvTableStart = 0;
+	samplerTableStart = 0;
+	constantsHandle = SimpleShaderHandle();
+	constantsSlot = 0;
+	if (!pixelShader)
+		return;
+
+	//Only trusted if the sizes agree, otherwise it's left unset.
+	//Recording then leaves the buffer to RecordParameters().
+	constantsHandle = pixelShader->GetBufferHandle("PerMaterial");
+	if (constantsHandle.Size != sizeof(MaterialConstants))
+		constantsHandle = SimpleShaderHandle();
+	else
+	{
+		constantsSlot = pixelShader->GetBufferInfo(constantsHandle.ConstantBufferIndex)->BindIndex;
+		pixelShader->SetBufferStreamed(constantsHandle.ConstantBufferIndex, true);
+	}
+
+	//Find the register range first, then fill it in
+	unsigned int first = UINT_MAX, last = 0;
+	for (auto& t : textureSRVs)
+	{
+		const SimpleSRV* info = pixelShader->GetShaderResourceViewInfo(t.first);
+		if (!info) continue;
+		first = info->BindIndex < first ? info->BindIndex : first;
+		last = info->BindIndex > last ? info->BindIndex : last;
+	}
+	if (first != UINT_MAX)
+	{
+		srvTableStart = first;
+		srvTable.assign(last - first + 1, 0);
+		for (auto& t : textureSRVs)
+		{
+			const SimpleSRV* info = pixelShader->GetShaderResourceViewInfo(t.first);
+			if (info) srvTable[info->BindIndex - first] = t.second.Get();
+		}
+	}
+
+	first = UINT_MAX, last = 0;
+	for (auto& t : samplers)
+	{
+		const SimpleSampler* info = pixelShader->GetSamplerInfo(t.first);
+		if (!info) continue;
+		first = info->BindIndex < first ? info->BindIndex : first;
+		last = info->BindIndex > last ? info->BindIndex : last;
+	}
+	if (first != UINT_MAX)
+	{
+		samplerTableStart = first;
+		samplerTable.assign(last - first + 1, 0);
+		for (auto& t : samplers)
+		{
+			const SimpleSampler* info = pixelShader->GetSamplerInfo(t.first);
+			if (info) samplerTable[info->BindIndex - first] = t.second.Get();
+		}
+	}
 }
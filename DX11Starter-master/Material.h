@@ -3,6 +3,9 @@
 #include "DXCore.h"
 #include <DirectXMath.h>
 #include "SimpleShader.h"
+#include "BufferStructs.h"
+#include "PixelShaderVariants.h"
+#include "PipelineState.h"
 #include <memory>
 
 class Material
@@ -17,8 +20,13 @@ public:
 	void SetRoughness(float roughness);
 	void SetScale(DirectX::XMFLOAT2 scale);
 	void SetOffset(DirectX::XMFLOAT2 offset);
+	void SetIsTransparent(bool isTransparent);
+	void SetIsAlphaTested(bool isAlphaTested);
+	void SetReceivesShadows(bool receivesShadows);
 	void SetPixelShader(std::shared_ptr<SimplePixelShader> pixelShader);
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader> vertexShader);
+	void SetShaderVariants(std::shared_ptr<PixelShaderVariants> shaderVariants);
+	void SetGBufferVariants(std::shared_ptr<PixelShaderVariants> gBufferVariants);
 	void AddTextureSRV(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureSRV);
 	void AddSampler(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
 
@@ -27,11 +35,24 @@ public:
 	float GetRoughness();
 	DirectX::XMFLOAT2 GetScale();
 	DirectX::XMFLOAT2 GetOffset();
+	bool GetIsTransparent();
+	bool GetIsAlphaTested();
+	bool GetReceivesShadows();
+	bool GetIsDeferrable(); // Can go through the G-buffer: opaque, shadowed and has a G-buffer pipeline
+	unsigned int GetShaderFeatures(); // SHADER_FEATURE_ bits this material needs
 	std::shared_ptr<SimplePixelShader> GetPixelShader();
 	std::shared_ptr<SimpleVertexShader> GetVertexShader();
+	const PipelineState* GetPipeline(); // Null until ResolvePipeline()
+	const PipelineState* GetDepthEqualPipeline(); // GetPipeline() after a depth pre-pass: equal test, no depth writes
+	std::shared_ptr<SimplePixelShader> GetGBufferShader();
+	const PipelineState* GetGBufferPipeline(); // Null without G-buffer variants
 
 	//Helpers
-	void PrepareMaterial();
+	void PrepareMaterial(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void RecordMaterial(CommandBuffer& commands);
+	void RecordParameters(CommandBuffer& commands); // Binds MaterialConstants to the PerMaterial slot
+	void SelectShaderVariant(); // Only with shader or G-buffer variants set
+	void ResolvePipeline(PipelineCache& pipelines); // Main thread only, after any shader change
 
 private:
 	DirectX::XMFLOAT4 colorTint;
@@ -40,8 +61,41 @@ private:
 	float roughness;
 	DirectX::XMFLOAT2 scale;
 	DirectX::XMFLOAT2 offset;
+	bool isTransparent; //Drawn after opaques, back to front
+	bool isAlphaTested; //Albedo alpha below the threshold is cut out
+	bool receivesShadows;
+
+	//If set, the pixel shader is whichever variant has just the
+	//features this material uses (see SelectShaderVariant())
+	std::shared_ptr<PixelShaderVariants> shaderVariants;
+
+	//Both shaders plus default state, cleared whenever a shader changes
+	const PipelineState* pipeline;
+	const PipelineState* depthEqualPipeline;
+
+	//Deferred path: the G-buffer variant for the same features.
+	//Uses the same registers as the forward shader, so the binding
+	//tables below serve both.
+	std::shared_ptr<PixelShaderVariants> gBufferVariants;
+	std::shared_ptr<SimplePixelShader> gBufferShader;
+	const PipelineState* gBufferPipeline;
 
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
+
+	//Binding tables: the resources above laid out by pixel shader
+	//register, so binding is one contiguous call per kind.
+	//Rebuilt whenever the pixel shader or a resource changes.
+	std::vector<ID3D11ShaderResourceView*> srvTable;
+	unsigned int srvTableStart;
+	std::vector<ID3D11SamplerState*> samplerTable;
+	unsigned int samplerTableStart;
+
+	//The pixel shader's PerMaterial buffer, filled from MaterialConstants
+	//(Size 0 if the shader doesn't have a matching one)
+	SimpleShaderHandle constantsHandle;
+	unsigned int constantsSlot;
+
+	void BuildBindingTables();
 };
 
@@ -0,0 +1,20 @@
+#include "MatrixBatch.h"
+
+using namespace DirectX;
+
+void MultiplyMatrixBatch(
+	const void* matrices, size_t matrixStride,
+	const XMFLOAT4X4& right,
+	void* results, size_t resultStride,
+	unsigned int count)
+{
+	XMMATRIX r = XMLoadFloat4x4(&right);
+	const unsigned char* source = (const unsigned char*)matrices;
+	unsigned char* destination = (unsigned char*)results;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMMATRIX m = XMLoadFloat4x4((const XMFLOAT4X4*)(source + i * matrixStride));
+		XMStoreFloat4x4((XMFLOAT4X4*)(destination + i * resultStride), XMMatrixMultiply(m, r));
+	}
+}
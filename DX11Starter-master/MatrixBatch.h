@@ -0,0 +1,22 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+
+// --------------------------------------------------------
+// Matrix math over a whole array of objects in one go, so
+// per object transforms are worked out once on the CPU
+// instead of once per vertex on the GPU
+//
+// - Strides are in bytes, so the matrices can sit inside
+//   larger structs (e.g. InstanceData)
+// - Uses DirectXMath's SIMD matrix multiply, with the shared
+//   matrix loaded only once
+// --------------------------------------------------------
+
+// results[i] = matrices[i] * right
+void MultiplyMatrixBatch(
+	const void* matrices, size_t matrixStride,
+	const DirectX::XMFLOAT4X4& right,
+	void* results, size_t resultStride,
+	unsigned int count);
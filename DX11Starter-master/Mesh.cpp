@@ -250,6 +250,21 @@ int Mesh::GetIndexCount()
 	return indexCount;
 }
 
+const std::vector<DirectX::XMFLOAT3>& Mesh::GetPositions()
+{
+	return positions;
+}
+
+const std::vector<unsigned int>& Mesh::GetIndices()
+{
+	return indices;
+}
+
+DirectX::BoundingBox Mesh::GetBounds()
+{
+	return bounds;
+}
+
 //Draws the mesh on screen
 void Mesh::Draw()
 {
@@ -280,11 +295,52 @@ void Mesh::Draw()
 	}
 }
 
+// --------------------------------------------------------
+// Draws several copies of the mesh in one call
+// - Per instance data must already be bound to input slot 1
+// --------------------------------------------------------
+void Mesh::DrawInstanced(unsigned int instanceCount, unsigned int startInstance)
+{
+	UINT stride = sizeof(Vertex);
+	UINT offset = 0;
+	deviceContext->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+	deviceContext->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+
+	deviceContext->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, startInstance);
+}
+
+// --------------------------------------------------------
+// Same as Draw and DrawInstanced, recorded into a command buffer
+// --------------------------------------------------------
+void Mesh::RecordDraw(CommandBuffer& commands)
+{
+	commands.SetVertexBuffer(0, vertexBuffer.Get(), sizeof(Vertex), 0);
+	commands.SetIndexBuffer(indexBuffer.Get());
+	commands.DrawIndexed(indexCount, 0, 0);
+}
+
+void Mesh::RecordDrawInstanced(CommandBuffer& commands, unsigned int instanceCount, unsigned int startInstance)
+{
+	commands.SetVertexBuffer(0, vertexBuffer.Get(), sizeof(Vertex), 0);
+	commands.SetIndexBuffer(indexBuffer.Get());
+	commands.DrawIndexedInstanced(indexCount, instanceCount, 0, 0, startInstance);
+}
+
 void Mesh::InitMesh(std::vector<Vertex> verts, int vertexCount, std::vector<UINT> indices, int indexCount, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext)
 {
 	this->indexCount = indexCount;
 	this->deviceContext = deviceContext;
 
+	//Keep positions and indices around for CPU culling
+	positions.clear();
+	positions.reserve(vertexCount);
+	for (int i = 0; i < vertexCount; i++)
+	{
+		positions.push_back(verts[i].Position);
+	}
+	this->indices = indices;
+	BoundingBox::CreateFromPoints(bounds, positions.size(), &positions[0], sizeof(XMFLOAT3));
+
 	// Create a VERTEX BUFFER
 	// - This holds the vertex data of triangles for a single object
 	// - This buffer is created on the GPU, which is where the data needs to
@@ -3,7 +3,9 @@
 #include "DXCore.h"
 #include "Vertex.h"
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
 #include <wrl/client.h>
+#include "CommandBuffer.h"
 #include <vector>
 
 class Mesh
@@ -17,7 +19,13 @@ public:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 	int GetIndexCount();
+	const std::vector<DirectX::XMFLOAT3>& GetPositions();
+	const std::vector<unsigned int>& GetIndices();
+	DirectX::BoundingBox GetBounds();
 	void Draw();
+	void DrawInstanced(unsigned int instanceCount, unsigned int startInstance);
+	void RecordDraw(CommandBuffer& commands);
+	void RecordDrawInstanced(CommandBuffer& commands, unsigned int instanceCount, unsigned int startInstance);
 	void InitMesh(std::vector<Vertex> verts, int vertexCount, std::vector<UINT> indices, int indexCount,
 		Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext);
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
@@ -27,5 +35,10 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
 	int indexCount;
+
+	//CPU side copy of the geometry, used for culling
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+	DirectX::BoundingBox bounds;
 };
 
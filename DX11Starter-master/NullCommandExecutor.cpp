@@ -0,0 +1,203 @@
+#include "NullCommandExecutor.h"
+#include <cstring>
+
+// Largest constant buffer Direct3D 11 allows (4096 float4s)
+#define MAX_CONSTANT_BUFFER_BYTES 65536
+
+NullCommandExecutor::NullCommandExecutor()
+{
+	memset(commandCounts, 0, sizeof(commandCounts));
+	commandCount = 0;
+	drawCount = 0;
+	instanceCount = 0;
+	indexCount = 0;
+	constantBytes = 0;
+	errorCount = 0;
+}
+
+NullCommandExecutor::~NullCommandExecutor()
+{
+}
+
+void NullCommandExecutor::Execute(const CommandBuffer& commands)
+{
+	memset(commandCounts, 0, sizeof(commandCounts));
+	drawCount = 0;
+	instanceCount = 0;
+	indexCount = 0;
+	constantBytes = 0;
+	errorCount = 0;
+	firstError.clear();
+	stateCache.Invalidate();
+	stateCache.ResetStats();
+
+	//Just enough pipeline state to tell whether a draw could work
+	bool hasInputLayout = false;
+	bool hasVertexShader = false;
+	bool hasPixelShader = false;
+	bool hasVertexBuffer = false;
+	bool hasIndexBuffer = false;
+
+	const std::vector<Command>& list = commands.GetCommands();
+	commandCount = (unsigned int)list.size();
+	for (unsigned int i = 0; i < list.size(); i++)
+	{
+		const Command& c = list[i];
+		if (c.Type >= CommandType::Count)
+		{
+			Error(i, "unknown command type");
+			continue;
+		}
+		commandCounts[(int)c.Type]++;
+		stateCache.Filter(c, commands.GetResourceLists());
+
+		switch (c.Type)
+		{
+		case CommandType::SetInputLayout:
+			hasInputLayout = c.Resource != 0;
+			break;
+
+		case CommandType::SetShader:
+			if (c.Stage == ShaderStage::Vertex) hasVertexShader = c.Resource != 0;
+			else hasPixelShader = c.Resource != 0;
+			break;
+
+		case CommandType::SetPipeline:
+		{
+			const PipelineState* pipeline = (const PipelineState*)c.Resource;
+			if (!pipeline)
+			{
+				Error(i, "null pipeline");
+				break;
+			}
+			hasVertexShader = pipeline->VertexShader != 0;
+			hasPixelShader = true; // No pixel shader means depth only, which is fine
+			hasInputLayout = pipeline->InputLayout != 0;
+			break;
+		}
+
+		case CommandType::SetVertexBuffer:
+			if (c.Slot >= MAX_VERTEX_BUFFER_SLOTS) Error(i, "vertex buffer slot out of range");
+			else if (c.Slot == 0) hasVertexBuffer = c.Resource != 0;
+			if (c.Resource && c.Args[0] == 0) Error(i, "vertex buffer with zero stride");
+			break;
+
+		case CommandType::SetIndexBuffer:
+			hasIndexBuffer = c.Resource != 0;
+			break;
+
+		case CommandType::UpdateConstants:
+			if (!c.Resource) Error(i, "constant update without a buffer");
+			if (c.Args[1] == 0 || c.Args[1] % 16 != 0 || c.Args[1] > MAX_CONSTANT_BUFFER_BYTES)
+				Error(i, "constant update size must be a non-zero multiple of 16, up to 64KB");
+			if ((unsigned long long)c.Args[0] + c.Args[1] > commands.GetConstantDataSize())
+				Error(i, "constant update reads past the recorded data");
+			constantBytes += c.Args[1];
+			break;
+
+		case CommandType::SetConstantBuffer:
+			if (c.Slot >= MAX_CONSTANT_BUFFER_SLOTS) Error(i, "constant buffer slot out of range");
+			break;
+
+		case CommandType::SetConstants:
+			if (c.Slot >= MAX_CONSTANT_BUFFER_SLOTS) Error(i, "constant buffer slot out of range");
+			if (c.Args[1] == 0 || c.Args[1] > MAX_CONSTANT_BUFFER_BYTES)
+				Error(i, "constants must be non-empty and at most 64KB");
+			if ((unsigned long long)c.Args[0] + c.Args[1] > commands.GetConstantDataSize())
+				Error(i, "constants read past the recorded data");
+			constantBytes += c.Args[1];
+			break;
+
+		case CommandType::SetShaderResource:
+			if (c.Slot >= MAX_RESOURCE_SLOTS) Error(i, "shader resource slot out of range");
+			break;
+
+		case CommandType::SetSampler:
+			if (c.Slot >= MAX_SAMPLER_SLOTS) Error(i, "sampler slot out of range");
+			break;
+
+		case CommandType::SetShaderResources:
+		case CommandType::SetSamplers:
+		{
+			unsigned int slotCount = c.Type == CommandType::SetSamplers ? MAX_SAMPLER_SLOTS : MAX_RESOURCE_SLOTS;
+			if (c.Args[0] == 0 || c.Slot + c.Args[0] > slotCount) Error(i, "resource list empty or out of range");
+			if ((unsigned long long)c.Args[1] + c.Args[0] > commands.GetResourceListSize())
+				Error(i, "resource list reads past the recorded lists");
+			break;
+		}
+
+		case CommandType::DrawIndexed:
+		case CommandType::DrawIndexedInstanced:
+		{
+			if (!hasInputLayout) Error(i, "draw without an input layout");
+			if (!hasVertexShader) Error(i, "draw without a vertex shader");
+			if (!hasPixelShader) Error(i, "draw without a pixel shader");
+			if (!hasVertexBuffer) Error(i, "draw without a vertex buffer in slot 0");
+			if (!hasIndexBuffer) Error(i, "indexed draw without an index buffer");
+
+			unsigned int instances = c.Type == CommandType::DrawIndexed ? 1 : c.Args[1];
+			if (c.Args[0] == 0 || instances == 0) Error(i, "empty draw");
+
+			drawCount++;
+			instanceCount += instances;
+			indexCount += (unsigned long long)c.Args[0] * instances;
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+}
+
+void NullCommandExecutor::Error(unsigned int commandIndex, const char* message)
+{
+	if (errorCount == 0)
+		firstError = "Command " + std::to_string(commandIndex) + ": " + message;
+	errorCount++;
+}
+
+unsigned int NullCommandExecutor::GetCommandCount()
+{
+	return commandCount;
+}
+
+unsigned int NullCommandExecutor::GetCommandCount(CommandType type)
+{
+	return type < CommandType::Count ? commandCounts[(int)type] : 0;
+}
+
+unsigned int NullCommandExecutor::GetDrawCount()
+{
+	return drawCount;
+}
+
+unsigned int NullCommandExecutor::GetInstanceCount()
+{
+	return instanceCount;
+}
+
+unsigned long long NullCommandExecutor::GetIndexCount()
+{
+	return indexCount;
+}
+
+unsigned int NullCommandExecutor::GetConstantBytes()
+{
+	return constantBytes;
+}
+
+unsigned int NullCommandExecutor::GetRedundantCount()
+{
+	return stateCache.GetElidedCount();
+}
+
+unsigned int NullCommandExecutor::GetErrorCount()
+{
+	return errorCount;
+}
+
+const std::string& NullCommandExecutor::GetFirstError()
+{
+	return firstError;
+}
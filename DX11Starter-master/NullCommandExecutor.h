@@ -0,0 +1,47 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include "StateCache.h"
+#include <string>
+
+// --------------------------------------------------------
+// Walks a command buffer without a GPU, checking it and
+// counting what it would have done
+//
+// Catches draws with missing shaders or buffers, bad slots
+// and malformed constant updates, so frame building can be
+// tested and benchmarked headless. Also counts the bindings
+// a StateCache would skip.
+// --------------------------------------------------------
+class NullCommandExecutor : public ICommandExecutor
+{
+public:
+	NullCommandExecutor();
+	~NullCommandExecutor();
+
+	void Execute(const CommandBuffer& commands) override;
+
+	//Stats, for the last Execute
+	unsigned int GetCommandCount();
+	unsigned int GetCommandCount(CommandType type);
+	unsigned int GetDrawCount();
+	unsigned int GetInstanceCount();
+	unsigned long long GetIndexCount();
+	unsigned int GetConstantBytes();
+	unsigned int GetRedundantCount();
+	unsigned int GetErrorCount();
+	const std::string& GetFirstError(); // Empty when there were no errors
+
+private:
+	unsigned int commandCounts[(int)CommandType::Count];
+	unsigned int commandCount;
+	unsigned int drawCount;
+	unsigned int instanceCount;
+	unsigned long long indexCount;
+	unsigned int constantBytes;
+	unsigned int errorCount;
+	std::string firstError;
+	StateCache stateCache;
+
+	void Error(unsigned int commandIndex, const char* message);
+};
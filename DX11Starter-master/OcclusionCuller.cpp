@@ -0,0 +1,523 @@
+#include "OcclusionCuller.h"
+#include "CpuFeatures.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// A tile with every one of its 32 pixels covered
+#define OCCLUSION_FULL_MASK 0xFFFFFFFFu
+
+// --------------------------------------------------------
+// Constructor
+//
+// width, height - Resolution of the software depth buffer.
+//                 Rounded up to whole 8x4 tiles.
+// threadPool    - Shared pool to rasterize and test with,
+//                 must outlive the culler
+// --------------------------------------------------------
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height, ThreadPool* threadPool)
+{
+	this->threadPool = threadPool;
+	useAVX2 = CpuHasAVX2();
+
+	occludeeTests = 0;
+	culledCount = 0;
+	rasterizeSeconds = 0.0;
+	testSeconds = 0.0;
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+
+	Resize(width, height);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+}
+
+void OcclusionCuller::Resize(unsigned int width, unsigned int height)
+{
+	tilesX = (width + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+	tilesY = (height + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+	this->width = tilesX * OCCLUSION_TILE_WIDTH;
+	this->height = tilesY * OCCLUSION_TILE_HEIGHT;
+
+	blocksX = (tilesX + OCCLUSION_BLOCK_TILES - 1) / OCCLUSION_BLOCK_TILES;
+	blocksY = (tilesY + OCCLUSION_BLOCK_TILES - 1) / OCCLUSION_BLOCK_TILES;
+
+	zMax0.assign(tilesX * tilesY, 1.0f);
+	zMax1.assign(tilesX * tilesY, 0.0f);
+	coverageMask.assign(tilesX * tilesY, 0);
+	blockMax.assign(blocksX * blocksY, 1.0f);
+
+	//Two strips per thread keeps everyone busy when the load is uneven
+	unsigned int binCount = std::min(threadPool->GetThreadCount() * 2, tilesY);
+	tileRowsPerBin = (tilesY + binCount - 1) / binCount;
+	bins.resize((tilesY + tileRowsPerBin - 1) / tileRowsPerBin);
+}
+
+void OcclusionCuller::BeginFrame(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection)
+{
+	XMStoreFloat4x4(&viewProjection,
+		XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+
+	std::fill(zMax0.begin(), zMax0.end(), 1.0f);
+	std::fill(zMax1.begin(), zMax1.end(), 0.0f);
+	std::fill(coverageMask.begin(), coverageMask.end(), 0);
+	std::fill(blockMax.begin(), blockMax.end(), 1.0f);
+
+	triangles.clear();
+	for (auto& b : bins)
+	{
+		b.clear();
+	}
+
+	occludeeTests = 0;
+	culledCount = 0;
+	rasterizeSeconds = 0.0;
+	testSeconds = 0.0;
+}
+
+// --------------------------------------------------------
+// Projects an occluder into screen space
+//
+// Triangles crossing the near plane are dropped rather than
+// clipped, which only ever makes the buffer less occluding.
+// --------------------------------------------------------
+void OcclusionCuller::AddOccluder(const DirectX::XMFLOAT3* positions, const unsigned int* indices,
+	unsigned int indexCount, const DirectX::XMFLOAT4X4& world)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProjection)));
+
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		ScreenTriangle tri = {};
+		bool clipped = false;
+		float maxZ = 0.0f;
+
+		for (int v = 0; v < 3; v++)
+		{
+			const XMFLOAT3& p = positions[indices[i + v]];
+			float cx = p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41;
+			float cy = p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42;
+			float cz = p.x * m._13 + p.y * m._23 + p.z * m._33 + m._43;
+			float cw = p.x * m._14 + p.y * m._24 + p.z * m._34 + m._44;
+
+			if (cz < 0.0f || cw <= 0.0f)
+			{
+				clipped = true;
+				break;
+			}
+
+			float invW = 1.0f / cw;
+			tri.X[v] = (cx * invW * 0.5f + 0.5f) * width;
+			tri.Y[v] = (0.5f - cy * invW * 0.5f) * height;
+			maxZ = std::max(maxZ, cz * invW);
+		}
+
+		if (clipped)
+			continue;
+
+		//Clockwise on screen (y down) is front facing in D3D
+		float area = (tri.X[1] - tri.X[0]) * (tri.Y[2] - tri.Y[0]) - (tri.X[2] - tri.X[0]) * (tri.Y[1] - tri.Y[0]);
+		if (area <= 0.0f)
+			continue;
+
+		//Entirely off screen or beyond the far plane?
+		float minX = std::min(tri.X[0], std::min(tri.X[1], tri.X[2]));
+		float maxX = std::max(tri.X[0], std::max(tri.X[1], tri.X[2]));
+		float minY = std::min(tri.Y[0], std::min(tri.Y[1], tri.Y[2]));
+		float maxY = std::max(tri.Y[0], std::max(tri.Y[1], tri.Y[2]));
+		if (maxX < 0.0f || maxY < 0.0f || minX >= (float)width || minY >= (float)height || maxZ >= 1.0f)
+			continue;
+
+		tri.MaxZ = maxZ;
+		triangles.push_back(tri);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	rasterizeSeconds += std::chrono::duration<double>(end - start).count();
+}
+
+void OcclusionCuller::RasterizeOccluders()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Bin each triangle into every horizontal strip it touches
+	for (unsigned int t = 0; t < triangles.size(); t++)
+	{
+		const ScreenTriangle& tri = triangles[t];
+		float minY = std::max(0.0f, std::min(tri.Y[0], std::min(tri.Y[1], tri.Y[2])));
+		float maxY = std::min((float)height - 1.0f, std::max(tri.Y[0], std::max(tri.Y[1], tri.Y[2])));
+
+		unsigned int firstBin = ((unsigned int)minY / OCCLUSION_TILE_HEIGHT) / tileRowsPerBin;
+		unsigned int lastBin = ((unsigned int)maxY / OCCLUSION_TILE_HEIGHT) / tileRowsPerBin;
+		for (unsigned int b = firstBin; b <= lastBin; b++)
+		{
+			bins[b].push_back(t);
+		}
+	}
+
+	//Strips never share tiles, so they can be filled independently
+	threadPool->ParallelFor((unsigned int)bins.size(), [this](unsigned int b) { RasterizeBin(b); });
+
+	BuildBlockLevel();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	rasterizeSeconds += std::chrono::duration<double>(end - start).count();
+}
+
+void OcclusionCuller::RasterizeBin(unsigned int bin)
+{
+	unsigned int firstRow = bin * tileRowsPerBin;
+	unsigned int lastRow = std::min(firstRow + tileRowsPerBin, tilesY) - 1;
+
+	for (unsigned int t : bins[bin])
+	{
+		RasterizeTriangle(triangles[t], firstRow, lastRow);
+	}
+}
+
+// --------------------------------------------------------
+// Computes the coverage mask of one triangle for each tile
+// it overlaps (within the given tile rows) and merges it
+// into the tile's depth layers
+// --------------------------------------------------------
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& tri, unsigned int firstTileRow, unsigned int lastTileRow)
+{
+	//Edge functions E(x, y) = A*x + B*y + C, positive inside
+	float a[3], b[3], c[3];
+	for (int e = 0; e < 3; e++)
+	{
+		int n = (e + 1) % 3;
+		a[e] = -(tri.Y[n] - tri.Y[e]);
+		b[e] = tri.X[n] - tri.X[e];
+		c[e] = -b[e] * tri.Y[e] - a[e] * tri.X[e];
+	}
+
+	//Tile bounds of the triangle
+	float minX = std::max(0.0f, std::min(tri.X[0], std::min(tri.X[1], tri.X[2])));
+	float maxX = std::min((float)width - 1.0f, std::max(tri.X[0], std::max(tri.X[1], tri.X[2])));
+	float minY = std::max(0.0f, std::min(tri.Y[0], std::min(tri.Y[1], tri.Y[2])));
+	float maxY = std::min((float)height - 1.0f, std::max(tri.Y[0], std::max(tri.Y[1], tri.Y[2])));
+
+	unsigned int tx0 = (unsigned int)minX / OCCLUSION_TILE_WIDTH;
+	unsigned int tx1 = (unsigned int)maxX / OCCLUSION_TILE_WIDTH;
+	unsigned int ty0 = std::max((unsigned int)minY / OCCLUSION_TILE_HEIGHT, firstTileRow);
+	unsigned int ty1 = std::min((unsigned int)maxY / OCCLUSION_TILE_HEIGHT, lastTileRow);
+
+	for (unsigned int ty = ty0; ty <= ty1; ty++)
+	{
+		for (unsigned int tx = tx0; tx <= tx1; tx++)
+		{
+			unsigned int tile = ty * tilesX + tx;
+
+			//Farther than what's already there? Nothing to gain
+			if (tri.MaxZ >= zMax0[tile])
+				continue;
+
+			float tileX = (float)(tx * OCCLUSION_TILE_WIDTH);
+			float tileY = (float)(ty * OCCLUSION_TILE_HEIGHT);
+			unsigned int mask = useAVX2 ? TileMaskAVX2(a, b, c, tileX, tileY) : TileMask(a, b, c, tileX, tileY);
+			if (mask != 0)
+				UpdateTile(tile, mask, tri.MaxZ);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Tests each pixel center against the edge functions, one
+// bit per pixel, row by row
+// --------------------------------------------------------
+unsigned int OcclusionCuller::TileMask(const float* a, const float* b, const float* c, float tileX, float tileY)
+{
+	unsigned int mask = 0;
+	for (unsigned int row = 0; row < OCCLUSION_TILE_HEIGHT; row++)
+	{
+		float py = tileY + row + 0.5f;
+		for (unsigned int col = 0; col < OCCLUSION_TILE_WIDTH; col++)
+		{
+			float px = tileX + col + 0.5f;
+			if (a[0] * px + b[0] * py + c[0] >= 0.0f &&
+				a[1] * px + b[1] * py + c[1] >= 0.0f &&
+				a[2] * px + b[2] * py + c[2] >= 0.0f)
+			{
+				mask |= 1u << (row * OCCLUSION_TILE_WIDTH + col);
+			}
+		}
+	}
+	return mask;
+}
+
+// --------------------------------------------------------
+// Two layer merge from the masked occlusion paper:
+//  - zMax0 is the conservative far depth of the whole tile
+//  - zMax1 / coverageMask accumulate the layer being built
+//  - Once the working layer covers the tile it replaces zMax0
+// --------------------------------------------------------
+void OcclusionCuller::UpdateTile(unsigned int tile, unsigned int mask, float z)
+{
+	float dist1t = zMax1[tile] - z;
+	float dist01 = zMax0[tile] - zMax1[tile];
+
+	//The new triangle is much nearer than the working layer, start over
+	if (dist1t > dist01)
+	{
+		zMax1[tile] = 0.0f;
+		coverageMask[tile] = 0;
+	}
+
+	zMax1[tile] = std::max(zMax1[tile], z);
+	coverageMask[tile] |= mask;
+
+	if (coverageMask[tile] == OCCLUSION_FULL_MASK)
+	{
+		zMax0[tile] = zMax1[tile];
+		zMax1[tile] = 0.0f;
+		coverageMask[tile] = 0;
+	}
+}
+
+void OcclusionCuller::BuildBlockLevel()
+{
+	for (unsigned int by = 0; by < blocksY; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksX; bx++)
+		{
+			float farthest = 0.0f;
+			unsigned int ty1 = std::min((by + 1) * OCCLUSION_BLOCK_TILES, tilesY);
+			unsigned int tx1 = std::min((bx + 1) * OCCLUSION_BLOCK_TILES, tilesX);
+			for (unsigned int ty = by * OCCLUSION_BLOCK_TILES; ty < ty1; ty++)
+			{
+				for (unsigned int tx = bx * OCCLUSION_BLOCK_TILES; tx < tx1; tx++)
+				{
+					farthest = std::max(farthest, zMax0[ty * tilesX + tx]);
+				}
+			}
+			blockMax[by * blocksX + bx] = farthest;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Returns false only when the box is provably hidden behind
+// the rasterized occluders (or entirely off screen)
+// --------------------------------------------------------
+bool OcclusionCuller::IsVisible(const DirectX::BoundingBox& worldBounds)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	occludeeTests++;
+
+	bool visible = TestBox(worldBounds);
+	if (!visible)
+		culledCount++;
+
+	auto end = std::chrono::high_resolution_clock::now();
+	testSeconds += std::chrono::duration<double>(end - start).count();
+	return visible;
+}
+
+// --------------------------------------------------------
+// IsVisible() for many boxes, split across the thread pool
+//
+// visible - Filled with 1 (visible) or 0 (culled) per box
+// --------------------------------------------------------
+void OcclusionCuller::TestVisibility(const std::vector<DirectX::BoundingBox>& worldBounds, std::vector<unsigned char>& visible)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	unsigned int count = (unsigned int)worldBounds.size();
+	visible.resize(count);
+
+	//Fixed size chunks, enough of them to balance uneven boxes
+	const unsigned int chunkSize = 256;
+	unsigned int chunkCount = (count + chunkSize - 1) / chunkSize;
+	std::vector<unsigned int> chunkCulled(chunkCount, 0);
+
+	threadPool->ParallelFor(chunkCount, [&](unsigned int chunk)
+	{
+		unsigned int end = std::min(count, (chunk + 1) * chunkSize);
+		for (unsigned int i = chunk * chunkSize; i < end; i++)
+		{
+			visible[i] = TestBox(worldBounds[i]) ? 1 : 0;
+			if (!visible[i])
+				chunkCulled[chunk]++;
+		}
+	});
+
+	occludeeTests += count;
+	for (unsigned int culled : chunkCulled)
+		culledCount += culled;
+
+	auto end = std::chrono::high_resolution_clock::now();
+	testSeconds += std::chrono::duration<double>(end - start).count();
+}
+
+// --------------------------------------------------------
+// The actual occludee test, reads the depth buffer only so
+// it's safe to call from several threads
+// --------------------------------------------------------
+bool OcclusionCuller::TestBox(const DirectX::BoundingBox& worldBounds) const
+{
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	worldBounds.GetCorners(corners);
+
+	const XMFLOAT4X4& m = viewProjection;
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float minZ = FLT_MAX;
+	bool visible = false;
+
+	for (size_t i = 0; i < BoundingBox::CORNER_COUNT; i++)
+	{
+		const XMFLOAT3& p = corners[i];
+		float cx = p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41;
+		float cy = p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42;
+		float cz = p.x * m._13 + p.y * m._23 + p.z * m._33 + m._43;
+		float cw = p.x * m._14 + p.y * m._24 + p.z * m._34 + m._44;
+
+		//Crossing the near plane, can't say anything useful
+		if (cz < 0.0f || cw <= 0.0f)
+		{
+			visible = true;
+			break;
+		}
+
+		float invW = 1.0f / cw;
+		float sx = (cx * invW * 0.5f + 0.5f) * width;
+		float sy = (0.5f - cy * invW * 0.5f) * height;
+		minX = std::min(minX, sx);
+		maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy);
+		maxY = std::max(maxY, sy);
+		minZ = std::min(minZ, cz * invW);
+	}
+
+	if (!visible)
+	{
+		//Off screen or past the far plane
+		if (maxX < 0.0f || maxY < 0.0f || minX >= (float)width || minY >= (float)height || minZ > 1.0f)
+		{
+			visible = false;
+		}
+		else
+		{
+			unsigned int tx0 = (unsigned int)std::max(0.0f, minX) / OCCLUSION_TILE_WIDTH;
+			unsigned int tx1 = (unsigned int)std::min((float)width - 1.0f, maxX) / OCCLUSION_TILE_WIDTH;
+			unsigned int ty0 = (unsigned int)std::max(0.0f, minY) / OCCLUSION_TILE_HEIGHT;
+			unsigned int ty1 = (unsigned int)std::min((float)height - 1.0f, maxY) / OCCLUSION_TILE_HEIGHT;
+
+			unsigned int bx0 = tx0 / OCCLUSION_BLOCK_TILES, bx1 = tx1 / OCCLUSION_BLOCK_TILES;
+			unsigned int by0 = ty0 / OCCLUSION_BLOCK_TILES, by1 = ty1 / OCCLUSION_BLOCK_TILES;
+
+			for (unsigned int by = by0; by <= by1 && !visible; by++)
+			{
+				for (unsigned int bx = bx0; bx <= bx1 && !visible; bx++)
+				{
+					//Whole block is nearer than the box
+					if (minZ >= blockMax[by * blocksX + bx])
+						continue;
+
+					unsigned int rx0 = std::max(tx0, bx * OCCLUSION_BLOCK_TILES);
+					unsigned int rx1 = std::min(tx1, bx * OCCLUSION_BLOCK_TILES + OCCLUSION_BLOCK_TILES - 1);
+					unsigned int ry0 = std::max(ty0, by * OCCLUSION_BLOCK_TILES);
+					unsigned int ry1 = std::min(ty1, by * OCCLUSION_BLOCK_TILES + OCCLUSION_BLOCK_TILES - 1);
+
+					for (unsigned int ty = ry0; ty <= ry1 && !visible; ty++)
+					{
+						const float* rowDepth = &zMax0[ty * tilesX];
+						unsigned int count = rx1 - rx0 + 1;
+						visible = useAVX2 ? AnyFartherAVX2(rowDepth + rx0, count, minZ) : AnyFarther(rowDepth + rx0, count, minZ);
+					}
+				}
+			}
+		}
+	}
+
+	return visible;
+}
+
+bool OcclusionCuller::AnyFarther(const float* depths, unsigned int count, float z)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (z < depths[i])
+			return true;
+	}
+	return false;
+}
+
+// --------------------------------------------------------
+// Grey is the committed far depth (zMax0) of each tile, red
+// marks pixels covered by a not-yet-complete working layer
+// --------------------------------------------------------
+void OcclusionCuller::GetDepthVisualization(std::vector<unsigned int>& rgba)
+{
+	rgba.resize(width * height);
+
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned int tile = (y / OCCLUSION_TILE_HEIGHT) * tilesX + x / OCCLUSION_TILE_WIDTH;
+			unsigned int bit = (y % OCCLUSION_TILE_HEIGHT) * OCCLUSION_TILE_WIDTH + x % OCCLUSION_TILE_WIDTH;
+			bool working = (coverageMask[tile] >> bit) & 1;
+
+			//Perspective depth bunches up near 1, spread it out a bit
+			float z = working ? zMax1[tile] : zMax0[tile];
+			unsigned int shade = (unsigned int)(std::pow(1.0f - z, 0.25f) * 255.0f);
+
+			unsigned int r = shade, g = working ? shade / 2 : shade, b = working ? shade / 2 : shade;
+			rgba[y * width + x] = r | (g << 8) | (b << 16) | 0xFF000000u;
+		}
+	}
+}
+
+unsigned int OcclusionCuller::GetWidth()
+{
+	return width;
+}
+
+unsigned int OcclusionCuller::GetHeight()
+{
+	return height;
+}
+
+unsigned int OcclusionCuller::GetOccluderTriangleCount()
+{
+	return (unsigned int)triangles.size();
+}
+
+unsigned int OcclusionCuller::GetOccludeeTestCount()
+{
+	return occludeeTests;
+}
+
+unsigned int OcclusionCuller::GetCulledCount()
+{
+	return culledCount;
+}
+
+double OcclusionCuller::GetRasterizeSeconds()
+{
+	return rasterizeSeconds;
+}
+
+double OcclusionCuller::GetTestSeconds()
+{
+	return testSeconds;
+}
+
+bool OcclusionCuller::GetUseAVX2()
+{
+	return useAVX2;
+}
+
+void OcclusionCuller::SetUseAVX2(bool useAVX2)
+{
+	this->useAVX2 = useAVX2 && CpuHasAVX2();
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+#include "ThreadPool.h"
+
+// Size of a single depth tile in pixels (one 32-bit coverage mask)
+#define OCCLUSION_TILE_WIDTH 8
+#define OCCLUSION_TILE_HEIGHT 4
+
+// Number of tiles (per axis) summarized by one coarse block
+#define OCCLUSION_BLOCK_TILES 4
+
+// --------------------------------------------------------
+// CPU-only masked software occlusion culling
+//
+// Occluder triangles are rasterized into a small depth buffer
+// made of 8x4 pixel tiles. Each tile keeps a 32-bit coverage
+// mask and two depth layers (Andersson et al., "Masked Software
+// Occlusion Culling"), so partially covered tiles still merge
+// into a conservative far depth. A coarser level of 4x4 tiles
+// lets large occludees be rejected without touching every tile.
+//
+// Usage per frame:
+//  BeginFrame() -> AddOccluder() ... -> RasterizeOccluders()
+//  -> IsVisible() or TestVisibility() for the occludees
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	OcclusionCuller(unsigned int width, unsigned int height, ThreadPool* threadPool);
+	~OcclusionCuller();
+
+	void Resize(unsigned int width, unsigned int height);
+
+	// Clears the depth buffer and sets the camera for this frame
+	void BeginFrame(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+
+	// Transforms, clips and back-face culls an occluder mesh, queuing its triangles
+	void AddOccluder(const DirectX::XMFLOAT3* positions, const unsigned int* indices,
+		unsigned int indexCount, const DirectX::XMFLOAT4X4& world);
+
+	// Bins queued triangles into horizontal strips and rasterizes them across threads
+	void RasterizeOccluders();
+
+	// Tests a world space bounding box against the depth buffer
+	bool IsVisible(const DirectX::BoundingBox& worldBounds);
+
+	// Tests many boxes at once across threads, 1 per visible box
+	void TestVisibility(const std::vector<DirectX::BoundingBox>& worldBounds, std::vector<unsigned char>& visible);
+
+	// Writes one RGBA8 value per pixel for debug display
+	void GetDepthVisualization(std::vector<unsigned int>& rgba);
+
+	// Turns the AVX2 paths on or off, off if the CPU doesn't have it
+	void SetUseAVX2(bool useAVX2);
+
+	//Getters
+	unsigned int GetWidth();
+	unsigned int GetHeight();
+	unsigned int GetOccluderTriangleCount();
+	unsigned int GetOccludeeTestCount();
+	unsigned int GetCulledCount();
+	double GetRasterizeSeconds();
+	double GetTestSeconds();
+	bool GetUseAVX2();
+
+private:
+	// A screen space triangle, already projected to pixels
+	struct ScreenTriangle
+	{
+		float X[3];
+		float Y[3];
+		float MaxZ; // Farthest vertex depth, used as the conservative triangle depth
+	};
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int tilesX;
+	unsigned int tilesY;
+	unsigned int blocksX;
+	unsigned int blocksY;
+
+	// Per tile depth layers and coverage of the working layer
+	std::vector<float> zMax0;
+	std::vector<float> zMax1;
+	std::vector<unsigned int> coverageMask;
+
+	// Coarse level: farthest zMax0 of each block of tiles
+	std::vector<float> blockMax;
+
+	// Triangles waiting to be rasterized and their per-strip bins
+	std::vector<ScreenTriangle> triangles;
+	std::vector<std::vector<unsigned int>> bins;
+	unsigned int tileRowsPerBin;
+
+	DirectX::XMFLOAT4X4 viewProjection;
+	ThreadPool* threadPool;
+	bool useAVX2;
+
+	//Stats
+	unsigned int occludeeTests;
+	unsigned int culledCount;
+	double rasterizeSeconds;
+	double testSeconds;
+
+	void RasterizeBin(unsigned int bin);
+	void RasterizeTriangle(const ScreenTriangle& tri, unsigned int firstTileRow, unsigned int lastTileRow);
+	void UpdateTile(unsigned int tile, unsigned int mask, float z);
+
+	// Pixels of an 8x4 tile inside all three edge functions
+	static unsigned int TileMask(const float* a, const float* b, const float* c, float tileX, float tileY);
+
+	// Whether z is nearer than any of count tile depths
+	static bool AnyFarther(const float* depths, unsigned int count, float z);
+
+	// Same as above 8 pixels or tiles at a time. Defined in
+	// OcclusionCullerAVX2.cpp, the only file built with AVX2.
+	static unsigned int TileMaskAVX2(const float* a, const float* b, const float* c, float tileX, float tileY);
+	static bool AnyFartherAVX2(const float* depths, unsigned int count, float z);
+
+	bool TestBox(const DirectX::BoundingBox& worldBounds) const;
+	void BuildBlockLevel();
+};
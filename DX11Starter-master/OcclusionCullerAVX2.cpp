@@ -0,0 +1,64 @@
+#include "OcclusionCuller.h"
+#include <immintrin.h>
+
+// --------------------------------------------------------
+// The AVX2 paths of OcclusionCuller. This is the only file
+// built with AVX2, so nothing here may run unless
+// CpuHasAVX2() said so.
+// --------------------------------------------------------
+
+// --------------------------------------------------------
+// A whole row of the tile per edge test, one lane per pixel
+// --------------------------------------------------------
+unsigned int OcclusionCuller::TileMaskAVX2(const float* a, const float* b, const float* c, float tileX, float tileY)
+{
+	const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	__m256 px = _mm256_add_ps(_mm256_set1_ps(tileX), laneOffsets);
+	__m256 rowStart[3];
+	for (int e = 0; e < 3; e++)
+	{
+		rowStart[e] = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a[e]), px), _mm256_set1_ps(c[e]));
+	}
+
+	unsigned int mask = 0;
+	for (unsigned int row = 0; row < OCCLUSION_TILE_HEIGHT; row++)
+	{
+		float py = tileY + row + 0.5f;
+		__m256 inside = _mm256_cmp_ps(_mm256_add_ps(rowStart[0], _mm256_set1_ps(b[0] * py)), zero, _CMP_GE_OQ);
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(rowStart[1], _mm256_set1_ps(b[1] * py)), zero, _CMP_GE_OQ));
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(rowStart[2], _mm256_set1_ps(b[2] * py)), zero, _CMP_GE_OQ));
+		mask |= (unsigned int)_mm256_movemask_ps(inside) << (row * OCCLUSION_TILE_WIDTH);
+	}
+	return mask;
+}
+
+// --------------------------------------------------------
+// 8 tiles at a time, then 4, as a block row is only 4 wide
+// --------------------------------------------------------
+bool OcclusionCuller::AnyFartherAVX2(const float* depths, unsigned int count, float z)
+{
+	unsigned int i = 0;
+
+	__m256 boxZ = _mm256_set1_ps(z);
+	for (; i + 8 <= count; i += 8)
+	{
+		if (_mm256_movemask_ps(_mm256_cmp_ps(boxZ, _mm256_loadu_ps(depths + i), _CMP_LT_OQ)) != 0)
+			return true;
+	}
+
+	if (i + 4 <= count)
+	{
+		if (_mm_movemask_ps(_mm_cmp_ps(_mm256_castps256_ps128(boxZ), _mm_loadu_ps(depths + i), _CMP_LT_OQ)) != 0)
+			return true;
+		i += 4;
+	}
+
+	for (; i < count; i++)
+	{
+		if (z < depths[i])
+			return true;
+	}
+	return false;
+}
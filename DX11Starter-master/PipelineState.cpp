@@ -0,0 +1,170 @@
+#include "PipelineState.h"
+#include "ShaderVariants.h"
+#include <cstring>
+
+// Descs are all 4 byte fields, so raw bytes are safe to hash and compare
+static_assert(sizeof(RasterizerStateDesc) == 10 * 4, "RasterizerStateDesc must have no padding");
+static_assert(sizeof(BlendStateDesc) == 9 * 4, "BlendStateDesc must have no padding");
+static_assert(sizeof(DepthStencilStateDesc) == 14 * 4, "DepthStencilStateDesc must have no padding");
+
+unsigned long long HashRasterizerState(const RasterizerStateDesc& desc)
+{
+	return HashShaderBytes(&desc, sizeof(desc));
+}
+
+unsigned long long HashBlendState(const BlendStateDesc& desc)
+{
+	return HashShaderBytes(&desc, sizeof(desc));
+}
+
+unsigned long long HashDepthStencilState(const DepthStencilStateDesc& desc)
+{
+	return HashShaderBytes(&desc, sizeof(desc));
+}
+
+// --------------------------------------------------------
+// Field by field, as PipelineDesc itself can have padding
+// between the pointers and the rest
+// --------------------------------------------------------
+unsigned long long HashPipeline(const PipelineDesc& desc)
+{
+	unsigned long long hash = HashShaderBytes(&desc.VertexShader, sizeof(desc.VertexShader));
+	hash = HashShaderBytes(&desc.PixelShader, sizeof(desc.PixelShader), hash);
+	hash = HashShaderBytes(&desc.InputLayout, sizeof(desc.InputLayout), hash);
+	hash = HashShaderBytes(&desc.Rasterizer, sizeof(desc.Rasterizer), hash);
+	hash = HashShaderBytes(&desc.Blend, sizeof(desc.Blend), hash);
+	hash = HashShaderBytes(&desc.DepthStencil, sizeof(desc.DepthStencil), hash);
+	return HashShaderBytes(&desc.Topology, sizeof(desc.Topology), hash);
+}
+
+static bool PipelineDescsMatch(const PipelineDesc& a, const PipelineDesc& b)
+{
+	return a.VertexShader == b.VertexShader &&
+		a.PixelShader == b.PixelShader &&
+		a.InputLayout == b.InputLayout &&
+		memcmp(&a.Rasterizer, &b.Rasterizer, sizeof(a.Rasterizer)) == 0 &&
+		memcmp(&a.Blend, &b.Blend, sizeof(a.Blend)) == 0 &&
+		memcmp(&a.DepthStencil, &b.DepthStencil, sizeof(a.DepthStencil)) == 0 &&
+		a.Topology == b.Topology;
+}
+
+PipelineCache::PipelineCache(IPipelineStateFactory* factory)
+{
+	this->factory = factory;
+	hitCount = 0;
+	missCount = 0;
+}
+
+PipelineCache::~PipelineCache()
+{
+}
+
+const PipelineState* PipelineCache::GetPipeline(const PipelineDesc& desc)
+{
+	unsigned long long hash = HashPipeline(desc);
+	auto range = pipelineLookup.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (PipelineDescsMatch(it->second->Desc, desc))
+		{
+			hitCount++;
+			return &it->second->State;
+		}
+	}
+
+	PipelineEntry entry = {};
+	entry.Desc = desc;
+	entry.State.VertexShader = desc.VertexShader;
+	entry.State.PixelShader = desc.PixelShader;
+	entry.State.InputLayout = desc.InputLayout;
+	entry.State.RasterizerState = GetRasterizerState(desc.Rasterizer);
+	entry.State.BlendState = GetBlendState(desc.Blend);
+	entry.State.DepthStencilState = GetDepthStencilState(desc.DepthStencil);
+	entry.State.Topology = desc.Topology;
+
+	pipelines.push_back(entry);
+	pipelineLookup.insert({ hash, &pipelines.back() });
+	missCount++;
+	return &pipelines.back().State;
+}
+
+void PipelineCache::Clear()
+{
+	pipelineLookup.clear();
+	pipelines.clear();
+}
+
+const void* PipelineCache::GetRasterizerState(const RasterizerStateDesc& desc)
+{
+	unsigned long long hash = HashRasterizerState(desc);
+	auto range = rasterizerStates.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (memcmp(&it->second.Desc, &desc, sizeof(desc)) == 0)
+			return it->second.Object;
+	}
+
+	const void* object = factory->CreateRasterizerState(desc);
+	rasterizerStates.insert({ hash, { desc, object } });
+	return object;
+}
+
+const void* PipelineCache::GetBlendState(const BlendStateDesc& desc)
+{
+	unsigned long long hash = HashBlendState(desc);
+	auto range = blendStates.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (memcmp(&it->second.Desc, &desc, sizeof(desc)) == 0)
+			return it->second.Object;
+	}
+
+	const void* object = factory->CreateBlendState(desc);
+	blendStates.insert({ hash, { desc, object } });
+	return object;
+}
+
+const void* PipelineCache::GetDepthStencilState(const DepthStencilStateDesc& desc)
+{
+	unsigned long long hash = HashDepthStencilState(desc);
+	auto range = depthStencilStates.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (memcmp(&it->second.Desc, &desc, sizeof(desc)) == 0)
+			return it->second.Object;
+	}
+
+	const void* object = factory->CreateDepthStencilState(desc);
+	depthStencilStates.insert({ hash, { desc, object } });
+	return object;
+}
+
+unsigned int PipelineCache::GetPipelineCount()
+{
+	return (unsigned int)pipelines.size();
+}
+
+unsigned int PipelineCache::GetRasterizerStateCount()
+{
+	return (unsigned int)rasterizerStates.size();
+}
+
+unsigned int PipelineCache::GetBlendStateCount()
+{
+	return (unsigned int)blendStates.size();
+}
+
+unsigned int PipelineCache::GetDepthStencilStateCount()
+{
+	return (unsigned int)depthStencilStates.size();
+}
+
+unsigned int PipelineCache::GetHitCount()
+{
+	return hitCount;
+}
+
+unsigned int PipelineCache::GetMissCount()
+{
+	return missCount;
+}
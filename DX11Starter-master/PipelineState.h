@@ -0,0 +1,166 @@
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+
+// --------------------------------------------------------
+// Fixed function state, field for field the same as the
+// D3D11_*_DESC structs and using the same enum values, but
+// without needing Direct3D. Defaults match D3D11's defaults.
+//
+// Every field is 4 bytes, so there's no padding and a desc
+// can be hashed and compared as raw bytes.
+// --------------------------------------------------------
+struct RasterizerStateDesc
+{
+	unsigned int FillMode = 3; // D3D11_FILL_SOLID
+	unsigned int CullMode = 3; // D3D11_CULL_BACK
+	unsigned int FrontCounterClockwise = 0;
+	int DepthBias = 0;
+	float DepthBiasClamp = 0.0f;
+	float SlopeScaledDepthBias = 0.0f;
+	unsigned int DepthClipEnable = 1;
+	unsigned int ScissorEnable = 0;
+	unsigned int MultisampleEnable = 0;
+	unsigned int AntialiasedLineEnable = 0;
+};
+
+struct DepthStencilOpDesc
+{
+	unsigned int StencilFailOp = 1; // D3D11_STENCIL_OP_KEEP
+	unsigned int StencilDepthFailOp = 1;
+	unsigned int StencilPassOp = 1;
+	unsigned int StencilFunc = 8; // D3D11_COMPARISON_ALWAYS
+};
+
+struct DepthStencilStateDesc
+{
+	unsigned int DepthEnable = 1;
+	unsigned int DepthWriteMask = 1; // D3D11_DEPTH_WRITE_MASK_ALL
+	unsigned int DepthFunc = 2; // D3D11_COMPARISON_LESS
+	unsigned int StencilEnable = 0;
+	unsigned int StencilReadMask = 0xFF;
+	unsigned int StencilWriteMask = 0xFF;
+	DepthStencilOpDesc FrontFace;
+	DepthStencilOpDesc BackFace;
+};
+
+// One blend setup, used for every render target
+struct BlendStateDesc
+{
+	unsigned int AlphaToCoverageEnable = 0;
+	unsigned int BlendEnable = 0;
+	unsigned int SrcBlend = 2; // D3D11_BLEND_ONE
+	unsigned int DestBlend = 1; // D3D11_BLEND_ZERO
+	unsigned int BlendOp = 1; // D3D11_BLEND_OP_ADD
+	unsigned int SrcBlendAlpha = 2;
+	unsigned int DestBlendAlpha = 1;
+	unsigned int BlendOpAlpha = 1;
+	unsigned int RenderTargetWriteMask = 0xF; // D3D11_COLOR_WRITE_ENABLE_ALL
+};
+
+// Everything that makes up a pipeline. Shaders and input
+// layout are opaque pointers, the same ones CommandBuffer takes.
+struct PipelineDesc
+{
+	const void* VertexShader = 0;
+	const void* PixelShader = 0;
+	const void* InputLayout = 0;
+	RasterizerStateDesc Rasterizer;
+	BlendStateDesc Blend;
+	DepthStencilStateDesc DepthStencil;
+	unsigned int Topology = 4; // D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST
+};
+
+// --------------------------------------------------------
+// A built pipeline: exactly what binding it sets. Made only
+// by PipelineCache and never changed afterwards, so the
+// pointer itself identifies the pipeline.
+// --------------------------------------------------------
+struct PipelineState
+{
+	const void* VertexShader;
+	const void* PixelShader;
+	const void* InputLayout;
+	const void* RasterizerState;
+	const void* BlendState;
+	const void* DepthStencilState;
+	unsigned int Topology;
+};
+
+// Hashes (64 bit FNV-1a)
+unsigned long long HashRasterizerState(const RasterizerStateDesc& desc);
+unsigned long long HashBlendState(const BlendStateDesc& desc);
+unsigned long long HashDepthStencilState(const DepthStencilStateDesc& desc);
+unsigned long long HashPipeline(const PipelineDesc& desc);
+
+// --------------------------------------------------------
+// Makes the API objects for fixed function state. Whatever
+// it returns has to stay alive as long as the factory does.
+// --------------------------------------------------------
+class IPipelineStateFactory
+{
+public:
+	virtual ~IPipelineStateFactory() {}
+	virtual const void* CreateRasterizerState(const RasterizerStateDesc& desc) = 0;
+	virtual const void* CreateBlendState(const BlendStateDesc& desc) = 0;
+	virtual const void* CreateDepthStencilState(const DepthStencilStateDesc& desc) = 0;
+};
+
+// --------------------------------------------------------
+// Hands out one PipelineState per distinct PipelineDesc
+//
+// - Pipelines are looked up by hash, then compared in full,
+//   so a collision can't hand back the wrong pipeline
+// - Rasterizer, blend and depth-stencil states are shared:
+//   each distinct desc is created once through the factory,
+//   however many pipelines use it
+// - Pipelines stay put until Clear(), so their pointers can
+//   be kept and recorded freely
+// - Not thread safe: build pipelines on one thread, record
+//   them from anywhere
+// --------------------------------------------------------
+class PipelineCache
+{
+public:
+	PipelineCache(IPipelineStateFactory* factory);
+	~PipelineCache();
+
+	const PipelineState* GetPipeline(const PipelineDesc& desc);
+
+	// Forgets every pipeline (e.g. after shaders are reloaded),
+	// keeping the shared states for the next ones
+	void Clear();
+
+	//Stats
+	unsigned int GetPipelineCount();
+	unsigned int GetRasterizerStateCount();
+	unsigned int GetBlendStateCount();
+	unsigned int GetDepthStencilStateCount();
+	unsigned int GetHitCount(); // GetPipeline() calls that found an existing pipeline
+	unsigned int GetMissCount();
+
+private:
+	struct PipelineEntry
+	{
+		PipelineDesc Desc;
+		PipelineState State;
+	};
+
+	struct RasterizerEntry { RasterizerStateDesc Desc; const void* Object; };
+	struct BlendEntry { BlendStateDesc Desc; const void* Object; };
+	struct DepthStencilEntry { DepthStencilStateDesc Desc; const void* Object; };
+
+	IPipelineStateFactory* factory;
+	std::deque<PipelineEntry> pipelines;
+	std::unordered_multimap<unsigned long long, PipelineEntry*> pipelineLookup;
+	std::unordered_multimap<unsigned long long, RasterizerEntry> rasterizerStates;
+	std::unordered_multimap<unsigned long long, BlendEntry> blendStates;
+	std::unordered_multimap<unsigned long long, DepthStencilEntry> depthStencilStates;
+	unsigned int hitCount;
+	unsigned int missCount;
+
+	const void* GetRasterizerState(const RasterizerStateDesc& desc);
+	const void* GetBlendState(const BlendStateDesc& desc);
+	const void* GetDepthStencilState(const DepthStencilStateDesc& desc);
+};
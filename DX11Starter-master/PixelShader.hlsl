@@ -1,31 +1,39 @@
 #include "ShaderHelper.hlsli"
 
-cbuffer ExternalData : register(b0)
+// Feature switches, set per variant (see ShaderVariants.h).
+// The defaults are everything on, which is what the prebuilt
+// PixelShader.cso gets.
+#ifndef USE_SHADOWS
+#define USE_SHADOWS 1
+#endif
+#ifndef USE_NORMAL_MAP
+#define USE_NORMAL_MAP 1
+#endif
+#ifndef USE_ALPHA_TEST
+#define USE_ALPHA_TEST 0
+#endif
+
+#define ALPHA_TEST_THRESHOLD 0.5f
+
+#include "Lighting.hlsli"
+
+//PerFrame and the light and shadow resources are in Lighting.hlsli
+cbuffer PerMaterial : register(b1) // C++: MaterialConstants
 {
     float4 colorTint;
-    float3 cameraPos;
-    float roughness;
-    float3 ambient;
     float2 scale;
     float2 offset;
-    Light directionalLight;
-    Light directionalLight2;
-    Light directionalLight3;
-    Light pointLight;
-    Light pointLight2;
+    float roughness;
 }
 
 //Need at least 1 sampler for textures
 SamplerState BasicSampler : register(s0);
-SamplerComparisonState ShadowSampler : register(s1);
 
 //Textures
 Texture2D Albedo : register(t0);
 Texture2D NormalMap : register(t1);
 Texture2D RoughnessMap : register(t2);
 Texture2D MetalnessMap : register(t3);
-Texture2D ShadowMap : register(t4);
-
 
 // --------------------------------------------------------
 // The entry point (main method) for our pixel shader
@@ -38,15 +46,6 @@ Texture2D ShadowMap : register(t4);
 // --------------------------------------------------------
 float4 main(VertexToPixel input) : SV_TARGET
 {
-    //Check Shadows
-    input.shadowMapPos /= input.shadowMapPos.w;
-    
-    float2 shadowUV = input.shadowMapPos.xy * 0.5f + 0.5f;
-    shadowUV.y = 1 - shadowUV.y;
-    
-    float distToLight = input.shadowMapPos.z;
-    float shadowAmount = ShadowMap.SampleCmpLevelZero(ShadowSampler, shadowUV, distToLight).r;
-    
     //Scale
     float2 scaleCenter = float2(0.5f, 0.5f);
     input.uv = (input.uv - scaleCenter) * scale + scaleCenter;
@@ -54,7 +53,14 @@ float4 main(VertexToPixel input) : SV_TARGET
     //Offset
     input.uv += offset;
     
+    //Cutouts go before any lighting work
+    float4 albedoSample = Albedo.Sample(BasicSampler, input.uv);
+#if USE_ALPHA_TEST
+    clip(albedoSample.a - ALPHA_TEST_THRESHOLD);
+#endif
+    
     //Normal
+#if USE_NORMAL_MAP
     float3 unpackedNormal = normalize(NormalMap.Sample(BasicSampler, input.uv).rgb * 2 - 1);
     float3 N = normalize(input.normal);
     float3 T = normalize(input.tangent);
@@ -62,34 +68,19 @@ float4 main(VertexToPixel input) : SV_TARGET
     float3 B = cross(T, N);
     float3x3 TBN = float3x3(T, B, N);
     input.normal = mul(unpackedNormal, TBN);
+#else
+    input.normal = normalize(input.normal);
+#endif
     
     //PBR parameters
-    float3 albedo = pow(Albedo.Sample(BasicSampler, input.uv).rgb, 2.2f);
+    float3 albedo = pow(albedoSample.rgb, 2.2f);
     float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
     float metalness = MetalnessMap.Sample(BasicSampler, input.uv).r;
-    float3 specularColor = lerp(F0_NON_METAL, albedo.rgb, metalness);
-    float3 toCamera = normalize(cameraPos - input.worldPosition);
-    float3 light = float3(0, 0, 0);
     
-    //Directional Light
-    float3 firstLight = DiffuseSpecCalc(directionalLight, input.normal, directionalLight.direction, toCamera,
-                             albedo, roughness, metalness, specularColor);
-    light += firstLight * shadowAmount; //Add shadows to the first directional light
-    light += DiffuseSpecCalc(directionalLight2, input.normal, directionalLight2.direction, toCamera,
-                             albedo, roughness, metalness, specularColor);
-    light += DiffuseSpecCalc(directionalLight3, input.normal, directionalLight3.direction, toCamera,
-                             albedo, roughness, metalness, specularColor);
-    
-    //Point Light
-    float3 direction = normalize(input.worldPosition - pointLight.position);
-    light += DiffuseSpecCalc(pointLight, input.normal, direction, toCamera,
-             albedo, roughness, metalness, specularColor)
-             * Attenuate(pointLight, input.worldPosition);
-    
-    direction = normalize(input.worldPosition - pointLight2.position);
-    light += DiffuseSpecCalc(pointLight2, input.normal, direction, toCamera,
-             albedo, roughness, metalness, specularColor)
-             * Attenuate(pointLight, input.worldPosition);
+    //Only the lights that reach this pixel's cluster. SV_Position.w
+    //is the view depth.
+    float3 light = ShadeClusteredLights(input.screenPosition.xy, input.screenPosition.w, input.worldPosition,
+                                        input.normal, albedo, roughness, metalness);
     
     return float4(pow(light * albedo, 1.0f / 2.2f), 1);
-}
\ No newline at end of file
+}
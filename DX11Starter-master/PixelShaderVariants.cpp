@@ -0,0 +1,131 @@
+#include "PixelShaderVariants.h"
+#include "PathHelpers.h"
+#include <d3dcompiler.h>
+
+PixelShaderVariants::PixelShaderVariants(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	const std::wstring& sourceFile, const std::wstring& outputFolder, std::shared_ptr<SimplePixelShader> fallback)
+{
+	this->device = device;
+	this->context = context;
+	this->sourceFile = sourceFile;
+	this->outputFolder = outputFolder;
+	this->fallback = fallback;
+	compiledCount = 0;
+	loadedCount = 0;
+	fallbackCount = 0;
+
+	//Variant files are named after the source file
+	std::wstring name = sourceFile;
+	size_t slash = name.find_last_of(L"/\\");
+	if (slash != std::wstring::npos)
+		name.erase(0, slash + 1);
+	size_t dot = name.find_last_of(L'.');
+	if (dot != std::wstring::npos)
+		name.erase(dot);
+	shaderName = WideToNarrow(name);
+}
+
+PixelShaderVariants::~PixelShaderVariants()
+{
+}
+
+std::shared_ptr<SimplePixelShader> PixelShaderVariants::GetVariant(ShaderVariantKey key)
+{
+	auto found = variants.find(key);
+	if (found != variants.end())
+		return found->second;
+
+	std::shared_ptr<SimplePixelShader> variant = BuildVariant(key);
+	if (!variant)
+	{
+		variant = fallback;
+		fallbackCount++;
+	}
+
+	variants.insert({ key, variant });
+	return variant;
+}
+
+// --------------------------------------------------------
+// Preprocessing first means the hash covers included files
+// too, and it's far cheaper than compiling, so finding an
+// up to date variant on disk costs very little
+// --------------------------------------------------------
+std::shared_ptr<SimplePixelShader> PixelShaderVariants::BuildVariant(ShaderVariantKey key)
+{
+	Microsoft::WRL::ComPtr<ID3DBlob> source;
+	if (D3DReadFileToBlob(sourceFile.c_str(), source.GetAddressOf()) != S_OK)
+		return 0;
+
+	//Defines, in the null terminated form D3D wants
+	std::vector<ShaderDefine> defines;
+	GetShaderVariantDefines(key, defines);
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const ShaderDefine& define : defines)
+	{
+		macros.push_back({ define.Name.c_str(), define.Value.c_str() });
+	}
+	macros.push_back({ 0, 0 });
+
+	std::string sourceName = WideToNarrow(sourceFile);
+	Microsoft::WRL::ComPtr<ID3DBlob> preprocessed;
+	if (D3DPreprocess(source->GetBufferPointer(), source->GetBufferSize(), sourceName.c_str(),
+		macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, preprocessed.GetAddressOf(), 0) != S_OK)
+		return 0;
+
+	//Compile flags change the output too
+#if defined(DEBUG) || defined(_DEBUG)
+	unsigned int flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+	unsigned int flags = D3DCOMPILE_OPTIMIZATION_LEVEL3;
+#endif
+	unsigned long long hash = HashShaderBytes(preprocessed->GetBufferPointer(), preprocessed->GetBufferSize());
+	hash = HashShaderBytes(&flags, sizeof(flags), hash);
+	hash = HashShaderVariant(hash, defines);
+	std::wstring variantFile = outputFolder + NarrowToWide(GetShaderVariantFileName(shaderName, hash));
+
+	//Already built?
+	if (GetFileAttributesW(variantFile.c_str()) != INVALID_FILE_ATTRIBUTES)
+	{
+		std::shared_ptr<SimplePixelShader> variant = std::make_shared<SimplePixelShader>(device, context, variantFile.c_str());
+		if (variant->IsShaderValid())
+		{
+			loadedCount++;
+			return variant;
+		}
+	}
+
+	Microsoft::WRL::ComPtr<ID3DBlob> compiled;
+	if (D3DCompile(preprocessed->GetBufferPointer(), preprocessed->GetBufferSize(), sourceName.c_str(),
+		0, 0, "main", "ps_5_0", flags, 0, compiled.GetAddressOf(), 0) != S_OK)
+		return 0;
+	if (D3DWriteBlobToFile(compiled.Get(), variantFile.c_str(), TRUE) != S_OK)
+		return 0;
+
+	std::shared_ptr<SimplePixelShader> variant = std::make_shared<SimplePixelShader>(device, context, variantFile.c_str());
+	if (!variant->IsShaderValid())
+		return 0;
+
+	compiledCount++;
+	return variant;
+}
+
+unsigned int PixelShaderVariants::GetVariantCount()
+{
+	return (unsigned int)variants.size();
+}
+
+unsigned int PixelShaderVariants::GetCompiledCount()
+{
+	return compiledCount;
+}
+
+unsigned int PixelShaderVariants::GetLoadedCount()
+{
+	return loadedCount;
+}
+
+unsigned int PixelShaderVariants::GetFallbackCount()
+{
+	return fallbackCount;
+}
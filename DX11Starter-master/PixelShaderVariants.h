@@ -0,0 +1,52 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "SimpleShader.h"
+#include "ShaderVariants.h"
+
+// --------------------------------------------------------
+// The compiled variants of one pixel shader, each made the
+// first time its key is asked for
+//
+// - The source is preprocessed with the key's defines and
+//   hashed. A .cso named after the hash in the output folder
+//   is loaded if it's there, otherwise the variant is
+//   compiled and written there for next time
+// - If the source can't be found, or a variant won't build,
+//   the prebuilt fallback (everything switched on) is used
+//   instead, so nothing breaks without shader sources
+// --------------------------------------------------------
+class PixelShaderVariants
+{
+public:
+	PixelShaderVariants(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		const std::wstring& sourceFile, const std::wstring& outputFolder, std::shared_ptr<SimplePixelShader> fallback);
+	~PixelShaderVariants();
+
+	std::shared_ptr<SimplePixelShader> GetVariant(ShaderVariantKey key);
+
+	//Stats
+	unsigned int GetVariantCount(); // Distinct keys asked for so far
+	unsigned int GetCompiledCount(); // Built from source this run
+	unsigned int GetLoadedCount(); // Already on disk from an earlier run
+	unsigned int GetFallbackCount();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	std::wstring sourceFile;
+	std::wstring outputFolder;
+	std::string shaderName; // Source file name without folder or extension
+	std::shared_ptr<SimplePixelShader> fallback;
+	std::unordered_map<ShaderVariantKey, std::shared_ptr<SimplePixelShader>> variants;
+
+	unsigned int compiledCount;
+	unsigned int loadedCount;
+	unsigned int fallbackCount;
+
+	std::shared_ptr<SimplePixelShader> BuildVariant(ShaderVariantKey key);
+};
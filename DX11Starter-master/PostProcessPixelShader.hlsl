@@ -1,4 +1,4 @@
-cbuffer externalData : register(b0)
+cbuffer externalData : register(b0) // C++: PostProcessConstants
 {
     int blurRadius;
     float pixelWidth;
@@ -0,0 +1,360 @@
+#include "RenderGraph.h"
+
+RenderGraph::RenderGraph(IRenderGraphBackend* backend)
+{
+	this->backend = backend;
+	compiled = false;
+	culledPassCount = 0;
+	transientTextureCount = 0;
+	texturesCreated = 0;
+	texturesReleased = 0;
+}
+
+RenderGraph::~RenderGraph()
+{
+	for (PooledTexture& pooled : pool)
+		backend->ReleaseTexture(pooled.Texture);
+}
+
+void RenderGraph::Reset()
+{
+	passes.clear();
+	resources.clear();
+	errors.clear();
+	compiled = false;
+}
+
+RenderGraphResource RenderGraph::CreateTexture(const std::string& name, const RenderGraphTextureDesc& desc)
+{
+	Resource resource = {};
+	resource.Name = name;
+	resource.Desc = desc;
+	resource.Physical = -1;
+	resources.push_back(resource);
+	return (RenderGraphResource)resources.size() - 1;
+}
+
+RenderGraphResource RenderGraph::ImportTexture(const std::string& name, void* texture)
+{
+	Resource resource = {};
+	resource.Name = name;
+	resource.Texture = texture;
+	resource.Imported = true;
+	resource.Physical = -1;
+	resources.push_back(resource);
+	return (RenderGraphResource)resources.size() - 1;
+}
+
+RenderGraphPass RenderGraph::AddPass(const std::string& name, std::function<void(RenderGraph&)> execute)
+{
+	Pass pass = {};
+	pass.Name = name;
+	pass.Execute = execute;
+	passes.push_back(pass);
+	return (RenderGraphPass)passes.size() - 1;
+}
+
+void RenderGraph::Read(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access)
+{
+	Access a = { resource, access, false };
+	passes[pass].Accesses.push_back(a);
+}
+
+void RenderGraph::Write(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access)
+{
+	Access a = { resource, access, true };
+	passes[pass].Accesses.push_back(a);
+}
+
+void RenderGraph::SetSideEffects(RenderGraphPass pass)
+{
+	passes[pass].SideEffects = true;
+}
+
+// --------------------------------------------------------
+// Culls, places barriers, then hands out pooled textures.
+// Problems (like reading a texture nothing wrote) are noted
+// in GetErrors() rather than stopping the frame.
+// --------------------------------------------------------
+void RenderGraph::Compile()
+{
+	CullPasses();
+	BuildBarriers();
+	AllocateTextures();
+
+	//Barriers only know their textures once everything's allocated
+	for (Pass& pass : passes)
+	{
+		for (RenderGraphBarrier& barrier : pass.Barriers)
+			barrier.Texture = GetTexture(barrier.Resource);
+	}
+	compiled = true;
+}
+
+void RenderGraph::Execute()
+{
+	if (!compiled)
+		Compile();
+
+	for (Pass& pass : passes)
+	{
+		if (pass.Culled)
+			continue;
+
+		if (!pass.Barriers.empty())
+			backend->Barriers(&pass.Barriers[0], (unsigned int)pass.Barriers.size());
+		if (pass.Execute)
+			pass.Execute(*this);
+	}
+}
+
+void* RenderGraph::GetTexture(RenderGraphResource resource)
+{
+	const Resource& r = resources[resource];
+	if (r.Imported)
+		return r.Texture;
+	return r.Physical >= 0 ? pool[r.Physical].Texture : 0;
+}
+
+// --------------------------------------------------------
+// Walks back from the last pass, keeping passes whose output
+// is still needed. A write doesn't end the need for what was
+// there before, as a pass may draw over an earlier one's
+// results rather than replace them.
+// --------------------------------------------------------
+void RenderGraph::CullPasses()
+{
+	std::vector<bool> needed(resources.size(), false);
+	culledPassCount = 0;
+
+	for (int p = (int)passes.size() - 1; p >= 0; p--)
+	{
+		Pass& pass = passes[p];
+		bool keep = pass.SideEffects;
+		for (const Access& a : pass.Accesses)
+		{
+			if (a.Write && (resources[a.Resource].Imported || needed[a.Resource]))
+				keep = true;
+		}
+
+		pass.Culled = !keep;
+		if (!keep)
+		{
+			culledPassCount++;
+			continue;
+		}
+
+		//Whatever this pass reads has to be there, and what it
+		//writes is drawn on top of what's already there
+		for (const Access& a : pass.Accesses)
+			needed[a.Resource] = true;
+	}
+}
+
+// --------------------------------------------------------
+// Follows each resource's state through the kept passes,
+// recording a barrier whenever it changes, and notes when
+// graph owned textures are first and last used
+// --------------------------------------------------------
+void RenderGraph::BuildBarriers()
+{
+	std::vector<RenderGraphAccess> states(resources.size(), RenderGraphAccess::None);
+	for (Resource& r : resources)
+	{
+		r.Usage = 0;
+		r.FirstPass = -1;
+		r.LastPass = -1;
+	}
+
+	for (unsigned int p = 0; p < passes.size(); p++)
+	{
+		Pass& pass = passes[p];
+		pass.Barriers.clear();
+		if (pass.Culled)
+			continue;
+
+		for (unsigned int i = 0; i < pass.Accesses.size(); i++)
+		{
+			const Access& a = pass.Accesses[i];
+			Resource& r = resources[a.Resource];
+
+			//D3D11 can't bind one texture as two things at once
+			bool conflict = false;
+			for (unsigned int j = 0; j < i; j++)
+			{
+				if (pass.Accesses[j].Resource == a.Resource && pass.Accesses[j].Type != a.Type)
+					conflict = true;
+			}
+			if (conflict)
+			{
+				errors.push_back(pass.Name + " uses " + r.Name + " two different ways");
+				continue;
+			}
+
+			if (!r.Imported && states[a.Resource] == RenderGraphAccess::None && !a.Write)
+				errors.push_back(pass.Name + " reads " + r.Name + " before anything writes it");
+
+			if (states[a.Resource] != a.Type)
+			{
+				RenderGraphBarrier barrier = { a.Resource, 0, states[a.Resource], a.Type };
+				pass.Barriers.push_back(barrier);
+				states[a.Resource] = a.Type;
+			}
+
+			r.Usage |= 1u << (unsigned int)a.Type;
+			if (r.FirstPass < 0)
+				r.FirstPass = (int)p;
+			r.LastPass = (int)p;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Greedy by first use: each texture takes any pooled one
+// with the same desc and usage that's free by then. With
+// lifetimes as intervals that's as few as possible per desc.
+// Pooled textures nothing took are released.
+// --------------------------------------------------------
+void RenderGraph::AllocateTextures()
+{
+	for (PooledTexture& pooled : pool)
+	{
+		pooled.Used = false;
+		pooled.LastPass = -1;
+	}
+
+	//Passes are in order, so first uses come in pass order
+	std::vector<unsigned int> order;
+	for (unsigned int p = 0; p < passes.size(); p++)
+	{
+		for (unsigned int r = 0; r < resources.size(); r++)
+		{
+			if (!resources[r].Imported && resources[r].FirstPass == (int)p)
+				order.push_back(r);
+		}
+	}
+
+	transientTextureCount = (unsigned int)order.size();
+	for (Resource& r : resources)
+		r.Physical = -1;
+
+	for (unsigned int r : order)
+	{
+		Resource& resource = resources[r];
+		int found = -1;
+		for (unsigned int i = 0; i < pool.size() && found < 0; i++)
+		{
+			PooledTexture& pooled = pool[i];
+			if (pooled.Usage == resource.Usage && SameDesc(pooled.Desc, resource.Desc) &&
+				(!pooled.Used || pooled.LastPass < resource.FirstPass))
+				found = (int)i;
+		}
+
+		if (found < 0)
+		{
+			PooledTexture pooled = {};
+			pooled.Desc = resource.Desc;
+			pooled.Usage = resource.Usage;
+			pooled.Texture = backend->CreateTexture(resource.Desc, resource.Usage);
+			pool.push_back(pooled);
+			texturesCreated++;
+			found = (int)pool.size() - 1;
+		}
+
+		pool[found].Used = true;
+		pool[found].LastPass = resource.LastPass;
+		resource.Physical = found;
+	}
+
+	//Drop what this frame didn't use, keeping indices in step
+	std::vector<int> remap(pool.size(), -1);
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < pool.size(); i++)
+	{
+		if (!pool[i].Used)
+		{
+			backend->ReleaseTexture(pool[i].Texture);
+			texturesReleased++;
+			continue;
+		}
+		remap[i] = (int)kept;
+		pool[kept++] = pool[i];
+	}
+	pool.resize(kept);
+
+	for (Resource& r : resources)
+	{
+		if (r.Physical >= 0)
+			r.Physical = remap[r.Physical];
+	}
+}
+
+bool RenderGraph::SameDesc(const RenderGraphTextureDesc& a, const RenderGraphTextureDesc& b)
+{
+	return a.Width == b.Width && a.Height == b.Height && a.Format == b.Format;
+}
+
+unsigned int RenderGraph::GetPassCount()
+{
+	return (unsigned int)passes.size();
+}
+
+const std::string& RenderGraph::GetPassName(RenderGraphPass pass)
+{
+	return passes[pass].Name;
+}
+
+bool RenderGraph::GetPassCulled(RenderGraphPass pass)
+{
+	return passes[pass].Culled;
+}
+
+const std::vector<RenderGraphBarrier>& RenderGraph::GetPassBarriers(RenderGraphPass pass)
+{
+	return passes[pass].Barriers;
+}
+
+unsigned int RenderGraph::GetResourceCount()
+{
+	return (unsigned int)resources.size();
+}
+
+const std::string& RenderGraph::GetResourceName(RenderGraphResource resource)
+{
+	return resources[resource].Name;
+}
+
+int RenderGraph::GetPhysicalIndex(RenderGraphResource resource)
+{
+	return resources[resource].Physical;
+}
+
+const std::vector<std::string>& RenderGraph::GetErrors()
+{
+	return errors;
+}
+
+unsigned int RenderGraph::GetCulledPassCount()
+{
+	return culledPassCount;
+}
+
+unsigned int RenderGraph::GetTransientTextureCount()
+{
+	return transientTextureCount;
+}
+
+unsigned int RenderGraph::GetPhysicalTextureCount()
+{
+	return (unsigned int)pool.size();
+}
+
+unsigned int RenderGraph::GetTexturesCreated()
+{
+	return texturesCreated;
+}
+
+unsigned int RenderGraph::GetTexturesReleased()
+{
+	return texturesReleased;
+}
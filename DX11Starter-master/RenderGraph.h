@@ -0,0 +1,178 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// How a pass uses a texture. Also the state a texture is
+// left in, so a change between passes is a barrier.
+// --------------------------------------------------------
+enum class RenderGraphAccess : unsigned char
+{
+	None,           // Not touched yet this frame
+	ShaderResource, // Read by a shader
+	RenderTarget,   // Written as a color target
+	DepthWrite      // Written (and tested) as depth
+};
+
+// Usage bits, one per access a texture sees over the frame
+#define RENDER_GRAPH_USAGE_SHADER_RESOURCE (1u << (unsigned int)RenderGraphAccess::ShaderResource)
+#define RENDER_GRAPH_USAGE_RENDER_TARGET (1u << (unsigned int)RenderGraphAccess::RenderTarget)
+#define RENDER_GRAPH_USAGE_DEPTH (1u << (unsigned int)RenderGraphAccess::DepthWrite)
+
+// Graph owned textures are described without Direct3D, like
+// PipelineDesc. How they're bound comes from the passes.
+struct RenderGraphTextureDesc
+{
+	unsigned int Width = 0;
+	unsigned int Height = 0;
+	unsigned int Format = 0; // DXGI_FORMAT value, typeless if depth is also read
+};
+
+typedef unsigned int RenderGraphResource;
+typedef unsigned int RenderGraphPass;
+
+// A state change ahead of a pass, with the texture it's for
+struct RenderGraphBarrier
+{
+	RenderGraphResource Resource;
+	void* Texture;
+	RenderGraphAccess Before;
+	RenderGraphAccess After;
+};
+
+// --------------------------------------------------------
+// Makes the API objects behind graph owned textures, and
+// turns barriers into whatever the API needs
+// --------------------------------------------------------
+class IRenderGraphBackend
+{
+public:
+	virtual ~IRenderGraphBackend() {}
+	virtual void* CreateTexture(const RenderGraphTextureDesc& desc, unsigned int usage) = 0;
+	virtual void ReleaseTexture(void* texture) = 0;
+	virtual void Barriers(const RenderGraphBarrier* barriers, unsigned int count) = 0;
+};
+
+// --------------------------------------------------------
+// A frame described as passes and the textures they read
+// and write, rebuilt every frame
+//
+// Compile():
+// - Culls passes nothing needs. A pass is kept if it writes
+//   an imported texture (those outlive the frame), has side
+//   effects, or writes something a kept later pass reads.
+// - Works out the barriers between passes, in declaration
+//   order (passes are never reordered)
+// - Gives each graph owned texture a pooled one. Textures
+//   with the same desc and usage whose lifetimes don't
+//   overlap share one.
+// - Keeps pooled textures that still match from the last
+//   compile, so a resize only remakes what changed size
+//
+// Graph owned textures start out undefined (they may have
+// just been used for something else), so the first pass to
+// write one has to clear or fully cover it.
+//
+// Usage per frame:
+//  Reset() -> CreateTexture()/ImportTexture() -> AddPass()
+//  -> Read()/Write() ... -> Compile() -> Execute()
+// --------------------------------------------------------
+class RenderGraph
+{
+public:
+	RenderGraph(IRenderGraphBackend* backend);
+	~RenderGraph();
+
+	// Forgets the passes and resources, keeping pooled textures
+	void Reset();
+
+	RenderGraphResource CreateTexture(const std::string& name, const RenderGraphTextureDesc& desc);
+	RenderGraphResource ImportTexture(const std::string& name, void* texture);
+
+	RenderGraphPass AddPass(const std::string& name, std::function<void(RenderGraph&)> execute);
+	void Read(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access = RenderGraphAccess::ShaderResource);
+	void Write(RenderGraphPass pass, RenderGraphResource resource, RenderGraphAccess access = RenderGraphAccess::RenderTarget);
+	void SetSideEffects(RenderGraphPass pass); // Never culled
+
+	void Compile();
+	void Execute(); // Runs kept passes in order, each after its barriers
+
+	// The backend's texture, or the imported pointer. Valid
+	// from Compile() until the next Reset().
+	void* GetTexture(RenderGraphResource resource);
+
+	//Getters
+	unsigned int GetPassCount();
+	const std::string& GetPassName(RenderGraphPass pass);
+	bool GetPassCulled(RenderGraphPass pass);
+	const std::vector<RenderGraphBarrier>& GetPassBarriers(RenderGraphPass pass);
+	unsigned int GetResourceCount();
+	const std::string& GetResourceName(RenderGraphResource resource);
+	int GetPhysicalIndex(RenderGraphResource resource); // Pooled texture used, -1 if imported or unused
+	const std::vector<std::string>& GetErrors(); // From the last Compile()
+
+	//Stats
+	unsigned int GetCulledPassCount();
+	unsigned int GetTransientTextureCount(); // Graph owned textures used this frame
+	unsigned int GetPhysicalTextureCount(); // Pooled textures backing them
+	unsigned int GetTexturesCreated(); // Since the graph was made
+	unsigned int GetTexturesReleased();
+
+private:
+	struct Access
+	{
+		RenderGraphResource Resource;
+		RenderGraphAccess Type;
+		bool Write;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		std::function<void(RenderGraph&)> Execute;
+		std::vector<Access> Accesses;
+		std::vector<RenderGraphBarrier> Barriers;
+		bool SideEffects;
+		bool Culled;
+	};
+
+	struct Resource
+	{
+		std::string Name;
+		RenderGraphTextureDesc Desc;
+		void* Texture;
+		bool Imported;
+		unsigned int Usage;
+		int FirstPass; // Kept passes only, -1 if none use it
+		int LastPass;
+		int Physical;
+	};
+
+	struct PooledTexture
+	{
+		RenderGraphTextureDesc Desc;
+		unsigned int Usage;
+		void* Texture;
+		int LastPass; // Lifetime end of whatever has it during Compile()
+		bool Used;
+	};
+
+	IRenderGraphBackend* backend;
+	std::vector<Pass> passes;
+	std::vector<Resource> resources;
+	std::vector<PooledTexture> pool;
+	std::vector<std::string> errors;
+	bool compiled;
+
+	unsigned int culledPassCount;
+	unsigned int transientTextureCount;
+	unsigned int texturesCreated;
+	unsigned int texturesReleased;
+
+	void CullPasses();
+	void BuildBarriers();
+	void AllocateTextures();
+	static bool SameDesc(const RenderGraphTextureDesc& a, const RenderGraphTextureDesc& b);
+};
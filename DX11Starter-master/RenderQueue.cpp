@@ -0,0 +1,206 @@
+#include "RenderQueue.h"
+#include <chrono>
+#include <cstring>
+
+// Field widths of the sort key
+#define KEY_PASS_BITS 2
+#define KEY_LAYER_BITS 4
+#define KEY_ID_BITS 12
+#define KEY_DEPTH_BITS 22
+
+#define KEY_ID_MASK ((1ull << KEY_ID_BITS) - 1)
+#define KEY_DEPTH_MASK ((1ull << KEY_DEPTH_BITS) - 1)
+
+static_assert(RENDER_QUEUE_MAX_RESOURCE_IDS == 1 << KEY_ID_BITS, "Resource id limit must match the key's id bits");
+
+RenderQueue::RenderQueue()
+{
+	stateChangesUnsorted = 0;
+	stateChangesSorted = 0;
+	resourceIdOverflows = 0;
+	sortSeconds = 0.0;
+}
+
+RenderQueue::~RenderQueue()
+{
+}
+
+// --------------------------------------------------------
+// Ids start over every frame, so the map only ever holds
+// what's drawn now, not every pointer ever seen (some of
+// which may since have been freed and reused)
+// --------------------------------------------------------
+void RenderQueue::Begin()
+{
+	packets.clear();
+	resourceIds.clear();
+	resourceIdOverflows = 0;
+}
+
+void RenderQueue::Add(unsigned long long key, unsigned int item)
+{
+	DrawPacket packet = {};
+	packet.Key = key;
+	packet.Item = item;
+	packets.push_back(packet);
+}
+
+// --------------------------------------------------------
+// LSD radix sort, one byte per pass
+// - Stable, so equal keys keep submission order
+// - A byte with a single populated bucket is skipped, which
+//   is most of them when only a few ids are in use
+// --------------------------------------------------------
+void RenderQueue::Sort()
+{
+	stateChangesUnsorted = CountStateChanges();
+	auto start = std::chrono::high_resolution_clock::now();
+
+	scratch.resize(packets.size());
+	DrawPacket* source = packets.data();
+	DrawPacket* destination = scratch.data();
+	unsigned int count = (unsigned int)packets.size();
+
+	for (unsigned int shift = 0; shift < 64 && count > 1; shift += 8)
+	{
+		unsigned int histogram[256];
+		memset(histogram, 0, sizeof(histogram));
+		for (unsigned int i = 0; i < count; i++)
+		{
+			histogram[(source[i].Key >> shift) & 0xFF]++;
+		}
+
+		//Everything lands in one bucket, order wouldn't change
+		if (histogram[(source[0].Key >> shift) & 0xFF] == count)
+			continue;
+
+		unsigned int offset = 0;
+		for (unsigned int b = 0; b < 256; b++)
+		{
+			unsigned int bucketCount = histogram[b];
+			histogram[b] = offset;
+			offset += bucketCount;
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			destination[histogram[(source[i].Key >> shift) & 0xFF]++] = source[i];
+		}
+
+		DrawPacket* swap = source;
+		source = destination;
+		destination = swap;
+	}
+
+	//Odd number of passes leaves the result in the scratch buffer
+	if (source != packets.data())
+		packets.swap(scratch);
+
+	sortSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	stateChangesSorted = CountStateChanges();
+}
+
+unsigned long long RenderQueue::MakeKey(unsigned int pass, unsigned int layer,
+	unsigned int shader, unsigned int material, unsigned int mesh, float depth01)
+{
+	if (depth01 < 0.0f) depth01 = 0.0f;
+	if (depth01 > 1.0f) depth01 = 1.0f;
+	unsigned long long depth = (unsigned long long)(depth01 * KEY_DEPTH_MASK);
+
+	unsigned long long key = pass & ((1ull << KEY_PASS_BITS) - 1);
+	key = (key << KEY_LAYER_BITS) | (layer & ((1ull << KEY_LAYER_BITS) - 1));
+
+	unsigned long long state = shader & KEY_ID_MASK;
+	state = (state << KEY_ID_BITS) | (material & KEY_ID_MASK);
+	state = (state << KEY_ID_BITS) | (mesh & KEY_ID_MASK);
+
+	if (pass == RENDER_PASS_TRANSPARENT)
+	{
+		//Farthest first, state only breaks ties
+		key = (key << KEY_DEPTH_BITS) | (KEY_DEPTH_MASK - depth);
+		key = (key << (KEY_ID_BITS * 3)) | state;
+	}
+	else
+	{
+		key = (key << (KEY_ID_BITS * 3)) | state;
+		key = (key << KEY_DEPTH_BITS) | depth;
+	}
+
+	return key;
+}
+
+unsigned int RenderQueue::GetResourceId(const void* resource)
+{
+	auto existing = resourceIds.find(resource);
+	if (existing != resourceIds.end())
+		return existing->second;
+
+	if (resourceIds.size() >= RENDER_QUEUE_MAX_RESOURCE_IDS)
+	{
+		resourceIdOverflows++;
+		return RENDER_QUEUE_MAX_RESOURCE_IDS - 1;
+	}
+
+	unsigned int id = (unsigned int)resourceIds.size();
+	resourceIds[resource] = id;
+	return id;
+}
+
+void RenderQueue::DecodeState(unsigned long long key, unsigned int& shader, unsigned int& material, unsigned int& mesh)
+{
+	unsigned int pass = (unsigned int)(key >> (64 - KEY_PASS_BITS));
+	unsigned long long state = pass == RENDER_PASS_TRANSPARENT ? key : key >> KEY_DEPTH_BITS;
+
+	mesh = (unsigned int)(state & KEY_ID_MASK);
+	material = (unsigned int)((state >> KEY_ID_BITS) & KEY_ID_MASK);
+	shader = (unsigned int)((state >> (KEY_ID_BITS * 2)) & KEY_ID_MASK);
+}
+
+// --------------------------------------------------------
+// Counts shader, material and mesh switches when drawing the
+// packets in their current order
+// --------------------------------------------------------
+unsigned int RenderQueue::CountStateChanges()
+{
+	unsigned int changes = 0;
+	unsigned int lastShader = 0, lastMaterial = 0, lastMesh = 0;
+	for (unsigned int i = 0; i < packets.size(); i++)
+	{
+		unsigned int shader, material, mesh;
+		DecodeState(packets[i].Key, shader, material, mesh);
+
+		if (i == 0 || shader != lastShader) changes++;
+		if (i == 0 || material != lastMaterial) changes++;
+		if (i == 0 || mesh != lastMesh) changes++;
+
+		lastShader = shader;
+		lastMaterial = material;
+		lastMesh = mesh;
+	}
+	return changes;
+}
+
+const std::vector<DrawPacket>& RenderQueue::GetPackets()
+{
+	return packets;
+}
+
+unsigned int RenderQueue::GetStateChangesUnsorted()
+{
+	return stateChangesUnsorted;
+}
+
+unsigned int RenderQueue::GetStateChangesSorted()
+{
+	return stateChangesSorted;
+}
+
+unsigned int RenderQueue::GetResourceIdOverflows()
+{
+	return resourceIdOverflows;
+}
+
+double RenderQueue::GetSortSeconds()
+{
+	return sortSeconds;
+}
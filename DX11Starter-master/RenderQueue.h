@@ -0,0 +1,72 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+// Passes, drawn in this order
+#define RENDER_PASS_OPAQUE 0
+#define RENDER_PASS_TRANSPARENT 1
+
+// Shader, material and mesh ids each get 12 bits of the key
+#define RENDER_QUEUE_MAX_RESOURCE_IDS 4096
+
+// One draw, reduced to what's needed to order it
+struct DrawPacket
+{
+	unsigned long long Key;
+	unsigned int Item; // Caller's index of the thing to draw
+};
+
+// --------------------------------------------------------
+// Orders a frame's draws by a 64-bit sort key
+//
+// Key layout, most significant bits first:
+//  Opaque:      pass(2) layer(4) shader(12) material(12) mesh(12) depth(22)
+//  Transparent: pass(2) layer(4) farness(22) shader(12) material(12) mesh(12)
+//
+// So opaque draws group by state and go front to back within
+// a state (early-Z), and transparent draws go back to front.
+// Keys are sorted with an LSD radix sort, skipping any byte
+// that's the same for every key.
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	void Begin();
+	void Add(unsigned long long key, unsigned int item);
+	void Sort();
+
+	// depth01 - View depth mapped to 0 (near) - 1 (far)
+	static unsigned long long MakeKey(unsigned int pass, unsigned int layer,
+		unsigned int shader, unsigned int material, unsigned int mesh, float depth01);
+
+	// Small id for a shader/material/mesh, assigned on first use and
+	// good until the next Begin(). Past RENDER_QUEUE_MAX_RESOURCE_IDS
+	// in a frame they all share the last id (still drawn, just not
+	// grouped), counted by GetResourceIdOverflows().
+	unsigned int GetResourceId(const void* resource);
+
+	//Getters
+	const std::vector<DrawPacket>& GetPackets();
+	unsigned int GetStateChangesUnsorted();
+	unsigned int GetStateChangesSorted();
+	unsigned int GetResourceIdOverflows(); // This frame
+	double GetSortSeconds();
+
+private:
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> scratch;
+	std::unordered_map<const void*, unsigned int> resourceIds;
+
+	//Stats
+	unsigned int stateChangesUnsorted;
+	unsigned int stateChangesSorted;
+	unsigned int resourceIdOverflows;
+	double sortSeconds;
+
+	static void DecodeState(unsigned long long key, unsigned int& shader, unsigned int& material, unsigned int& mesh);
+	unsigned int CountStateChanges();
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+// --------------------------------------------------------
+// Generated by Tools/CBufferGen from the shaders, don't
+// edit it: change the HLSL and build again instead.
+//
+// C++ copies of every cbuffer and struct marked "C++: Name"
+// in the shaders, laid out by HLSL packing rules. Gaps are
+// filled with Padding members and every offset is checked,
+// so a buffer can be filled in and uploaded in one go.
+// --------------------------------------------------------
+
+#include <DirectXMath.h>
+#include <cstddef>
+
+// ShaderHelper.hlsli, struct Light
+struct Light
+{
+	int Type;
+	DirectX::XMFLOAT3 Direction;
+	float Range;
+	DirectX::XMFLOAT3 Position;
+	float Intensity;
+	DirectX::XMFLOAT3 Color;
+	float SpotFalloff;
+	int ShadowTile; //Point lights: first of 6 cube face atlas tiles, -1 = no shadow
+	DirectX::XMFLOAT2 Padding;
+};
+
+// Lighting.hlsli, cbuffer PerFrame (b0)
+struct PixelFrameConstants
+{
+	DirectX::XMFLOAT3 CameraPos;
+	int CascadeLight; //Index into Lights of the light the cascades are for, -1 = none
+	DirectX::XMFLOAT3 Ambient;
+	unsigned int ClusterSlices;
+	DirectX::XMFLOAT2 ClusterTileScale; //Pixels to cluster tiles
+	float ClusterSliceScale; //Slice = log(view depth) * scale + bias
+	float ClusterSliceBias;
+	DirectX::XMUINT2 ClusterTiles; //Across, down
+	float Padding0[2];
+	DirectX::XMFLOAT4X4 InverseViewProjection; //Deferred only: depth back to world space
+	DirectX::XMFLOAT4X4 ShadowCascades[4]; //SHADOW_CASCADE_COUNT
+	DirectX::XMFLOAT4X4 AtlasMatrices[64]; //MAX_ATLAS_TILES
+	DirectX::XMFLOAT4 AtlasRects[64]; //MAX_ATLAS_TILES, xy = offset, zw = scale (atlas UVs)
+};
+
+// PixelShader.hlsl, CustomPS.hlsl, GBufferPS.hlsl, cbuffer PerMaterial (b1)
+struct MaterialConstants
+{
+	DirectX::XMFLOAT4 ColorTint;
+	DirectX::XMFLOAT2 Scale;
+	DirectX::XMFLOAT2 Offset;
+	float Roughness;
+	float Padding0[3];
+};
+
+// PostProcessPixelShader.hlsl, cbuffer externalData (b0)
+struct PostProcessConstants
+{
+	int BlurRadius;
+	float PixelWidth;
+	float PixelHeight;
+	float Padding0;
+};
+
+// ShadowVertexShader.hlsl, cbuffer PerObject (b0)
+struct ShadowObjectConstants
+{
+	DirectX::XMFLOAT4X4 WorldViewProjection; //World * light view * projection of the cascade being rendered
+};
+
+// SkyVertexShader.hlsl, cbuffer ExternalData (b0)
+struct SkyConstants
+{
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+};
+
+//Layout checks
+static_assert(sizeof(Light) == 64, "Light must match Light in ShaderHelper.hlsli");
+static_assert(offsetof(Light, Type) == 0, "Light must match Light in ShaderHelper.hlsli");
+static_assert(offsetof(Light, Direction) == 4, "Light must match Light in ShaderHelper.hlsli");
+static_assert(offsetof(Light, Range) == 16, "Light must match Light in ShaderHelper.hlsli");
+static_assert(offsetof(Light, Position) == 20, "Light must match Light in ShaderHelper.hlsli");
+static_assert(offsetof(Light, Intensity) == 32, "Light must match Light in ShaderHelper.hlsli");
+static_assert(offsetof(Light, Color) == 36, "Light must match Light in ShaderHelper.hlsli");
+static_assert(offsetof(Light, SpotFalloff) == 48, "Light must match Light in ShaderHelper.hlsli");
+static_assert(offsetof(Light, ShadowTile) == 52, "Light must match Light in ShaderHelper.hlsli");
+static_assert(offsetof(Light, Padding) == 56, "Light must match Light in ShaderHelper.hlsli");
+static_assert(sizeof(PixelFrameConstants) == 5504, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, CameraPos) == 0, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, CascadeLight) == 12, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, Ambient) == 16, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, ClusterSlices) == 28, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, ClusterTileScale) == 32, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, ClusterSliceScale) == 40, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, ClusterSliceBias) == 44, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, ClusterTiles) == 48, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, InverseViewProjection) == 64, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, ShadowCascades) == 128, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, AtlasMatrices) == 384, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(offsetof(PixelFrameConstants, AtlasRects) == 4480, "PixelFrameConstants must match PerFrame in Lighting.hlsli");
+static_assert(sizeof(MaterialConstants) == 48, "MaterialConstants must match PerMaterial in PixelShader.hlsl, CustomPS.hlsl, GBufferPS.hlsl");
+static_assert(offsetof(MaterialConstants, ColorTint) == 0, "MaterialConstants must match PerMaterial in PixelShader.hlsl, CustomPS.hlsl, GBufferPS.hlsl");
+static_assert(offsetof(MaterialConstants, Scale) == 16, "MaterialConstants must match PerMaterial in PixelShader.hlsl, CustomPS.hlsl, GBufferPS.hlsl");
+static_assert(offsetof(MaterialConstants, Offset) == 24, "MaterialConstants must match PerMaterial in PixelShader.hlsl, CustomPS.hlsl, GBufferPS.hlsl");
+static_assert(offsetof(MaterialConstants, Roughness) == 32, "MaterialConstants must match PerMaterial in PixelShader.hlsl, CustomPS.hlsl, GBufferPS.hlsl");
+static_assert(sizeof(PostProcessConstants) == 16, "PostProcessConstants must match externalData in PostProcessPixelShader.hlsl");
+static_assert(offsetof(PostProcessConstants, BlurRadius) == 0, "PostProcessConstants must match externalData in PostProcessPixelShader.hlsl");
+static_assert(offsetof(PostProcessConstants, PixelWidth) == 4, "PostProcessConstants must match externalData in PostProcessPixelShader.hlsl");
+static_assert(offsetof(PostProcessConstants, PixelHeight) == 8, "PostProcessConstants must match externalData in PostProcessPixelShader.hlsl");
+static_assert(sizeof(ShadowObjectConstants) == 64, "ShadowObjectConstants must match PerObject in ShadowVertexShader.hlsl");
+static_assert(offsetof(ShadowObjectConstants, WorldViewProjection) == 0, "ShadowObjectConstants must match PerObject in ShadowVertexShader.hlsl");
+static_assert(sizeof(SkyConstants) == 128, "SkyConstants must match ExternalData in SkyVertexShader.hlsl");
+static_assert(offsetof(SkyConstants, View) == 0, "SkyConstants must match ExternalData in SkyVertexShader.hlsl");
+static_assert(offsetof(SkyConstants, Projection) == 64, "SkyConstants must match ExternalData in SkyVertexShader.hlsl");
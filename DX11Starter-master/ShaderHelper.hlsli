@@ -4,6 +4,8 @@
 #define LIGHT_TYPE_POINT 1
 #define LIGHT_TYPE_SPOT 2
 #define MAX_SPECULAR_EXPONENT 256.0f;
+#define SHADOW_CASCADE_COUNT 4 // Must match ShadowCascades.h
+#define MAX_ATLAS_TILES 64 // Must match ShadowAtlas.h
 
 // CONSTANTS ===================
 
@@ -41,14 +43,13 @@ struct VertexToPixel
 	//  |    |                |
 	//  v    v                v
     float4 screenPosition : SV_POSITION;
-    float4 shadowMapPos : SHADOW_POSITION;
     float2 uv : TEXCOORD; //UVs
     float3 normal : NORMAL;
     float3 tangent : TANGENT;
     float3 worldPosition : POSITION;
 };
 
-struct Light
+struct Light // C++: Light
 {
     int type;
     float3 direction;
@@ -57,7 +58,8 @@ struct Light
     float intensity;
     float3 color;
     float spotFalloff;
-    float3 padding;
+    int shadowTile; //Point lights: first of 6 cube face atlas tiles, -1 = no shadow
+    float2 padding;
 };
 
 float3 palette(float t)
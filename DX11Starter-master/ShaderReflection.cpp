@@ -0,0 +1,535 @@
+#include "ShaderReflection.h"
+
+#include <cstring>
+#include <string>
+
+#define REFLECTION_MAGIC 0x4C464552 // "REFL"
+
+// DXBC chunk tags, as read from the file
+#define FOURCC(a, b, c, d) ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+#define TAG_DXBC FOURCC('D', 'X', 'B', 'C')
+#define TAG_RDEF FOURCC('R', 'D', 'E', 'F')
+#define TAG_ISGN FOURCC('I', 'S', 'G', 'N')
+#define TAG_ISG1 FOURCC('I', 'S', 'G', '1')
+#define TAG_OSGN FOURCC('O', 'S', 'G', 'N')
+#define TAG_OSG5 FOURCC('O', 'S', 'G', '5')
+#define TAG_OSG1 FOURCC('O', 'S', 'G', '1')
+#define TAG_SHDR FOURCC('S', 'H', 'D', 'R')
+#define TAG_SHEX FOURCC('S', 'H', 'E', 'X')
+
+// Shader bytecode opcodes we look for
+#define OPCODE_CUSTOMDATA 53
+#define OPCODE_DCL_THREAD_GROUP 155
+
+namespace
+{
+	// A chunk's data, with every read bounds checked
+	struct Chunk
+	{
+		const unsigned char* Data = 0;
+		unsigned int Size = 0;
+
+		bool ReadU32(unsigned int offset, unsigned int& value) const
+		{
+			if (offset > Size || Size - offset < 4)
+				return false;
+			memcpy(&value, Data + offset, 4);
+			return true;
+		}
+
+		bool ReadU8(unsigned int offset, unsigned int& value) const
+		{
+			if (offset >= Size)
+				return false;
+			value = Data[offset];
+			return true;
+		}
+
+		// Strings must end inside the chunk
+		bool ReadString(unsigned int offset, std::string& value) const
+		{
+			if (offset >= Size)
+				return false;
+			const void* end = memchr(Data + offset, 0, Size - offset);
+			if (end == 0)
+				return false;
+			value.assign((const char*)Data + offset, (const unsigned char*)end - (Data + offset));
+			return true;
+		}
+	};
+
+	// The container's size and chunk table have to add up
+	// before any chunk is looked for, so damage there fails
+	// the parse instead of reading as a missing chunk
+	bool ValidateContainer(const unsigned char* code, size_t size)
+	{
+		unsigned int tag = 0, totalSize = 0, chunkCount = 0;
+		if (size < 32)
+			return false;
+		memcpy(&tag, code, 4);
+		memcpy(&totalSize, code + 24, 4);
+		memcpy(&chunkCount, code + 28, 4);
+		if (tag != TAG_DXBC || totalSize < 32 || totalSize > size || chunkCount > (totalSize - 32) / 4)
+			return false;
+
+		for (unsigned int i = 0; i < chunkCount; i++)
+		{
+			unsigned int offset = 0, chunkSize = 0;
+			memcpy(&offset, code + 32 + i * 4, 4);
+			if (offset < 32 + chunkCount * 4 || offset > totalSize || totalSize - offset < 8)
+				return false;
+			memcpy(&chunkSize, code + offset + 4, 4);
+			if (chunkSize > totalSize - offset - 8)
+				return false;
+		}
+		return true;
+	}
+
+	// Only for containers that passed ValidateContainer()
+	bool FindChunk(const unsigned char* code, unsigned int tag, Chunk& chunk)
+	{
+		unsigned int chunkCount = 0;
+		memcpy(&chunkCount, code + 28, 4);
+		for (unsigned int i = 0; i < chunkCount; i++)
+		{
+			unsigned int offset = 0;
+			unsigned int chunkTag = 0;
+			memcpy(&offset, code + 32 + i * 4, 4);
+			memcpy(&chunkTag, code + offset, 4);
+			if (chunkTag == tag)
+			{
+				chunk.Data = code + offset + 8;
+				memcpy(&chunk.Size, code + offset + 4, 4);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Appends a name to the string table, returning its offset
+	unsigned int AddString(std::vector<char>& strings, const std::string& value)
+	{
+		unsigned int offset = (unsigned int)strings.size();
+		strings.insert(strings.end(), value.begin(), value.end());
+		strings.push_back(0);
+		return offset;
+	}
+
+	// ISGN/OSGN and friends, which only differ in element size
+	bool ParseSignature(const Chunk& chunk, unsigned int tag, std::vector<ReflectedParameter>& parameters, std::vector<char>& strings)
+	{
+		bool hasStream = tag == TAG_OSG5 || tag == TAG_ISG1 || tag == TAG_OSG1;
+		bool hasPrecision = tag == TAG_ISG1 || tag == TAG_OSG1;
+		unsigned int elementSize = 24 + (hasStream ? 4 : 0) + (hasPrecision ? 4 : 0);
+
+		unsigned int count = 0;
+		unsigned int offset = 0;
+		if (!chunk.ReadU32(0, count) || !chunk.ReadU32(4, offset))
+			return false;
+		if (offset > chunk.Size || count > (chunk.Size - offset) / elementSize)
+			return false;
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int element = offset + i * elementSize;
+			ReflectedParameter parameter = {};
+			if (hasStream)
+			{
+				chunk.ReadU32(element, parameter.Stream);
+				element += 4;
+			}
+
+			unsigned int nameOffset = 0;
+			std::string name;
+			chunk.ReadU32(element, nameOffset);
+			chunk.ReadU32(element + 4, parameter.SemanticIndex);
+			chunk.ReadU32(element + 8, parameter.SystemValue);
+			chunk.ReadU32(element + 12, parameter.ComponentType);
+			chunk.ReadU32(element + 16, parameter.Register);
+			chunk.ReadU8(element + 20, parameter.Mask);
+			if (!chunk.ReadString(nameOffset, name))
+				return false;
+
+			parameter.SemanticName = AddString(strings, name);
+			parameters.push_back(parameter);
+		}
+		return true;
+	}
+
+	// Only dcl_thread_group is of interest, and it's one of the
+	// declarations at the top of the program
+	void ParseThreadGroup(const Chunk& chunk, unsigned int threadGroup[3])
+	{
+		unsigned int tokenCount = 0;
+		if (!chunk.ReadU32(4, tokenCount) || tokenCount > chunk.Size / 4)
+			return;
+
+		unsigned int token = 2;
+		while (token < tokenCount)
+		{
+			unsigned int opcodeToken = 0;
+			chunk.ReadU32(token * 4, opcodeToken);
+			unsigned int opcode = opcodeToken & 0x7FF;
+			unsigned int length = (opcodeToken >> 24) & 0x7F;
+			if (opcode == OPCODE_CUSTOMDATA)
+				chunk.ReadU32((token + 1) * 4, length);
+
+			if (opcode == OPCODE_DCL_THREAD_GROUP && length >= 4)
+			{
+				chunk.ReadU32((token + 1) * 4, threadGroup[0]);
+				chunk.ReadU32((token + 2) * 4, threadGroup[1]);
+				chunk.ReadU32((token + 3) * 4, threadGroup[2]);
+				return;
+			}
+
+			if (length == 0 || length > tokenCount - token)
+				return;
+			token += length;
+		}
+	}
+}
+
+ShaderReflection::ShaderReflection()
+{
+}
+
+ShaderReflection::~ShaderReflection()
+{
+}
+
+// --------------------------------------------------------
+// Walks the container's chunks and packs what it finds
+// into the blob. Anything malformed fails the whole parse
+// rather than leaving half a reflection behind.
+// --------------------------------------------------------
+bool ShaderReflection::Parse(const void* shaderCode, size_t shaderSize)
+{
+	const unsigned char* code = (const unsigned char*)shaderCode;
+	if (!ValidateContainer(code, shaderSize))
+		return false;
+
+	Header header = {};
+	header.Magic = REFLECTION_MAGIC;
+	header.Version = SHADER_REFLECTION_VERSION;
+	memcpy(header.Checksum, code + 4, sizeof(header.Checksum));
+
+	std::vector<ReflectedBuffer> buffers;
+	std::vector<ReflectedVariable> variables;
+	std::vector<ReflectedResource> resources;
+	std::vector<ReflectedParameter> inputs;
+	std::vector<ReflectedParameter> outputs;
+	std::vector<char> strings;
+
+	// Resource definitions
+	Chunk rdef;
+	if (FindChunk(code, TAG_RDEF, rdef))
+	{
+		unsigned int bufferCount = 0, bufferOffset = 0;
+		unsigned int bindingCount = 0, bindingOffset = 0;
+		unsigned int target = 0;
+		if (!rdef.ReadU32(0, bufferCount) || !rdef.ReadU32(4, bufferOffset) ||
+			!rdef.ReadU32(8, bindingCount) || !rdef.ReadU32(12, bindingOffset) ||
+			!rdef.ReadU32(16, target))
+			return false;
+
+		// Shader model 5 added fields to variables, and 5.1 to bindings
+		unsigned int major = (target >> 8) & 0xFF;
+		unsigned int minor = target & 0xFF;
+		unsigned int bindingSize = (major > 5 || (major == 5 && minor >= 1)) ? 40 : 32;
+		unsigned int variableSize = major >= 5 ? 40 : 24;
+		header.ProgramType = target >> 16;
+
+		if (bindingOffset > rdef.Size || bindingCount > (rdef.Size - bindingOffset) / bindingSize)
+			return false;
+		if (bufferOffset > rdef.Size || bufferCount > (rdef.Size - bufferOffset) / 24)
+			return false;
+
+		std::vector<std::string> bindingNames(bindingCount);
+		for (unsigned int i = 0; i < bindingCount; i++)
+		{
+			unsigned int binding = bindingOffset + i * bindingSize;
+			unsigned int nameOffset = 0;
+			ReflectedResource resource = {};
+			rdef.ReadU32(binding, nameOffset);
+			rdef.ReadU32(binding + 4, resource.Type);
+			rdef.ReadU32(binding + 20, resource.BindPoint);
+			rdef.ReadU32(binding + 24, resource.BindCount);
+			if (!rdef.ReadString(nameOffset, bindingNames[i]))
+				return false;
+
+			resource.Name = AddString(strings, bindingNames[i]);
+			resources.push_back(resource);
+		}
+
+		for (unsigned int b = 0; b < bufferCount; b++)
+		{
+			unsigned int desc = bufferOffset + b * 24;
+			unsigned int nameOffset = 0, variableCount = 0, variableOffset = 0;
+			std::string name;
+			ReflectedBuffer buffer = {};
+			rdef.ReadU32(desc, nameOffset);
+			rdef.ReadU32(desc + 4, variableCount);
+			rdef.ReadU32(desc + 8, variableOffset);
+			rdef.ReadU32(desc + 12, buffer.Size);
+			rdef.ReadU32(desc + 20, buffer.Type);
+			if (!rdef.ReadString(nameOffset, name))
+				return false;
+			if (variableOffset > rdef.Size || variableCount > (rdef.Size - variableOffset) / variableSize)
+				return false;
+
+			// Bound wherever the first binding of the same name is
+			for (unsigned int i = 0; i < bindingCount; i++)
+			{
+				if (bindingNames[i] == name)
+				{
+					buffer.BindPoint = resources[i].BindPoint;
+					break;
+				}
+			}
+
+			buffer.Name = AddString(strings, name);
+			buffer.FirstVariable = (unsigned int)variables.size();
+			buffer.VariableCount = variableCount;
+			buffers.push_back(buffer);
+
+			for (unsigned int v = 0; v < variableCount; v++)
+			{
+				unsigned int var = variableOffset + v * variableSize;
+				unsigned int varNameOffset = 0;
+				std::string varName;
+				ReflectedVariable variable = {};
+				rdef.ReadU32(var, varNameOffset);
+				rdef.ReadU32(var + 4, variable.StartOffset);
+				rdef.ReadU32(var + 8, variable.Size);
+				if (!rdef.ReadString(varNameOffset, varName))
+					return false;
+
+				variable.Name = AddString(strings, varName);
+				variables.push_back(variable);
+			}
+		}
+	}
+
+	// Signatures
+	Chunk signature;
+	unsigned int inputTags[] = { TAG_ISGN, TAG_ISG1 };
+	unsigned int outputTags[] = { TAG_OSGN, TAG_OSG5, TAG_OSG1 };
+	for (unsigned int signatureTag : inputTags)
+	{
+		if (FindChunk(code, signatureTag, signature))
+		{
+			if (!ParseSignature(signature, signatureTag, inputs, strings))
+				return false;
+			break;
+		}
+	}
+	for (unsigned int signatureTag : outputTags)
+	{
+		if (FindChunk(code, signatureTag, signature))
+		{
+			if (!ParseSignature(signature, signatureTag, outputs, strings))
+				return false;
+			break;
+		}
+	}
+
+	// Compute thread group size
+	Chunk program;
+	if (FindChunk(code, TAG_SHEX, program) || FindChunk(code, TAG_SHDR, program))
+		ParseThreadGroup(program, header.ThreadGroup);
+
+	// Pack it all together
+	header.BufferCount = (unsigned int)buffers.size();
+	header.VariableCount = (unsigned int)variables.size();
+	header.ResourceCount = (unsigned int)resources.size();
+	header.InputCount = (unsigned int)inputs.size();
+	header.OutputCount = (unsigned int)outputs.size();
+	header.StringBytes = (unsigned int)strings.size();
+
+	blob.assign(sizeof(Header), 0);
+	memcpy(blob.data(), &header, sizeof(Header));
+	blob.resize(GetSectionOffset(5) + strings.size());
+	if (!buffers.empty()) memcpy(&blob[GetSectionOffset(0)], buffers.data(), buffers.size() * sizeof(ReflectedBuffer));
+	if (!variables.empty()) memcpy(&blob[GetSectionOffset(1)], variables.data(), variables.size() * sizeof(ReflectedVariable));
+	if (!resources.empty()) memcpy(&blob[GetSectionOffset(2)], resources.data(), resources.size() * sizeof(ReflectedResource));
+	if (!inputs.empty()) memcpy(&blob[GetSectionOffset(3)], inputs.data(), inputs.size() * sizeof(ReflectedParameter));
+	if (!outputs.empty()) memcpy(&blob[GetSectionOffset(4)], outputs.data(), outputs.size() * sizeof(ReflectedParameter));
+	if (!strings.empty()) memcpy(&blob[GetSectionOffset(5)], strings.data(), strings.size());
+	return true;
+}
+
+// --------------------------------------------------------
+// Reads a whole cache file in one go, then checks it's
+// intact and was made from this shader before using it
+// --------------------------------------------------------
+bool ShaderReflection::Read(std::istream& in, const void* shaderCode, size_t shaderSize)
+{
+	if (shaderSize < 20)
+		return false;
+
+	in.seekg(0, std::ios::end);
+	std::streamoff size = in.tellg();
+	in.seekg(0, std::ios::beg);
+	if (size < (std::streamoff)sizeof(Header) || size > 0x7FFFFFFF)
+		return false;
+
+	std::vector<unsigned char> previous;
+	previous.swap(blob);
+	blob.resize((size_t)size);
+	in.read((char*)blob.data(), size);
+
+	if (!in || !Validate() ||
+		memcmp(GetHeader()->Checksum, (const unsigned char*)shaderCode + 4, sizeof(Header::Checksum)) != 0)
+	{
+		blob.swap(previous);
+		return false;
+	}
+	return true;
+}
+
+bool ShaderReflection::Write(std::ostream& out)
+{
+	if (!IsValid())
+		return false;
+
+	out.write((const char*)blob.data(), blob.size());
+	return (bool)out;
+}
+
+void ShaderReflection::Clear()
+{
+	blob.clear();
+}
+
+// --------------------------------------------------------
+// Makes sure a blob that came from disk can be trusted:
+// sizes add up, names are inside the string table and
+// buffers only point at variables that exist
+// --------------------------------------------------------
+bool ShaderReflection::Validate()
+{
+	Header* header = GetHeader();
+	if (header->Magic != REFLECTION_MAGIC || header->Version != SHADER_REFLECTION_VERSION)
+		return false;
+
+	// Counts come from the file, so check them before any sums
+	size_t size = blob.size();
+	if (header->BufferCount > size / sizeof(ReflectedBuffer) || header->VariableCount > size / sizeof(ReflectedVariable) ||
+		header->ResourceCount > size / sizeof(ReflectedResource) || header->InputCount > size / sizeof(ReflectedParameter) ||
+		header->OutputCount > size / sizeof(ReflectedParameter) || header->StringBytes > size)
+		return false;
+	if (GetSectionOffset(5) + header->StringBytes != blob.size())
+		return false;
+	if (header->StringBytes > 0 && blob.back() != 0)
+		return false;
+
+	unsigned int strings = header->StringBytes;
+	for (unsigned int i = 0; i < header->BufferCount; i++)
+	{
+		const ReflectedBuffer& buffer = GetBuffer(i);
+		if (buffer.Name >= strings || buffer.FirstVariable > header->VariableCount ||
+			buffer.VariableCount > header->VariableCount - buffer.FirstVariable)
+			return false;
+	}
+	for (unsigned int i = 0; i < header->VariableCount; i++)
+		if (GetVariable(i).Name >= strings) return false;
+	for (unsigned int i = 0; i < header->ResourceCount; i++)
+		if (GetResource(i).Name >= strings) return false;
+	for (unsigned int i = 0; i < header->InputCount; i++)
+		if (GetInput(i).SemanticName >= strings) return false;
+	for (unsigned int i = 0; i < header->OutputCount; i++)
+		if (GetOutput(i).SemanticName >= strings) return false;
+	return true;
+}
+
+ShaderReflection::Header* ShaderReflection::GetHeader()
+{
+	return (Header*)blob.data();
+}
+
+// Sections in order: buffers, variables, resources, inputs, outputs, strings
+size_t ShaderReflection::GetSectionOffset(unsigned int section)
+{
+	Header* header = GetHeader();
+	size_t offset = sizeof(Header);
+	if (section > 0) offset += header->BufferCount * sizeof(ReflectedBuffer);
+	if (section > 1) offset += header->VariableCount * sizeof(ReflectedVariable);
+	if (section > 2) offset += header->ResourceCount * sizeof(ReflectedResource);
+	if (section > 3) offset += header->InputCount * sizeof(ReflectedParameter);
+	if (section > 4) offset += header->OutputCount * sizeof(ReflectedParameter);
+	return offset;
+}
+
+bool ShaderReflection::IsValid()
+{
+	return blob.size() >= sizeof(Header);
+}
+
+unsigned int ShaderReflection::GetProgramType()
+{
+	return GetHeader()->ProgramType;
+}
+
+unsigned int ShaderReflection::GetBufferCount()
+{
+	return GetHeader()->BufferCount;
+}
+
+unsigned int ShaderReflection::GetVariableCount()
+{
+	return GetHeader()->VariableCount;
+}
+
+unsigned int ShaderReflection::GetResourceCount()
+{
+	return GetHeader()->ResourceCount;
+}
+
+unsigned int ShaderReflection::GetInputCount()
+{
+	return GetHeader()->InputCount;
+}
+
+unsigned int ShaderReflection::GetOutputCount()
+{
+	return GetHeader()->OutputCount;
+}
+
+const ReflectedBuffer& ShaderReflection::GetBuffer(unsigned int index)
+{
+	return ((const ReflectedBuffer*)&blob[GetSectionOffset(0)])[index];
+}
+
+const ReflectedVariable& ShaderReflection::GetVariable(unsigned int index)
+{
+	return ((const ReflectedVariable*)&blob[GetSectionOffset(1)])[index];
+}
+
+const ReflectedResource& ShaderReflection::GetResource(unsigned int index)
+{
+	return ((const ReflectedResource*)&blob[GetSectionOffset(2)])[index];
+}
+
+const ReflectedParameter& ShaderReflection::GetInput(unsigned int index)
+{
+	return ((const ReflectedParameter*)&blob[GetSectionOffset(3)])[index];
+}
+
+const ReflectedParameter& ShaderReflection::GetOutput(unsigned int index)
+{
+	return ((const ReflectedParameter*)&blob[GetSectionOffset(4)])[index];
+}
+
+const char* ShaderReflection::GetString(unsigned int offset)
+{
+	return (const char*)&blob[GetSectionOffset(5) + offset];
+}
+
+unsigned int ShaderReflection::GetThreadGroupSize(unsigned int* x, unsigned int* y, unsigned int* z)
+{
+	Header* header = GetHeader();
+	if (x) *x = header->ThreadGroup[0];
+	if (y) *y = header->ThreadGroup[1];
+	if (z) *z = header->ThreadGroup[2];
+	return header->ThreadGroup[0] * header->ThreadGroup[1] * header->ThreadGroup[2];
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Bump whenever the layout below changes, so old caches are rebuilt
+#define SHADER_REFLECTION_VERSION 1
+
+// --------------------------------------------------------
+// The parts of a compiled shader that SimpleShader needs,
+// read straight out of the .cso (DXBC container) instead of
+// asking D3DReflect for them
+//
+// - Reads the RDEF (buffers, variables, bindings), ISGN/OSGN
+//   (signatures) and SHEX (thread group size) chunks
+// - Everything lives in one flat blob: a header, then arrays
+//   of the structs below, then a string table. Names are
+//   offsets into the string table
+// - The blob can be written next to the .cso and read back
+//   with a single read. It remembers the shader's checksum,
+//   so a cache from an older build of the shader is rejected
+// - Types and enums keep their D3D values, so they can be
+//   cast straight to D3D_SHADER_INPUT_TYPE etc.
+// - Knows nothing about Direct3D
+// --------------------------------------------------------
+
+struct ReflectedBuffer
+{
+	unsigned int Name;
+	unsigned int Type; // D3D_CBUFFER_TYPE
+	unsigned int Size;
+	unsigned int BindPoint;
+	unsigned int FirstVariable;
+	unsigned int VariableCount;
+};
+
+struct ReflectedVariable
+{
+	unsigned int Name;
+	unsigned int StartOffset;
+	unsigned int Size;
+};
+
+struct ReflectedResource
+{
+	unsigned int Name;
+	unsigned int Type; // D3D_SHADER_INPUT_TYPE
+	unsigned int BindPoint;
+	unsigned int BindCount;
+};
+
+struct ReflectedParameter
+{
+	unsigned int SemanticName;
+	unsigned int SemanticIndex;
+	unsigned int SystemValue; // D3D_NAME
+	unsigned int ComponentType; // D3D_REGISTER_COMPONENT_TYPE
+	unsigned int Register;
+	unsigned int Mask;
+	unsigned int Stream;
+};
+
+class ShaderReflection
+{
+public:
+	ShaderReflection();
+	~ShaderReflection();
+
+	// Builds the blob from a compiled shader
+	bool Parse(const void* shaderCode, size_t shaderSize);
+
+	// Cache file support. Read() only accepts a blob made
+	// from exactly this shader, and leaves things alone if not
+	bool Read(std::istream& in, const void* shaderCode, size_t shaderSize);
+	bool Write(std::ostream& out);
+
+	void Clear();
+
+	//Getters
+	bool IsValid();
+	unsigned int GetProgramType(); // 0xFFFF pixel, 0xFFFE vertex, 0x4353 compute, etc.
+	unsigned int GetBufferCount();
+	unsigned int GetVariableCount();
+	unsigned int GetResourceCount();
+	unsigned int GetInputCount();
+	unsigned int GetOutputCount();
+	const ReflectedBuffer& GetBuffer(unsigned int index);
+	const ReflectedVariable& GetVariable(unsigned int index);
+	const ReflectedResource& GetResource(unsigned int index);
+	const ReflectedParameter& GetInput(unsigned int index);
+	const ReflectedParameter& GetOutput(unsigned int index);
+	const char* GetString(unsigned int offset);
+	unsigned int GetThreadGroupSize(unsigned int* x, unsigned int* y, unsigned int* z); // Returns x * y * z
+
+private:
+	struct Header
+	{
+		unsigned int Magic;
+		unsigned int Version;
+		unsigned char Checksum[16]; // From the DXBC container
+		unsigned int ProgramType;
+		unsigned int ThreadGroup[3];
+		unsigned int BufferCount;
+		unsigned int VariableCount;
+		unsigned int ResourceCount;
+		unsigned int InputCount;
+		unsigned int OutputCount;
+		unsigned int StringBytes;
+	};
+
+	std::vector<unsigned char> blob; // Everything, in one allocation
+
+	Header* GetHeader();
+	size_t GetSectionOffset(unsigned int section);
+	bool Validate();
+};
@@ -0,0 +1,275 @@
+#include "ShaderVariableTable.h"
+
+#include <cstring>
+
+// --------------------------------------------------------
+// Empties the table, for reloading a shader
+// --------------------------------------------------------
+void ShaderVariableTable::Clear()
+{
+	buffers.clear();
+	bufferTable.clear();
+	varTable.clear();
+}
+
+// --------------------------------------------------------
+// Sizes the tables up front so filling them doesn't
+// rehash along the way
+// --------------------------------------------------------
+void ShaderVariableTable::Reserve(unsigned int bufferCount, unsigned int variableCount)
+{
+	buffers.reserve(bufferCount);
+	bufferTable.reserve(bufferCount);
+	varTable.reserve(variableCount);
+}
+
+// --------------------------------------------------------
+// Adds a constant buffer with zeroed local data, all of it
+// dirty since nothing's been uploaded yet
+//
+// Returns the buffer's index
+// --------------------------------------------------------
+unsigned int ShaderVariableTable::AddBuffer(const std::string& name, unsigned int size)
+{
+	ShaderLocalBuffer buffer;
+	buffer.Size = size;
+	buffer.Data.assign(size, 0);
+	buffer.DirtyStart = 0;
+	buffer.DirtyEnd = size;
+
+	unsigned int index = (unsigned int)buffers.size();
+	buffers.push_back(buffer);
+	bufferTable.insert(std::make_pair(name, index));
+	return index;
+}
+
+// --------------------------------------------------------
+// Adds a variable to an existing buffer
+// --------------------------------------------------------
+void ShaderVariableTable::AddVariable(const std::string& name, unsigned int bufferIndex, unsigned int byteOffset, unsigned int size)
+{
+	SimpleShaderVariable var = {};
+	var.ByteOffset = byteOffset;
+	var.Size = size;
+	var.ConstantBufferIndex = bufferIndex;
+	varTable.insert(std::make_pair(name, var));
+}
+
+// --------------------------------------------------------
+// Helper for looking up a variable by name and also
+// verifying that it is the requested size
+//
+// name - the name of the variable to look for
+// size - the size of the variable (for verification), or -1 to bypass
+// --------------------------------------------------------
+const SimpleShaderVariable* ShaderVariableTable::FindVariable(const std::string& name, int size) const
+{
+	auto result = varTable.find(name);
+	if (result == varTable.end())
+		return 0;
+
+	const SimpleShaderVariable* var = &(result->second);
+	if (size > 0 && var->Size != (unsigned int)size)
+		return 0;
+
+	return var;
+}
+
+// --------------------------------------------------------
+// Helper for looking up a constant buffer by name
+// --------------------------------------------------------
+bool ShaderVariableTable::FindBuffer(const std::string& name, unsigned int& index) const
+{
+	auto result = bufferTable.find(name);
+	if (result == bufferTable.end())
+		return false;
+
+	index = result->second;
+	return true;
+}
+
+// --------------------------------------------------------
+// Looks a variable up by name once, for the handle setters
+//
+// Returns a handle with a Size of 0 if the variable doesn't exist
+// --------------------------------------------------------
+SimpleShaderHandle ShaderVariableTable::GetVariableHandle(const std::string& name) const
+{
+	SimpleShaderHandle handle;
+	const SimpleShaderVariable* var = FindVariable(name, -1);
+	if (var == 0)
+		return handle;
+
+	handle.ConstantBufferIndex = var->ConstantBufferIndex;
+	handle.ByteOffset = var->ByteOffset;
+	handle.Size = var->Size;
+	return handle;
+}
+
+// --------------------------------------------------------
+// A handle to an entire constant buffer, for filling it from
+// a matching struct in one go
+// --------------------------------------------------------
+SimpleShaderHandle ShaderVariableTable::GetBufferHandle(const std::string& bufferName) const
+{
+	SimpleShaderHandle handle;
+	unsigned int index = 0;
+	if (!FindBuffer(bufferName, index))
+		return handle;
+
+	handle.ConstantBufferIndex = index;
+	handle.ByteOffset = 0;
+	handle.Size = buffers[index].Size;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Sets a variable by name
+//
+// size - The size of the data (this must be less than or equal to the variable's size)
+//
+// Returns true if data is copied, false if the variable
+// doesn't exist or is too small
+// --------------------------------------------------------
+bool ShaderVariableTable::SetData(const std::string& name, const void* data, unsigned int size)
+{
+	const SimpleShaderVariable* var = FindVariable(name, -1);
+	if (var == 0 || size > var->Size)
+		return false;
+
+	WriteLocalData(buffers[var->ConstantBufferIndex], var->ByteOffset, data, size);
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a variable through a handle from GetVariableHandle()
+//
+// The copy is checked against both the variable and its
+// buffer, so a handle from a different shader can't write
+// out of bounds
+// --------------------------------------------------------
+bool ShaderVariableTable::SetData(const SimpleShaderHandle& handle, const void* data, unsigned int size)
+{
+	if (size == 0 || size > handle.Size || handle.ConstantBufferIndex >= buffers.size())
+		return false;
+
+	ShaderLocalBuffer& buffer = buffers[handle.ConstantBufferIndex];
+	if (handle.ByteOffset + size > buffer.Size)
+		return false;
+
+	WriteLocalData(buffer, handle.ByteOffset, data, size);
+	return true;
+}
+
+// --------------------------------------------------------
+// Copies every buffer's local data, back to back in buffer
+// index order, into a caller owned staging array
+// --------------------------------------------------------
+void ShaderVariableTable::CopyLocalData(std::vector<unsigned char>& staging) const
+{
+	staging.clear();
+	for (unsigned int i = 0; i < buffers.size(); i++)
+		staging.insert(staging.end(), buffers[i].Data.begin(), buffers[i].Data.end());
+}
+
+// --------------------------------------------------------
+// CopyLocalData(), but only copies the one buffer. The array
+// still has room for all of them so offsets line up; the
+// rest are left as they were.
+// --------------------------------------------------------
+void ShaderVariableTable::CopyLocalData(std::vector<unsigned char>& staging, unsigned int index) const
+{
+	if (index >= buffers.size()) return;
+
+	unsigned int totalSize = 0;
+	for (unsigned int i = 0; i < buffers.size(); i++)
+		totalSize += buffers[i].Size;
+
+	if (staging.size() != totalSize)
+		staging.resize(totalSize);
+	if (buffers[index].Size > 0)
+		memcpy(&staging[GetStagedOffset(index)], buffers[index].Data.data(), buffers[index].Size);
+}
+
+// --------------------------------------------------------
+// SetData(), but writing into a staging array filled by
+// CopyLocalData() instead of the local data
+//
+// Only reads the table, so any number of threads can call
+// this at once with their own staging arrays
+// --------------------------------------------------------
+bool ShaderVariableTable::SetStagedData(std::vector<unsigned char>& staging, const SimpleShaderHandle& handle, const void* data, unsigned int size) const
+{
+	if (size == 0 || size > handle.Size || handle.ConstantBufferIndex >= buffers.size())
+		return false;
+
+	unsigned int bufferStart = GetStagedOffset(handle.ConstantBufferIndex);
+	if (handle.ByteOffset + size > buffers[handle.ConstantBufferIndex].Size ||
+		bufferStart + handle.ByteOffset + size > staging.size())
+		return false;
+
+	memcpy(&staging[bufferStart + handle.ByteOffset], data, size);
+	return true;
+}
+
+// --------------------------------------------------------
+// Forces the next upload of a buffer, for when the GPU copy
+// was written from somewhere other than the local data
+// --------------------------------------------------------
+void ShaderVariableTable::MarkDirty(unsigned int index)
+{
+	if (index >= buffers.size()) return;
+
+	buffers[index].DirtyStart = 0;
+	buffers[index].DirtyEnd = buffers[index].Size;
+}
+
+// --------------------------------------------------------
+// Called once a buffer's local data has been uploaded
+// --------------------------------------------------------
+void ShaderVariableTable::ClearDirty(unsigned int index)
+{
+	if (index >= buffers.size()) return;
+
+	buffers[index].DirtyStart = 0;
+	buffers[index].DirtyEnd = 0;
+}
+
+bool ShaderVariableTable::IsDirty(unsigned int index) const
+{
+	return index < buffers.size() && buffers[index].DirtyEnd > buffers[index].DirtyStart;
+}
+
+// --------------------------------------------------------
+// Where a buffer starts in a staging array
+// --------------------------------------------------------
+unsigned int ShaderVariableTable::GetStagedOffset(unsigned int index) const
+{
+	unsigned int bufferStart = 0;
+	for (unsigned int i = 0; i < index; i++)
+		bufferStart += buffers[i].Size;
+	return bufferStart;
+}
+
+// --------------------------------------------------------
+// Writes into a buffer's local data, widening its dirty
+// range only if the bytes actually change
+// --------------------------------------------------------
+void ShaderVariableTable::WriteLocalData(ShaderLocalBuffer& buffer, unsigned int offset, const void* data, unsigned int size)
+{
+	unsigned char* destination = buffer.Data.data() + offset;
+	if (memcmp(destination, data, size) == 0)
+		return;
+
+	memcpy(destination, data, size);
+	if (buffer.DirtyEnd <= buffer.DirtyStart)
+	{
+		buffer.DirtyStart = offset;
+		buffer.DirtyEnd = offset + size;
+	}
+	else
+	{
+		if (offset < buffer.DirtyStart) buffer.DirtyStart = offset;
+		if (offset + size > buffer.DirtyEnd) buffer.DirtyEnd = offset + size;
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// --------------------------------------------------------
+// Used by simple shaders to store information about
+// specific variables in constant buffers
+// --------------------------------------------------------
+struct SimpleShaderVariable
+{
+	unsigned int ByteOffset;
+	unsigned int Size;
+	unsigned int ConstantBufferIndex;
+};
+
+// --------------------------------------------------------
+// A shader variable resolved once by GetVariableHandle(), so
+// setting it later skips the name lookup entirely
+// (a Size of 0 means the variable wasn't found)
+// --------------------------------------------------------
+struct SimpleShaderHandle
+{
+	unsigned int ConstantBufferIndex = 0;
+	unsigned int ByteOffset = 0;
+	unsigned int Size = 0;
+};
+
+// --------------------------------------------------------
+// The CPU copy of one constant buffer's data
+// --------------------------------------------------------
+struct ShaderLocalBuffer
+{
+	unsigned int Size = 0;
+	std::vector<unsigned char> Data;
+
+	// Bytes changed since the last upload, [DirtyStart, DirtyEnd)
+	unsigned int DirtyStart = 0;
+	unsigned int DirtyEnd = 0;
+};
+
+// --------------------------------------------------------
+// The variable table and local constant data behind
+// SimpleShader's setters
+//
+// - Variables are found by name or through a handle, and
+//   every write is bounds checked against the variable and
+//   its buffer
+// - Writes that change nothing leave the dirty range alone,
+//   so unchanged buffers can skip their upload
+// - Knows nothing about Direct3D; SimpleShader owns the GPU
+//   buffers and uploads from here
+// --------------------------------------------------------
+class ShaderVariableTable
+{
+public:
+	// Building the table (buffers first, then their variables)
+	void Clear();
+	void Reserve(unsigned int bufferCount, unsigned int variableCount);
+	unsigned int AddBuffer(const std::string& name, unsigned int size);
+	void AddVariable(const std::string& name, unsigned int bufferIndex, unsigned int byteOffset, unsigned int size);
+
+	// Lookups
+	const SimpleShaderVariable* FindVariable(const std::string& name, int size) const;
+	bool FindBuffer(const std::string& name, unsigned int& index) const;
+	SimpleShaderHandle GetVariableHandle(const std::string& name) const;
+	SimpleShaderHandle GetBufferHandle(const std::string& bufferName) const;
+
+	// Setting local data
+	bool SetData(const std::string& name, const void* data, unsigned int size);
+	bool SetData(const SimpleShaderHandle& handle, const void* data, unsigned int size);
+
+	// Staged copies of the local data (see ISimpleShader::CopyLocalData())
+	void CopyLocalData(std::vector<unsigned char>& staging) const;
+	void CopyLocalData(std::vector<unsigned char>& staging, unsigned int index) const;
+	bool SetStagedData(std::vector<unsigned char>& staging, const SimpleShaderHandle& handle, const void* data, unsigned int size) const;
+
+	// Dirty tracking
+	void MarkDirty(unsigned int index);
+	void ClearDirty(unsigned int index);
+	bool IsDirty(unsigned int index) const;
+
+	//Getters
+	unsigned int GetBufferCount() const { return (unsigned int)buffers.size(); }
+	const ShaderLocalBuffer& GetBuffer(unsigned int index) const { return buffers[index]; }
+
+private:
+	std::vector<ShaderLocalBuffer> buffers;
+	std::unordered_map<std::string, unsigned int> bufferTable;
+	std::unordered_map<std::string, SimpleShaderVariable> varTable;
+
+	unsigned int GetStagedOffset(unsigned int index) const;
+	void WriteLocalData(ShaderLocalBuffer& buffer, unsigned int offset, const void* data, unsigned int size);
+};
@@ -0,0 +1,56 @@
+#include "ShaderVariants.h"
+
+ShaderVariantKey MakeShaderVariantKey(unsigned int features)
+{
+	return features & SHADER_FEATURE_MASK;
+}
+
+unsigned int GetVariantFeatures(ShaderVariantKey key)
+{
+	return key & SHADER_FEATURE_MASK;
+}
+
+void GetShaderVariantDefines(ShaderVariantKey key, std::vector<ShaderDefine>& defines)
+{
+	unsigned int features = GetVariantFeatures(key);
+
+	defines.clear();
+	defines.push_back({ "USE_SHADOWS", (features & SHADER_FEATURE_SHADOWS) ? "1" : "0" });
+	defines.push_back({ "USE_NORMAL_MAP", (features & SHADER_FEATURE_NORMAL_MAP) ? "1" : "0" });
+	defines.push_back({ "USE_ALPHA_TEST", (features & SHADER_FEATURE_ALPHA_TEST) ? "1" : "0" });
+}
+
+unsigned long long HashShaderBytes(const void* data, size_t size, unsigned long long hash)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// Names and values are hashed with their terminators, so
+// "AB"="C" and "A"="BC" don't collide
+// --------------------------------------------------------
+unsigned long long HashShaderVariant(unsigned long long sourceHash, const std::vector<ShaderDefine>& defines)
+{
+	unsigned long long hash = sourceHash;
+	for (const ShaderDefine& define : defines)
+	{
+		hash = HashShaderBytes(define.Name.c_str(), define.Name.size() + 1, hash);
+		hash = HashShaderBytes(define.Value.c_str(), define.Value.size() + 1, hash);
+	}
+	return hash;
+}
+
+std::string GetShaderVariantFileName(const std::string& shaderName, unsigned long long variantHash)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string name = shaderName + "_";
+	for (int shift = 60; shift >= 0; shift -= 4)
+		name += digits[(variantHash >> shift) & 0xF];
+	return name + ".cso";
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Feature bits, each one switched on in the shader by a #define
+// of the same name (see PixelShader.hlsl)
+#define SHADER_FEATURE_SHADOWS		0x1 // USE_SHADOWS
+#define SHADER_FEATURE_NORMAL_MAP	0x2 // USE_NORMAL_MAP
+#define SHADER_FEATURE_ALPHA_TEST	0x4 // USE_ALPHA_TEST
+#define SHADER_FEATURE_MASK			0x7
+
+// --------------------------------------------------------
+// Picking and naming compiled shader variants
+//
+// - A variant key is the feature bits, so it can key a map.
+//   Lights aren't part of it: the shader loops over however
+//   many there are (see LightManager.h)
+// - Each key turns into the list of defines to compile with
+// - A variant's hash covers its (preprocessed) source and its
+//   defines, so it names the compiled file on disk and a
+//   change to either gives a new file
+// - Knows nothing about Direct3D
+// --------------------------------------------------------
+
+typedef unsigned int ShaderVariantKey;
+
+struct ShaderDefine
+{
+	std::string Name;
+	std::string Value;
+};
+
+// Unknown feature bits are dropped
+ShaderVariantKey MakeShaderVariantKey(unsigned int features);
+unsigned int GetVariantFeatures(ShaderVariantKey key);
+
+// Every switch the shader knows, set to 0 or 1
+void GetShaderVariantDefines(ShaderVariantKey key, std::vector<ShaderDefine>& defines);
+
+// 64 bit FNV-1a, chainable through the hash parameter
+#define SHADER_HASH_SEED 14695981039346656037ULL
+unsigned long long HashShaderBytes(const void* data, size_t size, unsigned long long hash = SHADER_HASH_SEED);
+unsigned long long HashShaderVariant(unsigned long long sourceHash, const std::vector<ShaderDefine>& defines);
+
+// e.g. "PixelShader_0123456789abcdef.cso"
+std::string GetShaderVariantFileName(const std::string& shaderName, unsigned long long variantHash);
@@ -0,0 +1,316 @@
+#include "ShadowAtlas.h"
+#include <algorithm>
+
+// --------------------------------------------------------
+// Constructor
+//
+// atlasSize   - Width and height of the atlas texture (power of two)
+// minTileSize - Smallest tile handed out (power of two)
+// maxTileSize - Largest tile handed out (power of two)
+// --------------------------------------------------------
+ShadowAtlas::ShadowAtlas(unsigned int atlasSize, unsigned int minTileSize, unsigned int maxTileSize)
+{
+	this->atlasSize = atlasSize;
+	this->minTileSize = std::min(minTileSize, atlasSize);
+	this->maxTileSize = std::min(maxTileSize, atlasSize);
+
+	levelCount = 1;
+	while ((atlasSize >> (levelCount - 1)) > this->minTileSize)
+		levelCount++;
+
+	freeTiles.resize(levelCount);
+	freeTiles[0].insert(std::make_pair(0u, 0u));
+
+	frameIndex = 0;
+	evictAfterFrames = 120;
+	evictionCount = 0;
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+}
+
+void ShadowAtlas::BeginFrame()
+{
+	frameIndex++;
+
+	for (auto it = entries.begin(); it != entries.end();)
+	{
+		if (frameIndex - it->second.LastUsedFrame > evictAfterFrames)
+		{
+			Free(it->second.Tile);
+			it = entries.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Keeps the group's tiles if they're already the size asked
+// for, otherwise tries each size down from desiredSize.
+// A group that can't grow keeps what it has rather than
+// being thrown out and redrawn.
+// --------------------------------------------------------
+bool ShadowAtlas::Request(unsigned long long firstKey, unsigned int count, unsigned int desiredSize, bool evict,
+	ShadowAtlasTile* tiles, bool& isNew)
+{
+	desiredSize = std::max(minTileSize, std::min(maxTileSize, desiredSize));
+
+	//Shrinking always fits in the space it leaves, so just start over
+	unsigned int currentSize = GetGroupSize(firstKey, count);
+	if (currentSize == 0 || currentSize > desiredSize)
+	{
+		Release(firstKey, count);
+		currentSize = 0;
+	}
+
+	//Kept tiles can't be evicted to make room for the same group
+	for (unsigned int i = 0; i < count && currentSize > 0; i++)
+	{
+		entries[firstKey + i].LastUsedFrame = frameIndex;
+	}
+
+	for (unsigned int size = desiredSize; size >= minTileSize && size > currentSize; size /= 2)
+	{
+		if (!AllocateGroup(LevelFromSize(size), count, evict, tiles))
+			continue;
+
+		Release(firstKey, count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			Entry entry = {};
+			entry.Tile = tiles[i];
+			entry.LastUsedFrame = frameIndex;
+			entry.AllocatedFrame = frameIndex;
+			entries[firstKey + i] = entry;
+		}
+		isNew = true;
+		return true;
+	}
+
+	if (currentSize == 0)
+		return false;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		tiles[i] = entries[firstKey + i].Tile;
+	}
+	isNew = entries[firstKey].AllocatedFrame == frameIndex;
+	return true;
+}
+
+void ShadowAtlas::Release(unsigned long long firstKey, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		auto existing = entries.find(firstKey + i);
+		if (existing == entries.end())
+			continue;
+
+		Free(existing->second.Tile);
+		entries.erase(existing);
+	}
+}
+
+unsigned int ShadowAtlas::SizeFromCoverage(float coverage)
+{
+	coverage = std::max(0.0f, std::min(1.0f, coverage));
+
+	//Largest power of two that doesn't go over the ideal size
+	float ideal = coverage * maxTileSize;
+	unsigned int size = maxTileSize;
+	while (size > minTileSize && size > ideal)
+		size /= 2;
+
+	return size;
+}
+
+unsigned int ShadowAtlas::LevelFromSize(unsigned int size)
+{
+	unsigned int level = 0;
+	while ((atlasSize >> level) > size && level + 1 < levelCount)
+		level++;
+
+	return level;
+}
+
+// --------------------------------------------------------
+// Takes a free tile from the given level, splitting a larger
+// one from the level above if there isn't one
+// --------------------------------------------------------
+bool ShadowAtlas::Allocate(unsigned int level, ShadowAtlasTile& tile)
+{
+	if (freeTiles[level].empty())
+	{
+		if (level == 0)
+			return false;
+
+		ShadowAtlasTile parent;
+		if (!Allocate(level - 1, parent))
+			return false;
+
+		//Keep the first child, the other three become free
+		unsigned int half = parent.Size / 2;
+		freeTiles[level].insert(std::make_pair(parent.X + half, parent.Y));
+		freeTiles[level].insert(std::make_pair(parent.X, parent.Y + half));
+		freeTiles[level].insert(std::make_pair(parent.X + half, parent.Y + half));
+
+		tile.X = parent.X;
+		tile.Y = parent.Y;
+		tile.Size = half;
+		return true;
+	}
+
+	//Lowest position first keeps allocations packed toward one corner
+	auto first = freeTiles[level].begin();
+	tile.X = first->first;
+	tile.Y = first->second;
+	tile.Size = atlasSize >> level;
+	freeTiles[level].erase(first);
+	return true;
+}
+
+// --------------------------------------------------------
+// Takes count tiles from one level, or none at all
+// --------------------------------------------------------
+bool ShadowAtlas::AllocateGroup(unsigned int level, unsigned int count, bool evict, ShadowAtlasTile* tiles)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		bool allocated = Allocate(level, tiles[i]);
+		while (!allocated && evict && EvictLeastRecentlyUsed())
+		{
+			allocated = Allocate(level, tiles[i]);
+		}
+
+		if (!allocated)
+		{
+			for (unsigned int j = 0; j < i; j++)
+				Free(tiles[j]);
+			return false;
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Size of the tiles a group holds, 0 unless every key has
+// one and they're all the same size
+// --------------------------------------------------------
+unsigned int ShadowAtlas::GetGroupSize(unsigned long long firstKey, unsigned int count)
+{
+	unsigned int size = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		auto existing = entries.find(firstKey + i);
+		if (existing == entries.end() || (size != 0 && existing->second.Tile.Size != size))
+			return 0;
+		size = existing->second.Tile.Size;
+	}
+	return size;
+}
+
+// --------------------------------------------------------
+// Returns a tile, merging it with its siblings when all four
+// are free again
+// --------------------------------------------------------
+void ShadowAtlas::Free(const ShadowAtlasTile& tile)
+{
+	unsigned int level = LevelFromSize(tile.Size);
+	unsigned int x = tile.X;
+	unsigned int y = tile.Y;
+
+	while (level > 0)
+	{
+		unsigned int size = atlasSize >> level;
+		unsigned int parentX = x - (x % (size * 2));
+		unsigned int parentY = y - (y % (size * 2));
+
+		std::pair<unsigned int, unsigned int> siblings[3];
+		unsigned int siblingCount = 0;
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			std::pair<unsigned int, unsigned int> child(parentX + (i % 2) * size, parentY + (i / 2) * size);
+			if (child.first == x && child.second == y)
+				continue;
+
+			siblings[siblingCount++] = child;
+		}
+
+		bool allFree = true;
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			if (freeTiles[level].count(siblings[i]) == 0)
+				allFree = false;
+		}
+
+		if (!allFree)
+			break;
+
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			freeTiles[level].erase(siblings[i]);
+		}
+
+		x = parentX;
+		y = parentY;
+		level--;
+	}
+
+	freeTiles[level].insert(std::make_pair(x, y));
+}
+
+bool ShadowAtlas::EvictLeastRecentlyUsed()
+{
+	auto oldest = entries.end();
+	for (auto it = entries.begin(); it != entries.end(); ++it)
+	{
+		//Never steal from someone who already got a tile this frame
+		if (it->second.LastUsedFrame == frameIndex)
+			continue;
+
+		if (oldest == entries.end() || it->second.LastUsedFrame < oldest->second.LastUsedFrame)
+			oldest = it;
+	}
+
+	if (oldest == entries.end())
+		return false;
+
+	Free(oldest->second.Tile);
+	entries.erase(oldest);
+	evictionCount++;
+	return true;
+}
+
+unsigned int ShadowAtlas::GetAtlasSize()
+{
+	return atlasSize;
+}
+
+unsigned int ShadowAtlas::GetAllocatedTileCount()
+{
+	return (unsigned int)entries.size();
+}
+
+unsigned int ShadowAtlas::GetAllocatedTexels()
+{
+	unsigned int texels = 0;
+	for (auto& e : entries)
+	{
+		texels += e.second.Tile.Size * e.second.Tile.Size;
+	}
+	return texels;
+}
+
+unsigned int ShadowAtlas::GetEvictionCount()
+{
+	return evictionCount;
+}
+
+void ShadowAtlas::SetEvictAfterFrames(unsigned int frames)
+{
+	evictAfterFrames = frames;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Must match MAX_ATLAS_TILES in ShaderHelper.hlsli
+#define MAX_ATLAS_TILES 64
+
+// A square region of the atlas, in texels
+struct ShadowAtlasTile
+{
+	unsigned int X;
+	unsigned int Y;
+	unsigned int Size;
+};
+
+// --------------------------------------------------------
+// Hands out square, power of two tiles of one big shadow map
+//
+// - Quadtree (buddy) allocator: a tile is split into four
+//   children on demand, and four free siblings merge back
+// - Tiles are requested every frame in groups of consecutive
+//   keys (e.g. the six faces of one light), all or nothing
+//   and all the same size. A group that gets the same size as
+//   last frame keeps its tiles, so their contents can be reused.
+// - A group that doesn't fit is retried at half the size. One
+//   that can't get bigger keeps the tiles it has.
+// - Only tiles nobody has asked for yet this frame can be
+//   evicted, least recently used first, and only when the
+//   caller allows it. Requesting everything without eviction
+//   first, then retrying what failed or came out small with
+//   it, means a tile is never evicted to make room for one
+//   that's wanted less.
+// - Keys not requested for a while are freed automatically
+//
+// Pure CPU bookkeeping, nothing in here touches the GPU
+// --------------------------------------------------------
+class ShadowAtlas
+{
+public:
+	ShadowAtlas(unsigned int atlasSize, unsigned int minTileSize, unsigned int maxTileSize);
+	~ShadowAtlas();
+
+	// Starts a new frame and frees keys that have gone unused too long
+	void BeginFrame();
+
+	// Finds count tiles for keys firstKey onwards, ideally of desiredSize
+	// evict - Whether tiles not yet requested this frame may be thrown out
+	// tiles - count tiles out, all the same size
+	// isNew - Set when the tiles weren't holding these keys' data last
+	//         frame, including when they were handed out earlier this frame
+	// Returns false when they don't fit, even at the minimum size
+	bool Request(unsigned long long firstKey, unsigned int count, unsigned int desiredSize, bool evict,
+		ShadowAtlasTile* tiles, bool& isNew);
+
+	// Gives the tiles of count keys from firstKey back straight away
+	void Release(unsigned long long firstKey, unsigned int count);
+
+	// Picks a power of two tile size from how much of the screen a light covers (0 - 1)
+	unsigned int SizeFromCoverage(float coverage);
+
+	//Getters
+	unsigned int GetAtlasSize();
+	unsigned int GetAllocatedTileCount();
+	unsigned int GetAllocatedTexels();
+	unsigned int GetEvictionCount();
+
+	//Setters
+	void SetEvictAfterFrames(unsigned int frames);
+
+private:
+	struct Entry
+	{
+		ShadowAtlasTile Tile;
+		unsigned int LastUsedFrame;
+		unsigned int AllocatedFrame;
+	};
+
+	unsigned int atlasSize;
+	unsigned int minTileSize;
+	unsigned int maxTileSize;
+	unsigned int levelCount;
+
+	// Free tiles per quadtree level (level 0 is the whole atlas), keyed by position
+	std::vector<std::set<std::pair<unsigned int, unsigned int>>> freeTiles;
+	std::map<unsigned long long, Entry> entries;
+
+	unsigned int frameIndex;
+	unsigned int evictAfterFrames;
+	unsigned int evictionCount;
+
+	unsigned int LevelFromSize(unsigned int size);
+	bool Allocate(unsigned int level, ShadowAtlasTile& tile);
+	bool AllocateGroup(unsigned int level, unsigned int count, bool evict, ShadowAtlasTile* tiles);
+	unsigned int GetGroupSize(unsigned long long firstKey, unsigned int count);
+	void Free(const ShadowAtlasTile& tile);
+	bool EvictLeastRecentlyUsed();
+};
@@ -0,0 +1,232 @@
+#include "ShadowCascades.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// For the DirectX Math library
+using namespace DirectX;
+
+// Radius is rounded up to this so it stays constant while the camera moves
+#define CASCADE_RADIUS_STEP (1.0f / 16.0f)
+
+// Extra depth on both ends so nothing sits right on a clip plane
+#define CASCADE_DEPTH_PADDING 0.5f
+
+// Near plane is pulled back in steps of this (light space units) so
+// casters moving slightly don't change the matrix and invalidate caches
+#define CASCADE_NEAR_STEP 8.0f
+
+ShadowCascades::ShadowCascades(float cascadeResolution)
+{
+	this->cascadeResolution = cascadeResolution;
+	lambda = 0.75f;
+	shadowDistance = 60.0f;
+
+	for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+	{
+		XMStoreFloat4x4(&cascades[i].ViewProjection, XMMatrixIdentity());
+		cascades[i].Radius = 0.0f;
+		cascades[i].TexelSize = 0.0f;
+	}
+
+	for (unsigned int i = 0; i <= SHADOW_CASCADE_COUNT; i++)
+	{
+		splits[i] = 0.0f;
+	}
+}
+
+ShadowCascades::~ShadowCascades()
+{
+}
+
+// --------------------------------------------------------
+// Practical split scheme (Zhang et al.)
+//
+// Logarithmic splits give every cascade the same texel to
+// screen pixel ratio but crowd everything near the camera,
+// linear splits do the opposite. Lambda blends the two.
+// --------------------------------------------------------
+void ShadowCascades::ComputeSplits(float nearPlane, float farPlane, float lambda, float* splits)
+{
+	splits[0] = nearPlane;
+	for (unsigned int i = 1; i < SHADOW_CASCADE_COUNT; i++)
+	{
+		float t = (float)i / SHADOW_CASCADE_COUNT;
+		float logSplit = nearPlane * powf(farPlane / nearPlane, t);
+		float linearSplit = nearPlane + (farPlane - nearPlane) * t;
+		splits[i] = lambda * logSplit + (1.0f - lambda) * linearSplit;
+	}
+	splits[SHADOW_CASCADE_COUNT] = farPlane;
+}
+
+// --------------------------------------------------------
+// Rebuilds every cascade
+//
+// lightDirection   - Direction the light travels (world space)
+// cameraView       - Camera view matrix
+// cameraProjection - Camera projection matrix
+// nearPlane        - Camera near plane distance
+// farPlane         - Camera far plane distance
+// casters          - World bounds of every potential caster
+// --------------------------------------------------------
+void ShadowCascades::Update(const DirectX::XMFLOAT3& lightDirection,
+	const DirectX::XMFLOAT4X4& cameraView, const DirectX::XMFLOAT4X4& cameraProjection,
+	float nearPlane, float farPlane,
+	const std::vector<DirectX::BoundingBox>& casters)
+{
+	//Shadows stop at the shadow distance, but slices are still measured along the full frustum
+	float cameraRange = farPlane - nearPlane;
+	ComputeSplits(nearPlane, std::max(nearPlane + 0.01f, std::min(farPlane, shadowDistance)), lambda, splits);
+
+	//Light view sits at the origin so the texel grid only depends on the direction
+	XMVECTOR direction = XMVector3Normalize(XMLoadFloat3(&lightDirection));
+	XMVECTOR up = fabsf(XMVectorGetY(direction)) > 0.99f ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(0, 1, 0, 0);
+	XMMATRIX lightView = XMMatrixLookToLH(XMVectorZero(), direction, up);
+
+	//Corners of the full camera frustum in world space, near then far.
+	//Any slice is found by sliding along the edges between them, which
+	//works for both perspective and orthographic cameras.
+	XMMATRIX inverseViewProjection = XMMatrixInverse(0,
+		XMMatrixMultiply(XMLoadFloat4x4(&cameraView), XMLoadFloat4x4(&cameraProjection)));
+	const float ndc[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+	XMVECTOR nearCorners[4];
+	XMVECTOR edges[4];
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		nearCorners[c] = XMVector3TransformCoord(XMVectorSet(ndc[c][0], ndc[c][1], 0.0f, 1.0f), inverseViewProjection);
+		XMVECTOR farCorner = XMVector3TransformCoord(XMVectorSet(ndc[c][0], ndc[c][1], 1.0f, 1.0f), inverseViewProjection);
+		edges[c] = farCorner - nearCorners[c];
+	}
+
+	//Light space bounds of every caster, shared by all cascades
+	std::vector<XMFLOAT3> casterMin(casters.size());
+	std::vector<XMFLOAT3> casterMax(casters.size());
+	for (unsigned int i = 0; i < casters.size(); i++)
+	{
+		XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+		casters[i].GetCorners(corners);
+
+		XMVECTOR min = XMVectorReplicate(FLT_MAX);
+		XMVECTOR max = XMVectorReplicate(-FLT_MAX);
+		for (size_t c = 0; c < BoundingBox::CORNER_COUNT; c++)
+		{
+			XMVECTOR p = XMVector3TransformCoord(XMLoadFloat3(&corners[c]), lightView);
+			min = XMVectorMin(min, p);
+			max = XMVectorMax(max, p);
+		}
+		XMStoreFloat3(&casterMin[i], min);
+		XMStoreFloat3(&casterMax[i], max);
+	}
+
+	for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+	{
+		Cascade& cascade = cascades[i];
+
+		//The 8 corners of this slice
+		XMVECTOR sliceCorners[8];
+		XMVECTOR center = XMVectorZero();
+		for (unsigned int c = 0; c < 4; c++)
+		{
+			sliceCorners[c] = nearCorners[c] + edges[c] * ((splits[i] - nearPlane) / cameraRange);
+			sliceCorners[c + 4] = nearCorners[c] + edges[c] * ((splits[i + 1] - nearPlane) / cameraRange);
+		}
+		for (unsigned int c = 0; c < 8; c++)
+		{
+			center += sliceCorners[c];
+		}
+		center = center * (1.0f / 8.0f);
+
+		//Bounding sphere, radius quantized so it doesn't flicker
+		float radius = 0.0f;
+		for (unsigned int c = 0; c < 8; c++)
+		{
+			radius = std::max(radius, XMVectorGetX(XMVector3Length(sliceCorners[c] - center)));
+		}
+		radius = ceilf(radius / CASCADE_RADIUS_STEP) * CASCADE_RADIUS_STEP;
+
+		//Snap the center to whole texels in light space
+		float texelSize = radius * 2.0f / cascadeResolution;
+		XMFLOAT3 lightCenter;
+		XMStoreFloat3(&lightCenter, XMVector3TransformCoord(center, lightView));
+		lightCenter.x = floorf(lightCenter.x / texelSize) * texelSize;
+		lightCenter.y = floorf(lightCenter.y / texelSize) * texelSize;
+
+		float left = lightCenter.x - radius;
+		float right = lightCenter.x + radius;
+		float bottom = lightCenter.y - radius;
+		float top = lightCenter.y + radius;
+		float farZ = lightCenter.z + radius;
+
+		//Keep casters between the light and the cascade, pulling the near plane back to them
+		float nearZ = lightCenter.z - radius;
+		cascade.VisibleCasters.clear();
+		for (unsigned int c = 0; c < casters.size(); c++)
+		{
+			if (casterMax[c].x < left || casterMin[c].x > right ||
+				casterMax[c].y < bottom || casterMin[c].y > top ||
+				casterMin[c].z > farZ)
+				continue;
+
+			nearZ = std::min(nearZ, casterMin[c].z);
+			cascade.VisibleCasters.push_back(c);
+		}
+
+		nearZ = floorf((nearZ - CASCADE_DEPTH_PADDING) / CASCADE_NEAR_STEP) * CASCADE_NEAR_STEP;
+
+		XMMATRIX lightProjection = XMMatrixOrthographicOffCenterLH(left, right, bottom, top,
+			nearZ, farZ + CASCADE_DEPTH_PADDING);
+		XMStoreFloat4x4(&cascade.ViewProjection, XMMatrixMultiply(lightView, lightProjection));
+		cascade.Radius = radius;
+		cascade.TexelSize = texelSize;
+	}
+}
+
+DirectX::XMFLOAT4X4 ShadowCascades::GetViewProjection(unsigned int cascade)
+{
+	return cascades[cascade].ViewProjection;
+}
+
+const std::vector<unsigned int>& ShadowCascades::GetVisibleCasters(unsigned int cascade)
+{
+	return cascades[cascade].VisibleCasters;
+}
+
+float ShadowCascades::GetSplit(unsigned int index)
+{
+	return splits[index];
+}
+
+float ShadowCascades::GetRadius(unsigned int cascade)
+{
+	return cascades[cascade].Radius;
+}
+
+float ShadowCascades::GetTexelSize(unsigned int cascade)
+{
+	return cascades[cascade].TexelSize;
+}
+
+float ShadowCascades::GetLambda()
+{
+	return lambda;
+}
+
+float ShadowCascades::GetShadowDistance()
+{
+	return shadowDistance;
+}
+
+float ShadowCascades::GetCascadeResolution()
+{
+	return cascadeResolution;
+}
+
+void ShadowCascades::SetLambda(float lambda)
+{
+	this->lambda = lambda;
+}
+
+void ShadowCascades::SetShadowDistance(float shadowDistance)
+{
+	this->shadowDistance = shadowDistance;
+}
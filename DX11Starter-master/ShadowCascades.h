@@ -0,0 +1,70 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+
+// Must match SHADOW_CASCADE_COUNT in ShaderHelper.hlsli
+#define SHADOW_CASCADE_COUNT 4
+
+// --------------------------------------------------------
+// CPU side setup for cascaded directional shadows
+//
+// - Splits the camera's depth range with the "practical"
+//   scheme (blend of logarithmic and linear splits)
+// - Fits each cascade with a bounding sphere around its slice
+//   of the camera frustum, so the projection size doesn't
+//   change as the camera rotates
+// - Snaps each cascade to whole shadow map texels so edges
+//   don't shimmer as the camera moves
+// - Culls casters per cascade: only casters overlapping the
+//   cascade in light space and not entirely behind it are kept
+//
+// Nothing in here touches the GPU
+// --------------------------------------------------------
+class ShadowCascades
+{
+public:
+	ShadowCascades(float cascadeResolution);
+	~ShadowCascades();
+
+	// Rebuilds every cascade for the given light and camera
+	void Update(const DirectX::XMFLOAT3& lightDirection,
+		const DirectX::XMFLOAT4X4& cameraView, const DirectX::XMFLOAT4X4& cameraProjection,
+		float nearPlane, float farPlane,
+		const std::vector<DirectX::BoundingBox>& casters);
+
+	// Fills splits[0..SHADOW_CASCADE_COUNT] with view space depths
+	// lambda - 0 is fully linear, 1 is fully logarithmic
+	static void ComputeSplits(float nearPlane, float farPlane, float lambda, float* splits);
+
+	//Getters
+	DirectX::XMFLOAT4X4 GetViewProjection(unsigned int cascade);
+	const std::vector<unsigned int>& GetVisibleCasters(unsigned int cascade);
+	float GetSplit(unsigned int index);
+	float GetRadius(unsigned int cascade);
+	float GetTexelSize(unsigned int cascade);
+	float GetLambda();
+	float GetShadowDistance();
+	float GetCascadeResolution();
+
+	//Setters
+	void SetLambda(float lambda);
+	void SetShadowDistance(float shadowDistance);
+
+private:
+	struct Cascade
+	{
+		DirectX::XMFLOAT4X4 ViewProjection;
+		float Radius;
+		float TexelSize;
+		std::vector<unsigned int> VisibleCasters;
+	};
+
+	Cascade cascades[SHADOW_CASCADE_COUNT];
+	float splits[SHADOW_CASCADE_COUNT + 1];
+
+	float cascadeResolution;
+	float lambda;
+	float shadowDistance;
+};
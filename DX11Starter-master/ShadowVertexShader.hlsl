@@ -1,15 +1,12 @@
 #include "ShaderHelper.hlsli"
 
-//Constant Budder
-cbuffer externalData : register(b0)
+//Constant Buffer, generated into ShaderConstants.h
+cbuffer PerObject : register(b0) // C++: ShadowObjectConstants
 {
-    matrix world;
-    matrix view;
-    matrix projection;
+    matrix worldViewProjection; //World * light view * projection of the cascade being rendered
 };
 
 float4 main( VertexShaderInput input ) : SV_POSITION
 {
-    matrix wvp = mul(projection, mul(view, world));
-    return mul(wvp, float4(input.localPosition, 1.0f));
+    return mul(worldViewProjection, float4(input.localPosition, 1.0f));
 }
\ No newline at end of file
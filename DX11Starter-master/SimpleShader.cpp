@@ -1,9 +1,16 @@
 #include "SimpleShader.h"
 
+#include <fstream>
+
 // Default error reporting state
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
 
+// Upload stats
+unsigned int ISimpleShader::BytesUploaded = 0;
+unsigned int ISimpleShader::BytesChanged = 0;
+unsigned int ISimpleShader::UploadsSkipped = 0;
+
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
 // preferably before loading/using any shaders.
@@ -45,12 +52,7 @@ ISimpleShader::~ISimpleShader()
 // --------------------------------------------------------
 void ISimpleShader::CleanUp()
 {
-	// Handle constant buffers and local data buffers
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		delete[] constantBuffers[i].LocalDataBuffer;
-	}
-
+	// Handle constant buffers
 	if (constantBuffers)
 	{
 		delete[] constantBuffers;
@@ -64,15 +66,14 @@ void ISimpleShader::CleanUp()
 		delete samplerStates[i];
 
 	// Clean up tables
-	varTable.clear();
-	cbTable.clear();
+	variables.Clear();
 	samplerTable.clear();
 	textureTable.clear();
 }
 
 // --------------------------------------------------------
 // Loads the specified shader and builds the variable table 
-// using shader reflection.
+// using shader reflection (see LoadReflection()).
 //
 // shaderFile - A "wide string" specifying the compiled shader to load
 // 
@@ -94,6 +95,20 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	// Reflection has to come first, as creating the shader
+	// may need it (vertex shader input layouts, for instance)
+	if (!LoadReflection(shaderFile))
+	{
+		if (ReportErrors)
+		{
+			LogError("SimpleShader::LoadShaderFile() - Error reading reflection data from file '");
+			LogW(shaderFile);
+			LogError("'. Ensure this file is a compiled shader.\n");
+		}
+
+		return false;
+	}
+
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
 	shaderValid = CreateShader(shaderBlob);
@@ -109,33 +124,22 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
-	// Set up shader reflection to get information about
-	// this shader and its variables,  buffers, etc.
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get the description of the shader
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
+	// Create resource arrays, sizing the tables up front
+	// so filling them doesn't rehash along the way
+	constantBufferCount = reflection.GetBufferCount();
 	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+	variables.Reserve(constantBufferCount, reflection.GetVariableCount());
 	
 	// Handle bound resources (like shaders and samplers)
-	unsigned int resourceCount = shaderDesc.BoundResources;
+	unsigned int resourceCount = reflection.GetResourceCount();
 	for (unsigned int r = 0; r < resourceCount; r++)
 	{
 		// Get this resource's description
-		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
-		refl->GetResourceBindingDesc(r, &resourceDesc);
+		const ReflectedResource& resourceDesc = reflection.GetResource(r);
+		const char* resourceName = reflection.GetString(resourceDesc.Name);
 
 		// Check the type
-		switch (resourceDesc.Type)
+		switch ((D3D_SHADER_INPUT_TYPE)resourceDesc.Type)
 		{
 		case D3D_SIT_STRUCTURED: // Treat structured buffers as texture resources
 		case D3D_SIT_TEXTURE: // A texture resource
@@ -145,7 +149,7 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
 			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
 
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
+			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceName, srv));
 			shaderResourceViews.push_back(srv);
 		}
 			break;
@@ -157,7 +161,7 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
 			samp->Index = (unsigned int)samplerStates.size();	// Raw index
 
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
+			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceName, samp));
 			samplerStates.push_back(samp);
 		}
 			break;
@@ -167,52 +171,40 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	// Loop through all constant buffers
 	for (unsigned int b = 0; b < constantBufferCount; b++)
 	{
-		// Get this buffer
-		ID3D11ShaderReflectionConstantBuffer* cb =
-			refl->GetConstantBufferByIndex(b);
-		
-		// Get the description of this buffer
-		D3D11_SHADER_BUFFER_DESC bufferDesc;
-		cb->GetDesc(&bufferDesc);
+		// Get the description of this buffer, which already
+		// knows where it's bound in the shader
+		const ReflectedBuffer& bufferDesc = reflection.GetBuffer(b);
+		const char* bufferName = reflection.GetString(bufferDesc.Name);
 
 		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-		
-		// Get the description of the resource binding, so
-		// we know exactly how it's bound in the shader
-		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
-		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+		constantBuffers[b].Type = (D3D_CBUFFER_TYPE)bufferDesc.Type;
 		
-		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
-		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
+		// Set up the buffer
+		constantBuffers[b].BindIndex = bufferDesc.BindPoint;
+		constantBuffers[b].Name = bufferName;
 
 		// Create this constant buffer
 		D3D11_BUFFER_DESC newBuffDesc = {};
-		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
+		// - Dynamic, so uploads can Map() with WRITE_DISCARD
+		newBuffDesc.Usage = D3D11_USAGE_DYNAMIC;
 		newBuffDesc.ByteWidth = ((bufferDesc.Size + 15) / 16) * 16; // Quick and dirty 16-byte alignment using integer division
 		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		newBuffDesc.CPUAccessFlags = 0;
+		newBuffDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 		newBuffDesc.MiscFlags = 0;
 		newBuffDesc.StructureByteStride = 0;
 		device->CreateBuffer(&newBuffDesc, 0, constantBuffers[b].ConstantBuffer.GetAddressOf());
 
-		// Set up the data buffer for this constant buffer
+		// Set up the local data for this constant buffer, all of
+		// it dirty since nothing's on the GPU yet
 		constantBuffers[b].Size = bufferDesc.Size;
-		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		variables.AddBuffer(bufferName, bufferDesc.Size);
 
 		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		constantBuffers[b].Variables.reserve(bufferDesc.VariableCount);
+		for (unsigned int v = 0; v < bufferDesc.VariableCount; v++)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
+			// Get the description of this variable
+			const ReflectedVariable& varDesc = reflection.GetVariable(bufferDesc.FirstVariable + v);
 
 			// Create the variable struct
 			SimpleShaderVariable varStruct = {};
@@ -220,11 +212,8 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 			varStruct.ByteOffset = varDesc.StartOffset;
 			varStruct.Size = varDesc.Size;
 			
-			// Get a string version
-			std::string varName(varDesc.Name);
-
 			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			variables.AddVariable(reflection.GetString(varDesc.Name), b, varStruct.ByteOffset, varStruct.Size);
 			constantBuffers[b].Variables.push_back(varStruct);
 		}
 	}
@@ -233,6 +222,43 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	return true;
 }
 
+// --------------------------------------------------------
+// Gets the shader's reflection data without D3DReflect.
+// A cache file sits beside the .cso (same name, .refl) and
+// is used as long as it was made from this exact shader.
+// Otherwise the shader itself is parsed and the cache is
+// written for next time.
+//
+// shaderFile - The compiled shader, already in shaderBlob
+// --------------------------------------------------------
+bool ISimpleShader::LoadReflection(LPCWSTR shaderFile)
+{
+	// Swap the extension (if there is one) for .refl
+	std::wstring cacheFile = shaderFile;
+	size_t dot = cacheFile.find_last_of(L"./\\");
+	if (dot != std::wstring::npos && cacheFile[dot] == L'.')
+		cacheFile.erase(dot);
+	cacheFile += L".refl";
+
+	// Up to date cache?
+	std::ifstream cacheIn(cacheFile, std::ios::binary);
+	if (cacheIn && reflection.Read(cacheIn, shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize()))
+		return true;
+	cacheIn.close();
+
+	// Parse it ourselves
+	reflection.Clear();
+	if (!reflection.Parse(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize()))
+		return false;
+
+	// Failing to save just means parsing again next time
+	std::ofstream cacheOut(cacheFile, std::ios::binary | std::ios::trunc);
+	if (cacheOut)
+		reflection.Write(cacheOut);
+
+	return true;
+}
+
 // --------------------------------------------------------
 // Helper for looking up a variable by name and also
 // verifying that it is the requested size
@@ -240,25 +266,9 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 // name - the name of the variable to look for
 // size - the size of the variable (for verification), or -1 to bypass
 // --------------------------------------------------------
-SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
+const SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
-		varTable.find(name);
-
-	// Did we find the key?
-	if (result == varTable.end())
-		return 0;
-
-	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
-
-	// Is the data size correct ?
-	if (size > 0 && var->Size != size)
-		return 0;
-
-	// Success
-	return var;
+	return variables.FindVariable(name, size);
 }
 
 // --------------------------------------------------------
@@ -266,16 +276,11 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 // --------------------------------------------------------
 SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
 {
-	// Look for the key
-	std::unordered_map<std::string, SimpleConstantBuffer*>::iterator result =
-		cbTable.find(name);
-
-	// Did we find the key?
-	if (result == cbTable.end())
+	unsigned int index = 0;
+	if (!variables.FindBuffer(name, index))
 		return 0;
 
-	// Success
-	return result->second;
+	return &constantBuffers[index];
 }
 
 // --------------------------------------------------------
@@ -345,13 +350,10 @@ void ISimpleShader::CopyAllBufferData()
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy any that changed
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		UploadBuffer(i);
 	}
 }
 
@@ -375,14 +377,8 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if(index >= this->constantBufferCount)
 		return;
 
-	// Check for the buffer
-	SimpleConstantBuffer* cb = &this->constantBuffers[index];
-	if (!cb) return;
-
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(index);
 }
 
 // --------------------------------------------------------
@@ -398,63 +394,301 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!shaderValid) return;
 
 	// Check for the buffer
-	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
-	if (!cb) return;
+	unsigned int index = 0;
+	if (!variables.FindBuffer(bufferName, index)) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	UploadBuffer(index);
 }
 
+// --------------------------------------------------------
+// Forces the next copy of every buffer, for when the GPU
+// copies were written from somewhere other than the local
+// data (e.g. RecordStagedBufferData())
+// --------------------------------------------------------
+void ISimpleShader::MarkAllBuffersDirty()
+{
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+		variables.MarkDirty(i);
+}
 
 // --------------------------------------------------------
-// Sets a variable by name with arbitrary data of the specified size
+// MarkAllBuffersDirty(), for a single buffer
+// --------------------------------------------------------
+void ISimpleShader::MarkBufferDirty(unsigned int index)
+{
+	variables.MarkDirty(index);
+}
+
+// --------------------------------------------------------
+// Marks a buffer as streamed: its data arrives per draw via
+// CommandBuffer::SetConstants, so RecordShader() doesn't
+// bind it and RecordAllBufferData() doesn't upload it
+// --------------------------------------------------------
+void ISimpleShader::SetBufferStreamed(unsigned int index, bool streamed)
+{
+	if (index >= constantBufferCount) return;
+
+	constantBuffers[index].Streamed = streamed;
+}
+
+// --------------------------------------------------------
+// Sends a buffer's local data to the GPU if any of it changed
 //
-// name - The name of the shader variable
-// data - The data to set in the buffer
-// size - The size of the data (this must be less than or equal to the variable's size)
+// - Map() with WRITE_DISCARD hands back fresh memory, so the
+//   whole buffer is written even if only part of it changed
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(unsigned int index)
+{
+	if (!variables.IsDirty(index))
+	{
+		UploadsSkipped++;
+		return;
+	}
+
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	const ShaderLocalBuffer& local = variables.GetBuffer(index);
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(deviceContext->Map(cb->ConstantBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, local.Data.data(), local.Size);
+	deviceContext->Unmap(cb->ConstantBuffer.Get(), 0);
+
+	BytesUploaded += local.Size;
+	BytesChanged += local.DirtyEnd - local.DirtyStart;
+	variables.ClearDirty(index);
+}
+
+
+// --------------------------------------------------------
+// Records the shader and its constant buffers into a
+// command buffer, the recorded version of SetShader()
+// --------------------------------------------------------
+void ISimpleShader::RecordShader(CommandBuffer& commands)
+{
+	// Ensure the shader is valid
+	if (!shaderValid) return;
+
+	ShaderStage stage;
+	if (!GetCommandStage(stage))
+	{
+		if (ReportErrors)
+			LogError("ISimpleShader::RecordShader() - This shader stage can't be recorded into a command buffer.\n");
+		return;
+	}
+
+	RecordShaderAndCBs(commands);
+}
+
+// --------------------------------------------------------
+// Records only the constant buffer bindings (streamed ones
+// excepted), leaving the shader itself to a PipelineState
+// --------------------------------------------------------
+void ISimpleShader::RecordConstantBuffers(CommandBuffer& commands)
+{
+	// Ensure the shader is valid
+	if (!shaderValid) return;
+
+	ShaderStage stage;
+	if (!GetCommandStage(stage))
+		return;
+
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		if (constantBuffers[i].Type != D3D11_CT_CBUFFER || constantBuffers[i].Streamed)
+			continue;
+
+		commands.SetConstantBuffer(stage, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer.Get());
+	}
+}
+
+// --------------------------------------------------------
+// Records copies of all changed local constant data into a
+// command buffer, the recorded version of CopyAllBufferData()
+// 
+// - The data is copied at record time, so the shader's
+//   variables can be changed again straight away
+// - Clears the dirty ranges, so only call it from one thread
+// --------------------------------------------------------
+void ISimpleShader::RecordAllBufferData(CommandBuffer& commands)
+{
+	// Ensure the shader is valid
+	if (!shaderValid) return;
+
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		if (!variables.IsDirty(i) || constantBuffers[i].Streamed)
+			continue;
+
+		variables.ClearDirty(i);
+		commands.UpdateConstants(
+			constantBuffers[i].ConstantBuffer.Get(),
+			variables.GetBuffer(i).Data.data(),
+			constantBuffers[i].Size);
+	}
+}
+
+// --------------------------------------------------------
+// Records a shader resource view binding for this stage
 //
-// Returns true if data is copied, false if variable doesn't exist
+// Returns true if a texture of the given name was found, false otherwise
 // --------------------------------------------------------
-bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
+bool ISimpleShader::RecordShaderResourceView(CommandBuffer& commands, std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
 {
-	// Look for the variable and verify
-	SimpleShaderVariable* var = FindVariable(name, -1);
-	if (var == 0)
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	ShaderStage stage;
+	if (srvInfo == 0 || !GetCommandStage(stage))
 	{
 		if (ReportWarnings)
 		{
-			LogWarning("SimpleShader::SetData() - Shader variable '");
+			LogWarning("ISimpleShader::RecordShaderResourceView() - SRV named '");
 			Log(name);
-			LogWarning("' not found. Ensure the name is spelled correctly and that it exists in a constant buffer in the shader.\n");
+			LogWarning("' was not found in the shader, or the shader can't be recorded.\n");
 		}
 		return false;
 	}
 
-	// Ensure we're not trying to copy more data than the variable can hold
-	// Note: We can copy less data, in the case of a subset of an array
-	if (size > var->Size)
+	commands.SetShaderResource(stage, srvInfo->BindIndex, srv.Get());
+	return true;
+}
+
+// --------------------------------------------------------
+// Records a sampler state binding for this stage
+//
+// Returns true if a sampler of the given name was found, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::RecordSamplerState(CommandBuffer& commands, std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState)
+{
+	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	ShaderStage stage;
+	if (sampInfo == 0 || !GetCommandStage(stage))
 	{
 		if (ReportWarnings)
 		{
-			LogWarning("SimpleShader::SetData() - Shader variable '");
+			LogWarning("ISimpleShader::RecordSamplerState() - Sampler named '");
 			Log(name);
-			LogWarning("' is smaller than the size of the data being set. Ensure the variable is large enough for the specified data.\n");
+			LogWarning("' was not found in the shader, or the shader can't be recorded.\n");
 		}
 		return false;
 	}
 
-	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
-
-	// Success
+	commands.SetSampler(stage, sampInfo->BindIndex, samplerState.Get());
 	return true;
 }
 
+// --------------------------------------------------------
+// Copies every constant buffer's local data, back to back in
+// buffer index order, into a caller owned staging array
+// --------------------------------------------------------
+void ISimpleShader::CopyLocalData(std::vector<unsigned char>& staging)
+{
+	staging.clear();
+	if (!shaderValid) return;
+
+	variables.CopyLocalData(staging);
+}
+
+// --------------------------------------------------------
+// CopyLocalData(), but only copies the one buffer that will
+// be staged and recorded. The array still has room for all
+// of them so offsets line up; the rest are left as they were.
+// --------------------------------------------------------
+void ISimpleShader::CopyLocalData(std::vector<unsigned char>& staging, unsigned int index)
+{
+	if (!shaderValid) return;
+
+	variables.CopyLocalData(staging, index);
+}
+
+// --------------------------------------------------------
+// SetData(), but writing into a staging array filled by
+// CopyLocalData() instead of the shader's own buffers
+//
+// Only reads the shader's tables, so any number of threads
+// can call this at once with their own staging arrays
+// --------------------------------------------------------
+bool ISimpleShader::SetStagedData(std::vector<unsigned char>& staging, std::string name, const void* data, unsigned int size)
+{
+	return variables.SetStagedData(staging, variables.GetVariableHandle(name), data, size);
+}
+
+bool ISimpleShader::SetStagedData(std::vector<unsigned char>& staging, const SimpleShaderHandle& handle, const void* data, unsigned int size)
+{
+	return variables.SetStagedData(staging, handle, data, size);
+}
+
+// --------------------------------------------------------
+// RecordAllBufferData(), but from a staging array
+//
+// Always records every buffer, and leaves the dirty ranges
+// alone so it's safe on several threads. Once recording is
+// done, call MarkAllBuffersDirty() since the GPU copies no
+// longer match the local data.
+// --------------------------------------------------------
+void ISimpleShader::RecordStagedBufferData(CommandBuffer& commands, const std::vector<unsigned char>& staging)
+{
+	if (!shaderValid) return;
+
+	unsigned int bufferStart = 0;
+	for (unsigned int i = 0; i < constantBufferCount; i++)
+	{
+		if (bufferStart + constantBuffers[i].Size > staging.size())
+			return;
+
+		commands.UpdateConstants(
+			constantBuffers[i].ConstantBuffer.Get(),
+			&staging[bufferStart],
+			constantBuffers[i].Size);
+		bufferStart += constantBuffers[i].Size;
+	}
+}
+
+void ISimpleShader::RecordStagedBufferData(CommandBuffer& commands, const std::vector<unsigned char>& staging, unsigned int index)
+{
+	if (!shaderValid || index >= constantBufferCount) return;
+
+	unsigned int bufferStart = 0;
+	for (unsigned int i = 0; i < index; i++)
+		bufferStart += constantBuffers[i].Size;
+
+	if (bufferStart + constantBuffers[index].Size > staging.size())
+		return;
+
+	commands.UpdateConstants(
+		constantBuffers[index].ConstantBuffer.Get(),
+		&staging[bufferStart],
+		constantBuffers[index].Size);
+}
+
+// --------------------------------------------------------
+// Sets a variable by name with arbitrary data of the specified size
+//
+// name - The name of the shader variable
+// data - The data to set in the buffer
+// size - The size of the data (this must be less than or equal to the variable's size)
+//
+// Returns true if data is copied, false if variable doesn't exist
+// --------------------------------------------------------
+bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
+{
+	// Set the data in the local data buffer (the table checks
+	// that the variable exists and can hold this much data)
+	// Note: We can copy less data, in the case of a subset of an array
+	if (variables.SetData(name, data, size))
+		return true;
+
+	if (ReportWarnings)
+	{
+		LogWarning("SimpleShader::SetData() - Shader variable '");
+		Log(name);
+		if (FindVariable(name, -1) == 0)
+			LogWarning("' not found. Ensure the name is spelled correctly and that it exists in a constant buffer in the shader.\n");
+		else
+			LogWarning("' is smaller than the size of the data being set. Ensure the variable is large enough for the specified data.\n");
+	}
+	return false;
+}
+
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
@@ -535,6 +769,85 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Looks a variable up by name once, for the handle setters
+//
+// name - The name of the shader variable
+//
+// Returns a handle with a Size of 0 if the variable doesn't exist
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetVariableHandle(std::string name)
+{
+	SimpleShaderHandle handle = variables.GetVariableHandle(name);
+	if (handle.Size == 0 && ReportWarnings)
+	{
+		LogWarning("SimpleShader::GetVariableHandle() - Shader variable '");
+		Log(name);
+		LogWarning("' not found. Ensure the name is spelled correctly and that it exists in a constant buffer in the shader.\n");
+	}
+	return handle;
+}
+
+// --------------------------------------------------------
+// A handle to an entire constant buffer, for filling it from
+// a matching struct in one go (see BufferStructs.h)
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetBufferHandle(std::string bufferName)
+{
+	SimpleShaderHandle handle = variables.GetBufferHandle(bufferName);
+	if (handle.Size == 0 && ReportWarnings)
+	{
+		LogWarning("SimpleShader::GetBufferHandle() - Constant buffer '");
+		Log(bufferName);
+		LogWarning("' not found. Ensure the name is spelled correctly and that it is used by the shader.\n");
+	}
+	return handle;
+}
+
+// --------------------------------------------------------
+// Sets a variable through a handle from GetVariableHandle()
+//
+// The copy is checked against both the variable and its
+// buffer, so a handle from a different shader can't write
+// out of bounds
+//
+// Returns true if data is copied, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::SetData(const SimpleShaderHandle& handle, const void* data, unsigned int size)
+{
+	return variables.SetData(handle, data, size);
+}
+
+bool ISimpleShader::SetInt(const SimpleShaderHandle& handle, int data)
+{
+	return SetData(handle, &data, sizeof(int));
+}
+
+bool ISimpleShader::SetFloat(const SimpleShaderHandle& handle, float data)
+{
+	return SetData(handle, &data, sizeof(float));
+}
+
+bool ISimpleShader::SetFloat2(const SimpleShaderHandle& handle, const DirectX::XMFLOAT2& data)
+{
+	return SetData(handle, &data, sizeof(float) * 2);
+}
+
+bool ISimpleShader::SetFloat3(const SimpleShaderHandle& handle, const DirectX::XMFLOAT3& data)
+{
+	return SetData(handle, &data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat4(const SimpleShaderHandle& handle, const DirectX::XMFLOAT4& data)
+{
+	return SetData(handle, &data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetMatrix4x4(const SimpleShaderHandle& handle, const DirectX::XMFLOAT4X4& data)
+{
+	return SetData(handle, &data, sizeof(float) * 16);
+}
+
 // --------------------------------------------------------
 // Determines if the shader contains the specified
 // variable within one of its constant buffers
@@ -767,32 +1080,20 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 		return true;
 
 	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
+	// reflection data to create an input layout that 
 	// matches what the vertex shader expects.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
 
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
 	// Read input layout description from shader info
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	for (unsigned int i = 0; i < reflection.GetInputCount(); i++)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
+		const ReflectedParameter& paramDesc = reflection.GetInput(i);
+		const char* semanticName = reflection.GetString(paramDesc.SemanticName);
 
 		// Check the semantic name for "_PER_INSTANCE"
 		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
+		std::string sem = semanticName;
 		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
 		bool isPerInstance = 
 			lenDiff >= 0 &&
@@ -800,7 +1101,7 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc = {};
-		elementDesc.SemanticName = paramDesc.SemanticName;
+		elementDesc.SemanticName = semanticName;
 		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
 		elementDesc.InputSlot = 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
@@ -887,6 +1188,23 @@ void SimpleVertexShader::SetShaderAndCBs()
 	}
 }
 
+bool SimpleVertexShader::GetCommandStage(ShaderStage& stage)
+{
+	stage = ShaderStage::Vertex;
+	return true;
+}
+
+// --------------------------------------------------------
+// Records the vertex shader, input layout and constant
+// buffers, matching SetShaderAndCBs()
+// --------------------------------------------------------
+void SimpleVertexShader::RecordShaderAndCBs(CommandBuffer& commands)
+{
+	commands.SetInputLayout(inputLayout.Get());
+	commands.SetShader(ShaderStage::Vertex, shader.Get());
+	RecordConstantBuffers(commands);
+}
+
 // --------------------------------------------------------
 // Sets a shader resource view in the vertex shader stage
 //
@@ -1029,6 +1347,22 @@ void SimplePixelShader::SetShaderAndCBs()
 	}
 }
 
+bool SimplePixelShader::GetCommandStage(ShaderStage& stage)
+{
+	stage = ShaderStage::Pixel;
+	return true;
+}
+
+// --------------------------------------------------------
+// Records the pixel shader and constant buffers, matching
+// SetShaderAndCBs()
+// --------------------------------------------------------
+void SimplePixelShader::RecordShaderAndCBs(CommandBuffer& commands)
+{
+	commands.SetShader(ShaderStage::Pixel, shader.Get());
+	RecordConstantBuffers(commands);
+}
+
 // --------------------------------------------------------
 // Sets a shader resource view in the pixel shader stage
 //
@@ -1455,31 +1789,18 @@ bool SimpleGeometryShader::CreateShaderWithStreamOut(Microsoft::WRL::ComPtr<ID3D
 	// called more than once on the same object
 	this->CleanUp();
 
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
 	// Set up the output signature
 	streamOutVertexSize = 0;
 	std::vector<D3D11_SO_DECLARATION_ENTRY> soDecl;
-	for (unsigned int i = 0; i < shaderDesc.OutputParameters; i++)
+	for (unsigned int i = 0; i < reflection.GetOutputCount(); i++)
 	{
 		// Get the info about this entry
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetOutputParameterDesc(i, &paramDesc);
+		const ReflectedParameter& paramDesc = reflection.GetOutput(i);
 		
 		// Create the SO Declaration
 		D3D11_SO_DECLARATION_ENTRY entry = {};
 		entry.SemanticIndex  = paramDesc.SemanticIndex;
-		entry.SemanticName   = paramDesc.SemanticName;
+		entry.SemanticName   = reflection.GetString(paramDesc.SemanticName);
 		entry.Stream         = paramDesc.Stream;
 		entry.StartComponent = 0; // Assume starting at 0
 		entry.OutputSlot     = 0; // Assume the first output slot
@@ -1730,34 +2051,21 @@ bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBl
 	if (result != S_OK)
 		return false;
 
-	// Set up shader reflection to get information about UAV's
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-
-	// Get the description of the shader
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-	
 	// Grab the thread info
-	threadsTotal = refl->GetThreadGroupSize(
+	threadsTotal = reflection.GetThreadGroupSize(
 		&threadsX,
 		&threadsY,
 		&threadsZ);
 
 	// Loop and get all UAV resources
-	unsigned int resourceCount = shaderDesc.BoundResources;
+	unsigned int resourceCount = reflection.GetResourceCount();
 	for (unsigned int r = 0; r < resourceCount; r++)
 	{
 		// Get this resource's description
-		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
-		refl->GetResourceBindingDesc(r, &resourceDesc);
+		const ReflectedResource& resourceDesc = reflection.GetResource(r);
 
 		// Check the type, looking for any kind of UAV
-		switch (resourceDesc.Type)
+		switch ((D3D_SHADER_INPUT_TYPE)resourceDesc.Type)
 		{
 		case D3D_SIT_UAV_APPEND_STRUCTURED:
 		case D3D_SIT_UAV_CONSUME_STRUCTURED:
@@ -1765,7 +2073,7 @@ bool SimpleComputeShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBl
 		case D3D_SIT_UAV_RWSTRUCTURED:
 		case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
 		case D3D_SIT_UAV_RWTYPED:
-			uavTable.insert(std::pair<std::string, unsigned int>(resourceDesc.Name, resourceDesc.BindPoint));
+			uavTable.insert(std::pair<std::string, unsigned int>(reflection.GetString(resourceDesc.Name), resourceDesc.BindPoint));
 		}
 	}
 
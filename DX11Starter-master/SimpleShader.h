@@ -7,26 +7,19 @@
 #include <DirectXMath.h>
 #include <wrl/client.h>
 
+#include "CommandBuffer.h"
+#include "ShaderReflection.h"
+#include "ShaderVariableTable.h"
+
 #include <unordered_map>
 #include <vector>
 #include <string>
 
 
-// --------------------------------------------------------
-// Used by simple shaders to store information about
-// specific variables in constant buffers
-// --------------------------------------------------------
-struct SimpleShaderVariable
-{
-	unsigned int ByteOffset;
-	unsigned int Size;
-	unsigned int ConstantBufferIndex;
-};
-
 // --------------------------------------------------------
 // Contains information about a specific
-// constant buffer in a shader, as well as
-// the local data buffer for it
+// constant buffer in a shader (its local data
+// lives in the shader's ShaderVariableTable)
 // --------------------------------------------------------
 struct SimpleConstantBuffer
 {
@@ -35,8 +28,11 @@ struct SimpleConstantBuffer
 	unsigned int Size = 0;
 	unsigned int BindIndex = 0;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
-	unsigned char* LocalDataBuffer = 0;
 	std::vector<SimpleShaderVariable> Variables;
+
+	// Fed per draw with CommandBuffer::SetConstants instead, so
+	// recording leaves this buffer's slot and data alone
+	bool Streamed = false;
 };
 
 // --------------------------------------------------------
@@ -70,10 +66,32 @@ public:
 	bool IsShaderValid() { return shaderValid; }
 
 	// Activating the shader and copying data
+	// (buffers whose local data hasn't changed are skipped)
 	void SetShader();
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
 	void CopyBufferData(std::string bufferName);
+	void MarkAllBuffersDirty();
+	void MarkBufferDirty(unsigned int index);
+	void SetBufferStreamed(unsigned int index, bool streamed);
+
+	// Recording the same work into a command buffer instead
+	// (only vertex and pixel shaders can be recorded)
+	void RecordShader(CommandBuffer& commands);
+	void RecordConstantBuffers(CommandBuffer& commands); // Just the buffers, for when a pipeline sets the shader
+	void RecordAllBufferData(CommandBuffer& commands);
+	bool RecordShaderResourceView(CommandBuffer& commands, std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	bool RecordSamplerState(CommandBuffer& commands, std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+
+	// Staged constants, for recording from several threads at once:
+	// each thread copies the local data, changes its own copy and
+	// records from that, leaving the shader itself untouched
+	void CopyLocalData(std::vector<unsigned char>& staging);
+	void CopyLocalData(std::vector<unsigned char>& staging, unsigned int index); // Only fills in one buffer
+	bool SetStagedData(std::vector<unsigned char>& staging, std::string name, const void* data, unsigned int size);
+	bool SetStagedData(std::vector<unsigned char>& staging, const SimpleShaderHandle& handle, const void* data, unsigned int size);
+	void RecordStagedBufferData(CommandBuffer& commands, const std::vector<unsigned char>& staging);
+	void RecordStagedBufferData(CommandBuffer& commands, const std::vector<unsigned char>& staging, unsigned int index);
 
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
@@ -89,6 +107,18 @@ public:
 	bool SetMatrix4x4(std::string name, const float data[16]);
 	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
 
+	// Same setters through a pre-resolved handle: just a bounds
+	// checked copy, no string building or hashing
+	SimpleShaderHandle GetVariableHandle(std::string name);
+	SimpleShaderHandle GetBufferHandle(std::string bufferName); // Covers a whole constant buffer
+	bool SetData(const SimpleShaderHandle& handle, const void* data, unsigned int size);
+	bool SetInt(const SimpleShaderHandle& handle, int data);
+	bool SetFloat(const SimpleShaderHandle& handle, float data);
+	bool SetFloat2(const SimpleShaderHandle& handle, const DirectX::XMFLOAT2& data);
+	bool SetFloat3(const SimpleShaderHandle& handle, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(const SimpleShaderHandle& handle, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(const SimpleShaderHandle& handle, const DirectX::XMFLOAT4X4& data);
+
 	// Setting shader resources
 	virtual bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
 	virtual bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
@@ -122,10 +152,17 @@ public:
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Constant upload stats across all shaders (direct uploads
+	// only), reset by the caller whenever it likes
+	static unsigned int BytesUploaded;
+	static unsigned int BytesChanged;
+	static unsigned int UploadsSkipped;
+
 protected:
 	
 	bool shaderValid;
 	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+	ShaderReflection reflection; // Names in the tables below are copied out of this
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> deviceContext;
 
@@ -136,24 +173,31 @@ protected:
 	SimpleConstantBuffer*		constantBuffers; // For index-based lookup
 	std::vector<SimpleSRV*>		shaderResourceViews;
 	std::vector<SimpleSampler*>	samplerStates;
-	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
+	ShaderVariableTable variables; // Variable lookup and local data for every buffer
 	std::unordered_map<std::string, SimpleSRV*> textureTable;
 	std::unordered_map<std::string, SimpleSampler*> samplerTable;
 
-	// Initialization method
+	// Initialization methods
 	bool LoadShaderFile(LPCWSTR shaderFile);
+	bool LoadReflection(LPCWSTR shaderFile);
 
 	// Pure virtual functions for dealing with shader types
 	virtual bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob) = 0;
 	virtual void SetShaderAndCBs() = 0;
 
+	// Command buffer support, overridden by stages that can be recorded
+	virtual bool GetCommandStage(ShaderStage& stage) { return false; }
+	virtual void RecordShaderAndCBs(CommandBuffer& commands) {}
+
 	virtual void CleanUp();
 
 	// Helpers for finding data by name
-	SimpleShaderVariable* FindVariable(std::string name, int size);
+	const SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
 
+	// Helper for uploads
+	void UploadBuffer(unsigned int index);
+
 	// Error logging
 	void Log(std::string message, WORD color);
 	void LogW(std::wstring message, WORD color);
@@ -187,6 +231,8 @@ protected:
 	 Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	bool GetCommandStage(ShaderStage& stage);
+	void RecordShaderAndCBs(CommandBuffer& commands);
 	void CleanUp();
 };
 
@@ -208,6 +254,8 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
 	bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob);
 	void SetShaderAndCBs();
+	bool GetCommandStage(ShaderStage& stage);
+	void RecordShaderAndCBs(CommandBuffer& commands);
 	void CleanUp();
 };
 
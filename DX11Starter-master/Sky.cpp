@@ -1,14 +1,17 @@
 #include "Sky.h"
+#include "ShaderConstants.h"
 #include "WICTextureLoader.h"
 
 using namespace DirectX;
 
 Sky::Sky()
 {
+	pipeline = 0;
 }
 
 Sky::Sky(std::shared_ptr<Mesh> mesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler, Microsoft::WRL::ComPtr<ID3D11Device> device,
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<SimpleVertexShader> vs, std::shared_ptr<SimplePixelShader> ps,
+	PipelineCache& pipelines,
 	const wchar_t* right,
 	const wchar_t* left,
 	const wchar_t* up,
@@ -24,44 +27,40 @@ Sky::Sky(std::shared_ptr<Mesh> mesh, Microsoft::WRL::ComPtr<ID3D11SamplerState>
 	this->vs = vs;
 	this->texture = CreateCubemap(right, left, up, down, front, back);
 
-	//Create RasterizerState
-	D3D11_RASTERIZER_DESC rastDesc = {};
-	rastDesc.CullMode = D3D11_CULL_FRONT; //Draw the inside of the mesh
-	rastDesc.FillMode = D3D11_FILL_SOLID;
-	rastDesc.DepthClipEnable = true;
-	device->CreateRasterizerState(&rastDesc, rasterizer.GetAddressOf());
-
-	//Create DepthStencilState
-	D3D11_DEPTH_STENCIL_DESC depthDesc = {};
-	depthDesc.DepthEnable = true;
-	depthDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
-	depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-	device->CreateDepthStencilState(&depthDesc, depthStencil.GetAddressOf());
+	//Create Pipeline
+	PipelineDesc desc;
+	desc.VertexShader = vs->GetDirectXShader().Get();
+	desc.InputLayout = vs->GetInputLayout().Get();
+	desc.PixelShader = ps->GetDirectXShader().Get();
+	desc.Rasterizer.CullMode = D3D11_CULL_FRONT; //Draw the inside of the mesh
+	desc.DepthStencil.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+	pipeline = pipelines.GetPipeline(desc);
 }
 
 Sky::~Sky()
 {
 }
 
-void Sky::Draw(std::shared_ptr<Camera> camera)
+void Sky::Record(CommandBuffer& commands, std::shared_ptr<Camera> camera)
 {
-	context->RSSetState(rasterizer.Get());
-	context->OMSetDepthStencilState(depthStencil.Get(), 0);
+	commands.SetPipeline(pipeline);
 
-	vs->SetMatrix4x4("view", camera->GetViewMatrix());
-	vs->SetMatrix4x4("projection", camera->GetProjectionMatrix());
-	vs->CopyAllBufferData();
+	SkyConstants constants = {};
+	constants.View = camera->GetViewMatrix();
+	constants.Projection = camera->GetProjectionMatrix();
+	vs->SetData(vs->GetBufferHandle("ExternalData"), &constants, sizeof(SkyConstants));
+	vs->RecordAllBufferData(commands);
 
-	ps->SetShaderResourceView("SkyTexture", texture);
-	ps->SetSamplerState("BasicSampler", sampler);
-	ps->CopyAllBufferData();
+	ps->RecordShaderResourceView(commands, "SkyTexture", texture);
+	ps->RecordSamplerState(commands, "BasicSampler", sampler);
+	ps->RecordAllBufferData(commands);
 
-	vs->SetShader();
-	ps->SetShader();
-	mesh->Draw();
+	vs->RecordConstantBuffers(commands);
+	ps->RecordConstantBuffers(commands);
+	mesh->RecordDraw(commands);
 
-	context->RSSetState(0);
-	context->OMSetDepthStencilState(0, 0);
+	commands.SetRasterizerState(0);
+	commands.SetDepthStencilState(0);
 }
 
 // --------------------------------------------------------
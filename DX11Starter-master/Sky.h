@@ -6,6 +6,7 @@
 #include <memory>
 #include "SimpleShader.h"
 #include "Camera.h"
+#include "PipelineState.h"
 
 class Sky
 {
@@ -14,6 +15,7 @@ public:
 	Sky(std::shared_ptr<Mesh> mesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler, 
 		Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 		std::shared_ptr<SimpleVertexShader> vs, std::shared_ptr<SimplePixelShader> ps,
+		PipelineCache& pipelines,
 		const wchar_t* right,
 		const wchar_t* left,
 		const wchar_t* up,
@@ -22,7 +24,7 @@ public:
 		const wchar_t* back);
 	~Sky();
 
-	void Draw(std::shared_ptr<Camera> camera);
+	void Record(CommandBuffer& commands, std::shared_ptr<Camera> camera);
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
 		const wchar_t* right,
 		const wchar_t* left,
@@ -34,8 +36,7 @@ public:
 private:
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture;
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> depthStencil;
-	Microsoft::WRL::ComPtr<ID3D11RasterizerState> rasterizer;
+	const PipelineState* pipeline; //Inside faces, depth test passes at the far plane
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<SimplePixelShader> ps;
 	std::shared_ptr<SimpleVertexShader> vs;
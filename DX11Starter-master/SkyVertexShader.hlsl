@@ -1,4 +1,4 @@
-cbuffer ExternalData : register(b0)
+cbuffer ExternalData : register(b0) // C++: SkyConstants
 {
     matrix view;
     matrix projection;
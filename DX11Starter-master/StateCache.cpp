@@ -0,0 +1,215 @@
+#include "StateCache.h"
+#include <cstring>
+
+// Stands in for "whatever was there before", never equal to a real binding
+static const char unknownBinding = 0;
+#define UNKNOWN_BINDING ((const void*)&unknownBinding)
+#define UNKNOWN_TOPOLOGY 0xFFFFFFFF
+
+StateCache::StateCache()
+{
+	Invalidate();
+	ResetStats();
+}
+
+StateCache::~StateCache()
+{
+}
+
+void StateCache::Invalidate()
+{
+	inputLayout = UNKNOWN_BINDING;
+	indexBuffer = UNKNOWN_BINDING;
+	rasterizerState = UNKNOWN_BINDING;
+	depthStencilState = UNKNOWN_BINDING;
+	blendState = UNKNOWN_BINDING;
+	topology = UNKNOWN_TOPOLOGY;
+	pipelineChanges = PIPELINE_ALL;
+
+	for (unsigned int i = 0; i < MAX_VERTEX_BUFFER_SLOTS; i++)
+	{
+		vertexBuffers[i].Buffer = UNKNOWN_BINDING;
+		vertexBuffers[i].Stride = 0;
+		vertexBuffers[i].Offset = 0;
+	}
+
+	for (unsigned int s = 0; s < 2; s++)
+	{
+		shaders[s] = UNKNOWN_BINDING;
+		for (unsigned int i = 0; i < MAX_CONSTANT_BUFFER_SLOTS; i++) constantBuffers[s][i] = UNKNOWN_BINDING;
+		for (unsigned int i = 0; i < MAX_RESOURCE_SLOTS; i++) resources[s][i] = UNKNOWN_BINDING;
+		for (unsigned int i = 0; i < MAX_SAMPLER_SLOTS; i++) samplers[s][i] = UNKNOWN_BINDING;
+	}
+}
+
+bool StateCache::Change(const void*& bound, const void* value)
+{
+	if (bound == value)
+		return false;
+
+	bound = value;
+	return true;
+}
+
+// --------------------------------------------------------
+// Compares each part of a pipeline against what's bound,
+// returning the PIPELINE_* bits of the ones that differ
+// --------------------------------------------------------
+unsigned int StateCache::ChangePipeline(const PipelineState* pipeline)
+{
+	unsigned int changes = 0;
+	if (Change(shaders[0], pipeline->VertexShader)) changes |= PIPELINE_VERTEX_SHADER;
+	if (Change(shaders[1], pipeline->PixelShader)) changes |= PIPELINE_PIXEL_SHADER;
+	if (Change(inputLayout, pipeline->InputLayout)) changes |= PIPELINE_INPUT_LAYOUT;
+	if (Change(rasterizerState, pipeline->RasterizerState)) changes |= PIPELINE_RASTERIZER;
+	if (Change(blendState, pipeline->BlendState)) changes |= PIPELINE_BLEND;
+	if (Change(depthStencilState, pipeline->DepthStencilState)) changes |= PIPELINE_DEPTH_STENCIL;
+	if (topology != pipeline->Topology)
+	{
+		topology = pipeline->Topology;
+		changes |= PIPELINE_TOPOLOGY;
+	}
+	return changes;
+}
+
+bool StateCache::ChangeRange(const void** bound, unsigned int boundCount, unsigned int start, unsigned int count, const void* const* values)
+{
+	if (start >= boundCount)
+		return true;
+	if (count > boundCount - start)
+		count = boundCount - start;
+
+	bool changed = false;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		changed |= bound[start + i] != values[i];
+		bound[start + i] = values[i];
+	}
+	return changed;
+}
+
+bool StateCache::Filter(const Command& c, const void* const* resourceLists)
+{
+	unsigned int stage = c.Stage == ShaderStage::Vertex ? 0 : 1;
+	bool issue = true;
+
+	switch (c.Type)
+	{
+	case CommandType::SetInputLayout:
+		issue = Change(inputLayout, c.Resource);
+		break;
+
+	case CommandType::SetShader:
+		issue = Change(shaders[stage], c.Resource);
+		break;
+
+	case CommandType::SetVertexBuffer:
+		if (c.Slot < MAX_VERTEX_BUFFER_SLOTS)
+		{
+			VertexBufferBinding& vb = vertexBuffers[c.Slot];
+			issue = vb.Buffer != c.Resource || vb.Stride != c.Args[0] || vb.Offset != c.Args[1];
+			vb.Buffer = c.Resource;
+			vb.Stride = c.Args[0];
+			vb.Offset = c.Args[1];
+		}
+		break;
+
+	case CommandType::SetIndexBuffer:
+		issue = Change(indexBuffer, c.Resource);
+		break;
+
+	case CommandType::SetConstantBuffer:
+		if (c.Slot < MAX_CONSTANT_BUFFER_SLOTS)
+			issue = Change(constantBuffers[stage][c.Slot], c.Resource);
+		break;
+
+	case CommandType::SetConstants:
+		//Always a fresh range, and whatever buffer is bound next differs from it
+		if (c.Slot < MAX_CONSTANT_BUFFER_SLOTS)
+			constantBuffers[stage][c.Slot] = UNKNOWN_BINDING;
+		break;
+
+	case CommandType::SetShaderResource:
+		if (c.Slot < MAX_RESOURCE_SLOTS)
+			issue = Change(resources[stage][c.Slot], c.Resource);
+		break;
+
+	case CommandType::SetSampler:
+		if (c.Slot < MAX_SAMPLER_SLOTS)
+			issue = Change(samplers[stage][c.Slot], c.Resource);
+		break;
+
+	case CommandType::SetShaderResources:
+		issue = ChangeRange(resources[stage], MAX_RESOURCE_SLOTS, c.Slot, c.Args[0], resourceLists + c.Args[1]);
+		break;
+
+	case CommandType::SetSamplers:
+		issue = ChangeRange(samplers[stage], MAX_SAMPLER_SLOTS, c.Slot, c.Args[0], resourceLists + c.Args[1]);
+		break;
+
+	case CommandType::SetRasterizerState:
+		issue = Change(rasterizerState, c.Resource);
+		break;
+
+	case CommandType::SetDepthStencilState:
+		issue = Change(depthStencilState, c.Resource);
+		break;
+
+	case CommandType::SetPipeline:
+		if (c.Resource)
+		{
+			pipelineChanges = ChangePipeline((const PipelineState*)c.Resource);
+			issue = pipelineChanges != 0;
+			if (issue)
+			{
+				for (unsigned int bits = ~pipelineChanges & PIPELINE_ALL; bits; bits &= bits - 1)
+					elidedPipelineParts++;
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	if (issue)
+		issuedCount++;
+	else if (c.Type < CommandType::Count)
+		elidedCounts[(int)c.Type]++;
+	return issue;
+}
+
+void StateCache::ResetStats()
+{
+	issuedCount = 0;
+	elidedPipelineParts = 0;
+	memset(elidedCounts, 0, sizeof(elidedCounts));
+}
+
+unsigned int StateCache::GetIssuedCount()
+{
+	return issuedCount;
+}
+
+unsigned int StateCache::GetElidedCount()
+{
+	unsigned int total = 0;
+	for (unsigned int count : elidedCounts)
+		total += count;
+	return total;
+}
+
+unsigned int StateCache::GetElidedCount(CommandType type)
+{
+	return type < CommandType::Count ? elidedCounts[(int)type] : 0;
+}
+
+unsigned int StateCache::GetElidedPipelineParts()
+{
+	return elidedPipelineParts;
+}
+
+unsigned int StateCache::GetPipelineChanges()
+{
+	return pipelineChanges;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "CommandBuffer.h"
+#include "PipelineState.h"
+
+// Direct3D 11 binding limits (D3D11_COMMONSHADER_* and D3D11_IA_*)
+#define MAX_CONSTANT_BUFFER_SLOTS 14
+#define MAX_RESOURCE_SLOTS 128
+#define MAX_SAMPLER_SLOTS 16
+#define MAX_VERTEX_BUFFER_SLOTS 32
+
+// Parts of a pipeline, for GetPipelineChanges()
+#define PIPELINE_VERTEX_SHADER		0x01
+#define PIPELINE_PIXEL_SHADER		0x02
+#define PIPELINE_INPUT_LAYOUT		0x04
+#define PIPELINE_RASTERIZER			0x08
+#define PIPELINE_BLEND				0x10
+#define PIPELINE_DEPTH_STENCIL		0x20
+#define PIPELINE_TOPOLOGY			0x40
+#define PIPELINE_ALL				0x7F
+
+// --------------------------------------------------------
+// Shadows what's currently bound to the pipeline so binding
+// commands that wouldn't change anything can be skipped
+//
+// - Tracks shaders, input layout, vertex/index buffers,
+//   rasterizer, blend and depth state, topology, and the
+//   constant buffers, SRVs and samplers of each stage
+// - A list bind is skipped only if every slot in it matches
+// - A pipeline is split into its parts, tracked in the same
+//   slots as the single binds, so the two mix freely. It's
+//   skipped only if no part changes; otherwise
+//   GetPipelineChanges() says which parts to set.
+// - Constant updates, SetConstants and draws always go through
+// - Starts out (and Invalidate() returns to) "unknown", so
+//   the first bind of every slot is always issued. Call it
+//   whenever the context is used directly in between.
+// --------------------------------------------------------
+class StateCache
+{
+public:
+	StateCache();
+	~StateCache();
+
+	// Forgets everything that's bound
+	void Invalidate();
+
+	// Returns true if the command has to be issued, and
+	// records its effect; false if it's redundant
+	// resourceLists - The owning buffer's GetResourceLists()
+	bool Filter(const Command& command, const void* const* resourceLists);
+
+	// PIPELINE_* bits for the last SetPipeline that was filtered
+	unsigned int GetPipelineChanges();
+
+	// Zeroes the issued/elided counters
+	void ResetStats();
+
+	//Stats
+	unsigned int GetIssuedCount();
+	unsigned int GetElidedCount();
+	unsigned int GetElidedCount(CommandType type);
+	unsigned int GetElidedPipelineParts(); // Parts of issued pipelines that were already bound
+
+private:
+	struct VertexBufferBinding
+	{
+		const void* Buffer;
+		unsigned int Stride;
+		unsigned int Offset;
+	};
+
+	const void* inputLayout;
+	const void* shaders[2];
+	VertexBufferBinding vertexBuffers[MAX_VERTEX_BUFFER_SLOTS];
+	const void* indexBuffer;
+	const void* constantBuffers[2][MAX_CONSTANT_BUFFER_SLOTS];
+	const void* resources[2][MAX_RESOURCE_SLOTS];
+	const void* samplers[2][MAX_SAMPLER_SLOTS];
+	const void* rasterizerState;
+	const void* depthStencilState;
+	const void* blendState;
+	unsigned int topology;
+	unsigned int pipelineChanges;
+
+	unsigned int issuedCount;
+	unsigned int elidedCounts[(int)CommandType::Count];
+	unsigned int elidedPipelineParts;
+
+	// Updates a shadowed binding, true if it changed
+	static bool Change(const void*& bound, const void* value);
+	unsigned int ChangePipeline(const PipelineState* pipeline);
+	static bool ChangeRange(const void** bound, unsigned int boundCount, unsigned int start, unsigned int count, const void* const* values);
+};
@@ -0,0 +1,191 @@
+#include "TestHelpers.h"
+#include "Tools/CBufferGen/HlslLayout.h"
+#include "ShaderConstants.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// --------------------------------------------------------
+// CBufferGen's packing against what fxc does with the same
+// declarations, its errors, and the checked in
+// ShaderConstants.h against the shaders it came from.
+// Including ShaderConstants.h also compiles its layout checks.
+// --------------------------------------------------------
+
+static bool ParseOne(const std::string& hlsl, HlslLayout& layout)
+{
+	HlslLayoutParser parser;
+	if (!parser.ParseText(hlsl, "Test.hlsl", "") || parser.GetLayouts().empty())
+	{
+		printf("%s\n", parser.GetError().c_str());
+		return false;
+	}
+	layout = parser.GetLayouts().back();
+	return true;
+}
+
+// Offset of a named (non padding) member, or -1
+static int Offset(const HlslLayout& layout, const char* name)
+{
+	for (const HlslMember& member : layout.Members)
+	{
+		if (!member.IsPadding && member.Name == name)
+			return (int)member.Offset;
+	}
+	return -1;
+}
+
+static unsigned int PaddingBytes(const HlslLayout& layout)
+{
+	unsigned int bytes = 0;
+	for (const HlslMember& member : layout.Members)
+		bytes += member.IsPadding ? member.Size : 0;
+	return bytes;
+}
+
+// Members must tile the layout exactly, padding included
+static bool Contiguous(const HlslLayout& layout)
+{
+	unsigned int end = 0;
+	for (const HlslMember& member : layout.Members)
+	{
+		if (member.Offset != end)
+			return false;
+		end += member.Size;
+	}
+	return end == layout.Size;
+}
+
+static void TestPacking()
+{
+	HlslLayout l;
+
+	//Scalars and vectors share a register while they fit
+	CHECK(ParseOne("cbuffer A // C++: A\n{ float a; float3 b; }", l));
+	CHECK(Offset(l, "A") == 0 && Offset(l, "B") == 4 && l.Size == 16 && PaddingBytes(l) == 0);
+
+	//A vector never straddles a register
+	CHECK(ParseOne("cbuffer A // C++: A\n{ float2 a; float3 b; float c; }", l));
+	CHECK(Offset(l, "B") == 16 && Offset(l, "C") == 28 && l.Size == 32 && PaddingBytes(l) == 8);
+
+	//Matrices start a register
+	CHECK(ParseOne("cbuffer A // C++: A\n{ float a; matrix m; float b; }", l));
+	CHECK(Offset(l, "M") == 16 && Offset(l, "B") == 80 && l.Size == 96);
+
+	//So do arrays, with the next member straight after
+	CHECK(ParseOne("#define COUNT 3\ncbuffer A // C++: A\n{ float a; float4 items[COUNT]; float b; }", l));
+	CHECK(Offset(l, "Items") == 16 && Offset(l, "B") == 64 && l.Size == 80);
+	CHECK(l.Members[2].ArraySize == 3 && l.Members[2].ArraySizeName == "COUNT");
+
+	//Structs start a register and whatever follows starts another
+	CHECK(ParseOne("struct S // C++: S\n{ float3 p; };\ncbuffer A // C++: A\n{ float a; S s; float b; }", l));
+	CHECK(Offset(l, "S") == 16 && Offset(l, "B") == 32 && l.Size == 48);
+
+	//Structs are their exact size, cbuffers whole registers
+	HlslLayoutParser parser;
+	CHECK(parser.ParseText("struct S // C++: S\n{ float3 p; float r; float2 uv; };", "Test.hlsl", ""));
+	CHECK(parser.GetLayouts().size() == 1 && parser.GetLayouts()[0].Size == 24);
+	CHECK(ParseOne("cbuffer A : register(b3) // C++: A\n{ float a; }", l));
+	CHECK(l.Size == 16 && l.Register == "b3" && l.IsCBuffer);
+
+	//bool is 4 bytes, statics aren't stored, several names per line
+	CHECK(ParseOne("cbuffer A // C++: A\n{ bool on; static const float k = 2; row_major float4x4 m; uint x, y; }", l));
+	CHECK(Offset(l, "On") == 0 && Offset(l, "K") < 0 && Offset(l, "M") == 16 && Offset(l, "X") == 80 && Offset(l, "Y") == 84);
+	CHECK(l.Members[0].CppType == "int");
+
+	//Comments come along, unmarked declarations are skipped
+	CHECK(ParseOne("cbuffer Skipped { float a; }\ncbuffer A // C++: A\n{ float a; // Note\n}", l));
+	CHECK(l.HlslName == "A" && l.Members[0].Comment == "Note");
+
+	//Every one of these lays out with no holes
+	const char* layouts[] =
+	{
+		"cbuffer A // C++: A\n{ float a; float3 b; float2 c; float3 d; float e; }",
+		"cbuffer A // C++: A\n{ float3 a; float2 b; float2 c; float4 d; float e; }",
+		"struct S // C++: S\n{ float4 a; float b; };\ncbuffer A // C++: A\n{ float a; S s; float2 b; matrix m; }",
+	};
+	for (const char* hlsl : layouts)
+	{
+		HlslLayoutParser p;
+		CHECK(p.ParseText(hlsl, "Test.hlsl", ""));
+		for (const HlslLayout& layout : p.GetLayouts())
+			CHECK(Contiguous(layout));
+	}
+}
+
+static void TestErrors()
+{
+	const char* bad[] =
+	{
+		"cbuffer A // C++: A\n{ float a : packoffset(c0); }",
+		"cbuffer A // C++: A\n{ float2 a[4]; }", // HLSL pads each element
+		"struct S // C++: S\n{ float2 a; };\ncbuffer A // C++: A\n{ S s[2]; }",
+		"cbuffer A // C++: A\n{ float4 a[2][2]; }",
+		"cbuffer A // C++: A\n{ float4 a[COUNT]; }",
+		"cbuffer A // C++: A\n{ float4 a[0]; }",
+		"cbuffer A // C++: A\n{ half a; }",
+		"struct S { float a; };\ncbuffer A // C++: A\n{ S s; }", // Unmarked struct
+		"cbuffer A // C++: A\n{ }",
+		"cbuffer A // C++: A\n{ float a; }\ncbuffer B // C++: A\n{ float b; }", // Same C++ name, different layout
+		"#include \"Missing.hlsli\"\n",
+	};
+
+	for (const char* hlsl : bad)
+	{
+		HlslLayoutParser parser;
+		CHECK(!parser.ParseText(hlsl, "Test.hlsl", ""));
+		CHECK(parser.GetError().find("Test.hlsl(") == 0);
+	}
+
+	//Line numbers point at the problem
+	HlslLayoutParser parser;
+	CHECK(!parser.ParseText("\n\ncbuffer A // C++: A\n{\n float a;\n half b;\n}", "Test.hlsl", ""));
+	CHECK(parser.GetError().find("Test.hlsl(6): error : ") == 0);
+
+	//The same declaration twice is fine
+	HlslLayoutParser twice;
+	CHECK(twice.ParseText("cbuffer A // C++: A\n{ float a; }", "One.hlsl", ""));
+	CHECK(twice.ParseText("cbuffer A // C++: A\n{ float a; }", "Two.hlsl", ""));
+	CHECK(twice.GetLayouts().size() == 1 && twice.GetLayouts()[0].Sources == "One.hlsl, Two.hlsl");
+}
+
+// --------------------------------------------------------
+// Runs the generator over the shaders the project builds,
+// in the project's order, and compares with what's checked in
+// --------------------------------------------------------
+static void TestCheckedInHeader()
+{
+	std::string engineDir = ENGINE_DIR;
+	std::ifstream projectFile(engineDir + "/DX11Starter.vcxproj");
+	std::stringstream project;
+	project << projectFile.rdbuf();
+
+	HlslLayoutParser parser;
+	std::string text = project.str();
+	std::string marker = "<FxCompile Include=\"";
+	unsigned int shaderCount = 0;
+	for (size_t at = text.find(marker); at != std::string::npos; at = text.find(marker, at + 1))
+	{
+		size_t start = at + marker.size();
+		std::string shader = text.substr(start, text.find('"', start) - start);
+		bool parsed = parser.ParseFile(engineDir + "/" + shader);
+		CHECK(parsed);
+		if (!parsed)
+			printf("%s\n", parser.GetError().c_str());
+		shaderCount++;
+	}
+	CHECK(shaderCount > 0);
+
+	std::ifstream headerFile(engineDir + "/ShaderConstants.h", std::ios::binary);
+	std::stringstream header;
+	header << headerFile.rdbuf();
+	CHECK(parser.GenerateHeader() == header.str());
+}
+
+int main()
+{
+	TestPacking();
+	TestErrors();
+	TestCheckedInHeader();
+	return TestResult();
+}
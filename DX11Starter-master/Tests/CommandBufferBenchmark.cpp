@@ -0,0 +1,100 @@
+#include "TestHelpers.h"
+#include "CommandBuffer.h"
+#include "NullCommandExecutor.h"
+#include "PipelineState.h"
+#include <vector>
+
+// --------------------------------------------------------
+// Headless frame building: records a frame of draws the way
+// Game does (pipeline, buffers, textures, per object
+// constants, draw) and validates it with the null executor
+//
+// Reports commands per second for recording and for the
+// null executor's checks, so changes to either show up
+// without a GPU.
+//
+// Usage: CommandBufferBenchmark [--quick]
+// --------------------------------------------------------
+
+// Per object constants, the size of the engine's
+struct ObjectConstants
+{
+	float World[16];
+	float WorldInverseTranspose[16];
+	float Color[4];
+};
+
+class NullPipelineFactory : public IPipelineStateFactory
+{
+public:
+	const void* CreateRasterizerState(const RasterizerStateDesc&) override { return &states[0]; }
+	const void* CreateBlendState(const BlendStateDesc&) override { return &states[1]; }
+	const void* CreateDepthStencilState(const DepthStencilStateDesc&) override { return &states[2]; }
+
+private:
+	int states[3];
+};
+
+int main(int argc, char** argv)
+{
+	bool quick = HasArgument(argc, argv, "--quick");
+	unsigned int drawCount = 10000;
+	unsigned int frames = quick ? 5 : 200;
+
+	//A few shaders, materials and meshes, like a real scene
+	static int shaders[8], layouts[4], vertexBuffers[64], indexBuffers[64], textures[256], sampler;
+	NullPipelineFactory factory;
+	PipelineCache pipelineCache(&factory);
+	std::vector<const PipelineState*> pipelines;
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		PipelineDesc desc;
+		desc.VertexShader = &shaders[i * 2];
+		desc.PixelShader = &shaders[i * 2 + 1];
+		desc.InputLayout = &layouts[i];
+		pipelines.push_back(pipelineCache.GetPipeline(desc));
+	}
+
+	CommandBuffer commands;
+	NullCommandExecutor executor;
+	ObjectConstants constants = {};
+	double recordSeconds = 0.0;
+	double executeSeconds = 0.0;
+
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		BenchmarkTimer recordTimer;
+		commands.Reset();
+		const void* samplers[] = { &sampler };
+		commands.SetSamplers(ShaderStage::Pixel, 0, 1, samplers);
+		for (unsigned int d = 0; d < drawCount; d++)
+		{
+			//Sorted like the render queue: by pipeline, then mesh
+			unsigned int mesh = (d / 40) % 64;
+			const void* srvs[] = { &textures[(d / 10) % 256], &textures[(d / 20) % 256] };
+			constants.Color[0] = (float)d;
+
+			commands.SetPipeline(pipelines[d * 4 / drawCount]);
+			commands.SetVertexBuffer(0, &vertexBuffers[mesh], 48, 0);
+			commands.SetIndexBuffer(&indexBuffers[mesh]);
+			commands.SetShaderResources(ShaderStage::Pixel, 0, 2, srvs);
+			commands.SetConstants(ShaderStage::Vertex, 1, &constants, sizeof(constants));
+			commands.DrawIndexed(36, 0, 0);
+		}
+		recordSeconds += recordTimer.Seconds();
+
+		BenchmarkTimer executeTimer;
+		executor.Execute(commands);
+		executeSeconds += executeTimer.Seconds();
+	}
+
+	double commandTotal = (double)commands.GetCommands().size() * frames;
+	printf("Frame of %u draws, %u commands, %u frame(s)\n", drawCount, (unsigned int)commands.GetCommands().size(), frames);
+	printf("  Record:   %8.3f ms/frame %12.0f commands/s\n", recordSeconds / frames * 1000.0, commandTotal / recordSeconds);
+	printf("  Validate: %8.3f ms/frame %12.0f commands/s\n", executeSeconds / frames * 1000.0, commandTotal / executeSeconds);
+	printf("  Redundant binds: %u\n", executor.GetRedundantCount());
+
+	CHECK(executor.GetErrorCount() == 0);
+	CHECK(executor.GetDrawCount() == drawCount);
+	return TestResult();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// --------------------------------------------------------
+// Stand-in for the parts of DirectXCollision the CPU side of
+// the engine uses, see DirectXMath.h in this folder
+// --------------------------------------------------------
+
+#include "DirectXMath.h"
+#include <cstddef>
+
+namespace DirectX
+{
+	struct BoundingBox
+	{
+		static const size_t CORNER_COUNT = 8;
+
+		XMFLOAT3 Center;
+		XMFLOAT3 Extents;
+
+		BoundingBox() : Center(0, 0, 0), Extents(1, 1, 1) {}
+		BoundingBox(const XMFLOAT3& center, const XMFLOAT3& extents) : Center(center), Extents(extents) {}
+
+		// Same corner order as DirectXCollision
+		void GetCorners(XMFLOAT3* corners) const
+		{
+			static const float offsets[CORNER_COUNT][3] =
+			{
+				{ -1, -1, 1 }, { 1, -1, 1 }, { 1, 1, 1 }, { -1, 1, 1 },
+				{ -1, -1, -1 }, { 1, -1, -1 }, { 1, 1, -1 }, { -1, 1, -1 }
+			};
+			for (size_t i = 0; i < CORNER_COUNT; i++)
+			{
+				corners[i] = XMFLOAT3(
+					Center.x + Extents.x * offsets[i][0],
+					Center.y + Extents.y * offsets[i][1],
+					Center.z + Extents.z * offsets[i][2]);
+			}
+		}
+	};
+}
@@ -0,0 +1,357 @@
+#pragma once
+
+// --------------------------------------------------------
+// Plain C++ stand-in for the parts of DirectXMath the CPU
+// side of the engine uses, so its tests and benchmarks build
+// where the Windows SDK isn't installed. Only used when CMake
+// can't find the real DirectXMath.
+//
+// Matches DirectXMath's conventions: row vectors, row major
+// XMFLOAT4X4, left handed projections with depth 0 to 1.
+// Nothing here is SIMD, so timings of code built against it
+// are only good for comparing with each other.
+// --------------------------------------------------------
+
+#include <cmath>
+
+namespace DirectX
+{
+	const float XM_PI = 3.141592654f;
+	const float XM_2PI = 6.283185307f;
+	const float XM_PIDIV2 = 1.570796327f;
+	const float XM_PIDIV4 = 0.785398163f;
+
+	inline float XMConvertToRadians(float degrees) { return degrees * (XM_PI / 180.0f); }
+	inline float XMConvertToDegrees(float radians) { return radians * (180.0f / XM_PI); }
+
+	struct XMFLOAT2
+	{
+		float x, y;
+		XMFLOAT2() = default;
+		XMFLOAT2(float x, float y) : x(x), y(y) {}
+	};
+
+	struct XMFLOAT3
+	{
+		float x, y, z;
+		XMFLOAT3() = default;
+		XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+	};
+
+	struct XMFLOAT4
+	{
+		float x, y, z, w;
+		XMFLOAT4() = default;
+		XMFLOAT4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+	};
+
+	struct XMUINT2
+	{
+		unsigned int x, y;
+		XMUINT2() = default;
+		XMUINT2(unsigned int x, unsigned int y) : x(x), y(y) {}
+	};
+
+	struct XMUINT4
+	{
+		unsigned int x, y, z, w;
+		XMUINT4() = default;
+		XMUINT4(unsigned int x, unsigned int y, unsigned int z, unsigned int w) : x(x), y(y), z(z), w(w) {}
+	};
+
+	struct XMINT2
+	{
+		int x, y;
+		XMINT2() = default;
+		XMINT2(int x, int y) : x(x), y(y) {}
+	};
+
+	struct XMFLOAT4X4
+	{
+		union
+		{
+			struct
+			{
+				float _11, _12, _13, _14;
+				float _21, _22, _23, _24;
+				float _31, _32, _33, _34;
+				float _41, _42, _43, _44;
+			};
+			float m[4][4];
+		};
+
+		XMFLOAT4X4() = default;
+		XMFLOAT4X4(float m00, float m01, float m02, float m03,
+			float m10, float m11, float m12, float m13,
+			float m20, float m21, float m22, float m23,
+			float m30, float m31, float m32, float m33)
+			: _11(m00), _12(m01), _13(m02), _14(m03),
+			_21(m10), _22(m11), _23(m12), _24(m13),
+			_31(m20), _32(m21), _33(m22), _34(m23),
+			_41(m30), _42(m31), _43(m32), _44(m33) {}
+	};
+
+	struct XMVECTOR
+	{
+		float v[4];
+	};
+
+	struct XMMATRIX
+	{
+		XMVECTOR r[4];
+	};
+
+	typedef const XMVECTOR& FXMVECTOR;
+	typedef const XMMATRIX& FXMMATRIX;
+
+	// Vectors --------------------------------------------
+
+	inline XMVECTOR XMVectorSet(float x, float y, float z, float w)
+	{
+		XMVECTOR r = { { x, y, z, w } };
+		return r;
+	}
+
+	inline XMVECTOR XMVectorZero() { return XMVectorSet(0, 0, 0, 0); }
+	inline XMVECTOR XMVectorReplicate(float value) { return XMVectorSet(value, value, value, value); }
+	inline float XMVectorGetX(FXMVECTOR v) { return v.v[0]; }
+	inline float XMVectorGetY(FXMVECTOR v) { return v.v[1]; }
+	inline float XMVectorGetZ(FXMVECTOR v) { return v.v[2]; }
+	inline float XMVectorGetW(FXMVECTOR v) { return v.v[3]; }
+
+	inline XMVECTOR XMVectorMin(FXMVECTOR a, FXMVECTOR b)
+	{
+		XMVECTOR r;
+		for (int i = 0; i < 4; i++)
+			r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+		return r;
+	}
+
+	inline XMVECTOR XMVectorMax(FXMVECTOR a, FXMVECTOR b)
+	{
+		XMVECTOR r;
+		for (int i = 0; i < 4; i++)
+			r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+		return r;
+	}
+
+	inline XMVECTOR operator+(FXMVECTOR a, FXMVECTOR b) { return XMVectorSet(a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]); }
+	inline XMVECTOR operator-(FXMVECTOR a, FXMVECTOR b) { return XMVectorSet(a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]); }
+	inline XMVECTOR operator-(FXMVECTOR a) { return XMVectorSet(-a.v[0], -a.v[1], -a.v[2], -a.v[3]); }
+	inline XMVECTOR operator*(FXMVECTOR a, float s) { return XMVectorSet(a.v[0] * s, a.v[1] * s, a.v[2] * s, a.v[3] * s); }
+	inline XMVECTOR operator*(float s, FXMVECTOR a) { return a * s; }
+	inline XMVECTOR operator/(FXMVECTOR a, float s) { return a * (1.0f / s); }
+	inline XMVECTOR& operator+=(XMVECTOR& a, FXMVECTOR b) { a = a + b; return a; }
+	inline XMVECTOR& operator-=(XMVECTOR& a, FXMVECTOR b) { a = a - b; return a; }
+	inline XMVECTOR& operator*=(XMVECTOR& a, float s) { a = a * s; return a; }
+
+	inline XMVECTOR XMVectorAdd(FXMVECTOR a, FXMVECTOR b) { return a + b; }
+	inline XMVECTOR XMVectorSubtract(FXMVECTOR a, FXMVECTOR b) { return a - b; }
+	inline XMVECTOR XMVectorScale(FXMVECTOR a, float s) { return a * s; }
+
+	inline float Dot3(FXMVECTOR a, FXMVECTOR b) { return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2]; }
+
+	inline XMVECTOR XMVector3Dot(FXMVECTOR a, FXMVECTOR b) { return XMVectorReplicate(Dot3(a, b)); }
+	inline XMVECTOR XMVector3Length(FXMVECTOR v) { return XMVectorReplicate(std::sqrt(Dot3(v, v))); }
+
+	inline XMVECTOR XMVector3Cross(FXMVECTOR a, FXMVECTOR b)
+	{
+		return XMVectorSet(
+			a.v[1] * b.v[2] - a.v[2] * b.v[1],
+			a.v[2] * b.v[0] - a.v[0] * b.v[2],
+			a.v[0] * b.v[1] - a.v[1] * b.v[0],
+			0.0f);
+	}
+
+	inline XMVECTOR XMVector3Normalize(FXMVECTOR v)
+	{
+		float length = std::sqrt(Dot3(v, v));
+		return length > 0.0f ? v * (1.0f / length) : v;
+	}
+
+	// Loads and stores -----------------------------------
+
+	inline XMVECTOR XMLoadFloat2(const XMFLOAT2* p) { return XMVectorSet(p->x, p->y, 0, 0); }
+	inline XMVECTOR XMLoadFloat3(const XMFLOAT3* p) { return XMVectorSet(p->x, p->y, p->z, 0); }
+	inline XMVECTOR XMLoadFloat4(const XMFLOAT4* p) { return XMVectorSet(p->x, p->y, p->z, p->w); }
+	inline void XMStoreFloat2(XMFLOAT2* p, FXMVECTOR v) { p->x = v.v[0]; p->y = v.v[1]; }
+	inline void XMStoreFloat3(XMFLOAT3* p, FXMVECTOR v) { p->x = v.v[0]; p->y = v.v[1]; p->z = v.v[2]; }
+	inline void XMStoreFloat4(XMFLOAT4* p, FXMVECTOR v) { p->x = v.v[0]; p->y = v.v[1]; p->z = v.v[2]; p->w = v.v[3]; }
+
+	inline XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4* p)
+	{
+		XMMATRIX r;
+		for (int i = 0; i < 4; i++)
+			r.r[i] = XMVectorSet(p->m[i][0], p->m[i][1], p->m[i][2], p->m[i][3]);
+		return r;
+	}
+
+	inline void XMStoreFloat4x4(XMFLOAT4X4* p, FXMMATRIX m)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = 0; j < 4; j++)
+				p->m[i][j] = m.r[i].v[j];
+		}
+	}
+
+	// Matrices -------------------------------------------
+
+	inline XMMATRIX XMMatrixSet(float m00, float m01, float m02, float m03,
+		float m10, float m11, float m12, float m13,
+		float m20, float m21, float m22, float m23,
+		float m30, float m31, float m32, float m33)
+	{
+		XMMATRIX r;
+		r.r[0] = XMVectorSet(m00, m01, m02, m03);
+		r.r[1] = XMVectorSet(m10, m11, m12, m13);
+		r.r[2] = XMVectorSet(m20, m21, m22, m23);
+		r.r[3] = XMVectorSet(m30, m31, m32, m33);
+		return r;
+	}
+
+	inline XMMATRIX XMMatrixIdentity()
+	{
+		return XMMatrixSet(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
+	}
+
+	inline XMMATRIX XMMatrixMultiply(FXMMATRIX a, FXMMATRIX b)
+	{
+		XMMATRIX r;
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				r.r[i].v[j] = a.r[i].v[0] * b.r[0].v[j] + a.r[i].v[1] * b.r[1].v[j] +
+					a.r[i].v[2] * b.r[2].v[j] + a.r[i].v[3] * b.r[3].v[j];
+			}
+		}
+		return r;
+	}
+
+	inline XMMATRIX operator*(FXMMATRIX a, FXMMATRIX b) { return XMMatrixMultiply(a, b); }
+
+	inline XMMATRIX XMMatrixTranspose(FXMMATRIX m)
+	{
+		XMMATRIX r;
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = 0; j < 4; j++)
+				r.r[i].v[j] = m.r[j].v[i];
+		}
+		return r;
+	}
+
+	// Cofactor expansion, in double so near singular matrices keep some precision
+	inline XMMATRIX XMMatrixInverse(XMVECTOR* determinant, FXMMATRIX m)
+	{
+		double a[16], inv[16];
+		for (int i = 0; i < 16; i++)
+			a[i] = m.r[i / 4].v[i % 4];
+
+		inv[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+		inv[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+		inv[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+		inv[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+		inv[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+		inv[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+		inv[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+		inv[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+		inv[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+		inv[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+		inv[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+		inv[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+		inv[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+		inv[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+		inv[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+		inv[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+		double det = a[0] * inv[0] + a[1] * inv[4] + a[2] * inv[8] + a[3] * inv[12];
+		if (determinant)
+			*determinant = XMVectorReplicate((float)det);
+
+		XMMATRIX r;
+		double scale = det != 0.0 ? 1.0 / det : 0.0;
+		for (int i = 0; i < 16; i++)
+			r.r[i / 4].v[i % 4] = (float)(inv[i] * scale);
+		return r;
+	}
+
+	inline XMMATRIX XMMatrixTranslation(float x, float y, float z)
+	{
+		return XMMatrixSet(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, x, y, z, 1);
+	}
+
+	inline XMMATRIX XMMatrixScaling(float x, float y, float z)
+	{
+		return XMMatrixSet(x, 0, 0, 0, 0, y, 0, 0, 0, 0, z, 0, 0, 0, 0, 1);
+	}
+
+	inline XMMATRIX XMMatrixRotationY(float angle)
+	{
+		float s = std::sin(angle), c = std::cos(angle);
+		return XMMatrixSet(c, 0, -s, 0, 0, 1, 0, 0, s, 0, c, 0, 0, 0, 0, 1);
+	}
+
+	inline XMMATRIX XMMatrixLookToLH(FXMVECTOR eye, FXMVECTOR direction, FXMVECTOR up)
+	{
+		XMVECTOR r2 = XMVector3Normalize(direction);
+		XMVECTOR r0 = XMVector3Normalize(XMVector3Cross(up, r2));
+		XMVECTOR r1 = XMVector3Cross(r2, r0);
+		XMVECTOR negEye = -eye;
+		return XMMatrixSet(
+			r0.v[0], r1.v[0], r2.v[0], 0,
+			r0.v[1], r1.v[1], r2.v[1], 0,
+			r0.v[2], r1.v[2], r2.v[2], 0,
+			Dot3(r0, negEye), Dot3(r1, negEye), Dot3(r2, negEye), 1);
+	}
+
+	inline XMMATRIX XMMatrixLookAtLH(FXMVECTOR eye, FXMVECTOR focus, FXMVECTOR up)
+	{
+		return XMMatrixLookToLH(eye, focus - eye, up);
+	}
+
+	inline XMMATRIX XMMatrixPerspectiveFovLH(float fovY, float aspect, float nearZ, float farZ)
+	{
+		float h = 1.0f / std::tan(fovY * 0.5f);
+		float w = h / aspect;
+		float range = farZ / (farZ - nearZ);
+		return XMMatrixSet(w, 0, 0, 0, 0, h, 0, 0, 0, 0, range, 1, 0, 0, -range * nearZ, 0);
+	}
+
+	inline XMMATRIX XMMatrixOrthographicOffCenterLH(float left, float right, float bottom, float top, float nearZ, float farZ)
+	{
+		float rw = 1.0f / (right - left);
+		float rh = 1.0f / (top - bottom);
+		float range = 1.0f / (farZ - nearZ);
+		return XMMatrixSet(
+			rw + rw, 0, 0, 0,
+			0, rh + rh, 0, 0,
+			0, 0, range, 0,
+			-(left + right) * rw, -(top + bottom) * rh, -range * nearZ, 1);
+	}
+
+	inline XMMATRIX XMMatrixOrthographicLH(float width, float height, float nearZ, float farZ)
+	{
+		return XMMatrixOrthographicOffCenterLH(-width * 0.5f, width * 0.5f, -height * 0.5f, height * 0.5f, nearZ, farZ);
+	}
+
+	inline XMVECTOR XMVector4Transform(FXMVECTOR v, FXMMATRIX m)
+	{
+		XMVECTOR r;
+		for (int j = 0; j < 4; j++)
+			r.v[j] = v.v[0] * m.r[0].v[j] + v.v[1] * m.r[1].v[j] + v.v[2] * m.r[2].v[j] + v.v[3] * m.r[3].v[j];
+		return r;
+	}
+
+	inline XMVECTOR XMVector3TransformCoord(FXMVECTOR v, FXMMATRIX m)
+	{
+		XMVECTOR r = XMVector4Transform(XMVectorSet(v.v[0], v.v[1], v.v[2], 1.0f), m);
+		return r * (1.0f / r.v[3]);
+	}
+
+	inline XMVECTOR XMVector3TransformNormal(FXMVECTOR v, FXMMATRIX m)
+	{
+		return XMVector4Transform(XMVectorSet(v.v[0], v.v[1], v.v[2], 0.0f), m);
+	}
+}
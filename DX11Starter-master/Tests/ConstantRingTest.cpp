@@ -0,0 +1,178 @@
+#include "TestHelpers.h"
+#include "ConstantRing.h"
+#include <random>
+#include <vector>
+
+static void TestAlignment()
+{
+	ConstantRing ring(1000);
+	CHECK(ring.GetCapacity() == 768);
+
+	unsigned int offset = 12345;
+	ring.BeginFrame();
+	CHECK(!ring.Allocate(0, offset));
+	CHECK(offset == 12345);
+	CHECK(!ring.Allocate(769, offset));
+	CHECK(ring.GetFailedCount() == 2);
+
+	CHECK(ring.Allocate(1, offset) && offset == 0);
+	CHECK(ring.Allocate(300, offset) && offset == 256);
+	CHECK(ring.GetFrameBytes() == 768);
+	CHECK(!ring.Allocate(1, offset)); // Full
+	CHECK(ring.GetFailedCount() == 3);
+}
+
+// --------------------------------------------------------
+// Space only comes back once the frame's fence completes,
+// and an empty frame doesn't hold anything up
+// --------------------------------------------------------
+static void TestFenceReuse()
+{
+	ConstantRing ring(1024);
+	unsigned int offset = 0;
+
+	ring.BeginFrame();
+	CHECK(ring.Allocate(1024, offset) && offset == 0);
+	ring.EndFrame(1);
+	CHECK(ring.GetFramesInFlight() == 1);
+
+	ring.BeginFrame();
+	CHECK(!ring.Allocate(256, offset));
+	ring.EndFrame(2); // Nothing allocated, so nothing to wait for
+	CHECK(ring.GetFramesInFlight() == 1);
+
+	ring.Retire(0);
+	ring.BeginFrame();
+	CHECK(!ring.Allocate(256, offset));
+	CHECK(ring.GetUsedBytes() == 1024);
+
+	ring.Retire(1);
+	CHECK(ring.GetUsedBytes() == 0);
+	CHECK(ring.GetFramesInFlight() == 0);
+	CHECK(ring.Allocate(256, offset) && offset == 0); // Back to the front once idle
+	CHECK(ring.GetFailedCount() == 1); // BeginFrame() cleared the earlier ones
+}
+
+// --------------------------------------------------------
+// An allocation that won't fit before the end goes to the
+// front, and the skipped tail is freed with its frame
+// --------------------------------------------------------
+static void TestWrap()
+{
+	ConstantRing ring(1024);
+	unsigned int offset = 0;
+
+	ring.BeginFrame();
+	CHECK(ring.Allocate(512, offset) && offset == 0);
+	ring.EndFrame(1);
+	ring.BeginFrame();
+	CHECK(ring.Allocate(256, offset) && offset == 512);
+	ring.EndFrame(2);
+	ring.Retire(1);
+	CHECK(ring.GetUsedBytes() == 256);
+
+	ring.BeginFrame();
+	CHECK(!ring.Allocate(768, offset)); // 256 at the end, 512 at the front
+	CHECK(ring.Allocate(512, offset) && offset == 0);
+	CHECK(ring.GetFrameBytes() == 768); // Includes the skipped 256
+	CHECK(ring.GetUsedBytes() == 1024);
+	CHECK(!ring.Allocate(1, offset));
+	ring.EndFrame(3);
+
+	ring.Retire(2);
+	CHECK(ring.GetUsedBytes() == 768);
+	ring.BeginFrame();
+	CHECK(ring.Allocate(256, offset) && offset == 512); // Frame 2's old space
+	ring.EndFrame(4);
+
+	ring.Retire(4);
+	CHECK(ring.GetUsedBytes() == 0);
+	CHECK(ring.GetFramesInFlight() == 0);
+}
+
+// --------------------------------------------------------
+// Random sizes with the GPU a random number of frames behind.
+// Every allocation is checked against everything the GPU
+// could still be reading.
+// --------------------------------------------------------
+static void TestRandomFrames()
+{
+	struct Live
+	{
+		unsigned long long Fence;
+		unsigned int Offset;
+		unsigned int Size;
+	};
+
+	ConstantRing ring(64 * 1024);
+	std::mt19937 random(7);
+	std::vector<Live> live;
+	unsigned long long fence = 0, completed = 0;
+	bool aligned = true, inside = true, overlapFree = true;
+	unsigned int allocations = 0, failures = 0;
+
+	for (unsigned int frame = 0; frame < 20000; frame++)
+	{
+		//The GPU finishes up to three frames behind the CPU
+		unsigned long long lag = random() % 4;
+		if (fence > lag && fence - lag > completed)
+			completed = fence - lag;
+		ring.Retire(completed);
+		for (unsigned int i = 0; i < live.size();)
+		{
+			if (live[i].Fence <= completed)
+			{
+				live[i] = live.back();
+				live.pop_back();
+			}
+			else
+				i++;
+		}
+
+		fence++;
+		ring.BeginFrame();
+		unsigned int count = random() % 80;
+		for (unsigned int a = 0; a < count; a++)
+		{
+			unsigned int size = 1 + random() % 2048;
+			unsigned int offset = 0;
+			if (!ring.Allocate(size, offset))
+			{
+				failures++;
+				continue;
+			}
+
+			allocations++;
+			aligned = aligned && offset % CONSTANT_RING_ALIGNMENT == 0;
+			inside = inside && offset + size <= ring.GetCapacity();
+			for (const Live& l : live)
+				overlapFree = overlapFree && (offset + size <= l.Offset || l.Offset + l.Size <= offset);
+
+			Live allocation = { fence, offset, size };
+			live.push_back(allocation);
+		}
+		ring.EndFrame(fence);
+	}
+
+	CHECK(aligned);
+	CHECK(inside);
+	CHECK(overlapFree);
+	CHECK(allocations > 0 && failures > 0); // Both paths were exercised
+
+	//Once the GPU catches up everything is free again
+	ring.Retire(fence);
+	CHECK(ring.GetUsedBytes() == 0);
+	CHECK(ring.GetFramesInFlight() == 0);
+	unsigned int offset = 0;
+	ring.BeginFrame();
+	CHECK(ring.Allocate(ring.GetCapacity(), offset) && offset == 0);
+}
+
+int main()
+{
+	TestAlignment();
+	TestFenceReuse();
+	TestWrap();
+	TestRandomFrames();
+	return TestResult();
+}
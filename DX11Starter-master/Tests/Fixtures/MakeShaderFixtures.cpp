@@ -0,0 +1,353 @@
+#include "ShaderVariants.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Writes the .cso files ShaderReflectionTest reads
+//
+// There's no shader compiler off Windows, so these are DXBC
+// containers built by hand with the same chunk layouts fxc
+// writes: RDEF (shader model 5 and 5.1), ISGN/OSGN/OSG5 and
+// SHEX. Only what ShaderReflection reads is filled in (no
+// type info, no real bytecode beyond declarations) and the
+// checksum is a hash of the chunks rather than DXBC's own.
+//
+// The fixtures are checked in. Run this to remake them
+// after changing it:
+//  MakeShaderFixtures <Tests/Fixtures directory>
+// --------------------------------------------------------
+
+// D3D values, so the fixtures read like real reflection
+#define SIT_CBUFFER 0
+#define SIT_TEXTURE 2
+#define SIT_SAMPLER 3
+#define SIT_UAV_RWTYPED 4
+#define SIT_STRUCTURED 5
+#define COMPONENT_UINT32 1
+#define COMPONENT_FLOAT32 3
+#define NAME_POSITION 1
+#define NAME_TARGET 64
+
+#define PROGRAM_PIXEL 0xFFFF
+#define PROGRAM_VERTEX 0xFFFE
+#define PROGRAM_COMPUTE 0x4353
+
+struct Variable
+{
+	const char* Name;
+	unsigned int Offset;
+	unsigned int Size;
+};
+
+struct Buffer
+{
+	const char* Name;
+	unsigned int BindPoint;
+	unsigned int Size;
+	std::vector<Variable> Variables;
+};
+
+struct Binding
+{
+	const char* Name;
+	unsigned int Type;
+	unsigned int BindPoint;
+	unsigned int BindCount;
+};
+
+struct Element
+{
+	const char* Name;
+	unsigned int Index;
+	unsigned int SystemValue;
+	unsigned int ComponentType;
+	unsigned int Register;
+	unsigned int Mask;
+};
+
+struct Shader
+{
+	unsigned int ProgramType = PROGRAM_PIXEL;
+	unsigned int Major = 5;
+	unsigned int Minor = 0;
+	std::vector<Buffer> Buffers;
+	std::vector<Binding> Bindings; // Buffers get theirs added
+	std::vector<Element> Inputs;
+	std::vector<Element> Outputs;
+	bool StreamOutputs = false; // OSG5 instead of OSGN
+	unsigned int ThreadGroup[3] = { 0, 0, 0 };
+};
+
+typedef std::vector<unsigned char> Bytes;
+
+static void Put(Bytes& bytes, unsigned int value)
+{
+	for (unsigned int i = 0; i < 4; i++)
+		bytes.push_back((unsigned char)(value >> (i * 8)));
+}
+
+static void Patch(Bytes& bytes, size_t at, unsigned int value)
+{
+	for (unsigned int i = 0; i < 4; i++)
+		bytes[at + i] = (unsigned char)(value >> (i * 8));
+}
+
+static void PutString(Bytes& bytes, const char* value)
+{
+	bytes.insert(bytes.end(), value, value + strlen(value) + 1);
+}
+
+static Bytes MakeRDEF(const Shader& shader)
+{
+	bool sm51 = shader.Major > 5 || (shader.Major == 5 && shader.Minor >= 1);
+	unsigned int bindingSize = sm51 ? 40 : 32;
+	unsigned int variableSize = 40;
+
+	std::vector<Binding> bindings = shader.Bindings;
+	for (const Buffer& b : shader.Buffers)
+	{
+		Binding binding = { b.Name, SIT_CBUFFER, b.BindPoint, 1 };
+		bindings.push_back(binding);
+	}
+
+	unsigned int variableCount = 0;
+	for (const Buffer& b : shader.Buffers)
+		variableCount += (unsigned int)b.Variables.size();
+
+	unsigned int bindingOffset = 60;
+	unsigned int bufferOffset = bindingOffset + (unsigned int)bindings.size() * bindingSize;
+	unsigned int variableOffset = bufferOffset + (unsigned int)shader.Buffers.size() * 24;
+	unsigned int stringOffset = variableOffset + variableCount * variableSize;
+
+	//Names go after everything else, patched in as they're written
+	Bytes rdef;
+	Bytes strings;
+	std::vector<std::pair<size_t, const char*>> names;
+
+	Put(rdef, (unsigned int)shader.Buffers.size());
+	Put(rdef, bufferOffset);
+	Put(rdef, (unsigned int)bindings.size());
+	Put(rdef, bindingOffset);
+	Put(rdef, shader.ProgramType << 16 | shader.Major << 8 | shader.Minor);
+	Put(rdef, 0); // Flags
+	names.push_back(std::make_pair(rdef.size(), "MakeShaderFixtures"));
+	Put(rdef, 0);
+	Put(rdef, 0x31314452); // "RD11"
+	Put(rdef, 60); Put(rdef, 24); Put(rdef, bindingSize); Put(rdef, variableSize); Put(rdef, 36); Put(rdef, 12); Put(rdef, 0);
+
+	for (unsigned int i = 0; i < bindings.size(); i++)
+	{
+		names.push_back(std::make_pair(rdef.size(), bindings[i].Name));
+		Put(rdef, 0);
+		Put(rdef, bindings[i].Type);
+		Put(rdef, bindings[i].Type == SIT_TEXTURE || bindings[i].Type == SIT_UAV_RWTYPED ? 5 : 0); // Return type
+		Put(rdef, bindings[i].Type == SIT_TEXTURE || bindings[i].Type == SIT_UAV_RWTYPED ? 4 : 0); // Dimension
+		Put(rdef, bindings[i].Type == SIT_TEXTURE ? 0xFFFFFFFF : 0); // Samples
+		Put(rdef, bindings[i].BindPoint);
+		Put(rdef, bindings[i].BindCount);
+		Put(rdef, 0); // Flags
+		if (sm51)
+		{
+			Put(rdef, 0); // Space
+			Put(rdef, i); // ID
+		}
+	}
+
+	unsigned int nextVariable = variableOffset;
+	for (const Buffer& b : shader.Buffers)
+	{
+		names.push_back(std::make_pair(rdef.size(), b.Name));
+		Put(rdef, 0);
+		Put(rdef, (unsigned int)b.Variables.size());
+		Put(rdef, nextVariable);
+		Put(rdef, b.Size);
+		Put(rdef, 0); // Flags
+		Put(rdef, 0); // D3D_CT_CBUFFER
+		nextVariable += (unsigned int)b.Variables.size() * variableSize;
+	}
+
+	for (const Buffer& b : shader.Buffers)
+	{
+		for (const Variable& v : b.Variables)
+		{
+			names.push_back(std::make_pair(rdef.size(), v.Name));
+			Put(rdef, 0);
+			Put(rdef, v.Offset);
+			Put(rdef, v.Size);
+			Put(rdef, 2); // Used
+			Put(rdef, 0); // Type offset
+			Put(rdef, 0); // Default value
+			Put(rdef, 0xFFFFFFFF); Put(rdef, 0); Put(rdef, 0xFFFFFFFF); Put(rdef, 0);
+		}
+	}
+
+	for (const auto& name : names)
+	{
+		Patch(rdef, name.first, stringOffset + (unsigned int)strings.size());
+		PutString(strings, name.second);
+	}
+	rdef.insert(rdef.end(), strings.begin(), strings.end());
+	return rdef;
+}
+
+static Bytes MakeSignature(const std::vector<Element>& elements, bool stream)
+{
+	unsigned int elementSize = stream ? 28 : 24;
+	unsigned int stringOffset = 8 + (unsigned int)elements.size() * elementSize;
+
+	Bytes signature, strings;
+	Put(signature, (unsigned int)elements.size());
+	Put(signature, 8);
+	for (const Element& e : elements)
+	{
+		if (stream)
+			Put(signature, 0);
+		Put(signature, stringOffset + (unsigned int)strings.size());
+		PutString(strings, e.Name);
+		Put(signature, e.Index);
+		Put(signature, e.SystemValue);
+		Put(signature, e.ComponentType);
+		Put(signature, e.Register);
+		Put(signature, e.Mask | e.Mask << 8);
+	}
+	signature.insert(signature.end(), strings.begin(), strings.end());
+	return signature;
+}
+
+// Declarations only: global flags, a customdata block (which
+// has its own length rule), dcl_thread_group, then ret
+static Bytes MakeSHEX(const Shader& shader)
+{
+	Bytes shex;
+	unsigned int type = shader.ProgramType == PROGRAM_COMPUTE ? 5 : shader.ProgramType == PROGRAM_VERTEX ? 1 : 0;
+	Put(shex, type << 16 | shader.Major << 4 | shader.Minor);
+	Put(shex, 0); // Token count, patched below
+	Put(shex, 1 << 24 | 1 << 11 | 106); // dcl_globalFlags refactoringAllowed
+	Put(shex, 53); Put(shex, 4); Put(shex, 0x12345678); Put(shex, 0x9ABCDEF0); // customdata
+	if (shader.ThreadGroup[0] > 0)
+	{
+		Put(shex, 4 << 24 | 155);
+		Put(shex, shader.ThreadGroup[0]); Put(shex, shader.ThreadGroup[1]); Put(shex, shader.ThreadGroup[2]);
+	}
+	Put(shex, 1 << 24 | 62); // ret
+	Patch(shex, 4, (unsigned int)shex.size() / 4);
+	return shex;
+}
+
+static Bytes MakeContainer(const Shader& shader)
+{
+	std::vector<std::pair<const char*, Bytes>> chunks;
+	chunks.push_back(std::make_pair("RDEF", MakeRDEF(shader)));
+	chunks.push_back(std::make_pair("ISGN", MakeSignature(shader.Inputs, false)));
+	chunks.push_back(std::make_pair(shader.StreamOutputs ? "OSG5" : "OSGN", MakeSignature(shader.Outputs, shader.StreamOutputs)));
+	chunks.push_back(std::make_pair("SHEX", MakeSHEX(shader)));
+
+	Bytes body;
+	std::vector<unsigned int> offsets;
+	unsigned int headerSize = 32 + (unsigned int)chunks.size() * 4;
+	for (const auto& chunk : chunks)
+	{
+		offsets.push_back(headerSize + (unsigned int)body.size());
+		body.insert(body.end(), chunk.first, chunk.first + 4);
+		Put(body, (unsigned int)chunk.second.size());
+		body.insert(body.end(), chunk.second.begin(), chunk.second.end());
+	}
+
+	Bytes container = { 'D', 'X', 'B', 'C' };
+	unsigned long long hash = HashShaderBytes(body.data(), body.size());
+	unsigned long long hash2 = HashShaderBytes(&hash, sizeof(hash), hash);
+	for (unsigned int i = 0; i < 8; i++) container.push_back((unsigned char)(hash >> (i * 8)));
+	for (unsigned int i = 0; i < 8; i++) container.push_back((unsigned char)(hash2 >> (i * 8)));
+	Put(container, 1);
+	Put(container, headerSize + (unsigned int)body.size());
+	Put(container, (unsigned int)chunks.size());
+	for (unsigned int offset : offsets)
+		Put(container, offset);
+	container.insert(container.end(), body.begin(), body.end());
+	return container;
+}
+
+static bool Save(const std::string& directory, const char* name, const Bytes& bytes)
+{
+	std::string path = directory + "/" + name;
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		printf("Can't write %s\n", path.c_str());
+		return false;
+	}
+	fwrite(bytes.data(), 1, bytes.size(), file);
+	fclose(file);
+	printf("%s: %u bytes\n", path.c_str(), (unsigned int)bytes.size());
+	return true;
+}
+
+// A pixel shader like PixelShader.hlsl, with or without its normal map
+static Shader MakePixelShader(bool normalMap)
+{
+	Shader shader;
+	Buffer perFrame = { "PerFrame", 0, 32, { { "cameraPosition", 0, 12 }, { "lightCount", 12, 4 }, { "ambientColor", 16, 12 } } };
+	Buffer perMaterial = { "PerMaterial", 1, 48, { { "colorTint", 0, 16 }, { "scale", 16, 8 }, { "offset", 24, 8 }, { "roughness", 32, 4 } } };
+	shader.Buffers.push_back(perFrame);
+	shader.Buffers.push_back(perMaterial);
+
+	shader.Bindings.push_back({ "BasicSampler", SIT_SAMPLER, 0, 1 });
+	shader.Bindings.push_back({ "ShadowSampler", SIT_SAMPLER, 1, 1 });
+	shader.Bindings.push_back({ "Albedo", SIT_TEXTURE, 0, 1 });
+	if (normalMap)
+		shader.Bindings.push_back({ "NormalMap", SIT_TEXTURE, 1, 1 });
+	shader.Bindings.push_back({ "Lights", SIT_STRUCTURED, 4, 1 });
+	shader.Bindings.push_back({ "ShadowMaps", SIT_TEXTURE, 5, 4 });
+
+	shader.Inputs.push_back({ "SV_POSITION", 0, NAME_POSITION, COMPONENT_FLOAT32, 0, 0xF });
+	shader.Inputs.push_back({ "NORMAL", 0, 0, COMPONENT_FLOAT32, 1, 0x7 });
+	shader.Inputs.push_back({ "TEXCOORD", 0, 0, COMPONENT_FLOAT32, 2, 0x3 });
+	if (normalMap)
+		shader.Inputs.push_back({ "TANGENT", 0, 0, COMPONENT_FLOAT32, 3, 0x7 });
+	shader.Outputs.push_back({ "SV_TARGET", 0, NAME_TARGET, COMPONENT_FLOAT32, 0, 0xF });
+	return shader;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: MakeShaderFixtures <output directory>\n");
+		return 1;
+	}
+	std::string directory = argv[1];
+
+	//Constant buffers and nothing else
+	Shader buffers;
+	buffers.ProgramType = PROGRAM_VERTEX;
+	buffers.Buffers.push_back({ "$Globals", 0, 16, { { "time", 0, 4 }, { "frame", 4, 4 } } });
+	buffers.Buffers.push_back({ "PerObject", 2, 128, { { "world", 0, 64 }, { "worldInverseTranspose", 64, 64 } } });
+	buffers.Buffers.push_back({ "Empty", 3, 16, {} });
+	buffers.Inputs.push_back({ "POSITION", 0, 0, COMPONENT_FLOAT32, 0, 0x7 });
+	buffers.Inputs.push_back({ "WORLD_PER_INSTANCE", 0, 0, COMPONENT_FLOAT32, 1, 0xF });
+	buffers.Inputs.push_back({ "WORLD_PER_INSTANCE", 1, 0, COMPONENT_FLOAT32, 2, 0xF });
+	buffers.Inputs.push_back({ "BLENDINDICES", 0, 0, COMPONENT_UINT32, 3, 0x1 });
+	buffers.Outputs.push_back({ "SV_POSITION", 0, NAME_POSITION, COMPONENT_FLOAT32, 0, 0xF });
+	buffers.Outputs.push_back({ "TEXCOORD", 0, 0, COMPONENT_FLOAT32, 1, 0x3 });
+	buffers.StreamOutputs = true;
+
+	//Shader model 5.1 compute, for the wider bindings and thread groups
+	Shader compute;
+	compute.ProgramType = PROGRAM_COMPUTE;
+	compute.Minor = 1;
+	compute.Buffers.push_back({ "ClusterInfo", 0, 16, { { "tileCount", 0, 12 }, { "lightCount", 12, 4 } } });
+	compute.Bindings.push_back({ "Lights", SIT_STRUCTURED, 0, 1 });
+	compute.Bindings.push_back({ "ClusterRanges", SIT_UAV_RWTYPED, 0, 1 });
+	compute.ThreadGroup[0] = 8;
+	compute.ThreadGroup[1] = 8;
+	compute.ThreadGroup[2] = 1;
+
+	bool saved =
+		Save(directory, "ConstantBuffersVS.cso", MakeContainer(buffers)) &&
+		Save(directory, "ResourcesPS.cso", MakeContainer(MakePixelShader(true))) &&
+		Save(directory, "ResourcesPS_NoNormalMap.cso", MakeContainer(MakePixelShader(false))) &&
+		Save(directory, "ClustersCS.cso", MakeContainer(compute));
+	return saved ? 0 : 1;
+}
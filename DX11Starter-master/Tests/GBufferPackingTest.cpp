@@ -0,0 +1,281 @@
+#include "TestHelpers.h"
+#include "GBufferPacking.h"
+#include <cmath>
+
+using namespace DirectX;
+
+// Worst angle between a normal and its round trip through the
+// G-buffer. 12 + 12 bit octahedral comes to about 0.06 degrees
+// at its worst.
+#define MAX_NORMAL_ERROR_DEGREES 0.07
+
+// atan2 rather than acos, which can't resolve small angles
+static double AngleDegrees(XMFLOAT3 a, XMFLOAT3 b)
+{
+	double crossX = (double)a.y * b.z - (double)a.z * b.y;
+	double crossY = (double)a.z * b.x - (double)a.x * b.z;
+	double crossZ = (double)a.x * b.y - (double)a.y * b.x;
+	double dot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+	return atan2(sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ), dot) * 180.0 / 3.14159265358979;
+}
+
+static XMFLOAT3 Normalized(float x, float y, float z)
+{
+	float length = sqrtf(x * x + y * y + z * z);
+	return XMFLOAT3(x / length, y / length, z / length);
+}
+
+static XMFLOAT3 RoundTripNormal(XMFLOAT3 normal)
+{
+	GBufferSurface surface = {};
+	surface.Normal = normal;
+	return UnpackGBuffer(PackGBuffer(surface)).Normal;
+}
+
+static bool IsUnitLength(XMFLOAT3 v)
+{
+	return fabsf(sqrtf(v.x * v.x + v.y * v.y + v.z * v.z) - 1.0f) < 1e-5f;
+}
+
+// --------------------------------------------------------
+// Normals spread evenly over the whole sphere (a Fibonacci
+// spiral), through the packed targets and back
+// --------------------------------------------------------
+static void TestNormalErrorOverSphere()
+{
+	const unsigned int count = 200000;
+	const double goldenAngle = 3.14159265358979 * (3.0 - sqrt(5.0));
+	double worst = 0.0;
+	bool allUnit = true;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		double z = 1.0 - 2.0 * (i + 0.5) / count;
+		double radius = sqrt(1.0 - z * z);
+		XMFLOAT3 normal((float)(radius * cos(goldenAngle * i)), (float)(radius * sin(goldenAngle * i)), (float)z);
+
+		XMFLOAT3 decoded = RoundTripNormal(normal);
+		double error = AngleDegrees(normal, decoded);
+		if (error > worst) worst = error;
+		allUnit = allUnit && IsUnitLength(decoded);
+	}
+
+	printf("Worst normal error: %.4f degrees\n", worst);
+	CHECK(worst <= MAX_NORMAL_ERROR_DEGREES);
+	CHECK(allUnit);
+
+	//Without the 12 bit quantization it's just float error
+	double unquantized = 0.0;
+	for (unsigned int i = 0; i < 1000; i++)
+	{
+		double z = 1.0 - 2.0 * (i + 0.5) / 1000;
+		double radius = sqrt(1.0 - z * z);
+		XMFLOAT3 normal((float)(radius * cos(goldenAngle * i)), (float)(radius * sin(goldenAngle * i)), (float)z);
+		double error = AngleDegrees(normal, DecodeOctahedral(EncodeOctahedral(normal)));
+		if (error > unquantized) unquantized = error;
+	}
+	CHECK(unquantized < 0.01);
+}
+
+// --------------------------------------------------------
+// The axes land on the centre, corners and edge midpoints of
+// the square, and the lower half folds over at z = 0 and
+// meets itself again around -Z; all of them have to survive
+// --------------------------------------------------------
+static void TestAxesAndSeams()
+{
+	//0.5 falls between two 12 bit values, so +Z and the axes
+	//around the equator come back half a step off (about 0.02
+	//degrees). -Z is on the corners, which are exact.
+	XMFLOAT3 axes[] =
+	{
+		XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0),
+		XMFLOAT3(0, 1, 0), XMFLOAT3(0, -1, 0),
+		XMFLOAT3(0, 0, 1),
+	};
+	for (XMFLOAT3 axis : axes)
+		CHECK(AngleDegrees(axis, RoundTripNormal(axis)) < 0.025);
+	CHECK(AngleDegrees(XMFLOAT3(0, 0, -1), RoundTripNormal(XMFLOAT3(0, 0, -1))) < 1e-4);
+
+	//+Z is the centre of the square, -Z its corners
+	XMFLOAT2 up = EncodeOctahedral(XMFLOAT3(0, 0, 1));
+	CHECK_NEAR(up.x, 0.5, 1e-6);
+	CHECK_NEAR(up.y, 0.5, 1e-6);
+	XMFLOAT2 down = EncodeOctahedral(XMFLOAT3(0, 0, -1));
+	CHECK(down.x == 0.0f || down.x == 1.0f);
+	CHECK(down.y == 0.0f || down.y == 1.0f);
+
+	//Either side of the fold, and all the way around it
+	float sides[] = { 1e-4f, 0.0f, -1e-4f, -0.01f };
+	for (float z : sides)
+	{
+		for (unsigned int i = 0; i < 360; i++)
+		{
+			float angle = i * 3.14159265f / 180.0f;
+			XMFLOAT3 normal = Normalized(cosf(angle), sinf(angle), z);
+			CHECK(AngleDegrees(normal, RoundTripNormal(normal)) <= MAX_NORMAL_ERROR_DEGREES);
+		}
+	}
+
+	//Near -Z, from every quadrant: the four corners are the same direction
+	float offsets[] = { 1e-3f, -1e-3f, 1e-6f, -1e-6f };
+	for (float x : offsets)
+	{
+		for (float y : offsets)
+		{
+			XMFLOAT3 normal = Normalized(x, y, -1.0f);
+			XMFLOAT3 decoded = RoundTripNormal(normal);
+			CHECK(AngleDegrees(normal, decoded) <= MAX_NORMAL_ERROR_DEGREES);
+			CHECK(decoded.z < -0.9999f);
+		}
+	}
+
+	//And on the edges of the square, where x or y is 0 below the fold
+	XMFLOAT3 edges[] = { Normalized(1, 0, -1), Normalized(-1, 0, -1), Normalized(0, 1, -1), Normalized(0, -1, -1) };
+	for (XMFLOAT3 normal : edges)
+		CHECK(AngleDegrees(normal, RoundTripNormal(normal)) <= MAX_NORMAL_ERROR_DEGREES);
+}
+
+// --------------------------------------------------------
+// The 12 bit split over three bytes loses nothing, and each
+// 8 bit channel rounds to the nearest of its 256 values
+// --------------------------------------------------------
+static void TestQuantization()
+{
+	//Every 12 bit pair comes back exactly
+	bool exact = true;
+	for (unsigned int x = 0; x < 4096; x += 3)
+	{
+		for (unsigned int y = 0; y < 4096; y += 5)
+		{
+			XMFLOAT2 encoded(x / 4095.0f, y / 4095.0f);
+			XMFLOAT2 unpacked = UnpackOctahedral12(PackOctahedral12(encoded));
+			exact = exact && (unsigned int)floorf(unpacked.x * 4095.0f + 0.5f) == x;
+			exact = exact && (unsigned int)floorf(unpacked.y * 4095.0f + 0.5f) == y;
+		}
+	}
+	CHECK(exact);
+
+	//Every 8 bit value survives, in every channel
+	bool allValues = true;
+	for (unsigned int value = 0; value < 256; value++)
+	{
+		GBufferSurface surface = {};
+		surface.Albedo = XMFLOAT3(value / 255.0f, (255 - value) / 255.0f, value / 255.0f);
+		surface.Metalness = (255 - value) / 255.0f;
+		surface.Roughness = value / 255.0f;
+		surface.Normal = XMFLOAT3(0, 0, 1);
+
+		GBufferTexel texel = PackGBuffer(surface);
+		allValues = allValues && (texel.Target0 & 0xFF) == value;
+		allValues = allValues && ((texel.Target0 >> 8) & 0xFF) == 255 - value;
+		allValues = allValues && ((texel.Target0 >> 16) & 0xFF) == value;
+		allValues = allValues && (texel.Target0 >> 24) == 255 - value;
+		allValues = allValues && (texel.Target1 >> 24) == value;
+
+		GBufferSurface unpacked = UnpackGBuffer(texel);
+		allValues = allValues && unpacked.Albedo.x == value / 255.0f && unpacked.Roughness == value / 255.0f;
+	}
+	CHECK(allValues);
+
+	//Anything else rounds to the nearest, at most half a step off
+	double worst = 0.0;
+	for (unsigned int i = 0; i <= 10000; i++)
+	{
+		GBufferSurface surface = {};
+		surface.Albedo = XMFLOAT3(i / 10000.0f, 0, 0);
+		surface.Roughness = i / 10000.0f;
+		surface.Normal = XMFLOAT3(0, 0, 1);
+		GBufferSurface unpacked = UnpackGBuffer(PackGBuffer(surface));
+		worst = fmax(worst, fabs(unpacked.Albedo.x - surface.Albedo.x));
+		worst = fmax(worst, fabs(unpacked.Roughness - surface.Roughness));
+	}
+	CHECK(worst <= 0.5 / 255.0 + 1e-6);
+
+	//Out of range values clamp, as the GPU's UNORM conversion does
+	GBufferSurface outside = {};
+	outside.Albedo = XMFLOAT3(-0.5f, 1.5f, 2.0f);
+	outside.Metalness = -1.0f;
+	outside.Roughness = 3.0f;
+	outside.Normal = XMFLOAT3(0, 0, 1);
+	GBufferTexel texel = PackGBuffer(outside);
+	CHECK(texel.Target0 == 0x00FFFF00);
+	CHECK((texel.Target1 >> 24) == 0xFF);
+}
+
+// --------------------------------------------------------
+// Projects known points with a camera's view-projection,
+// then brings them back from screen position and depth
+// --------------------------------------------------------
+static void TestReconstructWorldPosition()
+{
+	float nearZ = 0.1f, farZ = 100.0f;
+	XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(2, 3, -6, 0), XMVectorSet(0, 1, 0, 0), XMVectorSet(0, 1, 0, 0));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XMConvertToRadians(60.0f), 16.0f / 9.0f, nearZ, farZ);
+	XMMATRIX viewProjection = view * projection;
+
+	XMFLOAT4X4 inverseViewProjection;
+	XMStoreFloat4x4(&inverseViewProjection, XMMatrixInverse(0, viewProjection));
+
+	//The point the camera looks at is in the middle of the screen
+	XMVECTOR focus = XMVector4Transform(XMVectorSet(0, 1, 0, 1), viewProjection);
+	float focusDepth = XMVectorGetZ(focus) / XMVectorGetW(focus);
+	float viewDepth = 0.0f;
+	XMFLOAT3 centre = ReconstructWorldPosition(inverseViewProjection, XMFLOAT2(0.5f, 0.5f), focusDepth, &viewDepth);
+	CHECK_NEAR(centre.x, 0.0, 1e-3);
+	CHECK_NEAR(centre.y, 1.0, 1e-3);
+	CHECK_NEAR(centre.z, 0.0, 1e-3);
+	CHECK_NEAR(viewDepth, sqrt(4.0 + 4.0 + 36.0), 1e-3);
+
+	//Depth 0 and 1 are the near and far planes
+	ReconstructWorldPosition(inverseViewProjection, XMFLOAT2(0.5f, 0.5f), 0.0f, &viewDepth);
+	CHECK_NEAR(viewDepth, nearZ, 1e-4);
+	ReconstructWorldPosition(inverseViewProjection, XMFLOAT2(0.5f, 0.5f), 1.0f, &viewDepth);
+	CHECK_NEAR(viewDepth, farZ, 0.05);
+
+	//Points all over the view, including near the edges and far away
+	XMFLOAT3 points[] =
+	{
+		XMFLOAT3(0, 0, 0), XMFLOAT3(1, 2, 3), XMFLOAT3(-4, 0.5f, 10),
+		XMFLOAT3(5, -1, 20), XMFLOAT3(-2, 4, 1), XMFLOAT3(10, 10, 60),
+	};
+	for (XMFLOAT3 point : points)
+	{
+		XMVECTOR clip = XMVector4Transform(XMVectorSet(point.x, point.y, point.z, 1), viewProjection);
+		float w = XMVectorGetW(clip);
+		CHECK(w > nearZ);
+
+		//uv has y down, NDC has y up
+		float ndcX = XMVectorGetX(clip) / w;
+		float ndcY = XMVectorGetY(clip) / w;
+		XMFLOAT2 uv(ndcX * 0.5f + 0.5f, 0.5f - ndcY * 0.5f);
+		float depth = XMVectorGetZ(clip) / w;
+
+		XMFLOAT3 world = ReconstructWorldPosition(inverseViewProjection, uv, depth, &viewDepth);
+		double tolerance = 1e-4 * w * w; //Depth precision falls off with distance
+		CHECK_NEAR(world.x, point.x, tolerance);
+		CHECK_NEAR(world.y, point.y, tolerance);
+		CHECK_NEAR(world.z, point.z, tolerance);
+		CHECK_NEAR(viewDepth, w, tolerance);
+	}
+
+	//Screen corners at the near plane span the frustum's near rectangle
+	XMFLOAT3 topLeft = ReconstructWorldPosition(inverseViewProjection, XMFLOAT2(0, 0), 0.0f);
+	XMFLOAT3 bottomRight = ReconstructWorldPosition(inverseViewProjection, XMFLOAT2(1, 1), 0.0f);
+	XMVECTOR topLeftView = XMVector3TransformCoord(XMVectorSet(topLeft.x, topLeft.y, topLeft.z, 1), view);
+	XMVECTOR bottomRightView = XMVector3TransformCoord(XMVectorSet(bottomRight.x, bottomRight.y, bottomRight.z, 1), view);
+	float halfHeight = nearZ * tanf(XMConvertToRadians(30.0f));
+	CHECK_NEAR(XMVectorGetY(topLeftView), halfHeight, 1e-5);
+	CHECK_NEAR(XMVectorGetX(topLeftView), -halfHeight * 16.0f / 9.0f, 1e-5);
+	CHECK_NEAR(XMVectorGetY(bottomRightView), -halfHeight, 1e-5);
+	CHECK_NEAR(XMVectorGetX(bottomRightView), halfHeight * 16.0f / 9.0f, 1e-5);
+}
+
+int main()
+{
+	TestNormalErrorOverSphere();
+	TestAxesAndSeams();
+	TestQuantization();
+	TestReconstructWorldPosition();
+	return TestResult();
+}
@@ -0,0 +1,120 @@
+#include "TestHelpers.h"
+#include "InstanceBatcher.h"
+
+using namespace DirectX;
+
+static XMFLOAT4X4 Translation(float x, float y, float z)
+{
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, XMMatrixTranslation(x, y, z));
+	return m;
+}
+
+// --------------------------------------------------------
+// Only neighbours with the same mesh, material and shader
+// merge, so the queue's order survives batching
+// --------------------------------------------------------
+static void TestGrouping()
+{
+	int meshA, meshB, materialA, materialB, shaderA, shaderB;
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	InstanceBatcher batcher;
+	batcher.Begin();
+	batcher.Add(10, &meshA, &materialA, &shaderA, identity, identity);
+	batcher.Add(11, &meshA, &materialA, &shaderA, identity, identity);
+	batcher.Add(12, &meshA, &materialA, &shaderA, identity, identity);
+	batcher.Add(13, &meshB, &materialA, &shaderA, identity, identity); // New mesh
+	batcher.Add(14, &meshB, &materialB, &shaderA, identity, identity); // New material
+	batcher.Add(15, &meshB, &materialB, &shaderB, identity, identity); // New shader
+	batcher.Add(16, &meshB, &materialB, &shaderB, identity, identity);
+	batcher.Add(17, &meshA, &materialA, &shaderA, identity, identity); // Same as the first, but not next to it
+	batcher.Build(identity);
+
+	const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+	CHECK(batcher.GetItemCount() == 8);
+	CHECK(batcher.GetInstances().size() == 8);
+	CHECK(batches.size() == 5);
+	if (batches.size() != 5)
+		return;
+
+	const unsigned int firstInstances[] = { 0, 3, 4, 5, 7 };
+	const unsigned int counts[] = { 3, 1, 1, 2, 1 };
+	const unsigned int firstItems[] = { 10, 13, 14, 15, 17 };
+	for (unsigned int i = 0; i < 5; i++)
+	{
+		CHECK(batches[i].FirstInstance == firstInstances[i]);
+		CHECK(batches[i].InstanceCount == counts[i]);
+		CHECK(batches[i].FirstItem == firstItems[i]);
+	}
+
+	CHECK(batches[0].Mesh == &meshA && batches[0].Material == &materialA && batches[0].Shader == &shaderA);
+	CHECK(batches[3].Mesh == &meshB && batches[3].Material == &materialB && batches[3].Shader == &shaderB);
+	CHECK(batches[4].Mesh == &meshA && batches[4].Material == &materialA && batches[4].Shader == &shaderA);
+}
+
+// Instances are packed in item order with world-view-projection worked out
+static void TestPacking()
+{
+	int mesh, material, shader;
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(
+		XMMatrixTranslation(0, 0, 5), XMMatrixPerspectiveFovLH(XM_PIDIV4, 1.5f, 0.1f, 100.0f)));
+
+	InstanceBatcher batcher;
+	batcher.Begin();
+	for (unsigned int i = 0; i < 100; i++)
+	{
+		XMFLOAT4X4 world = Translation((float)i, (float)i * 0.5f, -(float)i);
+		XMFLOAT4X4 inverseTranspose = Translation(0, (float)i, 0);
+		batcher.Add(i, &mesh, &material, &shader, world, inverseTranspose);
+	}
+	batcher.Build(viewProjection);
+
+	CHECK(batcher.GetBatches().size() == 1);
+	CHECK(batcher.GetBatches()[0].InstanceCount == 100);
+
+	const std::vector<InstanceData>& instances = batcher.GetInstances();
+	for (unsigned int i = 0; i < instances.size(); i++)
+	{
+		CHECK(instances[i].World._41 == (float)i);
+		CHECK(instances[i].WorldInverseTranspose._42 == (float)i);
+
+		XMFLOAT4X4 expected;
+		XMStoreFloat4x4(&expected, XMMatrixMultiply(XMLoadFloat4x4(&instances[i].World), XMLoadFloat4x4(&viewProjection)));
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+				CHECK_NEAR(instances[i].WorldViewProjection.m[r][c], expected.m[r][c], 1e-4f);
+		}
+	}
+}
+
+// Begin() starts a fresh frame, and an empty frame has no batches
+static void TestBegin()
+{
+	int mesh, material, shader;
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	InstanceBatcher batcher;
+	batcher.Begin();
+	batcher.Add(0, &mesh, &material, &shader, identity, identity);
+	batcher.Build(identity);
+	CHECK(batcher.GetBatches().size() == 1);
+
+	batcher.Begin();
+	batcher.Build(identity);
+	CHECK(batcher.GetItemCount() == 0);
+	CHECK(batcher.GetBatches().empty());
+	CHECK(batcher.GetInstances().empty());
+}
+
+int main()
+{
+	TestGrouping();
+	TestPacking();
+	TestBegin();
+	return TestResult();
+}
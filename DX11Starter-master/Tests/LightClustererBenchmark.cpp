@@ -0,0 +1,108 @@
+#include "TestHelpers.h"
+#include "CpuFeatures.h"
+#include "LightClusterer.h"
+#include "Lights.h"
+#include "ThreadPool.h"
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless light clustering benchmark
+//
+// 10,000 point and spot lights scattered over a town, seen
+// through the game's 16x9x24 clusters (120 pixel tiles at
+// 1080p). Reports the time per Assign() for the scalar path,
+// and for the AVX2 path if the CPU has it, and checks both
+// agree.
+//
+// Usage: LightClustererBenchmark [--quick] [--threads N]
+// --------------------------------------------------------
+
+struct BenchmarkResult
+{
+	double MillisecondsPerAssign;
+	unsigned int MaxLightsPerCluster;
+	std::vector<unsigned int> LightIndices;
+};
+
+static BenchmarkResult Run(LightClusterer& clusterer, const XMFLOAT4X4& view, const XMFLOAT4X4& projection,
+	const std::vector<int>& types, const std::vector<XMFLOAT3>& positions, const std::vector<float>& ranges, unsigned int frames)
+{
+	BenchmarkResult result = {};
+	double seconds = 0.0;
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		clusterer.Assign(view, projection, 0.1f, 300.0f, &types[0], &positions[0], &ranges[0], (unsigned int)types.size());
+		seconds += clusterer.GetAssignSeconds();
+	}
+
+	result.MillisecondsPerAssign = seconds * 1000.0 / frames;
+	result.MaxLightsPerCluster = clusterer.GetMaxLightsPerCluster();
+	result.LightIndices = clusterer.GetLightIndices();
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = HasArgument(argc, argv, "--quick");
+	unsigned int threads = 0;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--threads") == 0)
+			threads = (unsigned int)atoi(argv[i + 1]);
+	}
+
+	//Street lights, windows and so on: mostly small, a few big
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<int> types;
+	std::vector<XMFLOAT3> positions;
+	std::vector<float> ranges;
+	for (unsigned int i = 0; i < 10000; i++)
+	{
+		types.push_back(i & 1 ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT);
+		positions.push_back(XMFLOAT3((unit(random) - 0.5f) * 400.0f, unit(random) * 20.0f, (unit(random) - 0.2f) * 400.0f));
+		ranges.push_back(1.0f + unit(random) * unit(random) * 15.0f);
+	}
+	types[0] = LIGHT_TYPE_DIRECTIONAL;
+
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0, 3, 0, 0), XMVectorSet(0.2f, -0.05f, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 300.0f));
+
+	ThreadPool threadPool(threads);
+	LightClusterer clusterer(16, 9, 24, &threadPool);
+	unsigned int frames = quick ? 3 : 200;
+
+	printf("Light clusterer %ux%ux%u, %u thread(s), %u lights, %u frame(s)\n",
+		clusterer.GetTilesX(), clusterer.GetTilesY(), clusterer.GetSliceCount(),
+		threadPool.GetThreadCount(), (unsigned int)types.size(), frames);
+
+	clusterer.SetUseAVX2(false);
+	BenchmarkResult scalar = Run(clusterer, view, projection, types, positions, ranges, frames);
+	printf("  Scalar: %8.3f ms per assign (%u indices, at most %u per cluster)\n",
+		scalar.MillisecondsPerAssign, (unsigned int)scalar.LightIndices.size(), scalar.MaxLightsPerCluster);
+
+	//Every cluster has the directional light, and some have a lot more
+	CHECK(scalar.LightIndices.size() > clusterer.GetClusterCount());
+	CHECK(scalar.MaxLightsPerCluster > 1);
+
+	if (CpuHasAVX2())
+	{
+		clusterer.SetUseAVX2(true);
+		BenchmarkResult avx2 = Run(clusterer, view, projection, types, positions, ranges, frames);
+		printf("  AVX2:   %8.3f ms per assign (%u indices, at most %u per cluster)\n",
+			avx2.MillisecondsPerAssign, (unsigned int)avx2.LightIndices.size(), avx2.MaxLightsPerCluster);
+
+		CHECK(avx2.LightIndices == scalar.LightIndices);
+	}
+	else
+	{
+		printf("  AVX2:   not supported by this CPU\n");
+	}
+
+	return TestResult();
+}
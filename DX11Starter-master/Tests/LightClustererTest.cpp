@@ -0,0 +1,343 @@
+#include "TestHelpers.h"
+#include "CpuFeatures.h"
+#include "LightClusterer.h"
+#include "Lights.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// LightClusterer against a brute force assignment: every
+// light's sphere tested against every cluster
+//
+// - A cluster is really a slab of a frustum. Any light that
+//   reaches that must be listed.
+// - The clusterer may list a few more, as it tests against
+//   the box around the cluster, but never anything outside
+//   that box's reach
+// - Both give or take rounding
+// --------------------------------------------------------
+
+#define TEST_NEAR 0.1f
+#define TEST_FAR 200.0f
+
+struct TestLights
+{
+	std::vector<int> Types;
+	std::vector<XMFLOAT3> Positions;
+	std::vector<float> Ranges;
+	unsigned int Count() const { return (unsigned int)Types.size(); }
+};
+
+struct Output
+{
+	std::vector<ClusterRange> Clusters;
+	std::vector<unsigned int> LightIndices;
+	unsigned int MaxLightsPerCluster;
+	bool operator==(const Output& o) const
+	{
+		if (Clusters.size() != o.Clusters.size() || LightIndices != o.LightIndices || MaxLightsPerCluster != o.MaxLightsPerCluster)
+			return false;
+		for (size_t i = 0; i < Clusters.size(); i++)
+		{
+			if (Clusters[i].Offset != o.Clusters[i].Offset || Clusters[i].Count != o.Clusters[i].Count)
+				return false;
+		}
+		return true;
+	}
+};
+
+// Lights all around the camera: in front, behind, off to the
+// sides, straddling the near plane, past the far plane,
+// a few directional and a few with no range
+static TestLights MakeLights(unsigned int count, unsigned int seed)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	TestLights lights;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		int type = i % 50 == 0 ? LIGHT_TYPE_DIRECTIONAL : (i & 1 ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT);
+		float range = i % 37 == 0 ? 0.0f : 0.2f + unit(random) * unit(random) * 30.0f;
+		lights.Types.push_back(type);
+		lights.Positions.push_back(XMFLOAT3((unit(random) - 0.5f) * 300.0f, (unit(random) - 0.5f) * 60.0f, (unit(random) - 0.3f) * 300.0f));
+		lights.Ranges.push_back(range);
+	}
+
+	//Hand placed: on the eye, just behind it, just past the far plane
+	lights.Types.insert(lights.Types.end(), { LIGHT_TYPE_POINT, LIGHT_TYPE_POINT, LIGHT_TYPE_POINT });
+	lights.Positions.push_back(XMFLOAT3(0, 2, -5));
+	lights.Positions.push_back(XMFLOAT3(0, 2, -6));
+	lights.Positions.push_back(XMFLOAT3(0, 2, -5 + TEST_FAR + 1.0f));
+	lights.Ranges.insert(lights.Ranges.end(), { 0.5f, 0.95f, 1.5f });
+	return lights;
+}
+
+static Output Run(LightClusterer& clusterer, const XMFLOAT4X4& view, const XMFLOAT4X4& projection, const TestLights& lights)
+{
+	clusterer.Assign(view, projection, TEST_NEAR, TEST_FAR, &lights.Types[0], &lights.Positions[0], &lights.Ranges[0], lights.Count());
+	Output output;
+	output.Clusters = clusterer.GetClusters();
+	output.LightIndices = clusterer.GetLightIndices();
+	output.MaxLightsPerCluster = clusterer.GetMaxLightsPerCluster();
+	return output;
+}
+
+// Everything here is in double so it's a fair referee for the
+// clusterer's floats
+struct Vec
+{
+	double X, Y, Z;
+	Vec operator-(const Vec& v) const { return { X - v.X, Y - v.Y, Z - v.Z }; }
+	Vec operator+(const Vec& v) const { return { X + v.X, Y + v.Y, Z + v.Z }; }
+	Vec operator*(double s) const { return { X * s, Y * s, Z * s }; }
+};
+
+static double Dot(const Vec& a, const Vec& b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z; }
+static Vec Cross(const Vec& a, const Vec& b) { return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X }; }
+
+static double SegmentDistanceSquared(const Vec& p, const Vec& a, const Vec& b)
+{
+	Vec ab = b - a;
+	double t = std::min(1.0, std::max(0.0, Dot(p - a, ab) / Dot(ab, ab)));
+	Vec d = p - (a + ab * t);
+	return Dot(d, d);
+}
+
+// Squared distance from a point to a box
+static double BoxDistanceSquared(const Vec& p, const Vec& boxMin, const Vec& boxMax)
+{
+	double dx = std::max(0.0, std::max(boxMin.X - p.X, p.X - boxMax.X));
+	double dy = std::max(0.0, std::max(boxMin.Y - p.Y, p.Y - boxMax.Y));
+	double dz = std::max(0.0, std::max(boxMin.Z - p.Z, p.Z - boxMax.Z));
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// --------------------------------------------------------
+// Squared distance from a point to a convex solid given by
+// its 8 corners (bit 0 x, bit 1 y, bit 2 z). Zero inside,
+// otherwise the nearest of its 6 faces.
+// --------------------------------------------------------
+static double SolidDistanceSquared(const Vec& p, const Vec corners[8])
+{
+	const int faces[6][4] =
+	{
+		{ 0, 1, 3, 2 }, { 4, 6, 7, 5 }, // near, far
+		{ 0, 2, 6, 4 }, { 1, 5, 7, 3 }, // left, right
+		{ 0, 4, 5, 1 }, { 2, 3, 7, 6 }  // top, bottom
+	};
+
+	Vec center = { 0, 0, 0 };
+	for (int c = 0; c < 8; c++)
+		center = center + corners[c] * 0.125;
+
+	bool inside = true;
+	double best = 1e300;
+	for (auto& f : faces)
+	{
+		Vec normal = Cross(corners[f[1]] - corners[f[0]], corners[f[3]] - corners[f[0]]);
+		normal = normal * (1.0 / sqrt(Dot(normal, normal)));
+		if (Dot(normal, center - corners[f[0]]) > 0.0)
+			normal = normal * -1.0;
+
+		//Outward normal, so positive is outside this face's plane
+		double planeDistance = Dot(normal, p - corners[f[0]]);
+		if (planeDistance > 0.0)
+			inside = false;
+
+		//Over the face? Then straight down to it, otherwise its nearest edge
+		bool overFace = true;
+		for (int e = 0; e < 4; e++)
+		{
+			Vec edge = corners[f[(e + 1) & 3]] - corners[f[e]];
+			if (Dot(Cross(edge, p - corners[f[e]]), normal) > 0.0)
+				overFace = false;
+		}
+
+		if (overFace)
+			best = std::min(best, planeDistance * planeDistance);
+		else
+		{
+			for (int e = 0; e < 4; e++)
+				best = std::min(best, SegmentDistanceSquared(p, corners[f[e]], corners[f[(e + 1) & 3]]));
+		}
+	}
+	return inside ? 0.0 : best;
+}
+
+static void CheckAgainstBruteForce(LightClusterer& clusterer, const XMFLOAT4X4& view, const XMFLOAT4X4& projection, const TestLights& lights)
+{
+	Output output = Run(clusterer, view, projection, lights);
+	unsigned int tilesX = clusterer.GetTilesX();
+	unsigned int tilesY = clusterer.GetTilesY();
+	unsigned int slices = clusterer.GetSliceCount();
+	CHECK(output.Clusters.size() == clusterer.GetClusterCount());
+
+	//Lights in view space
+	std::vector<Vec> centers(lights.Count());
+	for (unsigned int i = 0; i < lights.Count(); i++)
+	{
+		const XMFLOAT3& p = lights.Positions[i];
+		double v[3];
+		for (int a = 0; a < 3; a++)
+			v[a] = p.x * view.m[0][a] + p.y * view.m[1][a] + p.z * view.m[2][a] + view.m[3][a];
+		centers[i] = { v[0], v[1], v[2] };
+	}
+
+	unsigned int missing = 0;
+	unsigned int extra = 0;
+	unsigned int loose = 0;
+	unsigned int unordered = 0;
+	unsigned int packed = 0;
+	unsigned int maxCount = 0;
+	unsigned long long pairs = 0;
+	std::vector<unsigned char> listed(lights.Count());
+
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		double zNear = TEST_NEAR * pow((double)TEST_FAR / TEST_NEAR, (double)s / slices);
+		double zFar = TEST_NEAR * pow((double)TEST_FAR / TEST_NEAR, (double)(s + 1) / slices);
+
+		//The shader's slice lookup has to land in this slice
+		float middle = (float)sqrt(zNear * zFar);
+		CHECK((unsigned int)floorf(logf(middle) * clusterer.GetSliceScale() + clusterer.GetSliceBias()) == s);
+
+		for (unsigned int y = 0; y < tilesY; y++)
+		{
+			for (unsigned int x = 0; x < tilesX; x++)
+			{
+				//The cluster's corners, and the box around them
+				Vec corners[8];
+				Vec boxMin = { 1e30, 1e30, zNear };
+				Vec boxMax = { -1e30, -1e30, zFar };
+				for (int c = 0; c < 8; c++)
+				{
+					double ndcX = -1.0 + 2.0 * (x + (c & 1)) / tilesX;
+					double ndcY = 1.0 - 2.0 * (y + ((c >> 1) & 1)) / tilesY;
+					double z = c & 4 ? zFar : zNear;
+					corners[c] = { ndcX * z / projection._11, ndcY * z / projection._22, z };
+					boxMin.X = std::min(boxMin.X, corners[c].X);
+					boxMax.X = std::max(boxMax.X, corners[c].X);
+					boxMin.Y = std::min(boxMin.Y, corners[c].Y);
+					boxMax.Y = std::max(boxMax.Y, corners[c].Y);
+				}
+
+				const ClusterRange& range = output.Clusters[(s * tilesY + y) * tilesX + x];
+				packed += range.Offset == pairs ? 0 : 1;
+				pairs += range.Count;
+				maxCount = std::max(maxCount, range.Count);
+
+				//Directional lights first, then the rest, each in light order
+				std::fill(listed.begin(), listed.end(), 0);
+				int previous = -1;
+				bool local = false;
+				for (unsigned int i = 0; i < range.Count && range.Offset + i < output.LightIndices.size(); i++)
+				{
+					unsigned int light = output.LightIndices[range.Offset + i];
+					if (light >= lights.Count())
+					{
+						unordered++;
+						continue;
+					}
+
+					bool directional = lights.Types[light] == LIGHT_TYPE_DIRECTIONAL;
+					if (!directional && !local)
+					{
+						local = true;
+						previous = -1;
+					}
+					if ((int)light <= previous || (directional && local))
+						unordered++;
+					previous = (int)light;
+					listed[light] = 1;
+				}
+
+				for (unsigned int i = 0; i < lights.Count(); i++)
+				{
+					if (lights.Types[i] == LIGHT_TYPE_DIRECTIONAL)
+					{
+						missing += listed[i] ? 0 : 1;
+						continue;
+					}
+
+					double r = lights.Ranges[i];
+					double exact = SolidDistanceSquared(centers[i], corners);
+					double box = BoxDistanceSquared(centers[i], boxMin, boxMax);
+					double slack = 1e-4 * (r * r + box) + 1e-6;
+					if (r > 0.0 && exact < r * r - slack && !listed[i])
+						missing++;
+					if (listed[i] && (r <= 0.0 || box > r * r + slack))
+						extra++;
+					if (listed[i] && exact > r * r + slack)
+						loose++;
+				}
+			}
+		}
+	}
+
+		CHECK(missing == 0);
+	CHECK(extra == 0);
+	CHECK(unordered == 0);
+	CHECK(packed == 0);
+	CHECK(pairs == output.LightIndices.size());
+	CHECK(maxCount == output.MaxLightsPerCluster);
+
+	//Otherwise the scene isn't testing much. The box test
+	//shouldn't be adding more than a few percent.
+	CHECK(pairs > output.Clusters.size() * 2);
+	CHECK(loose < pairs / 10);
+}
+
+int main()
+{
+	ThreadPool threadPool;
+	ThreadPool oneThread(1);
+	TestLights lights = MakeLights(3000, 99);
+
+	XMFLOAT4X4 view, wide, narrow;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0, 2, -5, 0), XMVectorSet(0.3f, -0.1f, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&wide, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, TEST_NEAR, TEST_FAR));
+	XMStoreFloat4x4(&narrow, XMMatrixPerspectiveFovLH(XM_PIDIV4 * 0.5f, 4.0f / 3.0f, TEST_NEAR, TEST_FAR));
+
+	//The game's layout, and one that doesn't fill the AVX2 lanes.
+	//Changing projection has to rebuild the cluster bounds.
+	const unsigned int sizes[2][3] = { { 16, 9, 24 }, { 13, 7, 10 } };
+	for (auto& size : sizes)
+	{
+		LightClusterer clusterer(size[0], size[1], size[2], &threadPool);
+		for (int pass = 0; pass < 2; pass++)
+		{
+			clusterer.SetUseAVX2(pass == 1);
+			CheckAgainstBruteForce(clusterer, view, wide, lights);
+			CheckAgainstBruteForce(clusterer, view, narrow, lights);
+		}
+
+		//Same answer whichever path and however many threads
+		clusterer.SetUseAVX2(false);
+		Output scalar = Run(clusterer, view, wide, lights);
+		clusterer.SetUseAVX2(true);
+		CHECK(clusterer.GetUseAVX2() == CpuHasAVX2());
+		CHECK(Run(clusterer, view, wide, lights) == scalar);
+
+		LightClusterer serial(size[0], size[1], size[2], &oneThread);
+		CHECK(Run(serial, view, wide, lights) == scalar);
+	}
+
+	//No lights at all, then only directional ones
+	LightClusterer clusterer(16, 9, 24, &threadPool);
+	int type = LIGHT_TYPE_POINT;
+	XMFLOAT3 position(0, 0, 0);
+	float range = 1.0f;
+	clusterer.Assign(view, wide, TEST_NEAR, TEST_FAR, &type, &position, &range, 0);
+	CHECK(clusterer.GetLightIndices().empty() && clusterer.GetMaxLightsPerCluster() == 0);
+
+	type = LIGHT_TYPE_DIRECTIONAL;
+	clusterer.Assign(view, wide, TEST_NEAR, TEST_FAR, &type, &position, &range, 1);
+	CHECK(clusterer.GetLightIndices().size() == clusterer.GetClusterCount() && clusterer.GetMaxLightsPerCluster() == 1);
+
+	return TestResult();
+}
@@ -0,0 +1,296 @@
+#include "TestHelpers.h"
+#include "LightManager.h"
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+static Light MakeLight(int type, float x)
+{
+	Light light = {};
+	light.Type = type;
+	light.Direction = XMFLOAT3(0, -1, 0);
+	light.Range = 10.0f;
+	light.Position = XMFLOAT3(x, 1, 2);
+	light.Intensity = 1.0f;
+	light.Color = XMFLOAT3(1, 1, 1);
+	light.SpotFalloff = 20.0f;
+	light.ShadowTile = -1;
+	return light;
+}
+
+static bool SameLight(const Light& a, const Light& b)
+{
+	return a.Type == b.Type &&
+		a.Direction.x == b.Direction.x && a.Direction.y == b.Direction.y && a.Direction.z == b.Direction.z &&
+		a.Range == b.Range &&
+		a.Position.x == b.Position.x && a.Position.y == b.Position.y && a.Position.z == b.Position.z &&
+		a.Intensity == b.Intensity &&
+		a.Color.x == b.Color.x && a.Color.y == b.Color.y && a.Color.z == b.Color.z &&
+		a.SpotFalloff == b.SpotFalloff &&
+		a.ShadowTile == b.ShadowTile;
+}
+
+static bool SameHandle(LightHandle a, LightHandle b)
+{
+	return a.Slot == b.Slot && a.Generation == b.Generation;
+}
+
+// --------------------------------------------------------
+// A removed light's handle stays dead, even once its slot
+// holds a new light
+// --------------------------------------------------------
+static void TestStaleHandles()
+{
+	LightManager lights;
+	LightHandle never;
+	CHECK(!lights.IsValid(never));
+
+	LightHandle a = lights.Add(MakeLight(LIGHT_TYPE_POINT, 1));
+	LightHandle b = lights.Add(MakeLight(LIGHT_TYPE_POINT, 2));
+	CHECK(lights.IsValid(a) && lights.IsValid(b));
+
+	lights.Remove(a);
+	CHECK(!lights.IsValid(a));
+	CHECK(lights.IsValid(b));
+	CHECK(lights.GetCount() == 1);
+
+	//The new light gets a's slot, but not its handle
+	LightHandle c = lights.Add(MakeLight(LIGHT_TYPE_SPOT, 3));
+	CHECK(c.Slot == a.Slot);
+	CHECK(c.Generation != a.Generation);
+	CHECK(!lights.IsValid(a));
+	CHECK(lights.IsValid(c));
+
+	//Removing through the stale handle leaves c alone
+	lights.Remove(a);
+	CHECK(lights.GetCount() == 2);
+	CHECK(lights.IsValid(c));
+	CHECK(lights.Get(c).Type == LIGHT_TYPE_SPOT);
+	CHECK(lights.Get(c).Position.x == 3);
+
+	//Removing twice only removes once
+	lights.Remove(c);
+	lights.Remove(c);
+	CHECK(lights.GetCount() == 1);
+	CHECK(lights.IsValid(b));
+
+	//Clear kills every handle, and new lights don't bring them back
+	lights.Clear();
+	CHECK(!lights.IsValid(b));
+	LightHandle d = lights.Add(MakeLight(LIGHT_TYPE_POINT, 4));
+	LightHandle e = lights.Add(MakeLight(LIGHT_TYPE_POINT, 5));
+	CHECK(!lights.IsValid(a) && !lights.IsValid(b) && !lights.IsValid(c));
+	CHECK(lights.IsValid(d) && lights.IsValid(e));
+	CHECK(lights.GetCount() == 2);
+}
+
+// --------------------------------------------------------
+// Removing fills the hole with the last light: its handle
+// follows it to the new index, with all of its data
+// --------------------------------------------------------
+static void TestSwapRemove()
+{
+	LightManager lights;
+	LightHandle handles[5];
+	for (unsigned int i = 0; i < 5; i++)
+		handles[i] = lights.Add(MakeLight(i < 2 ? LIGHT_TYPE_DIRECTIONAL : LIGHT_TYPE_POINT, (float)i));
+	lights.SetShadowTile(handles[4], 12);
+	CHECK(lights.GetCount(LIGHT_TYPE_DIRECTIONAL) == 2);
+	CHECK(lights.GetCount(LIGHT_TYPE_POINT) == 3);
+
+	lights.Remove(handles[1]);
+	CHECK(lights.GetCount() == 4);
+	CHECK(lights.GetIndex(handles[4]) == 1);
+	CHECK(SameHandle(lights.GetHandle(1), handles[4]));
+	CHECK(lights.Get(handles[4]).Position.x == 4);
+	CHECK(lights.Get(handles[4]).ShadowTile == 12);
+	CHECK(lights.GetPositions()[1].x == 4);
+	CHECK(lights.GetShadowTiles()[1] == 12);
+	CHECK(lights.GetTypes()[1] == LIGHT_TYPE_POINT);
+	CHECK(lights.GetCount(LIGHT_TYPE_DIRECTIONAL) == 1);
+	CHECK(lights.GetCount(LIGHT_TYPE_POINT) == 3);
+
+	//Everyone else stays put
+	CHECK(lights.GetIndex(handles[0]) == 0);
+	CHECK(lights.GetIndex(handles[2]) == 2);
+	CHECK(lights.GetIndex(handles[3]) == 3);
+
+	//Setting through the moved handle changes the moved light
+	lights.SetPosition(handles[4], XMFLOAT3(40, 0, 0));
+	CHECK(lights.GetPositions()[1].x == 40);
+	CHECK(lights.GetPositions()[3].x == 3);
+
+	//Removing the last light moves nothing
+	lights.Remove(handles[3]);
+	CHECK(lights.GetCount() == 3);
+	CHECK(lights.GetIndex(handles[0]) == 0);
+	CHECK(lights.GetIndex(handles[4]) == 1);
+	CHECK(lights.GetIndex(handles[2]) == 2);
+
+	//Removing the first moves the last into it
+	lights.Remove(handles[0]);
+	CHECK(lights.GetIndex(handles[2]) == 0);
+	CHECK(lights.GetIndex(handles[4]) == 1);
+	CHECK(SameHandle(lights.GetHandle(0), handles[2]));
+	CHECK(lights.GetCount(LIGHT_TYPE_DIRECTIONAL) == 0);
+	CHECK(lights.GetCount(LIGHT_TYPE_POINT) == 2);
+}
+
+// --------------------------------------------------------
+// PackChanges() only covers the lights touched since the
+// last call, and leaves the packed copy matching them
+// --------------------------------------------------------
+static void TestChangedRange()
+{
+	LightManager lights;
+	LightHandle handles[10];
+	for (unsigned int i = 0; i < 10; i++)
+		handles[i] = lights.Add(MakeLight(LIGHT_TYPE_POINT, (float)i));
+
+	unsigned int first = 99, count = 99;
+	CHECK(lights.PackChanges(first, count));
+	CHECK(first == 0 && count == 10);
+	for (unsigned int i = 0; i < 10; i++)
+		CHECK(SameLight(lights.GetPackedLights()[i], lights.Get(handles[i])));
+
+	//Nothing touched
+	CHECK(!lights.PackChanges(first, count));
+	CHECK(count == 0);
+
+	//One setter, one light
+	lights.SetIntensity(handles[7], 5.0f);
+	CHECK(lights.PackChanges(first, count));
+	CHECK(first == 7 && count == 1);
+	CHECK(lights.GetPackedLights()[7].Intensity == 5.0f);
+
+	//Two lights: the range between them, and nothing outside it
+	lights.SetPosition(handles[3], XMFLOAT3(30, 0, 0));
+	lights.SetColor(handles[6], XMFLOAT3(0, 1, 0));
+	CHECK(lights.PackChanges(first, count));
+	CHECK(first == 3 && count == 4);
+	CHECK(lights.GetPackedLights()[3].Position.x == 30);
+	CHECK(lights.GetPackedLights()[6].Color.x == 0);
+
+	//Every setter marks its light
+	lights.SetDirection(handles[2], XMFLOAT3(1, 0, 0));
+	CHECK(lights.PackChanges(first, count) && first == 2 && count == 1);
+	lights.SetRange(handles[2], 3.0f);
+	CHECK(lights.PackChanges(first, count) && first == 2 && count == 1);
+	lights.SetShadowTile(handles[2], 6);
+	CHECK(lights.PackChanges(first, count) && first == 2 && count == 1);
+	lights.SetColor(handles[2], XMFLOAT3(1, 0, 0));
+	CHECK(lights.PackChanges(first, count) && first == 2 && count == 1);
+	lights.Set(handles[2], MakeLight(LIGHT_TYPE_SPOT, 2));
+	CHECK(lights.PackChanges(first, count) && first == 2 && count == 1);
+	CHECK(SameLight(lights.GetPackedLights()[2], MakeLight(LIGHT_TYPE_SPOT, 2)));
+
+	//A swap-remove only changes the index that was filled
+	lights.Remove(handles[4]);
+	CHECK(lights.PackChanges(first, count));
+	CHECK(first == 4 && count == 1);
+	CHECK(SameLight(lights.GetPackedLights()[4], lights.Get(handles[9])));
+
+	//Removing the last light needs no upload at all
+	lights.Remove(handles[8]);
+	CHECK(!lights.PackChanges(first, count));
+
+	//A change to the last light, which then gets removed, is dropped
+	lights.SetIntensity(handles[7], 2.0f);
+	lights.Remove(handles[7]);
+	CHECK(!lights.PackChanges(first, count));
+	CHECK(lights.GetCount() == 7);
+
+	//...but not the rest of the range it was part of
+	lights.SetIntensity(handles[9], 2.0f);
+	lights.SetIntensity(handles[6], 2.0f);
+	lights.Remove(handles[6]);
+	CHECK(lights.PackChanges(first, count));
+	CHECK(first == 4 && count == 2);
+	CHECK(lights.GetPackedLights()[4].Intensity == 2.0f);
+
+	//An added light is its own change
+	LightHandle added = lights.Add(MakeLight(LIGHT_TYPE_DIRECTIONAL, 50));
+	CHECK(lights.PackChanges(first, count));
+	CHECK(first == lights.GetIndex(added) && count == 1);
+}
+
+// --------------------------------------------------------
+// Random adds, removes and sets against a plain copy: every
+// live handle finds its light, and the packed copy always
+// matches once the changes are packed
+// --------------------------------------------------------
+static void TestAgainstReference()
+{
+	std::mt19937 random(3);
+	LightManager lights;
+	std::vector<LightHandle> live;
+	std::vector<Light> expected;
+	std::vector<LightHandle> dead;
+
+	for (unsigned int step = 0; step < 5000; step++)
+	{
+		unsigned int op = random() % 4;
+		if (op == 0 || live.empty())
+		{
+			Light light = MakeLight(random() % 3, (float)step);
+			live.push_back(lights.Add(light));
+			expected.push_back(light);
+		}
+		else if (op == 1)
+		{
+			unsigned int i = random() % live.size();
+			lights.Remove(live[i]);
+			dead.push_back(live[i]);
+			live[i] = live.back();
+			expected[i] = expected.back();
+			live.pop_back();
+			expected.pop_back();
+		}
+		else
+		{
+			unsigned int i = random() % live.size();
+			expected[i].Intensity = (float)step;
+			lights.SetIntensity(live[i], (float)step);
+		}
+
+		if (step % 50 == 0)
+		{
+			unsigned int first, count;
+			lights.PackChanges(first, count);
+			CHECK(first + count <= lights.GetCount());
+		}
+	}
+
+	unsigned int first, count;
+	lights.PackChanges(first, count);
+	CHECK(lights.GetCount() == live.size());
+
+	unsigned int typeCounts[3] = {};
+	bool allMatch = true;
+	for (unsigned int i = 0; i < live.size(); i++)
+	{
+		allMatch = allMatch && lights.IsValid(live[i]);
+		allMatch = allMatch && SameLight(lights.Get(live[i]), expected[i]);
+		allMatch = allMatch && SameLight(lights.GetPackedLights()[lights.GetIndex(live[i])], expected[i]);
+		allMatch = allMatch && SameHandle(lights.GetHandle(lights.GetIndex(live[i])), live[i]);
+		typeCounts[expected[i].Type]++;
+	}
+	CHECK(allMatch);
+	for (int type = 0; type < 3; type++)
+		CHECK(lights.GetCount(type) == typeCounts[type]);
+
+	bool allDead = true;
+	for (LightHandle handle : dead)
+		allDead = allDead && !lights.IsValid(handle);
+	CHECK(allDead);
+}
+
+int main()
+{
+	TestStaleHandles();
+	TestSwapRemove();
+	TestChangedRange();
+	TestAgainstReference();
+	return TestResult();
+}
@@ -0,0 +1,118 @@
+#include "TestHelpers.h"
+#include "MatrixBatch.h"
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Per object world-view-projection matrices for a large
+// scene, through MultiplyMatrixBatch() and through a plain
+// scalar loop, which also checks the batch's results
+//
+// The batch writes into InstanceData-like structs, so the
+// strides are the ones the engine uses. Numbers are only
+// representative when built against the real DirectXMath,
+// not the scalar stand-in (see CMakeLists.txt).
+//
+// Usage: MatrixBatchBenchmark [--quick]
+// --------------------------------------------------------
+
+struct Instance
+{
+	XMFLOAT4X4 WorldViewProjection;
+	XMFLOAT4X4 World;
+	XMFLOAT4X4 WorldInverseTranspose;
+};
+
+static void MultiplyScalar(const XMFLOAT4X4& a, const XMFLOAT4X4& b, XMFLOAT4X4& result)
+{
+	for (unsigned int r = 0; r < 4; r++)
+	{
+		for (unsigned int c = 0; c < 4; c++)
+		{
+			float sum = 0.0f;
+			for (unsigned int k = 0; k < 4; k++)
+				sum += a.m[r][k] * b.m[k][c];
+			result.m[r][c] = sum;
+		}
+	}
+}
+
+static bool Near(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+{
+	for (unsigned int r = 0; r < 4; r++)
+	{
+		for (unsigned int c = 0; c < 4; c++)
+		{
+			float scale = std::fabs(a.m[r][c]) > 1.0f ? std::fabs(a.m[r][c]) : 1.0f;
+			if (std::fabs(a.m[r][c] - b.m[r][c]) > 1e-4f * scale)
+				return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = HasArgument(argc, argv, "--quick");
+	unsigned int count = quick ? 10000 : 100000;
+	unsigned int frames = quick ? 3 : 100;
+
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+	std::vector<XMFLOAT4X4> worlds(count);
+	for (XMFLOAT4X4& w : worlds)
+	{
+		XMMATRIX world = XMMatrixScaling(2.0f, 1.0f, 3.0f) * XMMatrixRotationY(position(random)) *
+			XMMatrixTranslation(position(random), position(random), position(random));
+		XMStoreFloat4x4(&w, world);
+	}
+
+	XMFLOAT4X4 viewProjection;
+	XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 10, -50, 1), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+	XMStoreFloat4x4(&viewProjection, view * XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f));
+
+	std::vector<Instance> instances(count);
+	std::vector<XMFLOAT4X4> scalar(count);
+	double batchSeconds = 0.0, scalarSeconds = 0.0;
+
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		BenchmarkTimer batchTimer;
+		MultiplyMatrixBatch(&worlds[0], sizeof(XMFLOAT4X4), viewProjection,
+			&instances[0].WorldViewProjection, sizeof(Instance), count);
+		batchSeconds += batchTimer.Seconds();
+
+		BenchmarkTimer scalarTimer;
+		for (unsigned int i = 0; i < count; i++)
+			MultiplyScalar(worlds[i], viewProjection, scalar[i]);
+		scalarSeconds += scalarTimer.Seconds();
+	}
+
+	bool allNear = true;
+	for (unsigned int i = 0; i < count; i++)
+		allNear = allNear && Near(instances[i].WorldViewProjection, scalar[i]);
+	CHECK(allNear);
+
+	//Strided in place, as with the world matrices already in the instance data
+	for (unsigned int i = 0; i < count; i++)
+		instances[i].World = worlds[i];
+	MultiplyMatrixBatch(&instances[0].World, sizeof(Instance), viewProjection,
+		&instances[0].World, sizeof(Instance), count);
+	allNear = true;
+	for (unsigned int i = 0; i < count; i++)
+		allNear = allNear && Near(instances[i].World, scalar[i]);
+	CHECK(allNear);
+
+	//An empty batch writes nothing
+	Instance untouched = instances[0];
+	MultiplyMatrixBatch(&worlds[0], sizeof(XMFLOAT4X4), viewProjection, &instances[0].WorldViewProjection, sizeof(Instance), 0);
+	CHECK(memcmp(&untouched, &instances[0], sizeof(Instance)) == 0);
+
+	double total = (double)count * frames;
+	printf("%u matrices x %u frames\n", count, frames);
+	printf("  Batch:  %6.2f ns per matrix, %.1f M matrices/s\n", batchSeconds * 1e9 / total, total / batchSeconds / 1e6);
+	printf("  Scalar: %6.2f ns per matrix, %.1f M matrices/s\n", scalarSeconds * 1e9 / total, total / scalarSeconds / 1e6);
+	return TestResult();
+}
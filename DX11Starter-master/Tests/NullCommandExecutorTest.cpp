@@ -0,0 +1,148 @@
+#include "TestHelpers.h"
+#include "CommandBuffer.h"
+#include "NullCommandExecutor.h"
+#include <string>
+
+// Stand-ins for API objects, only their addresses matter
+static int inputLayout, vertexShader, pixelShader, vertexBuffer, indexBuffer, constantBuffer;
+static int textures[4], samplers[2];
+
+// Everything a draw needs, bound one piece at a time
+static void RecordSetup(CommandBuffer& commands)
+{
+	commands.SetInputLayout(&inputLayout);
+	commands.SetShader(ShaderStage::Vertex, &vertexShader);
+	commands.SetShader(ShaderStage::Pixel, &pixelShader);
+	commands.SetVertexBuffer(0, &vertexBuffer, 32, 0);
+	commands.SetIndexBuffer(&indexBuffer);
+}
+
+static void TestValidFrame()
+{
+	CommandBuffer commands;
+	RecordSetup(commands);
+
+	float constants[16] = {};
+	const void* srvs[] = { &textures[0], &textures[1], &textures[2] };
+	const void* samplerList[] = { &samplers[0], &samplers[1] };
+	commands.UpdateConstants(&constantBuffer, constants, sizeof(constants));
+	commands.SetConstantBuffer(ShaderStage::Vertex, 0, &constantBuffer);
+	commands.SetConstants(ShaderStage::Pixel, 1, constants, 48);
+	commands.SetShaderResources(ShaderStage::Pixel, 0, 3, srvs);
+	commands.SetSamplers(ShaderStage::Pixel, 0, 2, samplerList);
+	commands.DrawIndexed(36, 0, 0);
+	commands.DrawIndexedInstanced(36, 10, 0, 0, 0);
+
+	NullCommandExecutor executor;
+	executor.Execute(commands);
+	CHECK(executor.GetErrorCount() == 0);
+	CHECK(executor.GetFirstError().empty());
+	CHECK(executor.GetCommandCount() == 12);
+	CHECK(executor.GetCommandCount(CommandType::SetShader) == 2);
+	CHECK(executor.GetDrawCount() == 2);
+	CHECK(executor.GetInstanceCount() == 11);
+	CHECK(executor.GetIndexCount() == 36 * 11);
+	CHECK(executor.GetConstantBytes() == sizeof(constants) + 48);
+}
+
+// Records one broken command after a good setup and expects an error naming it
+static void CheckError(void (*record)(CommandBuffer&), const char* expected)
+{
+	CommandBuffer commands;
+	RecordSetup(commands);
+	record(commands);
+
+	NullCommandExecutor executor;
+	executor.Execute(commands);
+	CHECK(executor.GetErrorCount() > 0);
+	if (executor.GetFirstError().find(expected) == std::string::npos)
+	{
+		printf("  expected \"%s\", got \"%s\"\n", expected, executor.GetFirstError().c_str());
+		CHECK(!"error message");
+	}
+}
+
+static void TestErrors()
+{
+	CheckError([](CommandBuffer& c) { c.SetShader(ShaderStage::Vertex, 0); c.DrawIndexed(3, 0, 0); }, "without a vertex shader");
+	CheckError([](CommandBuffer& c) { c.SetVertexBuffer(0, 0, 32, 0); c.DrawIndexed(3, 0, 0); }, "without a vertex buffer");
+	CheckError([](CommandBuffer& c) { c.SetIndexBuffer(0); c.DrawIndexed(3, 0, 0); }, "without an index buffer");
+	CheckError([](CommandBuffer& c) { c.SetInputLayout(0); c.DrawIndexed(3, 0, 0); }, "without an input layout");
+	CheckError([](CommandBuffer& c) { c.DrawIndexed(0, 0, 0); }, "empty draw");
+	CheckError([](CommandBuffer& c) { c.DrawIndexedInstanced(3, 0, 0, 0, 0); }, "empty draw");
+	CheckError([](CommandBuffer& c) { c.SetVertexBuffer(40, &vertexBuffer, 32, 0); }, "slot out of range");
+	CheckError([](CommandBuffer& c) { c.SetVertexBuffer(1, &vertexBuffer, 0, 0); }, "zero stride");
+	CheckError([](CommandBuffer& c) { c.SetConstantBuffer(ShaderStage::Pixel, 14, &constantBuffer); }, "slot out of range");
+	CheckError([](CommandBuffer& c) { c.SetSampler(ShaderStage::Pixel, 16, &samplers[0]); }, "slot out of range");
+	CheckError([](CommandBuffer& c) { float d[5] = {}; c.UpdateConstants(&constantBuffer, d, sizeof(d)); }, "multiple of 16");
+	CheckError([](CommandBuffer& c) { float d[4] = {}; c.UpdateConstants(0, d, sizeof(d)); }, "without a buffer");
+	CheckError([](CommandBuffer& c) { const void* s[2] = {}; c.SetShaderResources(ShaderStage::Pixel, 127, 2, s); }, "out of range");
+	CheckError([](CommandBuffer& c) { c.SetPipeline(0); }, "null pipeline");
+}
+
+// --------------------------------------------------------
+// Appended buffers keep their own constants and lists, with
+// offsets moved past what was already there
+// --------------------------------------------------------
+static void TestAppend()
+{
+	CommandBuffer first, second, joined;
+	float a[4] = { 1, 2, 3, 4 };
+	float b[8] = { 5, 6, 7, 8, 9, 10, 11, 12 };
+	const void* listA[] = { &textures[0] };
+	const void* listB[] = { &textures[2], &textures[3] };
+
+	first.SetConstants(ShaderStage::Vertex, 0, a, sizeof(a));
+	first.SetShaderResources(ShaderStage::Pixel, 0, 1, listA);
+	second.SetConstants(ShaderStage::Vertex, 0, b, sizeof(b));
+	second.SetShaderResources(ShaderStage::Pixel, 2, 2, listB);
+
+	joined.Append(first);
+	joined.Append(second);
+
+	const std::vector<Command>& commands = joined.GetCommands();
+	CHECK(commands.size() == 4);
+	CHECK(joined.GetConstantDataSize() == sizeof(a) + sizeof(b));
+	CHECK(joined.GetResourceListSize() == 3);
+	if (commands.size() != 4)
+		return;
+
+	const float* secondData = (const float*)(joined.GetConstantData() + commands[2].Args[0]);
+	CHECK(commands[2].Args[0] == sizeof(a));
+	CHECK(secondData[0] == 5 && secondData[7] == 12);
+	CHECK(commands[3].Args[1] == 1);
+	CHECK(joined.GetResourceLists()[commands[3].Args[1] + 1] == &textures[3]);
+
+	NullCommandExecutor executor;
+	executor.Execute(joined);
+	CHECK(executor.GetErrorCount() == 0);
+}
+
+// Binding what's already bound counts as redundant
+static void TestRedundant()
+{
+	CommandBuffer commands;
+	RecordSetup(commands);
+	commands.SetShader(ShaderStage::Vertex, &vertexShader);
+	commands.SetShader(ShaderStage::Pixel, &pixelShader);
+	commands.SetShaderResource(ShaderStage::Pixel, 0, &textures[0]);
+	commands.SetShaderResource(ShaderStage::Pixel, 0, &textures[0]);
+	commands.SetShaderResource(ShaderStage::Pixel, 0, &textures[1]);
+
+	NullCommandExecutor executor;
+	executor.Execute(commands);
+	CHECK(executor.GetRedundantCount() == 3);
+
+	//Counts start over with every Execute
+	executor.Execute(commands);
+	CHECK(executor.GetRedundantCount() == 3);
+}
+
+int main()
+{
+	TestValidFrame();
+	TestErrors();
+	TestAppend();
+	TestRedundant();
+	return TestResult();
+}
@@ -0,0 +1,165 @@
+#include "TestHelpers.h"
+#include "CpuFeatures.h"
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Headless occlusion culling benchmark
+//
+// Buildings either side of a street hide most of a field of
+// small boxes. Reports occluder triangles and
+// occludee tests per second for the scalar path, and for the
+// AVX2 path if the CPU has it, and checks both agree.
+//
+// Usage: OcclusionCullerBenchmark [--quick] [--threads N]
+// --------------------------------------------------------
+
+struct Occluder
+{
+	XMFLOAT4X4 World;
+};
+
+struct BenchmarkResult
+{
+	double TrianglesPerSecond;
+	double TestsPerSecond;
+	unsigned int Triangles;
+	unsigned int Culled;
+	std::vector<unsigned char> Visible;
+};
+
+// A unit cube, wound clockwise seen from outside like the meshes
+static void MakeCube(std::vector<XMFLOAT3>& positions, std::vector<unsigned int>& indices)
+{
+	for (int i = 0; i < 8; i++)
+		positions.push_back(XMFLOAT3(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f));
+
+	const unsigned int faces[6][4] =
+	{
+		{ 0, 2, 3, 1 }, { 4, 5, 7, 6 }, // -z, +z
+		{ 0, 4, 6, 2 }, { 1, 3, 7, 5 }, // -x, +x
+		{ 0, 1, 5, 4 }, { 2, 6, 7, 3 }  // -y, +y
+	};
+	for (auto& f : faces)
+	{
+		unsigned int quad[6] = { f[0], f[1], f[2], f[0], f[2], f[3] };
+		indices.insert(indices.end(), quad, quad + 6);
+	}
+}
+
+static BenchmarkResult Run(OcclusionCuller& culler, const XMFLOAT4X4& view, const XMFLOAT4X4& projection,
+	const std::vector<XMFLOAT3>& positions, const std::vector<unsigned int>& indices,
+	const std::vector<Occluder>& occluders, const std::vector<BoundingBox>& occludees, unsigned int frames)
+{
+	BenchmarkResult result = {};
+	double rasterizeSeconds = 0.0;
+	double testSeconds = 0.0;
+	unsigned long long triangles = 0;
+	unsigned long long tests = 0;
+
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		culler.BeginFrame(view, projection);
+		for (const Occluder& o : occluders)
+			culler.AddOccluder(&positions[0], &indices[0], (unsigned int)indices.size(), o.World);
+		culler.RasterizeOccluders();
+		culler.TestVisibility(occludees, result.Visible);
+
+		rasterizeSeconds += culler.GetRasterizeSeconds();
+		testSeconds += culler.GetTestSeconds();
+		triangles += culler.GetOccluderTriangleCount();
+		tests += culler.GetOccludeeTestCount();
+	}
+
+	result.Triangles = culler.GetOccluderTriangleCount();
+	result.Culled = culler.GetCulledCount();
+	result.TrianglesPerSecond = rasterizeSeconds > 0.0 ? triangles / rasterizeSeconds : 0.0;
+	result.TestsPerSecond = testSeconds > 0.0 ? tests / testSeconds : 0.0;
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = HasArgument(argc, argv, "--quick");
+	unsigned int threads = 0;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--threads") == 0)
+			threads = (unsigned int)atoi(argv[i + 1]);
+	}
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
+	MakeCube(positions, indices);
+
+	//Buildings either side of a street running away from the camera
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Occluder> occluders;
+	for (unsigned int i = 0; i < 2000; i++)
+	{
+		float side = i & 1 ? 1.0f : -1.0f;
+		float x = side * (8.0f + unit(random) * 60.0f);
+		float z = 5.0f + unit(random) * 120.0f;
+		float width = 1.0f + unit(random) * 6.0f;
+		float height = 2.0f + unit(random) * 12.0f;
+
+		Occluder o;
+		XMStoreFloat4x4(&o.World, XMMatrixMultiply(
+			XMMatrixScaling(width, height, 1.0f + unit(random) * 4.0f),
+			XMMatrixTranslation(x, height * 0.5f - 2.0f, z)));
+		occluders.push_back(o);
+	}
+
+	//Small things scattered down the street and behind the buildings
+	std::vector<BoundingBox> occludees;
+	for (unsigned int i = 0; i < 100000; i++)
+	{
+		XMFLOAT3 center((unit(random) - 0.5f) * 140.0f, unit(random) * 6.0f - 1.5f, 5.0f + unit(random) * 140.0f);
+		occludees.push_back(BoundingBox(center, XMFLOAT3(0.5f, 0.5f, 0.5f)));
+	}
+
+	XMFLOAT4X4 view, projection;
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(0, 1.5f, 0, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 200.0f));
+
+	ThreadPool threadPool(threads);
+	OcclusionCuller culler(320, 180, &threadPool);
+	unsigned int frames = quick ? 2 : 50;
+
+	printf("Occlusion culler %ux%u, %u thread(s), %u occluders, %u occludees, %u frame(s)\n",
+		culler.GetWidth(), culler.GetHeight(), threadPool.GetThreadCount(),
+		(unsigned int)occluders.size(), (unsigned int)occludees.size(), frames);
+
+	culler.SetUseAVX2(false);
+	BenchmarkResult scalar = Run(culler, view, projection, positions, indices, occluders, occludees, frames);
+	printf("  Scalar: %12.0f triangles/s %12.0f tests/s (%u triangles, %u culled)\n",
+		scalar.TrianglesPerSecond, scalar.TestsPerSecond, scalar.Triangles, scalar.Culled);
+
+	//Something has to be hidden, or the scene isn't testing anything
+	CHECK(scalar.Triangles > 0);
+	CHECK(scalar.Culled > 0);
+	CHECK(scalar.Culled < occludees.size());
+
+	if (CpuHasAVX2())
+	{
+		culler.SetUseAVX2(true);
+		BenchmarkResult avx2 = Run(culler, view, projection, positions, indices, occluders, occludees, frames);
+		printf("  AVX2:   %12.0f triangles/s %12.0f tests/s (%u triangles, %u culled)\n",
+			avx2.TrianglesPerSecond, avx2.TestsPerSecond, avx2.Triangles, avx2.Culled);
+
+		CHECK(avx2.Triangles == scalar.Triangles);
+		CHECK(avx2.Visible == scalar.Visible);
+	}
+	else
+	{
+		printf("  AVX2:   not supported by this CPU\n");
+	}
+
+	return TestResult();
+}
@@ -0,0 +1,224 @@
+#include "TestHelpers.h"
+#include "CommandBuffer.h"
+#include "PipelineState.h"
+#include "StateCache.h"
+#include <new>
+#include <vector>
+
+// --------------------------------------------------------
+// Counts what the cache asks for, handing out a distinct
+// address each time
+// --------------------------------------------------------
+class CountingFactory : public IPipelineStateFactory
+{
+public:
+	unsigned int RasterizerCount = 0;
+	unsigned int BlendCount = 0;
+	unsigned int DepthStencilCount = 0;
+
+	const void* CreateRasterizerState(const RasterizerStateDesc&) override { RasterizerCount++; return Next(); }
+	const void* CreateBlendState(const BlendStateDesc&) override { BlendCount++; return Next(); }
+	const void* CreateDepthStencilState(const DepthStencilStateDesc&) override { DepthStencilCount++; return Next(); }
+
+private:
+	int objects[256];
+	unsigned int used = 0;
+	const void* Next() { return &objects[used++ % 256]; }
+};
+
+static int shaders[8], layouts[2];
+
+static PipelineDesc MakeDesc()
+{
+	PipelineDesc desc;
+	desc.VertexShader = &shaders[0];
+	desc.PixelShader = &shaders[1];
+	desc.InputLayout = &layouts[0];
+	return desc;
+}
+
+static void TestDedup()
+{
+	CountingFactory factory;
+	PipelineCache cache(&factory);
+
+	PipelineDesc desc = MakeDesc();
+	const PipelineState* a = cache.GetPipeline(desc);
+	const PipelineState* b = cache.GetPipeline(MakeDesc());
+	CHECK(a == b);
+	CHECK(cache.GetPipelineCount() == 1);
+	CHECK(cache.GetMissCount() == 1 && cache.GetHitCount() == 1);
+	CHECK(a->VertexShader == &shaders[0] && a->PixelShader == &shaders[1] && a->InputLayout == &layouts[0]);
+	CHECK(a->Topology == 4);
+
+	//A second pipeline with different shaders but the same states shares them
+	desc.PixelShader = &shaders[2];
+	const PipelineState* c = cache.GetPipeline(desc);
+	CHECK(c != a);
+	CHECK(c->RasterizerState == a->RasterizerState);
+	CHECK(c->BlendState == a->BlendState);
+	CHECK(c->DepthStencilState == a->DepthStencilState);
+	CHECK(factory.RasterizerCount == 1 && factory.BlendCount == 1 && factory.DepthStencilCount == 1);
+
+	//Only the state that differs is made again
+	desc.Rasterizer.CullMode = 1; // D3D11_CULL_NONE
+	const PipelineState* d = cache.GetPipeline(desc);
+	CHECK(d->RasterizerState != a->RasterizerState);
+	CHECK(d->BlendState == a->BlendState);
+	CHECK(factory.RasterizerCount == 2 && factory.BlendCount == 1);
+	CHECK(cache.GetRasterizerStateCount() == 2 && cache.GetBlendStateCount() == 1 && cache.GetDepthStencilStateCount() == 1);
+}
+
+// --------------------------------------------------------
+// Changing any one field gives a different pipeline, and
+// asking again for any of them gives the same one back
+// --------------------------------------------------------
+static void TestEveryField()
+{
+	CountingFactory factory;
+	PipelineCache cache(&factory);
+	std::vector<PipelineDesc> descs;
+	descs.push_back(MakeDesc());
+
+	PipelineDesc d = MakeDesc(); d.VertexShader = &shaders[3]; descs.push_back(d);
+	d = MakeDesc(); d.PixelShader = 0; descs.push_back(d);
+	d = MakeDesc(); d.InputLayout = &layouts[1]; descs.push_back(d);
+	d = MakeDesc(); d.Rasterizer.FillMode = 2; descs.push_back(d);
+	d = MakeDesc(); d.Rasterizer.DepthBias = 1000; descs.push_back(d);
+	d = MakeDesc(); d.Rasterizer.SlopeScaledDepthBias = 1.0f; descs.push_back(d);
+	d = MakeDesc(); d.Blend.BlendEnable = 1; descs.push_back(d);
+	d = MakeDesc(); d.Blend.RenderTargetWriteMask = 0; descs.push_back(d);
+	d = MakeDesc(); d.DepthStencil.DepthWriteMask = 0; descs.push_back(d);
+	d = MakeDesc(); d.DepthStencil.DepthFunc = 4; descs.push_back(d);
+	d = MakeDesc(); d.DepthStencil.BackFace.StencilFunc = 3; descs.push_back(d);
+	d = MakeDesc(); d.Topology = 5; descs.push_back(d);
+
+	std::vector<const PipelineState*> pipelines;
+	std::vector<unsigned long long> hashes;
+	for (const PipelineDesc& desc : descs)
+	{
+		pipelines.push_back(cache.GetPipeline(desc));
+		hashes.push_back(HashPipeline(desc));
+	}
+
+	bool allDistinct = true;
+	for (unsigned int i = 0; i < descs.size(); i++)
+	{
+		for (unsigned int j = i + 1; j < descs.size(); j++)
+			allDistinct = allDistinct && pipelines[i] != pipelines[j] && hashes[i] != hashes[j];
+	}
+	CHECK(allDistinct);
+	CHECK(cache.GetPipelineCount() == descs.size());
+
+	//Four rasterizer, three blend and four depth-stencil descs in all
+	CHECK(factory.RasterizerCount == 4 && factory.BlendCount == 3 && factory.DepthStencilCount == 4);
+
+	bool allFound = true;
+	for (unsigned int i = 0; i < descs.size(); i++)
+		allFound = allFound && cache.GetPipeline(descs[i]) == pipelines[i];
+	CHECK(allFound);
+	CHECK(cache.GetHitCount() == descs.size());
+}
+
+// --------------------------------------------------------
+// Equal descs hash equally whatever was in their memory
+// before, so padding never leaks into a hash
+// --------------------------------------------------------
+static void TestHashIgnoresPadding()
+{
+	alignas(PipelineDesc) unsigned char memoryA[sizeof(PipelineDesc)];
+	alignas(PipelineDesc) unsigned char memoryB[sizeof(PipelineDesc)];
+	memset(memoryA, 0x00, sizeof(memoryA));
+	memset(memoryB, 0xCD, sizeof(memoryB));
+
+	PipelineDesc* a = new (memoryA) PipelineDesc(MakeDesc());
+	PipelineDesc* b = new (memoryB) PipelineDesc(MakeDesc());
+	CHECK(HashPipeline(*a) == HashPipeline(*b));
+	CHECK(HashRasterizerState(a->Rasterizer) == HashRasterizerState(RasterizerStateDesc()));
+	CHECK(HashBlendState(a->Blend) == HashBlendState(BlendStateDesc()));
+	CHECK(HashDepthStencilState(a->DepthStencil) == HashDepthStencilState(DepthStencilStateDesc()));
+	a->~PipelineDesc();
+	b->~PipelineDesc();
+}
+
+// --------------------------------------------------------
+// Pipelines never move while more are added, and Clear()
+// keeps the shared states for the next ones
+// --------------------------------------------------------
+static void TestStableAndClear()
+{
+	CountingFactory factory;
+	PipelineCache cache(&factory);
+	const PipelineState* first = cache.GetPipeline(MakeDesc());
+	PipelineState copy = *first;
+
+	static int manyShaders[2000];
+	for (unsigned int i = 0; i < 2000; i++)
+	{
+		PipelineDesc desc = MakeDesc();
+		desc.VertexShader = &manyShaders[i];
+		cache.GetPipeline(desc);
+	}
+	CHECK(cache.GetPipelineCount() == 2001);
+	CHECK(cache.GetPipeline(MakeDesc()) == first);
+	CHECK(memcmp(first, &copy, sizeof(copy)) == 0);
+
+	cache.Clear();
+	CHECK(cache.GetPipelineCount() == 0);
+	const PipelineState* again = cache.GetPipeline(MakeDesc());
+	CHECK(again->RasterizerState == copy.RasterizerState);
+	CHECK(factory.RasterizerCount == 1 && factory.BlendCount == 1 && factory.DepthStencilCount == 1);
+}
+
+// --------------------------------------------------------
+// Binding a pipeline is one command, and only the parts that
+// differ from what's bound get set
+// --------------------------------------------------------
+static void TestBindingChanges()
+{
+	CountingFactory factory;
+	PipelineCache cache(&factory);
+	PipelineDesc desc = MakeDesc();
+	const PipelineState* opaque = cache.GetPipeline(desc);
+	desc.PixelShader = &shaders[2];
+	const PipelineState* otherShader = cache.GetPipeline(desc);
+	desc.Blend.BlendEnable = 1;
+	desc.DepthStencil.DepthWriteMask = 0;
+	const PipelineState* transparent = cache.GetPipeline(desc);
+
+	CommandBuffer commands;
+	commands.SetPipeline(opaque);
+	commands.SetPipeline(opaque);
+	commands.SetPipeline(otherShader);
+	commands.SetPipeline(transparent);
+	commands.SetShader(ShaderStage::Pixel, &shaders[1]); // A single bind over part of a pipeline
+	commands.SetPipeline(transparent);
+
+	StateCache state;
+	const std::vector<Command>& list = commands.GetCommands();
+	CHECK(list.size() == 6);
+	if (list.size() != 6)
+		return;
+
+	CHECK(state.Filter(list[0], commands.GetResourceLists()));
+	CHECK(state.GetPipelineChanges() == PIPELINE_ALL);
+	CHECK(!state.Filter(list[1], commands.GetResourceLists()));
+	CHECK(state.Filter(list[2], commands.GetResourceLists()));
+	CHECK(state.GetPipelineChanges() == PIPELINE_PIXEL_SHADER);
+	CHECK(state.Filter(list[3], commands.GetResourceLists()));
+	CHECK(state.GetPipelineChanges() == (PIPELINE_BLEND | PIPELINE_DEPTH_STENCIL));
+	CHECK(state.Filter(list[4], commands.GetResourceLists()));
+	CHECK(state.Filter(list[5], commands.GetResourceLists()));
+	CHECK(state.GetPipelineChanges() == PIPELINE_PIXEL_SHADER);
+	CHECK(state.GetElidedCount(CommandType::SetPipeline) == 1);
+}
+
+int main()
+{
+	TestDedup();
+	TestEveryField();
+	TestHashIgnoresPadding();
+	TestStableAndClear();
+	TestBindingChanges();
+	return TestResult();
+}
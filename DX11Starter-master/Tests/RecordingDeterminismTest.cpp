@@ -0,0 +1,253 @@
+#include "TestHelpers.h"
+#include "CommandBuffer.h"
+#include "InstanceBatcher.h"
+#include "NullCommandExecutor.h"
+#include "PipelineState.h"
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Builds a frame the way Game::RecordScene() does (sort,
+// batch, record chunks of batches on the thread pool, merge
+// in chunk order) and checks the merged command stream is
+// byte for byte the same every time, whatever the thread
+// count or chunk size
+// --------------------------------------------------------
+
+#define OBJECT_COUNT 5000
+#define SHADER_COUNT 3
+#define MATERIAL_COUNT 24
+#define MESH_COUNT 12
+
+struct SceneObject
+{
+	unsigned int Shader;
+	unsigned int Material;
+	unsigned int Mesh;
+	float Depth;
+	XMFLOAT4X4 World;
+};
+
+struct MaterialConstants
+{
+	float Color[4];
+	float Roughness;
+	float Metalness;
+	float Padding[2];
+};
+
+// Stand-ins for API objects, only their addresses matter
+static int vertexBuffers[MESH_COUNT], indexBuffers[MESH_COUNT], textures[MATERIAL_COUNT * 2];
+
+class NullPipelineFactory : public IPipelineStateFactory
+{
+public:
+	const void* CreateRasterizerState(const RasterizerStateDesc&) override { return &states[0]; }
+	const void* CreateBlendState(const BlendStateDesc&) override { return &states[1]; }
+	const void* CreateDepthStencilState(const DepthStencilStateDesc&) override { return &states[2]; }
+
+private:
+	int states[3];
+};
+
+static std::vector<SceneObject> MakeScene()
+{
+	std::mt19937 random(99);
+	std::vector<SceneObject> objects(OBJECT_COUNT);
+	for (unsigned int i = 0; i < OBJECT_COUNT; i++)
+	{
+		SceneObject& o = objects[i];
+		o.Shader = random() % SHADER_COUNT;
+		o.Material = o.Shader * (MATERIAL_COUNT / SHADER_COUNT) + random() % (MATERIAL_COUNT / SHADER_COUNT);
+		o.Mesh = random() % MESH_COUNT;
+		o.Depth = (random() % 1000) / 1000.0f; // Plenty of equal keys
+		XMStoreFloat4x4(&o.World, XMMatrixTranslation((float)(i % 100), 0.0f, (float)(i / 100)));
+	}
+	return objects;
+}
+
+// --------------------------------------------------------
+// A run of batches into one chunk, like Game::RecordBatches():
+// material constants only when the material changes within
+// the chunk, then pipeline, textures and the instanced draw
+// --------------------------------------------------------
+static void RecordBatches(CommandBuffer& commands, const std::vector<InstanceBatch>& batches,
+	const std::vector<SceneObject>& objects, const std::vector<const PipelineState*>& pipelines,
+	unsigned int first, unsigned int count)
+{
+	commands.Reset();
+	int boundMaterial = -1;
+
+	for (unsigned int b = first; b < first + count; b++)
+	{
+		const InstanceBatch& batch = batches[b];
+		const SceneObject& o = objects[batch.FirstItem];
+
+		if ((int)o.Material != boundMaterial)
+		{
+			MaterialConstants constants = {};
+			constants.Color[0] = o.Material / (float)MATERIAL_COUNT;
+			constants.Roughness = 0.5f;
+			constants.Metalness = o.Material % 2 ? 1.0f : 0.0f;
+			commands.SetConstants(ShaderStage::Pixel, 2, &constants, sizeof(constants));
+			boundMaterial = (int)o.Material;
+		}
+
+		const void* srvs[] = { &textures[o.Material * 2], &textures[o.Material * 2 + 1] };
+		commands.SetPipeline(pipelines[o.Shader]);
+		commands.SetShaderResources(ShaderStage::Pixel, 0, 2, srvs);
+		commands.SetVertexBuffer(0, &vertexBuffers[o.Mesh], 48, 0);
+		commands.SetIndexBuffer(&indexBuffers[o.Mesh]);
+		commands.DrawIndexedInstanced(36, batch.InstanceCount, 0, 0, batch.FirstInstance);
+	}
+}
+
+// Sorts, batches and records the scene into one buffer
+static void RecordScene(CommandBuffer& frame, const std::vector<SceneObject>& objects,
+	const std::vector<const PipelineState*>& pipelines, ThreadPool& threadPool, unsigned int batchesPerChunk)
+{
+	RenderQueue queue;
+	queue.Begin();
+	for (unsigned int i = 0; i < objects.size(); i++)
+	{
+		const SceneObject& o = objects[i];
+		queue.Add(RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, o.Shader, o.Material, o.Mesh, o.Depth), i);
+	}
+	queue.Sort();
+
+	InstanceBatcher batcher;
+	batcher.Begin();
+	for (const DrawPacket& packet : queue.GetPackets())
+	{
+		const SceneObject& o = objects[packet.Item];
+		batcher.Add(packet.Item, &vertexBuffers[o.Mesh], &textures[o.Material * 2], pipelines[o.Shader], o.World, o.World);
+	}
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+	batcher.Build(viewProjection);
+
+	const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+	unsigned int batchCount = (unsigned int)batches.size();
+	unsigned int chunkCount = (batchCount + batchesPerChunk - 1) / batchesPerChunk;
+	std::vector<CommandBuffer> chunks(chunkCount);
+
+	threadPool.ParallelFor(chunkCount, [&](unsigned int c)
+	{
+		unsigned int first = c * batchesPerChunk;
+		unsigned int remaining = batchCount - first;
+		RecordBatches(chunks[c], batches, objects, pipelines, first, remaining < batchesPerChunk ? remaining : batchesPerChunk);
+	});
+
+	frame.Reset();
+	static int instanceBuffer;
+	frame.SetVertexBuffer(1, &instanceBuffer, sizeof(InstanceData), 0);
+	for (const CommandBuffer& chunk : chunks)
+		frame.Append(chunk);
+}
+
+// --------------------------------------------------------
+// Everything the executor would see, field by field so
+// struct padding can't make equal streams differ
+// --------------------------------------------------------
+template <typename T>
+static void Write(std::vector<unsigned char>& bytes, const T& value)
+{
+	const unsigned char* p = (const unsigned char*)&value;
+	bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+static std::vector<unsigned char> Serialize(const CommandBuffer& commands)
+{
+	std::vector<unsigned char> bytes;
+	for (const Command& c : commands.GetCommands())
+	{
+		Write(bytes, c.Type);
+		Write(bytes, c.Stage);
+		Write(bytes, c.Slot);
+		for (unsigned int a = 0; a < 5; a++)
+			Write(bytes, c.Args[a]);
+		Write(bytes, (uintptr_t)c.Resource);
+	}
+
+	const unsigned char* data = commands.GetConstantData();
+	bytes.insert(bytes.end(), data, data + commands.GetConstantDataSize());
+
+	const void* const* lists = commands.GetResourceLists();
+	for (unsigned int i = 0; i < commands.GetResourceListSize(); i++)
+		Write(bytes, (uintptr_t)lists[i]);
+	return bytes;
+}
+
+int main()
+{
+	std::vector<SceneObject> objects = MakeScene();
+
+	NullPipelineFactory factory;
+	PipelineCache pipelineCache(&factory);
+	static int shaders[SHADER_COUNT * 2], inputLayout;
+	std::vector<const PipelineState*> pipelines;
+	for (unsigned int i = 0; i < SHADER_COUNT; i++)
+	{
+		PipelineDesc desc;
+		desc.VertexShader = &shaders[i * 2];
+		desc.PixelShader = &shaders[i * 2 + 1];
+		desc.InputLayout = &inputLayout;
+		pipelines.push_back(pipelineCache.GetPipeline(desc));
+	}
+
+	//Reference: one thread, one chunk
+	ThreadPool serialPool(1);
+	CommandBuffer reference;
+	RecordScene(reference, objects, pipelines, serialPool, 1000000);
+	std::vector<unsigned char> referenceBytes = Serialize(reference);
+
+	NullCommandExecutor executor;
+	executor.Execute(reference);
+	CHECK(executor.GetErrorCount() == 0);
+	CHECK(executor.GetInstanceCount() == OBJECT_COUNT);
+	unsigned int referenceDraws = executor.GetDrawCount();
+	CHECK(referenceDraws < OBJECT_COUNT); // Something was instanced
+
+	//The same scene twice per setup, on several threads with chunks of several sizes
+	ThreadPool threadPool(8);
+	unsigned int chunkSizes[] = { 1, 7, 16, 64 };
+	for (unsigned int chunkSize : chunkSizes)
+	{
+		std::vector<unsigned char> firstRun;
+		for (unsigned int run = 0; run < 2; run++)
+		{
+			CommandBuffer frame;
+			RecordScene(frame, objects, pipelines, threadPool, chunkSize);
+			executor.Execute(frame);
+			CHECK(executor.GetErrorCount() == 0);
+			CHECK(executor.GetDrawCount() == referenceDraws);
+
+			//Smaller chunks re-send material constants at chunk
+			//starts, so only the same chunk size can match the
+			//reference exactly. Runs must always match each other.
+			std::vector<unsigned char> bytes = Serialize(frame);
+			if (run == 0)
+				firstRun = bytes;
+			else
+				CHECK(bytes == firstRun);
+		}
+	}
+
+	//With one chunk per frame, threads make no difference at all
+	CommandBuffer threaded;
+	RecordScene(threaded, objects, pipelines, threadPool, 1000000);
+	CHECK(Serialize(threaded) == referenceBytes);
+
+	//Same chunking, one thread against eight
+	CommandBuffer serialChunked, threadedChunked;
+	RecordScene(serialChunked, objects, pipelines, serialPool, 16);
+	RecordScene(threadedChunked, objects, pipelines, threadPool, 16);
+	CHECK(Serialize(serialChunked) == Serialize(threadedChunked));
+
+	return TestResult();
+}
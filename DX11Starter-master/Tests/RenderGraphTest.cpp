@@ -0,0 +1,500 @@
+#include "TestHelpers.h"
+#include "RenderGraph.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// RenderGraph against a fake backend that hands out numbered
+// textures and logs every call, so culling, barriers,
+// aliasing and the texture pool can be checked without
+// Direct3D
+// --------------------------------------------------------
+
+// DXGI_FORMAT values, as Game uses them
+#define TEST_FORMAT_COLOR 28 // R8G8B8A8_UNORM
+#define TEST_FORMAT_DEPTH 39 // R32_TYPELESS
+
+class FakeBackend : public IRenderGraphBackend
+{
+public:
+	struct Texture
+	{
+		RenderGraphTextureDesc Desc;
+		unsigned int Usage;
+	};
+
+	std::map<void*, Texture> live;
+	std::vector<std::string> log; // Barriers and passes, in the order they happened
+	unsigned int nextTexture = 1;
+	unsigned int created = 0;
+	unsigned int released = 0;
+	unsigned int badReleases = 0;
+	unsigned int badBarriers = 0;
+
+	void* CreateTexture(const RenderGraphTextureDesc& desc, unsigned int usage) override
+	{
+		void* texture = (void*)(size_t)nextTexture++;
+		live[texture] = { desc, usage };
+		created++;
+		return texture;
+	}
+
+	void ReleaseTexture(void* texture) override
+	{
+		badReleases += live.erase(texture) == 1 ? 0 : 1;
+		released++;
+	}
+
+	void Barriers(const RenderGraphBarrier* barriers, unsigned int count) override
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const RenderGraphBarrier& b = barriers[i];
+			if (b.Before == b.After || b.Texture == 0)
+				badBarriers++;
+			log.push_back("barrier " + std::to_string((size_t)b.Texture) + " " +
+				std::to_string((int)b.Before) + "->" + std::to_string((int)b.After));
+		}
+	}
+
+	// A pass body that notes it ran
+	std::function<void(RenderGraph&)> Pass(const std::string& name)
+	{
+		return [this, name](RenderGraph&) { log.push_back("run " + name); };
+	}
+};
+
+static RenderGraphTextureDesc Desc(unsigned int width, unsigned int height, unsigned int format)
+{
+	RenderGraphTextureDesc desc;
+	desc.Width = width;
+	desc.Height = height;
+	desc.Format = format;
+	return desc;
+}
+
+static bool HasBarrier(RenderGraph& graph, RenderGraphPass pass, RenderGraphResource resource,
+	RenderGraphAccess before, RenderGraphAccess after)
+{
+	for (const RenderGraphBarrier& b : graph.GetPassBarriers(pass))
+	{
+		if (b.Resource == resource && b.Before == before && b.After == after)
+			return b.Texture == graph.GetTexture(resource);
+	}
+	return false;
+}
+
+// --------------------------------------------------------
+// Passes are kept only if something kept needs their output
+// --------------------------------------------------------
+static void TestCulling()
+{
+	FakeBackend backend;
+	int backBuffer = 0;
+	RenderGraph graph(&backend);
+	RenderGraphTextureDesc desc = Desc(1280, 720, TEST_FORMAT_COLOR);
+
+	RenderGraphResource output = graph.ImportTexture("BackBuffer", &backBuffer);
+	RenderGraphResource x = graph.CreateTexture("X", desc);
+	RenderGraphResource y = graph.CreateTexture("Y", desc);
+	RenderGraphResource unused = graph.CreateTexture("Unused", desc);
+	RenderGraphResource unused2 = graph.CreateTexture("Unused2", desc);
+	RenderGraphResource never = graph.CreateTexture("NeverWritten", desc);
+
+	RenderGraphPass a = graph.AddPass("A", backend.Pass("A"));
+	graph.Write(a, x);
+	RenderGraphPass b = graph.AddPass("B", backend.Pass("B"));
+	graph.Read(b, x);
+	graph.Write(b, y);
+
+	//A branch nothing reads, two passes deep. The second one's
+	//bad read isn't an error as it never runs.
+	RenderGraphPass u = graph.AddPass("U", backend.Pass("U"));
+	graph.Read(u, y);
+	graph.Write(u, unused);
+	RenderGraphPass u2 = graph.AddPass("U2", backend.Pass("U2"));
+	graph.Read(u2, unused);
+	graph.Read(u2, never);
+	graph.Write(u2, unused2);
+
+	RenderGraphPass c = graph.AddPass("C", backend.Pass("C"));
+	graph.Read(c, y);
+	graph.Write(c, output);
+
+	//Kept for its side effects alone
+	RenderGraphPass query = graph.AddPass("Query", backend.Pass("Query"));
+	graph.SetSideEffects(query);
+
+	graph.Compile();
+	graph.Execute();
+
+	CHECK(!graph.GetPassCulled(a) && !graph.GetPassCulled(b) && !graph.GetPassCulled(c) && !graph.GetPassCulled(query));
+	CHECK(graph.GetPassCulled(u) && graph.GetPassCulled(u2));
+	CHECK(graph.GetCulledPassCount() == 2);
+	CHECK(graph.GetPassBarriers(u).empty() && graph.GetPassBarriers(u2).empty());
+	CHECK(graph.GetErrors().empty());
+
+	//Nothing backs what only culled passes touch
+	CHECK(graph.GetPhysicalIndex(unused) == -1 && graph.GetPhysicalIndex(unused2) == -1 && graph.GetPhysicalIndex(never) == -1);
+	CHECK(graph.GetTexture(unused) == 0);
+	CHECK(graph.GetTransientTextureCount() == 2);
+
+	std::vector<std::string> ran;
+	for (const std::string& entry : backend.log)
+	{
+		if (entry.compare(0, 4, "run ") == 0)
+			ran.push_back(entry.substr(4));
+	}
+	CHECK((ran == std::vector<std::string>{ "A", "B", "C", "Query" }));
+
+	//Drawing over something keeps whatever drew it first
+	graph.Reset();
+	output = graph.ImportTexture("BackBuffer", &backBuffer);
+	x = graph.CreateTexture("X", desc);
+	a = graph.AddPass("Opaque", nullptr);
+	graph.Write(a, x);
+	b = graph.AddPass("Transparent", nullptr);
+	graph.Write(b, x);
+	c = graph.AddPass("Present", nullptr);
+	graph.Read(c, x);
+	graph.Write(c, output);
+	RenderGraphPass late = graph.AddPass("Late", nullptr);
+	graph.Write(late, x);
+	graph.Compile();
+	CHECK(!graph.GetPassCulled(a) && !graph.GetPassCulled(b) && !graph.GetPassCulled(c));
+	CHECK(graph.GetPassCulled(late));
+}
+
+// --------------------------------------------------------
+// Game's deferred frame: every state change gets one barrier,
+// sent just before the pass that needs it
+// --------------------------------------------------------
+static void TestBarriers()
+{
+	FakeBackend backend;
+	int backBuffer = 0;
+	int shadowMap = 0;
+	RenderGraph graph(&backend);
+	RenderGraphTextureDesc colorDesc = Desc(1280, 720, TEST_FORMAT_COLOR);
+	RenderGraphTextureDesc depthDesc = Desc(1280, 720, TEST_FORMAT_DEPTH);
+
+	RenderGraphResource output = graph.ImportTexture("BackBuffer", &backBuffer);
+	RenderGraphResource shadows = graph.ImportTexture("ShadowMap", &shadowMap);
+	RenderGraphResource color = graph.CreateTexture("SceneColor", colorDesc);
+	RenderGraphResource depth = graph.CreateTexture("SceneDepth", depthDesc);
+	RenderGraphResource g0 = graph.CreateTexture("GBuffer0", colorDesc);
+	RenderGraphResource g1 = graph.CreateTexture("GBuffer1", colorDesc);
+
+	RenderGraphPass shadow = graph.AddPass("Shadows", backend.Pass("Shadows"));
+	graph.Write(shadow, shadows, RenderGraphAccess::DepthWrite);
+	RenderGraphPass gBuffer = graph.AddPass("GBuffer", backend.Pass("GBuffer"));
+	graph.Write(gBuffer, g0);
+	graph.Write(gBuffer, g1);
+	graph.Write(gBuffer, depth, RenderGraphAccess::DepthWrite);
+	RenderGraphPass lighting = graph.AddPass("DeferredLighting", backend.Pass("DeferredLighting"));
+	graph.Read(lighting, g0);
+	graph.Read(lighting, g1);
+	graph.Read(lighting, depth);
+	graph.Read(lighting, shadows);
+	graph.Write(lighting, color);
+	RenderGraphPass forward = graph.AddPass("Forward", backend.Pass("Forward"));
+	graph.Read(forward, shadows);
+	graph.Write(forward, color);
+	graph.Write(forward, depth, RenderGraphAccess::DepthWrite);
+	RenderGraphPass post = graph.AddPass("PostProcess", backend.Pass("PostProcess"));
+	graph.Read(post, color);
+	graph.Write(post, output);
+	RenderGraphPass ui = graph.AddPass("ImGui", backend.Pass("ImGui"));
+	graph.Write(ui, output);
+
+	graph.Compile();
+	CHECK(graph.GetErrors().empty());
+	CHECK(graph.GetCulledPassCount() == 0);
+
+	typedef RenderGraphAccess A;
+	CHECK(graph.GetPassBarriers(shadow).size() == 1 && HasBarrier(graph, shadow, shadows, A::None, A::DepthWrite));
+
+	CHECK(graph.GetPassBarriers(gBuffer).size() == 3);
+	CHECK(HasBarrier(graph, gBuffer, g0, A::None, A::RenderTarget));
+	CHECK(HasBarrier(graph, gBuffer, g1, A::None, A::RenderTarget));
+	CHECK(HasBarrier(graph, gBuffer, depth, A::None, A::DepthWrite));
+
+	CHECK(graph.GetPassBarriers(lighting).size() == 5);
+	CHECK(HasBarrier(graph, lighting, g0, A::RenderTarget, A::ShaderResource));
+	CHECK(HasBarrier(graph, lighting, g1, A::RenderTarget, A::ShaderResource));
+	CHECK(HasBarrier(graph, lighting, depth, A::DepthWrite, A::ShaderResource));
+	CHECK(HasBarrier(graph, lighting, shadows, A::DepthWrite, A::ShaderResource));
+	CHECK(HasBarrier(graph, lighting, color, A::None, A::RenderTarget));
+
+	//Shadows are still readable and color is still a target
+	CHECK(graph.GetPassBarriers(forward).size() == 1);
+	CHECK(HasBarrier(graph, forward, depth, A::ShaderResource, A::DepthWrite));
+
+	CHECK(graph.GetPassBarriers(post).size() == 2);
+	CHECK(HasBarrier(graph, post, color, A::RenderTarget, A::ShaderResource));
+	CHECK(HasBarrier(graph, post, output, A::None, A::RenderTarget));
+	CHECK(graph.GetPassBarriers(ui).empty());
+
+	//Each pass's barriers arrive just ahead of it
+	graph.Execute();
+	CHECK(backend.badBarriers == 0);
+	std::vector<std::string> expected;
+	for (RenderGraphPass p = 0; p < graph.GetPassCount(); p++)
+	{
+		for (const RenderGraphBarrier& b : graph.GetPassBarriers(p))
+			expected.push_back("barrier " + std::to_string((size_t)b.Texture) + " " +
+				std::to_string((int)b.Before) + "->" + std::to_string((int)b.After));
+		expected.push_back("run " + graph.GetPassName(p));
+	}
+	CHECK(backend.log == expected);
+
+	//Depth is read and written, so it's made for both
+	void* depthTexture = graph.GetTexture(depth);
+	CHECK(backend.live.count(depthTexture) == 1);
+	CHECK(backend.live[depthTexture].Usage == (RENDER_GRAPH_USAGE_DEPTH | RENDER_GRAPH_USAGE_SHADER_RESOURCE));
+	CHECK(graph.GetTexture(output) == &backBuffer && graph.GetTexture(shadows) == &shadowMap);
+}
+
+// --------------------------------------------------------
+// Same desc and usage with lifetimes that don't overlap
+// share a texture, anything else doesn't
+// --------------------------------------------------------
+static void TestAliasing()
+{
+	FakeBackend backend;
+	int backBuffer = 0;
+	RenderGraph graph(&backend);
+	RenderGraphTextureDesc desc = Desc(1280, 720, TEST_FORMAT_COLOR);
+
+	//Ping pong down a chain of blurs: X -> Y -> Z -> W -> output
+	RenderGraphResource output = graph.ImportTexture("BackBuffer", &backBuffer);
+	RenderGraphResource x = graph.CreateTexture("X", desc);
+	RenderGraphResource y = graph.CreateTexture("Y", desc);
+	RenderGraphResource z = graph.CreateTexture("Z", desc);
+	RenderGraphResource w = graph.CreateTexture("W", desc);
+	RenderGraphResource half = graph.CreateTexture("Half", Desc(640, 360, TEST_FORMAT_COLOR));
+	RenderGraphResource other = graph.CreateTexture("OtherFormat", Desc(1280, 720, TEST_FORMAT_DEPTH));
+
+	RenderGraphPass p0 = graph.AddPass("P0", nullptr);
+	graph.Write(p0, x);
+	RenderGraphPass p1 = graph.AddPass("P1", nullptr);
+	graph.Read(p1, x);
+	graph.Write(p1, y);
+	RenderGraphPass p2 = graph.AddPass("P2", nullptr);
+	graph.Read(p2, y);
+	graph.Write(p2, z);
+	graph.Write(p2, half);
+	RenderGraphPass p3 = graph.AddPass("P3", nullptr);
+	graph.Read(p3, z);
+	graph.Read(p3, half);
+	graph.Write(p3, w);
+	graph.Write(p3, other);
+	RenderGraphPass p4 = graph.AddPass("P4", nullptr);
+	graph.Read(p4, w);
+	graph.Read(p4, other);
+	graph.Write(p4, output);
+
+	graph.Compile();
+	CHECK(graph.GetErrors().empty());
+	CHECK(graph.GetTransientTextureCount() == 6);
+
+	//X is done by P1, so Z (from P2) can have it. Y ends where Z
+	//starts, so they can't share; W gets Y's.
+	CHECK(graph.GetPhysicalIndex(x) == graph.GetPhysicalIndex(z));
+	CHECK(graph.GetPhysicalIndex(y) == graph.GetPhysicalIndex(w));
+	CHECK(graph.GetPhysicalIndex(x) != graph.GetPhysicalIndex(y));
+
+	//Different size or format, never shared
+	CHECK(graph.GetPhysicalIndex(half) != graph.GetPhysicalIndex(x) && graph.GetPhysicalIndex(half) != graph.GetPhysicalIndex(y));
+	CHECK(graph.GetPhysicalIndex(other) != graph.GetPhysicalIndex(x) && graph.GetPhysicalIndex(other) != graph.GetPhysicalIndex(y));
+	CHECK(graph.GetPhysicalTextureCount() == 4);
+	CHECK(backend.created == 4);
+
+	//A read in the pass that writes the other is still an overlap
+	graph.Reset();
+	output = graph.ImportTexture("BackBuffer", &backBuffer);
+	x = graph.CreateTexture("X", desc);
+	y = graph.CreateTexture("Y", desc);
+	p0 = graph.AddPass("P0", nullptr);
+	graph.Write(p0, x);
+	p1 = graph.AddPass("P1", nullptr);
+	graph.Read(p1, x);
+	graph.Write(p1, y);
+	p2 = graph.AddPass("P2", nullptr);
+	graph.Read(p2, y);
+	graph.Write(p2, output);
+	graph.Compile();
+	CHECK(graph.GetPhysicalIndex(x) != graph.GetPhysicalIndex(y));
+
+	//Same desc but one is also read as depth: different textures
+	graph.Reset();
+	output = graph.ImportTexture("BackBuffer", &backBuffer);
+	x = graph.CreateTexture("DepthOnly", Desc(1280, 720, TEST_FORMAT_DEPTH));
+	y = graph.CreateTexture("DepthRead", Desc(1280, 720, TEST_FORMAT_DEPTH));
+	p0 = graph.AddPass("P0", nullptr);
+	graph.Write(p0, x, RenderGraphAccess::DepthWrite);
+	graph.Write(p0, output);
+	p1 = graph.AddPass("P1", nullptr);
+	graph.Write(p1, y, RenderGraphAccess::DepthWrite);
+	p2 = graph.AddPass("P2", nullptr);
+	graph.Read(p2, y);
+	graph.Write(p2, output);
+	graph.Compile();
+	CHECK(graph.GetPhysicalIndex(x) != graph.GetPhysicalIndex(y));
+	CHECK(backend.live[graph.GetTexture(x)].Usage == RENDER_GRAPH_USAGE_DEPTH);
+}
+
+// --------------------------------------------------------
+// Builds Game's frame, with or without the deferred passes
+// --------------------------------------------------------
+static void BuildFrame(RenderGraph& graph, void* backBuffer, unsigned int width, unsigned int height, bool deferred,
+	RenderGraphResource& color, RenderGraphResource& depth)
+{
+	RenderGraphTextureDesc colorDesc = Desc(width, height, TEST_FORMAT_COLOR);
+	RenderGraphTextureDesc depthDesc = Desc(width, height, TEST_FORMAT_DEPTH);
+
+	graph.Reset();
+	RenderGraphResource output = graph.ImportTexture("BackBuffer", backBuffer);
+	color = graph.CreateTexture("SceneColor", colorDesc);
+	depth = graph.CreateTexture("SceneDepth", depthDesc);
+
+	if (deferred)
+	{
+		RenderGraphResource g0 = graph.CreateTexture("GBuffer0", colorDesc);
+		RenderGraphResource g1 = graph.CreateTexture("GBuffer1", colorDesc);
+		RenderGraphPass gBuffer = graph.AddPass("GBuffer", nullptr);
+		graph.Write(gBuffer, g0);
+		graph.Write(gBuffer, g1);
+		graph.Write(gBuffer, depth, RenderGraphAccess::DepthWrite);
+		RenderGraphPass lighting = graph.AddPass("DeferredLighting", nullptr);
+		graph.Read(lighting, g0);
+		graph.Read(lighting, g1);
+		graph.Read(lighting, depth);
+		graph.Write(lighting, color);
+	}
+
+	RenderGraphPass forward = graph.AddPass("Forward", nullptr);
+	graph.Write(forward, color);
+	graph.Write(forward, depth, RenderGraphAccess::DepthWrite);
+	RenderGraphPass post = graph.AddPass("PostProcess", nullptr);
+	graph.Read(post, color);
+	graph.Read(post, depth);
+	graph.Write(post, output);
+	graph.Compile();
+}
+
+// --------------------------------------------------------
+// Textures are kept from frame to frame while they still
+// match, and released once a frame doesn't use them
+// --------------------------------------------------------
+static void TestPool()
+{
+	FakeBackend backend;
+	int backBuffer = 0;
+	RenderGraphResource color, depth;
+	{
+		RenderGraph graph(&backend);
+
+		//Scene color has the G-buffers' desc, but it's written by the
+		//pass that reads them, so all four need their own
+		BuildFrame(graph, &backBuffer, 1280, 720, true, color, depth);
+		unsigned int firstCreated = backend.created;
+		CHECK(graph.GetTransientTextureCount() == 4);
+		CHECK(firstCreated == 4 && graph.GetPhysicalTextureCount() == 4);
+		void* colorTexture = graph.GetTexture(color);
+		void* depthTexture = graph.GetTexture(depth);
+
+		//The same frame again makes nothing and hands back the same textures
+		for (int frame = 0; frame < 3; frame++)
+		{
+			BuildFrame(graph, &backBuffer, 1280, 720, true, color, depth);
+			CHECK(graph.GetErrors().empty());
+		}
+		CHECK(backend.created == firstCreated && backend.released == 0);
+		CHECK(graph.GetTexture(color) == colorTexture && graph.GetTexture(depth) == depthTexture);
+
+		//Forward only: the G-buffers' textures go, the rest stay
+		BuildFrame(graph, &backBuffer, 1280, 720, false, color, depth);
+		CHECK(backend.created == firstCreated);
+		CHECK(backend.released == firstCreated - 2);
+		CHECK(graph.GetPhysicalTextureCount() == 2);
+		CHECK(graph.GetTexture(depth) == depthTexture);
+		CHECK(backend.live.size() == 2);
+
+		//Resize: everything remade at the new size, the old ones released
+		unsigned int created = backend.created;
+		unsigned int released = backend.released;
+		BuildFrame(graph, &backBuffer, 1920, 1080, false, color, depth);
+		CHECK(backend.created == created + 2 && backend.released == released + 2);
+		CHECK(backend.live.size() == 2);
+		for (auto& texture : backend.live)
+			CHECK(texture.second.Desc.Width == 1920 && texture.second.Desc.Height == 1080);
+		CHECK(graph.GetTexture(depth) != depthTexture);
+
+		//Deferred back on at the new size only adds what's missing
+		created = backend.created;
+		BuildFrame(graph, &backBuffer, 1920, 1080, true, color, depth);
+		CHECK(backend.created == created + firstCreated - 2);
+		CHECK(backend.badReleases == 0);
+	}
+
+	//The graph gives everything back when it goes
+	CHECK(backend.live.empty());
+	CHECK(backend.created == backend.released && backend.badReleases == 0);
+}
+
+// --------------------------------------------------------
+// Mistakes are reported, not fatal
+// --------------------------------------------------------
+static void TestErrors()
+{
+	FakeBackend backend;
+	int backBuffer = 0;
+	int history = 0;
+	RenderGraph graph(&backend);
+	RenderGraphTextureDesc desc = Desc(1280, 720, TEST_FORMAT_COLOR);
+
+	RenderGraphResource output = graph.ImportTexture("BackBuffer", &backBuffer);
+	RenderGraphResource previous = graph.ImportTexture("History", &history);
+	RenderGraphResource blur = graph.CreateTexture("Blur", desc);
+	RenderGraphResource bloom = graph.CreateTexture("Bloom", desc);
+
+	//Imported textures hold last frame's contents, so reading them first is fine
+	RenderGraphPass a = graph.AddPass("Blur", nullptr);
+	graph.Read(a, bloom);
+	graph.Read(a, previous);
+	graph.Write(a, blur);
+	RenderGraphPass b = graph.AddPass("Composite", nullptr);
+	graph.Read(b, blur);
+	graph.Write(b, blur);
+	graph.Write(b, output);
+	graph.Compile();
+
+	const std::vector<std::string>& errors = graph.GetErrors();
+	CHECK(errors.size() == 2);
+	CHECK(errors.size() == 2 && errors[0] == "Blur reads Bloom before anything writes it");
+	CHECK(errors.size() == 2 && errors[1] == "Composite uses Blur two different ways");
+
+	//Still runs, and the conflicting use isn't turned into a barrier
+	CHECK(!HasBarrier(graph, b, blur, RenderGraphAccess::ShaderResource, RenderGraphAccess::RenderTarget));
+	graph.Execute();
+
+	//Reset clears them for the next frame
+	graph.Reset();
+	output = graph.ImportTexture("BackBuffer", &backBuffer);
+	a = graph.AddPass("Clear", nullptr);
+	graph.Write(a, output);
+	graph.Compile();
+	CHECK(graph.GetErrors().empty());
+}
+
+int main()
+{
+	TestCulling();
+	TestBarriers();
+	TestAliasing();
+	TestPool();
+	TestErrors();
+	return TestResult();
+}
@@ -0,0 +1,81 @@
+#include "TestHelpers.h"
+#include "RenderQueue.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// --------------------------------------------------------
+// Sorts a million draw packets with the queue's radix sort
+// and with std::sort / std::stable_sort for comparison
+//
+// Keys are built with MakeKey() from a scene's worth of
+// shaders, materials and meshes at random depths.
+//
+// Usage: RenderQueueBenchmark [--quick]
+// --------------------------------------------------------
+
+static bool KeyLess(const DrawPacket& a, const DrawPacket& b)
+{
+	return a.Key < b.Key;
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = HasArgument(argc, argv, "--quick");
+	unsigned int count = quick ? 100000 : 1000000;
+	unsigned int runs = quick ? 1 : 10;
+
+	std::mt19937 random(7);
+	std::vector<unsigned long long> keys(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int pass = random() % 10 == 0 ? RENDER_PASS_TRANSPARENT : RENDER_PASS_OPAQUE;
+		keys[i] = RenderQueue::MakeKey(pass, 0, random() % 16, random() % 200, random() % 500, (random() % 100000) / 100000.0f);
+	}
+
+	RenderQueue queue;
+	double radixSeconds = 0.0, sortSeconds = 0.0, stableSeconds = 0.0;
+	std::vector<DrawPacket> packets(count);
+
+	for (unsigned int run = 0; run < runs; run++)
+	{
+		queue.Begin();
+		for (unsigned int i = 0; i < count; i++)
+			queue.Add(keys[i], i);
+		queue.Sort();
+		radixSeconds += queue.GetSortSeconds();
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			packets[i].Key = keys[i];
+			packets[i].Item = i;
+		}
+		BenchmarkTimer sortTimer;
+		std::sort(packets.begin(), packets.end(), KeyLess);
+		sortSeconds += sortTimer.Seconds();
+
+		for (unsigned int i = 0; i < count; i++)
+		{
+			packets[i].Key = keys[i];
+			packets[i].Item = i;
+		}
+		BenchmarkTimer stableTimer;
+		std::stable_sort(packets.begin(), packets.end(), KeyLess);
+		stableSeconds += stableTimer.Seconds();
+	}
+
+	printf("Sorting %u packets, %u run(s)\n", count, runs);
+	printf("  Radix sort:       %8.3f ms %12.0f packets/s\n", radixSeconds / runs * 1000.0, count * runs / radixSeconds);
+	printf("  std::sort:        %8.3f ms %12.0f packets/s\n", sortSeconds / runs * 1000.0, count * runs / sortSeconds);
+	printf("  std::stable_sort: %8.3f ms %12.0f packets/s\n", stableSeconds / runs * 1000.0, count * runs / stableSeconds);
+	printf("  State changes:    %u unsorted, %u sorted\n", queue.GetStateChangesUnsorted(), queue.GetStateChangesSorted());
+
+	//Same order as the stable sort
+	const std::vector<DrawPacket>& sorted = queue.GetPackets();
+	bool same = sorted.size() == packets.size();
+	for (unsigned int i = 0; same && i < count; i++)
+		same = sorted[i].Key == packets[i].Key && sorted[i].Item == packets[i].Item;
+	CHECK(same);
+
+	return TestResult();
+}
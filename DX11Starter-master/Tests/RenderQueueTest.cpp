@@ -0,0 +1,145 @@
+#include "TestHelpers.h"
+#include "RenderQueue.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static bool KeyLess(const DrawPacket& a, const DrawPacket& b)
+{
+	return a.Key < b.Key;
+}
+
+// --------------------------------------------------------
+// Sorts the same packets with the queue and std::stable_sort,
+// which have to agree on keys and, for equal keys, on items
+// --------------------------------------------------------
+static void CheckAgainstStableSort(const std::vector<unsigned long long>& keys)
+{
+	RenderQueue queue;
+	std::vector<DrawPacket> expected;
+	queue.Begin();
+	for (unsigned int i = 0; i < keys.size(); i++)
+	{
+		queue.Add(keys[i], i);
+		DrawPacket packet = { keys[i], i };
+		expected.push_back(packet);
+	}
+
+	queue.Sort();
+	std::stable_sort(expected.begin(), expected.end(), KeyLess);
+
+	const std::vector<DrawPacket>& sorted = queue.GetPackets();
+	CHECK(sorted.size() == expected.size());
+	bool same = sorted.size() == expected.size();
+	for (unsigned int i = 0; same && i < sorted.size(); i++)
+		same = sorted[i].Key == expected[i].Key && sorted[i].Item == expected[i].Item;
+	CHECK(same);
+}
+
+static void TestMatchesStableSort()
+{
+	std::mt19937_64 random(42);
+
+	//Tiny and empty queues
+	CheckAgainstStableSort(std::vector<unsigned long long>());
+	CheckAgainstStableSort(std::vector<unsigned long long>(1, 5));
+	CheckAgainstStableSort(std::vector<unsigned long long>{ 2, 1 });
+
+	//Every byte differs, so all 8 passes run
+	std::vector<unsigned long long> keys;
+	for (unsigned int i = 0; i < 10000; i++)
+		keys.push_back(random());
+	CheckAgainstStableSort(keys);
+
+	//Only some bytes differ, so some passes are skipped (odd and even counts)
+	unsigned long long masks[] = { 0xFFull, 0xFF00FF00ull, 0x0F000000000000F0ull, 0xFF0000FF00FF0000ull };
+	for (unsigned long long mask : masks)
+	{
+		keys.clear();
+		for (unsigned int i = 0; i < 5000; i++)
+			keys.push_back((random() & mask) | 0x1000000000000000ull);
+		CheckAgainstStableSort(keys);
+	}
+
+	//Lots of equal keys, where stability shows
+	keys.clear();
+	for (unsigned int i = 0; i < 5000; i++)
+		keys.push_back(RenderQueue::MakeKey(i % 2, 0, (unsigned int)(random() % 3), (unsigned int)(random() % 4), 1, (random() % 4) / 4.0f));
+	CheckAgainstStableSort(keys);
+
+	//All the same
+	CheckAgainstStableSort(std::vector<unsigned long long>(1000, 123456789));
+}
+
+// --------------------------------------------------------
+// Opaque first, grouped by state and front to back within a
+// state, then transparent back to front whatever the state
+// --------------------------------------------------------
+static void TestKeyOrder()
+{
+	unsigned long long opaqueNear = RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, 1, 1, 1, 0.1f);
+	unsigned long long opaqueFar = RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, 1, 1, 1, 0.9f);
+	unsigned long long opaqueOtherShader = RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, 2, 0, 0, 0.0f);
+	unsigned long long transparentNear = RenderQueue::MakeKey(RENDER_PASS_TRANSPARENT, 0, 0, 0, 0, 0.1f);
+	unsigned long long transparentFar = RenderQueue::MakeKey(RENDER_PASS_TRANSPARENT, 0, 5, 5, 5, 0.9f);
+	unsigned long long laterLayer = RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 1, 0, 0, 0, 0.0f);
+
+	CHECK(opaqueNear < opaqueFar);
+	CHECK(opaqueFar < opaqueOtherShader);
+	CHECK(opaqueOtherShader < laterLayer);
+	CHECK(laterLayer < transparentFar);
+	CHECK(transparentFar < transparentNear);
+
+	//Depth is clamped rather than spilling into the state bits
+	CHECK(RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, 1, 1, 1, 7.0f) == RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, 1, 1, 1, 1.0f));
+	CHECK(RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, 1, 1, 1, -1.0f) == RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, 1, 1, 1, 0.0f));
+}
+
+// Sorting by state can only reduce the state changes counted
+static void TestStateChanges()
+{
+	RenderQueue queue;
+	queue.Begin();
+	for (unsigned int i = 0; i < 100; i++)
+		queue.Add(RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, i % 2, i % 5, i % 3, i / 100.0f), i);
+	queue.Sort();
+
+	CHECK(queue.GetStateChangesSorted() < queue.GetStateChangesUnsorted());
+	//Shader: 2, material: 2 * 5, mesh: 2 * 5 * at most 3 (only combinations that occur)
+	CHECK(queue.GetStateChangesSorted() <= 2 + 10 + 30);
+}
+
+static void TestResourceIds()
+{
+	int a, b;
+	RenderQueue queue;
+	CHECK(queue.GetResourceId(&a) == 0);
+	CHECK(queue.GetResourceId(&b) == 1);
+	CHECK(queue.GetResourceId(&a) == 0);
+
+	//Every id fits in the key, the ones past the limit share the last
+	std::vector<int> resources(RENDER_QUEUE_MAX_RESOURCE_IDS + 10);
+	queue.Begin();
+	for (unsigned int i = 0; i < resources.size(); i++)
+	{
+		unsigned int id = queue.GetResourceId(&resources[i]);
+		CHECK(id == std::min(i, (unsigned int)RENDER_QUEUE_MAX_RESOURCE_IDS - 1));
+	}
+	CHECK(queue.GetResourceIdOverflows() == 10);
+	CHECK(queue.GetResourceId(&resources[100]) == 100);
+
+	//A new frame starts over
+	queue.Begin();
+	CHECK(queue.GetResourceIdOverflows() == 0);
+	CHECK(queue.GetResourceId(&b) == 0);
+	CHECK(queue.GetResourceId(&resources.back()) == 1);
+}
+
+int main()
+{
+	TestMatchesStableSort();
+	TestKeyOrder();
+	TestStateChanges();
+	TestResourceIds();
+	return TestResult();
+}
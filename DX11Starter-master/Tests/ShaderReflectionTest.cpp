@@ -0,0 +1,352 @@
+#include "TestHelpers.h"
+#include "ShaderReflection.h"
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Reads the .cso fixtures in Fixtures/ (see
+// MakeShaderFixtures.cpp for what's in them), then feeds the
+// parser and the cache reader truncated and corrupted copies
+// --------------------------------------------------------
+
+typedef std::vector<unsigned char> Bytes;
+
+// D3D values, as in the fixtures
+#define SIT_CBUFFER 0
+#define SIT_TEXTURE 2
+#define SIT_SAMPLER 3
+#define SIT_UAV_RWTYPED 4
+#define SIT_STRUCTURED 5
+
+static Bytes LoadFixture(const char* name)
+{
+	std::ifstream file(std::string(SHADER_FIXTURE_DIR) + "/" + name, std::ios::binary);
+	Bytes bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	CHECK(!bytes.empty());
+	return bytes;
+}
+
+static bool Parse(ShaderReflection& reflection, const Bytes& code)
+{
+	return !code.empty() && reflection.Parse(code.data(), code.size());
+}
+
+static std::string WriteCache(ShaderReflection& reflection)
+{
+	std::ostringstream out;
+	reflection.Write(out);
+	return out.str();
+}
+
+static bool ReadCache(ShaderReflection& reflection, const std::string& cache, const Bytes& code)
+{
+	std::istringstream in(cache);
+	return reflection.Read(in, code.data(), code.size());
+}
+
+// Index of a resource by name, or -1
+static int FindResource(ShaderReflection& reflection, const char* name)
+{
+	for (unsigned int i = 0; i < reflection.GetResourceCount(); i++)
+	{
+		if (strcmp(reflection.GetString(reflection.GetResource(i).Name), name) == 0)
+			return (int)i;
+	}
+	return -1;
+}
+
+// Touches every name, so a bad offset shows up under a sanitizer
+static size_t TouchStrings(ShaderReflection& reflection)
+{
+	size_t length = 0;
+	for (unsigned int i = 0; i < reflection.GetBufferCount(); i++)
+	{
+		const ReflectedBuffer& buffer = reflection.GetBuffer(i);
+		length += strlen(reflection.GetString(buffer.Name));
+		for (unsigned int v = 0; v < buffer.VariableCount; v++)
+			length += strlen(reflection.GetString(reflection.GetVariable(buffer.FirstVariable + v).Name));
+	}
+	for (unsigned int i = 0; i < reflection.GetResourceCount(); i++)
+		length += strlen(reflection.GetString(reflection.GetResource(i).Name));
+	for (unsigned int i = 0; i < reflection.GetInputCount(); i++)
+		length += strlen(reflection.GetString(reflection.GetInput(i).SemanticName));
+	for (unsigned int i = 0; i < reflection.GetOutputCount(); i++)
+		length += strlen(reflection.GetString(reflection.GetOutput(i).SemanticName));
+	return length;
+}
+
+static void TestConstantBuffers()
+{
+	Bytes code = LoadFixture("ConstantBuffersVS.cso");
+	ShaderReflection r;
+	CHECK(Parse(r, code));
+	CHECK(r.GetProgramType() == 0xFFFE);
+	CHECK(r.GetThreadGroupSize(0, 0, 0) == 0);
+
+	CHECK(r.GetBufferCount() == 3);
+	CHECK(r.GetVariableCount() == 4);
+	if (r.GetBufferCount() != 3 || r.GetVariableCount() != 4)
+		return;
+
+	const ReflectedBuffer& globals = r.GetBuffer(0);
+	CHECK(strcmp(r.GetString(globals.Name), "$Globals") == 0);
+	CHECK(globals.Size == 16 && globals.BindPoint == 0 && globals.Type == 0);
+	CHECK(globals.FirstVariable == 0 && globals.VariableCount == 2);
+	CHECK(strcmp(r.GetString(r.GetVariable(1).Name), "frame") == 0);
+	CHECK(r.GetVariable(1).StartOffset == 4 && r.GetVariable(1).Size == 4);
+
+	const ReflectedBuffer& perObject = r.GetBuffer(1);
+	CHECK(strcmp(r.GetString(perObject.Name), "PerObject") == 0);
+	CHECK(perObject.Size == 128 && perObject.BindPoint == 2);
+	CHECK(perObject.FirstVariable == 2 && perObject.VariableCount == 2);
+	const ReflectedVariable& inverse = r.GetVariable(3);
+	CHECK(strcmp(r.GetString(inverse.Name), "worldInverseTranspose") == 0);
+	CHECK(inverse.StartOffset == 64 && inverse.Size == 64);
+
+	CHECK(r.GetBuffer(2).VariableCount == 0 && r.GetBuffer(2).BindPoint == 3);
+
+	//Buffers are bindings too
+	CHECK(r.GetResourceCount() == 3);
+	for (unsigned int i = 0; i < r.GetResourceCount(); i++)
+		CHECK(r.GetResource(i).Type == SIT_CBUFFER);
+
+	//Signatures, including OSG5's extra stream field
+	CHECK(r.GetInputCount() == 4);
+	CHECK(r.GetOutputCount() == 2);
+	if (r.GetInputCount() == 4 && r.GetOutputCount() == 2)
+	{
+		CHECK(strcmp(r.GetString(r.GetInput(2).SemanticName), "WORLD_PER_INSTANCE") == 0);
+		CHECK(r.GetInput(2).SemanticIndex == 1 && r.GetInput(2).Register == 2 && r.GetInput(2).Mask == 0xF);
+		CHECK(r.GetInput(3).ComponentType == 1 && r.GetInput(3).Mask == 0x1);
+		CHECK(strcmp(r.GetString(r.GetOutput(0).SemanticName), "SV_POSITION") == 0);
+		CHECK(r.GetOutput(0).SystemValue == 1 && r.GetOutput(1).Mask == 0x3);
+	}
+}
+
+static void TestResources()
+{
+	Bytes code = LoadFixture("ResourcesPS.cso");
+	ShaderReflection r;
+	CHECK(Parse(r, code));
+	CHECK(r.GetProgramType() == 0xFFFF);
+	CHECK(r.GetResourceCount() == 8);
+
+	int basicSampler = FindResource(r, "BasicSampler");
+	int shadowSampler = FindResource(r, "ShadowSampler");
+	int normalMap = FindResource(r, "NormalMap");
+	int lights = FindResource(r, "Lights");
+	int shadowMaps = FindResource(r, "ShadowMaps");
+	CHECK(basicSampler >= 0 && shadowSampler >= 0 && normalMap >= 0 && lights >= 0 && shadowMaps >= 0);
+	if (basicSampler < 0 || shadowSampler < 0 || normalMap < 0 || lights < 0 || shadowMaps < 0)
+		return;
+
+	CHECK(r.GetResource(basicSampler).Type == SIT_SAMPLER && r.GetResource(basicSampler).BindPoint == 0);
+	CHECK(r.GetResource(shadowSampler).Type == SIT_SAMPLER && r.GetResource(shadowSampler).BindPoint == 1);
+	CHECK(r.GetResource(normalMap).Type == SIT_TEXTURE && r.GetResource(normalMap).BindPoint == 1);
+	CHECK(r.GetResource(lights).Type == SIT_STRUCTURED && r.GetResource(lights).BindPoint == 4);
+	CHECK(r.GetResource(shadowMaps).BindPoint == 5 && r.GetResource(shadowMaps).BindCount == 4);
+
+	//A buffer's bind point comes from the binding of the same name
+	CHECK(r.GetBufferCount() == 2);
+	if (r.GetBufferCount() == 2)
+	{
+		CHECK(strcmp(r.GetString(r.GetBuffer(1).Name), "PerMaterial") == 0);
+		CHECK(r.GetBuffer(1).BindPoint == 1 && r.GetBuffer(1).Size == 48);
+	}
+}
+
+// --------------------------------------------------------
+// Two variants of one shader: different resources, and a
+// cache made from one must not be taken for the other
+// --------------------------------------------------------
+static void TestVariants()
+{
+	Bytes full = LoadFixture("ResourcesPS.cso");
+	Bytes noNormalMap = LoadFixture("ResourcesPS_NoNormalMap.cso");
+	ShaderReflection a, b;
+	CHECK(Parse(a, full));
+	CHECK(Parse(b, noNormalMap));
+	CHECK(FindResource(a, "NormalMap") >= 0);
+	CHECK(FindResource(b, "NormalMap") < 0);
+	CHECK(b.GetResourceCount() == a.GetResourceCount() - 1);
+	CHECK(b.GetInputCount() == a.GetInputCount() - 1);
+
+	std::string cacheA = WriteCache(a);
+	std::string cacheB = WriteCache(b);
+	ShaderReflection c;
+	CHECK(ReadCache(c, cacheA, full));
+	CHECK(WriteCache(c) == cacheA);
+
+	//The wrong variant's cache leaves what was there alone
+	CHECK(!ReadCache(c, cacheB, full));
+	CHECK(FindResource(c, "NormalMap") >= 0);
+	CHECK(WriteCache(c) == cacheA);
+	CHECK(ReadCache(c, cacheB, noNormalMap));
+	CHECK(FindResource(c, "NormalMap") < 0);
+}
+
+static void TestCompute()
+{
+	Bytes code = LoadFixture("ClustersCS.cso");
+	ShaderReflection r;
+	CHECK(Parse(r, code));
+	CHECK(r.GetProgramType() == 0x4353);
+
+	//Past the customdata block, which has its own length
+	unsigned int x = 0, y = 0, z = 0;
+	CHECK(r.GetThreadGroupSize(&x, &y, &z) == 64);
+	CHECK(x == 8 && y == 8 && z == 1);
+
+	//Shader model 5.1 bindings are 40 bytes
+	int ranges = FindResource(r, "ClusterRanges");
+	CHECK(r.GetResourceCount() == 3 && ranges >= 0);
+	if (ranges >= 0)
+		CHECK(r.GetResource(ranges).Type == SIT_UAV_RWTYPED && r.GetResource(ranges).BindPoint == 0);
+	CHECK(r.GetBufferCount() == 1 && r.GetVariableCount() == 2);
+	if (r.GetVariableCount() == 2)
+		CHECK(strcmp(r.GetString(r.GetVariable(1).Name), "lightCount") == 0 && r.GetVariable(1).StartOffset == 12);
+}
+
+// --------------------------------------------------------
+// Every prefix of every fixture and cache: neither a short
+// container nor a short cache is ever accepted
+// --------------------------------------------------------
+static void TestTruncated(const char* name)
+{
+	Bytes code = LoadFixture(name);
+	ShaderReflection full;
+	CHECK(Parse(full, code));
+	std::string cache = WriteCache(full);
+
+	bool shortCodeRejected = true;
+	for (size_t size = 0; size < code.size(); size++)
+	{
+		ShaderReflection r;
+		shortCodeRejected = shortCodeRejected && !r.Parse(code.data(), size);
+	}
+	CHECK(shortCodeRejected);
+
+	bool shortCacheRejected = true;
+	for (size_t size = 0; size < cache.size(); size++)
+	{
+		ShaderReflection r;
+		shortCacheRejected = shortCacheRejected && !ReadCache(r, cache.substr(0, size), code);
+		shortCacheRejected = shortCacheRejected && !r.IsValid();
+	}
+	CHECK(shortCacheRejected);
+}
+
+// --------------------------------------------------------
+// Every single bit flipped, in the container and in the
+// cache. Whatever's accepted has to be safe to walk.
+// --------------------------------------------------------
+static void TestCorrupt(const char* name)
+{
+	Bytes code = LoadFixture(name);
+	ShaderReflection full;
+	CHECK(Parse(full, code));
+	std::string cache = WriteCache(full);
+
+	for (size_t i = 0; i < code.size(); i++)
+	{
+		for (unsigned int bit = 0; bit < 8; bit++)
+		{
+			Bytes corrupt = code;
+			corrupt[i] ^= (unsigned char)(1 << bit);
+			ShaderReflection r;
+			if (r.Parse(corrupt.data(), corrupt.size()))
+				TouchStrings(r);
+		}
+	}
+
+	unsigned int cacheAccepted = 0;
+	for (size_t i = 0; i < cache.size(); i++)
+	{
+		for (unsigned int bit = 0; bit < 8; bit++)
+		{
+			std::string corrupt = cache;
+			corrupt[i] ^= (char)(1 << bit);
+			ShaderReflection r;
+			if (ReadCache(r, corrupt, code))
+			{
+				cacheAccepted++;
+				TouchStrings(r);
+			}
+		}
+	}
+	CHECK(cacheAccepted < cache.size() * 8);
+}
+
+// --------------------------------------------------------
+// Hand picked damage that has to fail the parse outright
+// --------------------------------------------------------
+static void TestRejected()
+{
+	Bytes code = LoadFixture("ResourcesPS.cso");
+	unsigned int rdef = 0;
+	memcpy(&rdef, &code[32], 4);
+	rdef += 8; // Past the chunk's tag and size
+
+	struct Damage
+	{
+		size_t Offset;
+		unsigned int Value;
+	};
+	Damage damages[] =
+	{
+		{ 0, 0x43425845 },           // Not "DXBC"
+		{ 24, 0x00001000 },          // Bigger than the file
+		{ 28, 0x40000000 },          // Chunk count past the end
+		{ 32, 0xFFFFFFF0 },          // Chunk offset past the end
+		{ 32, 0x00000004 },          // Chunk inside the header
+		{ rdef - 4, 0x7FFFFFFF },    // Chunk size past the end
+		{ rdef + 0, 0x10000000 },    // Buffer count past the chunk
+		{ rdef + 8, 0x01000000 },    // Binding count past the chunk
+		{ rdef + 12, 0xFFFFFF00 },   // Bindings start past the chunk
+		{ rdef + 60, 0x00FFFFFF },   // First binding's name outside the chunk
+	};
+
+	for (const Damage& damage : damages)
+	{
+		Bytes corrupt = code;
+		memcpy(&corrupt[damage.Offset], &damage.Value, 4);
+		ShaderReflection r;
+		CHECK(!r.Parse(corrupt.data(), corrupt.size()));
+	}
+
+	//A name that runs to the end of the chunk without a terminator
+	Bytes unterminated = code;
+	unsigned int rdefSize = 0;
+	memcpy(&rdefSize, &code[rdef - 4], 4);
+	unterminated[rdef + rdefSize - 1] = 'x';
+	ShaderReflection r;
+	CHECK(!r.Parse(unterminated.data(), unterminated.size()));
+
+	//A cache from an older layout is rebuilt, not read
+	ShaderReflection full;
+	CHECK(Parse(full, code));
+	std::string cache = WriteCache(full);
+	unsigned int oldVersion = SHADER_REFLECTION_VERSION - 1;
+	memcpy(&cache[4], &oldVersion, 4);
+	CHECK(!ReadCache(r, cache, code));
+}
+
+int main()
+{
+	const char* fixtures[] = { "ConstantBuffersVS.cso", "ResourcesPS.cso", "ResourcesPS_NoNormalMap.cso", "ClustersCS.cso" };
+
+	TestConstantBuffers();
+	TestResources();
+	TestVariants();
+	TestCompute();
+	for (const char* fixture : fixtures)
+	{
+		TestTruncated(fixture);
+		TestCorrupt(fixture);
+	}
+	TestRejected();
+	return TestResult();
+}
@@ -0,0 +1,233 @@
+#include "TestHelpers.h"
+#include "ShaderVariableTable.h"
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstring>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Per set cost of SimpleShader's constant setters: by name,
+// through a handle from GetVariableHandle(), and a whole
+// buffer through GetBufferHandle()
+//
+// SimpleShader's setters are ShaderVariableTable's, so this
+// times the table directly, without Direct3D.
+//
+// Each entity sets what Game::Draw() used to set by name
+// before the handles and buffer structs: six matrices in the
+// vertex shader, then colorTint, cameraPos, roughness,
+// ambient, scale, offset and five Light structs in the pixel
+// shader, each shader with one 384 byte ExternalData buffer.
+//
+// Usage: ShaderVariableBenchmark [--quick]
+// --------------------------------------------------------
+
+// The old Light struct, 64 bytes to match the HLSL
+struct Light
+{
+	int Type;
+	XMFLOAT3 Direction;
+	float Range;
+	XMFLOAT3 Position;
+	float Intensity;
+	XMFLOAT3 Color;
+	float SpotFalloff;
+	XMFLOAT3 Padding;
+};
+
+// The old shaders' ExternalData buffers
+struct VertexExternalData
+{
+	XMFLOAT4X4 World;
+	XMFLOAT4X4 WorldInverseTranspose;
+	XMFLOAT4X4 View;
+	XMFLOAT4X4 Projection;
+	XMFLOAT4X4 LightView;
+	XMFLOAT4X4 LightProjection;
+};
+
+struct PixelExternalData
+{
+	XMFLOAT4 ColorTint;
+	XMFLOAT3 CameraPos;
+	float Roughness;
+	XMFLOAT3 Ambient;
+	float Padding; // scale can't straddle a register
+	XMFLOAT2 Scale;
+	XMFLOAT2 Offset;
+	Light Lights[5];
+};
+
+static_assert(sizeof(Light) == 64, "Light must match the HLSL struct");
+static_assert(sizeof(VertexExternalData) == 384, "Vertex data must match the HLSL cbuffer");
+static_assert(sizeof(PixelExternalData) == 384, "Pixel data must match the HLSL cbuffer");
+
+struct VariableDesc
+{
+	const char* Name;
+	unsigned int ByteOffset;
+	unsigned int Size;
+};
+
+static const VariableDesc vertexVariables[] =
+{
+	{ "world", offsetof(VertexExternalData, World), 64 },
+	{ "worldInverseTranspose", offsetof(VertexExternalData, WorldInverseTranspose), 64 },
+	{ "view", offsetof(VertexExternalData, View), 64 },
+	{ "projection", offsetof(VertexExternalData, Projection), 64 },
+	{ "lightView", offsetof(VertexExternalData, LightView), 64 },
+	{ "lightProjection", offsetof(VertexExternalData, LightProjection), 64 },
+};
+
+static const VariableDesc pixelVariables[] =
+{
+	{ "colorTint", offsetof(PixelExternalData, ColorTint), 16 },
+	{ "cameraPos", offsetof(PixelExternalData, CameraPos), 12 },
+	{ "roughness", offsetof(PixelExternalData, Roughness), 4 },
+	{ "ambient", offsetof(PixelExternalData, Ambient), 12 },
+	{ "scale", offsetof(PixelExternalData, Scale), 8 },
+	{ "offset", offsetof(PixelExternalData, Offset), 8 },
+	{ "directionalLight", offsetof(PixelExternalData, Lights) + 0 * sizeof(Light), 64 },
+	{ "directionalLight2", offsetof(PixelExternalData, Lights) + 1 * sizeof(Light), 64 },
+	{ "directionalLight3", offsetof(PixelExternalData, Lights) + 2 * sizeof(Light), 64 },
+	{ "pointLight", offsetof(PixelExternalData, Lights) + 3 * sizeof(Light), 64 },
+	{ "pointLight2", offsetof(PixelExternalData, Lights) + 4 * sizeof(Light), 64 },
+};
+
+#define VERTEX_VARIABLE_COUNT (sizeof(vertexVariables) / sizeof(vertexVariables[0]))
+#define PIXEL_VARIABLE_COUNT (sizeof(pixelVariables) / sizeof(pixelVariables[0]))
+#define VARIABLE_COUNT (VERTEX_VARIABLE_COUNT + PIXEL_VARIABLE_COUNT)
+
+// A shader's table, as SimpleShader builds it from reflection
+static ShaderVariableTable MakeTable(const VariableDesc* variables, unsigned int count, unsigned int bufferSize)
+{
+	ShaderVariableTable table;
+	table.Reserve(1, count);
+	unsigned int buffer = table.AddBuffer("ExternalData", bufferSize);
+	for (unsigned int v = 0; v < count; v++)
+		table.AddVariable(variables[v].Name, buffer, variables[v].ByteOffset, variables[v].Size);
+	return table;
+}
+
+// Fills in what one entity set: the camera and lights are
+// the same for every entity, the rest changes
+static void EntityValues(unsigned int entity, VertexExternalData& vs, PixelExternalData& ps)
+{
+	float e = (float)entity;
+	float* vsFloats = &vs.World._11;
+	for (unsigned int i = 0; i < 16; i++)
+	{
+		vsFloats[i] = e + i;			// World
+		vsFloats[16 + i] = e * 2 + i;	// WorldInverseTranspose
+		vsFloats[32 + i] = 1.0f + i;	// View
+		vsFloats[48 + i] = 2.0f + i;	// Projection
+		vsFloats[64 + i] = 3.0f + i;	// LightView
+		vsFloats[80 + i] = 4.0f + i;	// LightProjection
+	}
+
+	memset(&ps, 0, sizeof(ps));
+	ps.ColorTint = XMFLOAT4(e, 1, 1, 1);
+	ps.CameraPos = XMFLOAT3(0, 5, -10);
+	ps.Roughness = (entity % 10) / 10.0f;
+	ps.Ambient = XMFLOAT3(0.1f, 0.1f, 0.2f);
+	ps.Scale = XMFLOAT2(1.0f + entity % 3, 1.0f);
+	ps.Offset = XMFLOAT2(e * 0.5f, 0);
+	for (unsigned int l = 0; l < 5; l++)
+	{
+		ps.Lights[l].Type = l < 3 ? 0 : 1;
+		ps.Lights[l].Direction = XMFLOAT3(1, -1, (float)l);
+		ps.Lights[l].Range = 10.0f;
+		ps.Lights[l].Position = XMFLOAT3((float)l, 2, 0);
+		ps.Lights[l].Intensity = 1.0f;
+		ps.Lights[l].Color = XMFLOAT3(1, 1, 1);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool quick = HasArgument(argc, argv, "--quick");
+	unsigned int entityCount = 10000;
+	unsigned int frames = quick ? 3 : 100;
+
+	ShaderVariableTable vsByName = MakeTable(vertexVariables, VERTEX_VARIABLE_COUNT, sizeof(VertexExternalData));
+	ShaderVariableTable psByName = MakeTable(pixelVariables, PIXEL_VARIABLE_COUNT, sizeof(PixelExternalData));
+	ShaderVariableTable vsByHandle = vsByName, psByHandle = psByName;
+	ShaderVariableTable vsByBuffer = vsByName, psByBuffer = psByName;
+
+	//Resolved once, like LoadShaders() and the materials do
+	SimpleShaderHandle vsHandles[VERTEX_VARIABLE_COUNT];
+	SimpleShaderHandle psHandles[PIXEL_VARIABLE_COUNT];
+	for (unsigned int v = 0; v < VERTEX_VARIABLE_COUNT; v++)
+		vsHandles[v] = vsByHandle.GetVariableHandle(vertexVariables[v].Name);
+	for (unsigned int v = 0; v < PIXEL_VARIABLE_COUNT; v++)
+		psHandles[v] = psByHandle.GetVariableHandle(pixelVariables[v].Name);
+	SimpleShaderHandle vsBuffer = vsByBuffer.GetBufferHandle("ExternalData");
+	SimpleShaderHandle psBuffer = psByBuffer.GetBufferHandle("ExternalData");
+
+	VertexExternalData vs;
+	PixelExternalData ps;
+	const unsigned char* vsBytes = (const unsigned char*)&vs;
+	const unsigned char* psBytes = (const unsigned char*)&ps;
+	double nameSeconds = 0.0, handleSeconds = 0.0, bufferSeconds = 0.0;
+	unsigned int failures = 0;
+
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		for (unsigned int e = 0; e < entityCount; e++)
+		{
+			EntityValues(e, vs, ps);
+
+			//The old Game::Draw(): SetMatrix4x4, SetFloat4 etc. and SetData for the lights
+			BenchmarkTimer nameTimer;
+			failures += vsByName.SetData("world", &vs.World, sizeof(XMFLOAT4X4)) ? 0 : 1;
+			failures += vsByName.SetData("worldInverseTranspose", &vs.WorldInverseTranspose, sizeof(XMFLOAT4X4)) ? 0 : 1;
+			failures += vsByName.SetData("view", &vs.View, sizeof(XMFLOAT4X4)) ? 0 : 1;
+			failures += vsByName.SetData("projection", &vs.Projection, sizeof(XMFLOAT4X4)) ? 0 : 1;
+			failures += vsByName.SetData("lightView", &vs.LightView, sizeof(XMFLOAT4X4)) ? 0 : 1;
+			failures += vsByName.SetData("lightProjection", &vs.LightProjection, sizeof(XMFLOAT4X4)) ? 0 : 1;
+			failures += psByName.SetData("colorTint", &ps.ColorTint, sizeof(float) * 4) ? 0 : 1;
+			failures += psByName.SetData("cameraPos", &ps.CameraPos, sizeof(float) * 3) ? 0 : 1;
+			failures += psByName.SetData("roughness", &ps.Roughness, sizeof(float)) ? 0 : 1;
+			failures += psByName.SetData("ambient", &ps.Ambient, sizeof(float) * 3) ? 0 : 1;
+			failures += psByName.SetData("scale", &ps.Scale, sizeof(float) * 2) ? 0 : 1;
+			failures += psByName.SetData("offset", &ps.Offset, sizeof(float) * 2) ? 0 : 1;
+			failures += psByName.SetData("directionalLight", &ps.Lights[0], sizeof(Light)) ? 0 : 1;
+			failures += psByName.SetData("directionalLight2", &ps.Lights[1], sizeof(Light)) ? 0 : 1;
+			failures += psByName.SetData("directionalLight3", &ps.Lights[2], sizeof(Light)) ? 0 : 1;
+			failures += psByName.SetData("pointLight", &ps.Lights[3], sizeof(Light)) ? 0 : 1;
+			failures += psByName.SetData("pointLight2", &ps.Lights[4], sizeof(Light)) ? 0 : 1;
+			nameSeconds += nameTimer.Seconds();
+
+			//Same sets through handles
+			BenchmarkTimer handleTimer;
+			for (unsigned int v = 0; v < VERTEX_VARIABLE_COUNT; v++)
+				failures += vsByHandle.SetData(vsHandles[v], vsBytes + vertexVariables[v].ByteOffset, vertexVariables[v].Size) ? 0 : 1;
+			for (unsigned int v = 0; v < PIXEL_VARIABLE_COUNT; v++)
+				failures += psByHandle.SetData(psHandles[v], psBytes + pixelVariables[v].ByteOffset, pixelVariables[v].Size) ? 0 : 1;
+			handleSeconds += handleTimer.Seconds();
+
+			//The structs already match the buffers, so one set each
+			BenchmarkTimer bufferTimer;
+			failures += vsByBuffer.SetData(vsBuffer, &vs, sizeof(vs)) ? 0 : 1;
+			failures += psByBuffer.SetData(psBuffer, &ps, sizeof(ps)) ? 0 : 1;
+			bufferSeconds += bufferTimer.Seconds();
+		}
+	}
+
+	//All three have to leave the same bytes behind
+	CHECK(failures == 0);
+	CHECK(vsByName.GetBuffer(0).Data == vsByHandle.GetBuffer(0).Data);
+	CHECK(psByName.GetBuffer(0).Data == psByHandle.GetBuffer(0).Data);
+	CHECK(vsByName.GetBuffer(0).Data == vsByBuffer.GetBuffer(0).Data);
+	CHECK(psByName.GetBuffer(0).Data == psByBuffer.GetBuffer(0).Data);
+	CHECK(memcmp(vsByName.GetBuffer(0).Data.data(), &vs, sizeof(vs)) == 0);
+	CHECK(memcmp(psByName.GetBuffer(0).Data.data(), &ps, sizeof(ps)) == 0);
+
+	double sets = (double)entityCount * frames * VARIABLE_COUNT;
+	printf("%u entities x %u variables, %u frames, 2 x 384 byte buffers\n", entityCount, (unsigned int)VARIABLE_COUNT, frames);
+	printf("  By name:      %6.2f ns per set\n", nameSeconds * 1e9 / sets);
+	printf("  By handle:    %6.2f ns per set\n", handleSeconds * 1e9 / sets);
+	printf("  Whole buffer: %6.2f ns per variable\n", bufferSeconds * 1e9 / sets);
+	return TestResult();
+}
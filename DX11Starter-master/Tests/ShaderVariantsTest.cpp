@@ -0,0 +1,144 @@
+#include "TestHelpers.h"
+#include "ShaderVariants.h"
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+// Value of a define by name, or "" if it's missing
+static std::string DefineValue(const std::vector<ShaderDefine>& defines, const char* name)
+{
+	for (const ShaderDefine& define : defines)
+	{
+		if (define.Name == name)
+			return define.Value;
+	}
+	return "";
+}
+
+static unsigned long long HashText(const char* text)
+{
+	return HashShaderBytes(text, strlen(text));
+}
+
+static unsigned long long VariantHash(unsigned long long sourceHash, unsigned int features)
+{
+	std::vector<ShaderDefine> defines;
+	GetShaderVariantDefines(MakeShaderVariantKey(features), defines);
+	return HashShaderVariant(sourceHash, defines);
+}
+
+// --------------------------------------------------------
+// Every switch is always defined, to 1 only if its bit is set,
+// and bits the shader doesn't know are dropped
+// --------------------------------------------------------
+static void TestKeyToDefines()
+{
+	const char* names[] = { "USE_SHADOWS", "USE_NORMAL_MAP", "USE_ALPHA_TEST" };
+	unsigned int bits[] = { SHADER_FEATURE_SHADOWS, SHADER_FEATURE_NORMAL_MAP, SHADER_FEATURE_ALPHA_TEST };
+
+	for (unsigned int features = 0; features <= SHADER_FEATURE_MASK; features++)
+	{
+		ShaderVariantKey key = MakeShaderVariantKey(features);
+		CHECK(GetVariantFeatures(key) == features);
+
+		std::vector<ShaderDefine> defines;
+		GetShaderVariantDefines(key, defines);
+		CHECK(defines.size() == 3);
+		for (unsigned int i = 0; i < 3; i++)
+			CHECK(DefineValue(defines, names[i]) == ((features & bits[i]) ? "1" : "0"));
+	}
+
+	CHECK(MakeShaderVariantKey(0xFFFFFFF8) == 0);
+	CHECK(MakeShaderVariantKey(0x100 | SHADER_FEATURE_NORMAL_MAP) == MakeShaderVariantKey(SHADER_FEATURE_NORMAL_MAP));
+
+	//Filling a list that's already in use replaces it
+	std::vector<ShaderDefine> defines(5);
+	GetShaderVariantDefines(MakeShaderVariantKey(SHADER_FEATURE_SHADOWS), defines);
+	CHECK(defines.size() == 3);
+	CHECK(DefineValue(defines, "USE_SHADOWS") == "1");
+}
+
+// --------------------------------------------------------
+// The hash names files on disk, so it has to come out the
+// same from run to run and build to build
+// --------------------------------------------------------
+static void TestHashStability()
+{
+	//FNV-1a 64 reference values
+	CHECK(HashShaderBytes("", 0) == 0xcbf29ce484222325ULL);
+	CHECK(HashShaderBytes("a", 1) == 0xaf63dc4c8601ec8cULL);
+	CHECK(HashShaderBytes("foobar", 6) == 0x85944171f73967e8ULL);
+
+	//Chaining is the same as hashing it all at once
+	CHECK(HashShaderBytes("bar", 3, HashShaderBytes("foo", 3)) == HashShaderBytes("foobar", 6));
+
+	//A variant's hash only depends on its inputs
+	unsigned long long source = HashText("float4 main() : SV_TARGET { return 1; }");
+	for (unsigned int features = 0; features <= SHADER_FEATURE_MASK; features++)
+		CHECK(VariantHash(source, features) == VariantHash(source, features));
+
+	//Pinned, so a change to the hashing shows up here before it orphans every .cso
+	CHECK(HashText("source") == 0x76dbdc228f782db8ULL);
+	CHECK(VariantHash(HashText("source"), SHADER_FEATURE_SHADOWS | SHADER_FEATURE_ALPHA_TEST) == 0xdc5af2d55733ff0eULL);
+}
+
+// --------------------------------------------------------
+// Changing the source or any define gives a new hash
+// --------------------------------------------------------
+static void TestHashChanges()
+{
+	unsigned long long source = HashText("float4 main() : SV_TARGET { return 1; }");
+	unsigned long long editedSource = HashText("float4 main() : SV_TARGET { return 0; }");
+	CHECK(source != editedSource);
+
+	//Every variant of both sources is different
+	std::set<unsigned long long> hashes;
+	for (unsigned int features = 0; features <= SHADER_FEATURE_MASK; features++)
+	{
+		hashes.insert(VariantHash(source, features));
+		hashes.insert(VariantHash(editedSource, features));
+	}
+	CHECK(hashes.size() == 2 * (SHADER_FEATURE_MASK + 1));
+
+	//Names, values and the split between them all count
+	std::vector<ShaderDefine> base = { { "USE_SHADOWS", "1" } };
+	std::vector<ShaderDefine> otherValue = { { "USE_SHADOWS", "2" } };
+	std::vector<ShaderDefine> otherName = { { "USE_SHADOW", "1" } };
+	std::vector<ShaderDefine> extra = { { "USE_SHADOWS", "1" }, { "DEBUG", "1" } };
+	std::vector<ShaderDefine> splitA = { { "AB", "C" } };
+	std::vector<ShaderDefine> splitB = { { "A", "BC" } };
+	std::vector<ShaderDefine> none;
+	CHECK(HashShaderVariant(source, base) != HashShaderVariant(source, otherValue));
+	CHECK(HashShaderVariant(source, base) != HashShaderVariant(source, otherName));
+	CHECK(HashShaderVariant(source, base) != HashShaderVariant(source, extra));
+	CHECK(HashShaderVariant(source, splitA) != HashShaderVariant(source, splitB));
+	CHECK(HashShaderVariant(source, none) == source);
+}
+
+// --------------------------------------------------------
+// Shader name, an underscore, all 16 hex digits, .cso
+// --------------------------------------------------------
+static void TestFileNames()
+{
+	CHECK(GetShaderVariantFileName("PixelShader", 0x0123456789abcdefULL) == "PixelShader_0123456789abcdef.cso");
+	CHECK(GetShaderVariantFileName("PixelShader", 0) == "PixelShader_0000000000000000.cso");
+	CHECK(GetShaderVariantFileName("PixelShader", 0xFFFFFFFFFFFFFFFFULL) == "PixelShader_ffffffffffffffff.cso");
+	CHECK(GetShaderVariantFileName("VertexShader", 0xAB) == "VertexShader_00000000000000ab.cso");
+
+	//Different variants never share a file
+	unsigned long long source = HashText("source");
+	std::set<std::string> names;
+	for (unsigned int features = 0; features <= SHADER_FEATURE_MASK; features++)
+		names.insert(GetShaderVariantFileName("PixelShader", VariantHash(source, features)));
+	CHECK(names.size() == SHADER_FEATURE_MASK + 1);
+}
+
+int main()
+{
+	TestKeyToDefines();
+	TestHashStability();
+	TestHashChanges();
+	TestFileNames();
+	return TestResult();
+}
@@ -0,0 +1,255 @@
+#include "TestHelpers.h"
+#include "ShadowAtlas.h"
+#include <vector>
+
+// --------------------------------------------------------
+// ShadowAtlas driven the way Game::UpdateShadowAtlas() does:
+// six keys per light, whole cubes, everything that fits
+// first and eviction only for what didn't or came out small
+// --------------------------------------------------------
+
+struct TestLight
+{
+	unsigned int Key;
+	unsigned int Size; // Asked for, 0 to not ask this frame
+	bool Placed;
+	bool IsNew;
+	ShadowAtlasTile Tiles[6];
+};
+
+struct FrameResult
+{
+	unsigned int Placed;
+	unsigned int NewTiles;
+	unsigned int Evictions;
+};
+
+static FrameResult Frame(ShadowAtlas& atlas, std::vector<TestLight>& lights)
+{
+	unsigned int evictions = atlas.GetEvictionCount();
+	atlas.BeginFrame();
+	for (TestLight& light : lights)
+		light.Placed = false;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (TestLight& light : lights)
+		{
+			if (light.Size == 0 || (light.Placed && light.Tiles[0].Size == light.Size))
+				continue;
+			light.Placed = atlas.Request(light.Key * 6, 6, light.Size, pass == 1, light.Tiles, light.IsNew);
+		}
+	}
+
+	FrameResult result = {};
+	for (TestLight& light : lights)
+	{
+		result.Placed += light.Placed ? 1 : 0;
+		result.NewTiles += light.Placed && light.IsNew ? 6 : 0;
+	}
+	result.Evictions = atlas.GetEvictionCount() - evictions;
+	return result;
+}
+
+static TestLight Light(unsigned int key, unsigned int size)
+{
+	TestLight light = {};
+	light.Key = key;
+	light.Size = size;
+	return light;
+}
+
+// Every placed tile inside the atlas, a cube's faces the same size, no two overlapping
+static bool TilesValid(ShadowAtlas& atlas, const std::vector<TestLight>& lights)
+{
+	std::vector<ShadowAtlasTile> tiles;
+	for (const TestLight& light : lights)
+	{
+		for (unsigned int face = 0; light.Placed && face < 6; face++)
+		{
+			const ShadowAtlasTile& t = light.Tiles[face];
+			if (t.Size != light.Tiles[0].Size || t.X + t.Size > atlas.GetAtlasSize() || t.Y + t.Size > atlas.GetAtlasSize())
+				return false;
+			tiles.push_back(t);
+		}
+	}
+
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		for (size_t j = i + 1; j < tiles.size(); j++)
+		{
+			const ShadowAtlasTile& a = tiles[i];
+			const ShadowAtlasTile& b = tiles[j];
+			if (a.X < b.X + b.Size && b.X < a.X + a.Size && a.Y < b.Y + b.Size && b.Y < a.Y + a.Size)
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool SameTiles(const TestLight& a, const TestLight& b)
+{
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		if (a.Tiles[face].X != b.Tiles[face].X || a.Tiles[face].Y != b.Tiles[face].Y || a.Tiles[face].Size != b.Tiles[face].Size)
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Nothing moves, so after the first frame nothing is new.
+// The third light doesn't fit at 1024 but does at 512.
+// --------------------------------------------------------
+static void TestStaticScene()
+{
+	ShadowAtlas atlas(4096, 64, 1024);
+	std::vector<TestLight> lights = { Light(0, 1024), Light(1, 1024), Light(2, 1024), Light(3, 512) };
+
+	FrameResult first = Frame(atlas, lights);
+	CHECK(first.Placed == 4 && first.NewTiles == 24 && first.Evictions == 0);
+	CHECK(lights[2].Tiles[0].Size == 512 && lights[3].Tiles[0].Size == 512);
+	CHECK(TilesValid(atlas, lights));
+
+	std::vector<TestLight> firstTiles = lights;
+	for (int frame = 0; frame < 200; frame++)
+	{
+		//Order changes as lights swap places on screen, shouldn't matter
+		if (frame % 3 == 0)
+			std::swap(lights[0], lights[1]);
+
+		FrameResult result = Frame(atlas, lights);
+		CHECK(result.Placed == 4 && result.NewTiles == 0 && result.Evictions == 0);
+	}
+
+	for (const TestLight& light : lights)
+		CHECK(SameTiles(light, firstTiles[light.Key]));
+}
+
+// --------------------------------------------------------
+// A light that needs room takes it from lights that weren't
+// asked for this frame, never from ones that were
+// --------------------------------------------------------
+static void TestNoCrossLightThrash()
+{
+	ShadowAtlas atlas(4096, 64, 1024);
+	std::vector<TestLight> lights = { Light(0, 1024), Light(1, 1024), Light(2, 512), Light(3, 0) };
+	Frame(atlas, lights);
+	TestLight kept1 = lights[1];
+	TestLight kept2 = lights[2];
+
+	//Light 0 goes out of view as light 3 turns up wanting 1024. Only
+	//light 0's old tiles can make room for it.
+	lights[0].Size = 0;
+	lights[3].Size = 1024;
+	FrameResult result = Frame(atlas, lights);
+	CHECK(result.Placed == 3);
+	CHECK(lights[3].Placed && lights[3].IsNew && lights[3].Tiles[0].Size == 1024);
+	CHECK(!lights[1].IsNew && SameTiles(lights[1], kept1));
+	CHECK(!lights[2].IsNew && SameTiles(lights[2], kept2));
+	CHECK(result.Evictions > 0 && result.Evictions <= 6);
+	CHECK(TilesValid(atlas, lights));
+
+	//Then it's all stable again
+	result = Frame(atlas, lights);
+	CHECK(result.NewTiles == 0 && result.Evictions == 0);
+
+	//More wanted than fits: lights shrink rather than push each other out
+	std::vector<TestLight> crowd;
+	for (unsigned int i = 0; i < 8; i++)
+		crowd.push_back(Light(10 + i, 1024));
+	ShadowAtlas crowded(4096, 64, 1024);
+	result = Frame(crowded, crowd);
+	CHECK(result.Placed == 8 && result.Evictions == 0);
+	CHECK(TilesValid(crowded, crowd));
+	for (int frame = 0; frame < 10; frame++)
+	{
+		result = Frame(crowded, crowd);
+		CHECK(result.Placed == 8 && result.NewTiles == 0 && result.Evictions == 0);
+	}
+
+	//Once there's room, a shrunken light grows back, once
+	for (unsigned int i = 0; i < 6; i++)
+		crowd[i].Size = 0;
+	crowded.Release(crowd[0].Key * 6, 6);
+	crowded.Release(crowd[1].Key * 6, 6);
+	result = Frame(crowded, crowd);
+	CHECK(crowd[6].Tiles[0].Size == 1024 && crowd[7].Tiles[0].Size == 1024);
+	result = Frame(crowded, crowd);
+	CHECK(result.NewTiles == 0);
+}
+
+// --------------------------------------------------------
+// Released tiles merge back into bigger ones, and a cube
+// that doesn't fit leaves nothing behind
+// --------------------------------------------------------
+static void TestBuddyMerge()
+{
+	ShadowAtlas atlas(1024, 64, 1024);
+	ShadowAtlasTile tiles[256];
+	bool isNew = false;
+
+	//Fill it with the smallest tiles, scattered over every level
+	atlas.BeginFrame();
+	CHECK(atlas.Request(0, 6, 256, false, tiles, isNew));
+	CHECK(atlas.Request(100, 160, 64, false, tiles, isNew));
+	CHECK(atlas.GetAllocatedTileCount() == 166);
+	CHECK(!atlas.Request(1000, 1, 64, false, tiles, isNew));
+
+	//No whole atlas until every piece is back
+	atlas.Release(0, 6);
+	CHECK(!atlas.Request(1000, 1, 1024, false, tiles, isNew) || tiles[0].Size < 1024);
+	atlas.Release(1000, 1);
+	atlas.Release(100, 160);
+	CHECK(atlas.GetAllocatedTileCount() == 0 && atlas.GetAllocatedTexels() == 0);
+	CHECK(atlas.Request(1000, 1, 1024, false, tiles, isNew));
+	CHECK(tiles[0].X == 0 && tiles[0].Y == 0 && tiles[0].Size == 1024);
+	atlas.Release(1000, 1);
+
+	//Six faces don't fit at 1024 or 512, so all six come in at 256
+	CHECK(atlas.Request(0, 6, 1024, false, tiles, isNew));
+	for (unsigned int face = 0; face < 6; face++)
+		CHECK(tiles[face].Size == 256);
+	atlas.Release(0, 6);
+
+	//More than fits even at the minimum: nothing is kept
+	CHECK(!atlas.Request(0, 257, 64, true, tiles, isNew));
+	CHECK(atlas.GetAllocatedTileCount() == 0);
+	CHECK(atlas.Request(0, 1, 1024, false, tiles, isNew) && tiles[0].Size == 1024);
+}
+
+// --------------------------------------------------------
+// Tiles nobody asks for are freed after evictAfterFrames
+// --------------------------------------------------------
+static void TestAging()
+{
+	ShadowAtlas atlas(4096, 64, 1024);
+	atlas.SetEvictAfterFrames(3);
+	std::vector<TestLight> lights = { Light(0, 1024), Light(1, 512) };
+	Frame(atlas, lights);
+	CHECK(atlas.GetAllocatedTileCount() == 12);
+
+	//Light 1 stops asking, light 0 carries on
+	lights[1].Size = 0;
+	for (int frame = 0; frame < 3; frame++)
+	{
+		Frame(atlas, lights);
+		CHECK(atlas.GetAllocatedTileCount() == 12);
+	}
+	Frame(atlas, lights);
+	CHECK(atlas.GetAllocatedTileCount() == 6);
+
+	//Aging out isn't an eviction, and light 0 never lost its tiles
+	CHECK(atlas.GetEvictionCount() == 0);
+	CHECK(!lights[0].IsNew);
+	CHECK(atlas.GetAllocatedTexels() == 6 * 1024 * 1024);
+}
+
+int main()
+{
+	TestStaticScene();
+	TestNoCrossLightThrash();
+	TestBuddyMerge();
+	TestAging();
+	return TestResult();
+}
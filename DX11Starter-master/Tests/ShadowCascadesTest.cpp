@@ -0,0 +1,189 @@
+#include "TestHelpers.h"
+#include "ShadowCascades.h"
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+using namespace DirectX;
+
+#define NEAR_PLANE 0.1f
+#define FAR_PLANE 100.0f
+#define RESOLUTION 2048.0f
+
+static void TestSplits()
+{
+	float splits[SHADOW_CASCADE_COUNT + 1];
+
+	//Lambda 0 is evenly spaced
+	ShadowCascades::ComputeSplits(1.0f, 81.0f, 0.0f, splits);
+	for (unsigned int i = 0; i <= SHADOW_CASCADE_COUNT; i++)
+		CHECK_NEAR(splits[i], 1.0f + 80.0f * i / SHADOW_CASCADE_COUNT, 1e-4f);
+
+	//Lambda 1 keeps the same ratio between neighbours (3 for 1 to 81)
+	ShadowCascades::ComputeSplits(1.0f, 81.0f, 1.0f, splits);
+	const float expected[SHADOW_CASCADE_COUNT + 1] = { 1.0f, 3.0f, 9.0f, 27.0f, 81.0f };
+	for (unsigned int i = 0; i <= SHADOW_CASCADE_COUNT; i++)
+		CHECK_NEAR(splits[i], expected[i], 1e-3f);
+
+	//In between is in between, and always increasing
+	ShadowCascades::ComputeSplits(NEAR_PLANE, FAR_PLANE, 0.5f, splits);
+	CHECK(splits[0] == NEAR_PLANE);
+	CHECK(splits[SHADOW_CASCADE_COUNT] == FAR_PLANE);
+	for (unsigned int i = 1; i <= SHADOW_CASCADE_COUNT; i++)
+		CHECK(splits[i] > splits[i - 1]);
+}
+
+static void MakeCamera(const XMFLOAT3& position, float yaw, XMFLOAT4X4& view, XMFLOAT4X4& projection)
+{
+	XMVECTOR direction = XMVectorSet(sinf(yaw), -0.2f, cosf(yaw), 0);
+	XMStoreFloat4x4(&view, XMMatrixLookToLH(XMLoadFloat3(&position), direction, XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, NEAR_PLANE, FAR_PLANE));
+}
+
+// --------------------------------------------------------
+// The 8 corners of the camera frustum between two view
+// depths, the same slice Update() fits a cascade around
+// --------------------------------------------------------
+static void GetSliceCorners(const XMFLOAT4X4& view, const XMFLOAT4X4& projection, float nearZ, float farZ, XMVECTOR* corners)
+{
+	XMMATRIX inverse = XMMatrixInverse(0, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+	const float ndc[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		XMVECTOR a = XMVector3TransformCoord(XMVectorSet(ndc[c][0], ndc[c][1], 0.0f, 1.0f), inverse);
+		XMVECTOR b = XMVector3TransformCoord(XMVectorSet(ndc[c][0], ndc[c][1], 1.0f, 1.0f), inverse);
+		corners[c] = a + (b - a) * ((nearZ - NEAR_PLANE) / (FAR_PLANE - NEAR_PLANE));
+		corners[c + 4] = a + (b - a) * ((farZ - NEAR_PLANE) / (FAR_PLANE - NEAR_PLANE));
+	}
+}
+
+// --------------------------------------------------------
+// Every corner of a cascade's slice has to land inside its
+// shadow map, within the circle of the bounding sphere (plus
+// the up to one texel the snapping moves it) and inside the
+// depth range
+// --------------------------------------------------------
+static void TestSpheresContainSlices()
+{
+	std::vector<BoundingBox> casters;
+	casters.push_back(BoundingBox(XMFLOAT3(0, 0, 10), XMFLOAT3(2, 2, 2)));
+
+	ShadowCascades cascades(RESOLUTION);
+	XMFLOAT3 lightDirections[] = { XMFLOAT3(1, -1, 1), XMFLOAT3(0, -1, 0), XMFLOAT3(-0.3f, -0.2f, 1) };
+	float yaws[] = { 0.0f, 1.0f, 2.5f };
+
+	for (const XMFLOAT3& light : lightDirections)
+	{
+		for (float yaw : yaws)
+		{
+			XMFLOAT4X4 view, projection;
+			MakeCamera(XMFLOAT3(3, 2, -5), yaw, view, projection);
+			cascades.Update(light, view, projection, NEAR_PLANE, FAR_PLANE, casters);
+
+			for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+			{
+				XMFLOAT4X4 viewProjection = cascades.GetViewProjection(i);
+				XMMATRIX shadow = XMLoadFloat4x4(&viewProjection);
+				XMVECTOR corners[8];
+				GetSliceCorners(view, projection, cascades.GetSplit(i), cascades.GetSplit(i + 1), corners);
+
+				float circle = 1.0f + 2.0f * 1.5f / RESOLUTION;
+				for (unsigned int c = 0; c < 8; c++)
+				{
+					XMFLOAT3 p;
+					XMStoreFloat3(&p, XMVector3TransformCoord(corners[c], shadow));
+					CHECK(sqrtf(p.x * p.x + p.y * p.y) <= circle);
+					CHECK(p.z >= 0.0f && p.z <= 1.0f);
+				}
+			}
+		}
+	}
+}
+
+// Where a world position lands in the shadow map, in texels
+static XMFLOAT2 ToTexels(const XMFLOAT4X4& viewProjection, const XMFLOAT3& position)
+{
+	XMFLOAT3 p;
+	XMStoreFloat3(&p, XMVector3TransformCoord(XMLoadFloat3(&position), XMLoadFloat4x4(&viewProjection)));
+	return XMFLOAT2((p.x * 0.5f + 0.5f) * RESOLUTION, (0.5f - p.y * 0.5f) * RESOLUTION);
+}
+
+// --------------------------------------------------------
+// Moving the camera by less than a texel at a time must only
+// ever move the shadow map by whole texels, so a fixed point
+// in the world keeps its position within a texel
+// --------------------------------------------------------
+static void TestSnappingIsStable()
+{
+	std::vector<BoundingBox> casters;
+	ShadowCascades cascades(RESOLUTION);
+	XMFLOAT3 light(0.4f, -1.0f, 0.7f);
+	XMFLOAT3 probes[] = { XMFLOAT3(0, 0, 0), XMFLOAT3(1.3f, 0.2f, 2.7f), XMFLOAT3(-2.1f, 0.0f, 5.9f) };
+
+	XMFLOAT4X4 view, projection;
+	MakeCamera(XMFLOAT3(0, 2, -3), 0.3f, view, projection);
+	cascades.Update(light, view, projection, NEAR_PLANE, FAR_PLANE, casters);
+
+	XMFLOAT4X4 first[SHADOW_CASCADE_COUNT];
+	float radius[SHADOW_CASCADE_COUNT];
+	float smallestTexel = FLT_MAX;
+	for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+	{
+		first[i] = cascades.GetViewProjection(i);
+		radius[i] = cascades.GetRadius(i);
+		smallestTexel = std::min(smallestTexel, cascades.GetTexelSize(i));
+	}
+
+	for (unsigned int step = 1; step <= 40; step++)
+	{
+		float offset = step * smallestTexel * 0.37f;
+		MakeCamera(XMFLOAT3(offset, 2, -3 + offset * 0.5f), 0.3f, view, projection);
+		cascades.Update(light, view, projection, NEAR_PLANE, FAR_PLANE, casters);
+
+		for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+		{
+			CHECK(cascades.GetRadius(i) == radius[i]);
+
+			for (const XMFLOAT3& probe : probes)
+			{
+				XMFLOAT2 before = ToTexels(first[i], probe);
+				XMFLOAT2 after = ToTexels(cascades.GetViewProjection(i), probe);
+				float dx = after.x - before.x;
+				float dy = after.y - before.y;
+				CHECK_NEAR(dx, roundf(dx), 2e-3f);
+				CHECK_NEAR(dy, roundf(dy), 2e-3f);
+			}
+		}
+	}
+}
+
+// Turning the camera on the spot keeps every cascade the same size
+static void TestRadiusIgnoresRotation()
+{
+	std::vector<BoundingBox> casters;
+	ShadowCascades cascades(RESOLUTION);
+	XMFLOAT4X4 view, projection;
+
+	MakeCamera(XMFLOAT3(0, 2, 0), 0.0f, view, projection);
+	cascades.Update(XMFLOAT3(1, -1, 0), view, projection, NEAR_PLANE, FAR_PLANE, casters);
+	float radius[SHADOW_CASCADE_COUNT];
+	for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+		radius[i] = cascades.GetRadius(i);
+
+	for (float yaw = 0.1f; yaw < 6.2f; yaw += 0.37f)
+	{
+		MakeCamera(XMFLOAT3(0, 2, 0), yaw, view, projection);
+		cascades.Update(XMFLOAT3(1, -1, 0), view, projection, NEAR_PLANE, FAR_PLANE, casters);
+		for (unsigned int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+			CHECK(cascades.GetRadius(i) == radius[i]);
+	}
+}
+
+int main()
+{
+	TestSplits();
+	TestSpheresContainSlices();
+	TestSnappingIsStable();
+	TestRadiusIgnoresRotation();
+	return TestResult();
+}
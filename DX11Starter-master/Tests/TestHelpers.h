@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// --------------------------------------------------------
+// Just enough to write the tests and benchmarks without a
+// framework
+//
+// - CHECK() and CHECK_NEAR() report a failure and carry on,
+//   so one run shows everything that's wrong
+// - Tests return TestResult() from main(), which is what
+//   ctest looks at
+// - Benchmarks take --quick, which ctest passes so they're
+//   at least run (and checked) with every build
+// --------------------------------------------------------
+
+inline int& TestFailureCount()
+{
+	static int count = 0;
+	return count;
+}
+
+inline void TestFailed(const char* file, int line, const char* what)
+{
+	printf("%s(%d): FAILED %s\n", file, line, what);
+	TestFailureCount()++;
+}
+
+#define CHECK(condition) \
+	do { if (!(condition)) TestFailed(__FILE__, __LINE__, #condition); } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+	do { if (!(std::fabs((double)(a) - (double)(b)) <= (double)(tolerance))) TestFailed(__FILE__, __LINE__, #a " near " #b); } while (0)
+
+inline int TestResult()
+{
+	if (TestFailureCount() > 0)
+	{
+		printf("%d check(s) failed\n", TestFailureCount());
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
+
+// True if the given flag was passed on the command line
+inline bool HasArgument(int argc, char** argv, const char* flag)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], flag) == 0)
+			return true;
+	}
+	return false;
+}
+
+// Times whatever runs between construction and Seconds()
+class BenchmarkTimer
+{
+public:
+	BenchmarkTimer() : start(std::chrono::high_resolution_clock::now()) {}
+
+	double Seconds()
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+private:
+	std::chrono::high_resolution_clock::time_point start;
+};
@@ -0,0 +1,77 @@
+#include "TestHelpers.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// --------------------------------------------------------
+// Back to back batches of different sizes, so workers that
+// are still leaving one batch meet the next. Every index of
+// every batch has to run exactly once.
+// --------------------------------------------------------
+static void TestBackToBackBatches()
+{
+	ThreadPool pool(8);
+	bool allOnce = true;
+	unsigned long long total = 0;
+	unsigned long long expected = 0;
+
+	for (unsigned int batch = 0; batch < 20000; batch++)
+	{
+		unsigned int count = 1 + (batch * 7) % 61;
+		std::unique_ptr<std::atomic<unsigned int>[]> hits(new std::atomic<unsigned int>[count]);
+		for (unsigned int i = 0; i < count; i++)
+			hits[i] = 0;
+
+		std::atomic<unsigned long long> sum(0);
+		pool.ParallelFor(count, [&](unsigned int i)
+		{
+			hits[i]++;
+			sum += i;
+		});
+
+		for (unsigned int i = 0; i < count; i++)
+			allOnce = allOnce && hits[i] == 1;
+		total += sum;
+		expected += (unsigned long long)count * (count - 1) / 2;
+	}
+
+	CHECK(allOnce);
+	CHECK(total == expected);
+}
+
+// The job is a temporary that's gone once ParallelFor returns
+static void TestTemporaryJobs()
+{
+	ThreadPool pool(4);
+	std::vector<unsigned int> values(64, 0);
+
+	for (unsigned int round = 0; round < 5000; round++)
+	{
+		pool.ParallelFor((unsigned int)values.size(), [&values, round](unsigned int i) { values[i] = round + i; });
+	}
+
+	bool last = true;
+	for (unsigned int i = 0; i < values.size(); i++)
+		last = last && values[i] == 4999 + i;
+	CHECK(last);
+}
+
+static void TestSingleThread()
+{
+	ThreadPool pool(1);
+	CHECK(pool.GetThreadCount() == 1);
+
+	unsigned int calls = 0;
+	pool.ParallelFor(10, [&](unsigned int) { calls++; });
+	pool.ParallelFor(0, [&](unsigned int) { calls++; });
+	CHECK(calls == 10);
+}
+
+int main()
+{
+	TestBackToBackBatches();
+	TestTemporaryJobs();
+	TestSingleThread();
+	return TestResult();
+}
@@ -0,0 +1,148 @@
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Creates the worker threads
+//
+// threadCount - Total threads to use, including the calling
+//               thread. Zero picks one per hardware core.
+// --------------------------------------------------------
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	job = 0;
+	jobCount = 0;
+	nextIndex = 0;
+	finishedCount = 0;
+	generation = 0;
+	shuttingDown = false;
+
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+
+	//The caller counts as one of the threads
+	for (unsigned int i = 1; i < threadCount; i++)
+	{
+		workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		shuttingDown = true;
+	}
+	wakeCondition.notify_all();
+
+	for (auto& w : workers)
+	{
+		w.join();
+	}
+}
+
+unsigned int ThreadPool::GetThreadCount()
+{
+	return (unsigned int)workers.size() + 1;
+}
+
+// --------------------------------------------------------
+// Takes the next index of the given batch, if that batch is
+// still the current one and has any left
+// --------------------------------------------------------
+bool ThreadPool::ClaimIndex(unsigned int batch, unsigned int count, unsigned int& index)
+{
+	unsigned long long current = nextIndex.load();
+	while (true)
+	{
+		if ((unsigned int)(current >> 32) != batch || (unsigned int)current >= count)
+			return false;
+
+		if (nextIndex.compare_exchange_weak(current, current + 1))
+		{
+			index = (unsigned int)current;
+			return true;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Hands out indices until the batch is exhausted
+//
+// Finishes only count towards the batch the indices came from.
+// That batch can't end while any of its indices are running,
+// so the job and count copied with it stay valid throughout.
+// --------------------------------------------------------
+void ThreadPool::RunJobs(unsigned int batch, const std::function<void(unsigned int)>* batchJob, unsigned int count)
+{
+	unsigned int done = 0;
+	unsigned int i;
+	while (ClaimIndex(batch, count, i))
+	{
+		(*batchJob)(i);
+		done++;
+	}
+
+	if (done > 0 && finishedCount.fetch_add(done) + done == count)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		doneCondition.notify_all();
+	}
+}
+
+void ThreadPool::WorkerLoop()
+{
+	unsigned int seenGeneration = 0;
+
+	while (true)
+	{
+		const std::function<void(unsigned int)>* batchJob;
+		unsigned int count;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeCondition.wait(lock, [&] { return shuttingDown || generation != seenGeneration; });
+
+			if (shuttingDown)
+				return;
+
+			seenGeneration = generation;
+			batchJob = job;
+			count = jobCount;
+		}
+
+		RunJobs(seenGeneration, batchJob, count);
+	}
+}
+
+void ThreadPool::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& job)
+{
+	if (count == 0)
+		return;
+
+	//Not worth waking anyone up
+	if (count == 1 || workers.empty())
+	{
+		for (unsigned int i = 0; i < count; i++)
+			job(i);
+		return;
+	}
+
+	unsigned int batch;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		batch = ++generation;
+		this->job = &job;
+		jobCount = count;
+		finishedCount = 0;
+		nextIndex = (unsigned long long)batch << 32;
+	}
+	wakeCondition.notify_all();
+
+	//Help out, then wait for the stragglers
+	RunJobs(batch, &job, count);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	doneCondition.wait(lock, [&] { return finishedCount.load() == count; });
+	this->job = 0;
+	jobCount = 0;
+}
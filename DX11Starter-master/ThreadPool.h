@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// A small pool of persistent worker threads used to split
+// CPU-side frame work (culling, binning, etc.) across cores
+//
+// - ParallelFor() blocks until every index has been processed
+// - The calling thread also takes part in the work
+// - One ParallelFor() at a time, so systems that run one after
+//   another on the same thread can share a single pool
+// --------------------------------------------------------
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const&) = delete;
+	void operator=(ThreadPool const&) = delete;
+
+	// Runs job(i) for every i in [0, count)
+	void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& job);
+
+	// Total number of threads taking part in a ParallelFor (workers + caller)
+	unsigned int GetThreadCount();
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+
+	// Current batch of work. Only changed under the mutex, where
+	// workers copy it along with the generation it belongs to.
+	const std::function<void(unsigned int)>* job;
+	unsigned int jobCount;
+	unsigned int generation;
+	bool shuttingDown;
+
+	// Generation in the high 32 bits and the next index in the
+	// low 32, so a worker that's fallen behind can't claim an
+	// index from a batch it didn't copy
+	std::atomic<unsigned long long> nextIndex;
+	std::atomic<unsigned int> finishedCount;
+
+	void WorkerLoop();
+	void RunJobs(unsigned int batch, const std::function<void(unsigned int)>* batchJob, unsigned int count);
+	bool ClaimIndex(unsigned int batch, unsigned int count, unsigned int& index);
+};
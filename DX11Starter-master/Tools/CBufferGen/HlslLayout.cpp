@@ -0,0 +1,611 @@
+#include "HlslLayout.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+
+// Includes nested deeper than this are assumed to be a cycle
+#define MAX_INCLUDE_DEPTH 16
+
+static unsigned int AlignRegister(unsigned int offset)
+{
+	return (offset + 15) & ~15u;
+}
+
+static std::string Trim(const std::string& text)
+{
+	size_t first = text.find_first_not_of(" \t\r\n");
+	if (first == std::string::npos)
+		return "";
+	size_t last = text.find_last_not_of(" \t\r\n");
+	return text.substr(first, last - first + 1);
+}
+
+// Just the file name, so the output doesn't depend on where it was built
+static std::string GetFileName(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static std::string GetFolder(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+static bool ReadFile(const std::string& path, std::string& text)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	std::stringstream contents;
+	contents << file.rdbuf();
+	text = contents.str();
+	return true;
+}
+
+HlslLayoutParser::HlslLayoutParser()
+{
+}
+
+HlslLayoutParser::~HlslLayoutParser()
+{
+}
+
+bool HlslLayoutParser::ParseFile(const std::string& path)
+{
+	std::string text;
+	if (!ReadFile(path, text))
+		return Fail(path, 0, "can't open the file");
+
+	return ParseText(text, path, GetFolder(path));
+}
+
+bool HlslLayoutParser::ParseText(const std::string& text, const std::string& name, const std::string& folder)
+{
+	//Defines and structs belong to one shader and what it includes
+	if (includeStack.empty())
+	{
+		defines.clear();
+		structs.clear();
+	}
+
+	std::vector<Token> tokens;
+	Tokenize(text, tokens);
+
+	includeStack.push_back(name);
+	bool parsed = ParseTokens(tokens, name, folder);
+	includeStack.pop_back();
+	return parsed;
+}
+
+// --------------------------------------------------------
+// Splits source into words (identifiers and numbers),
+// single character symbols, comments and whole preprocessor
+// lines. Line numbers are 1 based.
+// --------------------------------------------------------
+void HlslLayoutParser::Tokenize(const std::string& text, std::vector<Token>& tokens)
+{
+	unsigned int line = 1;
+	bool lineStart = true;
+	size_t i = 0;
+	while (i < text.size())
+	{
+		char c = text[i];
+		if (c == '\n')
+		{
+			line++;
+			lineStart = true;
+			i++;
+		}
+		else if (isspace((unsigned char)c))
+		{
+			i++;
+		}
+		else if (c == '/' && i + 1 < text.size() && text[i + 1] == '/')
+		{
+			size_t end = text.find('\n', i);
+			if (end == std::string::npos) end = text.size();
+			tokens.push_back({ Token::Comment, Trim(text.substr(i + 2, end - i - 2)), line });
+			i = end;
+		}
+		else if (c == '/' && i + 1 < text.size() && text[i + 1] == '*')
+		{
+			size_t end = text.find("*/", i + 2);
+			if (end == std::string::npos) end = text.size();
+			tokens.push_back({ Token::Comment, Trim(text.substr(i + 2, end - i - 2)), line });
+			for (size_t j = i; j < end; j++)
+			{
+				if (text[j] == '\n') line++;
+			}
+			i = end + 2;
+		}
+		else if (c == '#' && lineStart)
+		{
+			//The directive without any comment after it
+			size_t end = text.find('\n', i);
+			if (end == std::string::npos) end = text.size();
+			std::string directive = text.substr(i, end - i);
+			size_t comment = directive.find("//");
+			if (comment != std::string::npos) directive.erase(comment);
+			tokens.push_back({ Token::Directive, Trim(directive), line });
+			i = end;
+		}
+		else if (isalnum((unsigned char)c) || c == '_' || c == '.')
+		{
+			size_t start = i;
+			while (i < text.size() && (isalnum((unsigned char)text[i]) || text[i] == '_' || text[i] == '.'))
+				i++;
+			tokens.push_back({ Token::Word, text.substr(start, i - start), line });
+			lineStart = false;
+		}
+		else
+		{
+			tokens.push_back({ Token::Symbol, std::string(1, c), line });
+			lineStart = false;
+			i++;
+		}
+	}
+}
+
+bool HlslLayoutParser::ParseTokens(const std::vector<Token>& tokens, const std::string& name, const std::string& folder)
+{
+	int depth = 0;
+	size_t i = 0;
+	while (i < tokens.size())
+	{
+		const Token& token = tokens[i];
+		if (token.Type == Token::Directive)
+		{
+			if (!ParseDirective(token, name, folder))
+				return false;
+			i++;
+		}
+		else if (depth == 0 && token.Type == Token::Word && (token.Text == "struct" || token.Text == "cbuffer") &&
+			i + 1 < tokens.size() && tokens[i + 1].Type == Token::Word)
+		{
+			if (!ParseBlock(tokens, i, token.Text == "cbuffer", name))
+				return false;
+		}
+		else
+		{
+			if (token.Type == Token::Symbol && token.Text == "{") depth++;
+			if (token.Type == Token::Symbol && token.Text == "}") depth--;
+			i++;
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Follows includes and remembers integer defines, anything
+// else is left alone
+// --------------------------------------------------------
+bool HlslLayoutParser::ParseDirective(const Token& token, const std::string& name, const std::string& folder)
+{
+	std::istringstream words(token.Text.substr(1));
+	std::string directive;
+	words >> directive;
+
+	if (directive == "define")
+	{
+		std::string defineName, value;
+		words >> defineName >> value;
+		if (defineName.empty() || value.empty() || !isdigit((unsigned char)value[0]))
+			return true;
+
+		char* end = 0;
+		unsigned long number = strtoul(value.c_str(), &end, 0);
+		if (*end == 'u' || *end == 'U') end++;
+		if (*end == 0)
+			defines[defineName] = (unsigned int)number;
+		return true;
+	}
+
+	if (directive == "include")
+	{
+		size_t open = token.Text.find('"');
+		size_t close = token.Text.find('"', open + 1);
+		if (open == std::string::npos || close == std::string::npos)
+			return true; // <system> includes aren't ours
+
+		std::string path = folder + token.Text.substr(open + 1, close - open - 1);
+		if (includeStack.size() >= MAX_INCLUDE_DEPTH)
+			return Fail(name, token.Line, "includes nested too deeply (or including themselves)");
+
+		std::string text;
+		if (!ReadFile(path, text))
+			return Fail(name, token.Line, "can't open include \"" + path + "\"");
+		return ParseText(text, path, GetFolder(path));
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Parses "struct Name { ... };" or "cbuffer Name : register(bN)
+// { ... }" starting at the keyword, leaving i just past it.
+// Unmarked ones are skipped without looking inside.
+// --------------------------------------------------------
+bool HlslLayoutParser::ParseBlock(const std::vector<Token>& tokens, size_t& i, bool isCBuffer, const std::string& name)
+{
+	HlslLayout layout;
+	layout.HlslName = tokens[i + 1].Text;
+	layout.Sources = GetFileName(name);
+	layout.IsCBuffer = isCBuffer;
+	layout.Size = 0;
+	unsigned int line = tokens[i + 1].Line;
+	i += 2;
+
+	//Up to the brace: the marker comment and the register
+	for (; i < tokens.size(); i++)
+	{
+		const Token& token = tokens[i];
+		if (token.Type == Token::Symbol && (token.Text == "{" || token.Text == ";" || token.Text == "("))
+		{
+			if (token.Text == "(" && i > 0 && tokens[i - 1].Text == "register" && i + 1 < tokens.size())
+			{
+				layout.Register = tokens[i + 1].Text;
+				continue;
+			}
+			break;
+		}
+		if (token.Type == Token::Comment)
+		{
+			size_t marker = token.Text.find("C++:");
+			if (marker != std::string::npos)
+			{
+				std::istringstream words(token.Text.substr(marker + 4));
+				words >> layout.CppName;
+			}
+		}
+	}
+
+	//A declaration, a function returning a struct, or the end of the file
+	if (i >= tokens.size() || tokens[i].Text != "{")
+		return true;
+	i++;
+
+	//Skip the body of anything that isn't generated
+	if (layout.CppName.empty())
+	{
+		for (int depth = 1; i < tokens.size() && depth > 0; i++)
+		{
+			if (tokens[i].Type != Token::Symbol) continue;
+			if (tokens[i].Text == "{") depth++;
+			if (tokens[i].Text == "}") depth--;
+		}
+		return true;
+	}
+
+	//Members, one statement at a time
+	unsigned int cursor = 0;
+	unsigned int end = 0;
+	std::vector<const Token*> statement;
+	for (; i < tokens.size(); i++)
+	{
+		const Token& token = tokens[i];
+		if (token.Type == Token::Comment || token.Type == Token::Directive)
+			continue;
+		if (token.Type == Token::Symbol && token.Text == "}")
+		{
+			i++;
+			break;
+		}
+		if (!(token.Type == Token::Symbol && token.Text == ";"))
+		{
+			statement.push_back(&token);
+			continue;
+		}
+
+		//A comment on the same line describes the member
+		std::string comment;
+		if (i + 1 < tokens.size() && tokens[i + 1].Type == Token::Comment && tokens[i + 1].Line == token.Line)
+			comment = tokens[i + 1].Text;
+
+		//Modifiers first. Static members aren't stored in the buffer.
+		size_t w = 0;
+		bool isStatic = false;
+		while (w < statement.size() && (statement[w]->Text == "row_major" || statement[w]->Text == "column_major" ||
+			statement[w]->Text == "uniform" || statement[w]->Text == "precise" || statement[w]->Text == "static" ||
+			statement[w]->Text == "const"))
+		{
+			isStatic |= statement[w]->Text == "static";
+			w++;
+		}
+		if (isStatic || w >= statement.size())
+		{
+			statement.clear();
+			continue;
+		}
+		std::string type = statement[w++]->Text;
+
+		//Then one or more "name[size] : semantic", comma separated
+		while (w < statement.size())
+		{
+			if (statement[w]->Type != Token::Word)
+				return Fail(name, statement[w]->Line, "expected a member name after " + type);
+			std::string memberName = statement[w++]->Text;
+
+			std::string arraySize;
+			if (w < statement.size() && statement[w]->Text == "[")
+			{
+				if (w + 2 >= statement.size() || statement[w + 2]->Text != "]")
+					return Fail(name, statement[w]->Line, "array size of " + memberName + " must be a number or a #define");
+				arraySize = statement[w + 1]->Text;
+				w += 3;
+				if (w < statement.size() && statement[w]->Text == "[")
+					return Fail(name, statement[w]->Line, memberName + " has more than one dimension, which isn't supported");
+			}
+
+			if (w < statement.size() && statement[w]->Text == ":")
+			{
+				if (w + 1 < statement.size() && statement[w + 1]->Text == "packoffset")
+					return Fail(name, statement[w]->Line, "packoffset isn't supported, " + memberName + " has to be packed automatically");
+				while (w < statement.size() && statement[w]->Text != ",")
+					w++;
+			}
+
+			if (!AddMember(layout, cursor, type, memberName, arraySize, comment, name, token.Line))
+				return false;
+			end = layout.Members.back().Offset + layout.Members.back().Size;
+
+			if (w < statement.size() && statement[w]->Text == ",")
+				w++;
+		}
+		statement.clear();
+	}
+
+	//Trailing ; after a struct
+	if (i < tokens.size() && tokens[i].Text == ";")
+		i++;
+
+	if (layout.Members.empty())
+		return Fail(name, line, layout.HlslName + " has no members");
+
+	//Buffers are always whole registers, structs are just their members
+	layout.Size = isCBuffer ? AlignRegister(end) : end;
+	AddPadding(layout, end, layout.Size);
+
+	if (!isCBuffer)
+		structs[layout.HlslName] = layout;
+	return AddLayout(layout, name, line);
+}
+
+// --------------------------------------------------------
+// Places one member by HLSL packing rules, adding padding
+// before it if it can't follow the previous one directly
+// --------------------------------------------------------
+bool HlslLayoutParser::AddMember(HlslLayout& layout, unsigned int& cursor, const std::string& type, const std::string& memberName,
+	const std::string& arraySize, const std::string& comment, const std::string& name, unsigned int line)
+{
+	HlslMember member = {};
+	member.Name = memberName;
+	member.Name[0] = (char)toupper((unsigned char)member.Name[0]);
+	member.Comment = comment;
+
+	unsigned int elementSize = 0;
+	bool isStruct = false;
+	if (!GetBuiltInType(type, member.CppType, elementSize))
+	{
+		auto found = structs.find(type);
+		if (found == structs.end())
+			return Fail(name, line, "type " + type + " of " + memberName + " has no C++ equivalent (structs need a C++: name)");
+
+		member.CppType = found->second.CppName;
+		elementSize = found->second.Size;
+		isStruct = true;
+	}
+
+	bool isMatrix = elementSize == 64 && !isStruct;
+	unsigned int size = elementSize;
+	if (!arraySize.empty())
+	{
+		if (isdigit((unsigned char)arraySize[0]))
+		{
+			member.ArraySize = (unsigned int)strtoul(arraySize.c_str(), 0, 0);
+		}
+		else
+		{
+			auto found = defines.find(arraySize);
+			if (found == defines.end())
+				return Fail(name, line, "array size " + arraySize + " isn't an integer #define");
+			member.ArraySize = found->second;
+			member.ArraySizeName = arraySize;
+		}
+		if (member.ArraySize == 0)
+			return Fail(name, line, memberName + " is an empty array");
+
+		//HLSL puts every element in its own register(s)
+		if (elementSize % 16 != 0)
+			return Fail(name, line, "elements of " + memberName + " are padded to 16 bytes in HLSL, use a 16 byte type (e.g. float4) so C++ matches");
+		size = elementSize * member.ArraySize;
+	}
+
+	//Structs, arrays and matrices start a register, vectors can't straddle one
+	unsigned int end = cursor;
+	if (isStruct || isMatrix || member.ArraySize > 0 || cursor % 16 + size > 16)
+		cursor = AlignRegister(cursor);
+	if (!layout.Members.empty())
+		end = layout.Members.back().Offset + layout.Members.back().Size;
+	AddPadding(layout, end, cursor);
+
+	member.Offset = cursor;
+	member.Size = size;
+	layout.Members.push_back(member);
+	cursor += size;
+
+	//Whatever follows a struct starts a new register
+	if (isStruct)
+		cursor = AlignRegister(cursor);
+	return true;
+}
+
+void HlslLayoutParser::AddPadding(HlslLayout& layout, unsigned int& end, unsigned int offset)
+{
+	if (offset <= end)
+		return;
+
+	unsigned int paddingCount = 0;
+	for (const HlslMember& existing : layout.Members)
+	{
+		if (existing.IsPadding) paddingCount++;
+	}
+
+	HlslMember padding = {};
+	padding.Name = "Padding" + std::to_string(paddingCount);
+	padding.CppType = "float";
+	padding.ArraySize = (offset - end) / 4 > 1 ? (offset - end) / 4 : 0;
+	padding.Offset = end;
+	padding.Size = offset - end;
+	padding.IsPadding = true;
+	layout.Members.push_back(padding);
+	end = offset;
+}
+
+// --------------------------------------------------------
+// Adds a finished layout, or checks it against the one of
+// the same C++ name that's already there
+// --------------------------------------------------------
+bool HlslLayoutParser::AddLayout(const HlslLayout& layout, const std::string& name, unsigned int line)
+{
+	for (HlslLayout& existing : layouts)
+	{
+		if (existing.CppName != layout.CppName)
+			continue;
+
+		bool same = existing.IsCBuffer == layout.IsCBuffer && existing.Size == layout.Size &&
+			existing.Members.size() == layout.Members.size();
+		for (size_t m = 0; same && m < layout.Members.size(); m++)
+		{
+			const HlslMember& a = existing.Members[m];
+			const HlslMember& b = layout.Members[m];
+			same = a.Name == b.Name && a.CppType == b.CppType && a.ArraySize == b.ArraySize && a.Offset == b.Offset;
+		}
+		if (!same)
+			return Fail(name, line, layout.CppName + " doesn't match the one in " + existing.Sources);
+
+		//Same declaration seen again (an include, or a buffer several shaders share)
+		if (existing.Sources.find(layout.Sources) == std::string::npos)
+			existing.Sources += ", " + layout.Sources;
+		return true;
+	}
+
+	layouts.push_back(layout);
+	return true;
+}
+
+bool HlslLayoutParser::GetBuiltInType(const std::string& type, std::string& cppType, unsigned int& size)
+{
+	static const struct { const char* Hlsl; const char* Cpp; unsigned int Size; } types[] =
+	{
+		{ "float", "float", 4 },
+		{ "float1", "float", 4 },
+		{ "float2", "DirectX::XMFLOAT2", 8 },
+		{ "float3", "DirectX::XMFLOAT3", 12 },
+		{ "float4", "DirectX::XMFLOAT4", 16 },
+		{ "int", "int", 4 },
+		{ "int1", "int", 4 },
+		{ "int2", "DirectX::XMINT2", 8 },
+		{ "int3", "DirectX::XMINT3", 12 },
+		{ "int4", "DirectX::XMINT4", 16 },
+		{ "uint", "unsigned int", 4 },
+		{ "uint1", "unsigned int", 4 },
+		{ "dword", "unsigned int", 4 },
+		{ "uint2", "DirectX::XMUINT2", 8 },
+		{ "uint3", "DirectX::XMUINT3", 12 },
+		{ "uint4", "DirectX::XMUINT4", 16 },
+		{ "bool", "int", 4 }, // 4 bytes in HLSL, unlike C++ bool
+		{ "matrix", "DirectX::XMFLOAT4X4", 64 },
+		{ "float4x4", "DirectX::XMFLOAT4X4", 64 },
+	};
+
+	for (const auto& t : types)
+	{
+		if (type == t.Hlsl)
+		{
+			cppType = t.Cpp;
+			size = t.Size;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool HlslLayoutParser::Fail(const std::string& name, unsigned int line, const std::string& message)
+{
+	if (error.empty())
+		error = name + "(" + std::to_string(line) + "): error : " + message;
+	return false;
+}
+
+std::string HlslLayoutParser::GenerateHeader()
+{
+	std::ostringstream out;
+	out <<
+		"#pragma once\n"
+		"\n"
+		"// --------------------------------------------------------\n"
+		"// Generated by Tools/CBufferGen from the shaders, don't\n"
+		"// edit it: change the HLSL and build again instead.\n"
+		"//\n"
+		"// C++ copies of every cbuffer and struct marked \"C++: Name\"\n"
+		"// in the shaders, laid out by HLSL packing rules. Gaps are\n"
+		"// filled with Padding members and every offset is checked,\n"
+		"// so a buffer can be filled in and uploaded in one go.\n"
+		"// --------------------------------------------------------\n"
+		"\n"
+		"#include <DirectXMath.h>\n"
+		"#include <cstddef>\n";
+
+	for (const HlslLayout& layout : layouts)
+	{
+		out << "\n// " << layout.Sources << ", " << (layout.IsCBuffer ? "cbuffer " : "struct ") << layout.HlslName;
+		if (!layout.Register.empty())
+			out << " (" << layout.Register << ")";
+		out << "\nstruct " << layout.CppName << "\n{\n";
+
+		for (const HlslMember& member : layout.Members)
+		{
+			out << "\t" << member.CppType << " " << member.Name;
+			if (member.ArraySize > 0)
+				out << "[" << member.ArraySize << "]";
+			out << ";";
+
+			std::string comment = member.ArraySizeName;
+			if (!member.Comment.empty())
+				comment += (comment.empty() ? "" : ", ") + member.Comment;
+			if (!comment.empty())
+				out << " //" << comment;
+			out << "\n";
+		}
+		out << "};\n";
+	}
+
+	out << "\n//Layout checks\n";
+	for (const HlslLayout& layout : layouts)
+	{
+		std::string message = "\"" + layout.CppName + " must match " + layout.HlslName + " in " + layout.Sources + "\"";
+		out << "static_assert(sizeof(" << layout.CppName << ") == " << layout.Size << ", " << message << ");\n";
+		for (const HlslMember& member : layout.Members)
+		{
+			if (member.IsPadding)
+				continue;
+			out << "static_assert(offsetof(" << layout.CppName << ", " << member.Name << ") == " << member.Offset << ", " << message << ");\n";
+		}
+	}
+
+	return out.str();
+}
+
+const std::vector<HlslLayout>& HlslLayoutParser::GetLayouts()
+{
+	return layouts;
+}
+
+const std::string& HlslLayoutParser::GetError()
+{
+	return error;
+}
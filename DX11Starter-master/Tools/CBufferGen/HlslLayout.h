@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+// --------------------------------------------------------
+// One member of a generated struct. Padding members fill the
+// gaps HLSL packing leaves and have no HLSL name.
+// --------------------------------------------------------
+struct HlslMember
+{
+	std::string Name; // As it will be in C++
+	std::string CppType;
+	unsigned int ArraySize; // 0 if not an array
+	std::string ArraySizeName; // Define the size came from, if any
+	unsigned int Offset;
+	unsigned int Size;
+	bool IsPadding;
+	std::string Comment; // Copied from the HLSL
+};
+
+// A cbuffer or struct with the C++ name it's generated as
+struct HlslLayout
+{
+	std::string HlslName;
+	std::string CppName; // Empty if it isn't marked for C++
+	std::string Sources; // Files it was found in
+	std::string Register; // e.g. "b0", cbuffers only
+	bool IsCBuffer;
+	unsigned int Size; // Structs exactly, cbuffers rounded up to 16 bytes
+	std::vector<HlslMember> Members;
+};
+
+// --------------------------------------------------------
+// Reads cbuffer and struct declarations from HLSL source and
+// lays them out the way the compiler packs constant buffers
+//
+// - Only declarations marked with a "C++: Name" comment
+//   between their name and the opening brace are generated,
+//   and any struct they use has to be marked as well
+// - #include "..." is followed and simple integer #defines
+//   are remembered for array sizes. Other preprocessing is
+//   ignored, so declarations must not depend on it.
+// - Packing: vectors don't straddle 16 byte boundaries;
+//   structs, arrays and matrices start a new register;
+//   array elements are 16 byte aligned and a struct always
+//   ends its last register
+// - Each C++ member mirrors its HLSL type exactly, so arrays
+//   whose elements aren't a multiple of 16 bytes (where HLSL
+//   pads every element) and non 4x4 matrices are refused
+// - The same C++ name can come from several files as long as
+//   the layouts are identical
+// - Knows nothing about Direct3D
+// --------------------------------------------------------
+class HlslLayoutParser
+{
+public:
+	HlslLayoutParser();
+	~HlslLayoutParser();
+
+	// Parses a shader and everything it includes
+	bool ParseFile(const std::string& path);
+
+	// Parses source text (name is for messages, folder for includes)
+	bool ParseText(const std::string& text, const std::string& name, const std::string& folder);
+
+	// The whole C++ header for everything parsed so far
+	std::string GenerateHeader();
+
+	//Getters
+	const std::vector<HlslLayout>& GetLayouts(); // Marked ones, dependencies first
+	const std::string& GetError(); // "file(line): error : message", as MSBuild expects
+
+private:
+	struct Token
+	{
+		enum Kind { Word, Symbol, Comment, Directive } Type;
+		std::string Text;
+		unsigned int Line;
+	};
+
+	std::vector<HlslLayout> layouts;
+	std::map<std::string, HlslLayout> structs; // Every struct in the current file, by HLSL name
+	std::map<std::string, unsigned int> defines; // Integer #defines in the current file
+	std::vector<std::string> includeStack;
+	std::string error;
+
+	bool ParseTokens(const std::vector<Token>& tokens, const std::string& name, const std::string& folder);
+	bool ParseDirective(const Token& token, const std::string& name, const std::string& folder);
+	bool ParseBlock(const std::vector<Token>& tokens, size_t& i, bool isCBuffer, const std::string& name);
+	bool AddMember(HlslLayout& layout, unsigned int& cursor, const std::string& type, const std::string& memberName,
+		const std::string& arraySize, const std::string& comment, const std::string& name, unsigned int line);
+	bool AddLayout(const HlslLayout& layout, const std::string& name, unsigned int line);
+	bool Fail(const std::string& name, unsigned int line, const std::string& message);
+
+	static void Tokenize(const std::string& text, std::vector<Token>& tokens);
+	static void AddPadding(HlslLayout& layout, unsigned int& end, unsigned int offset);
+	static bool GetBuiltInType(const std::string& type, std::string& cppType, unsigned int& size);
+};
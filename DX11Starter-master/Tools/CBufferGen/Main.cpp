@@ -0,0 +1,49 @@
+#include "HlslLayout.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+// --------------------------------------------------------
+// CBufferGen <output header> <shader.hlsl>...
+//
+// Writes the C++ mirror structs for the shaders' marked
+// cbuffers and structs (see HlslLayout.h). The header is
+// only rewritten when it actually changes, so an unchanged
+// layout doesn't rebuild everything that includes it.
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cerr << "Usage: CBufferGen <output header> <shader.hlsl>...\n";
+		return 1;
+	}
+
+	HlslLayoutParser parser;
+	for (int i = 2; i < argc; i++)
+	{
+		if (!parser.ParseFile(argv[i]))
+		{
+			std::cerr << parser.GetError() << "\n";
+			return 1;
+		}
+	}
+	std::string header = parser.GenerateHeader();
+
+	std::ifstream existingFile(argv[1], std::ios::binary);
+	std::stringstream existing;
+	existing << existingFile.rdbuf();
+	existingFile.close();
+	if (existing.str() == header)
+		return 0;
+
+	std::ofstream output(argv[1], std::ios::binary);
+	output << header;
+	if (!output)
+	{
+		std::cerr << argv[1] << ": error : can't write the header\n";
+		return 1;
+	}
+	std::cout << "CBufferGen: wrote " << parser.GetLayouts().size() << " layouts to " << argv[1] << "\n";
+	return 0;
+}
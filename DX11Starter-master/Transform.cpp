@@ -15,6 +15,7 @@ Transform::Transform()
 	XMStoreFloat4x4(&worldInverseTranspose, XMMatrixIdentity());
 	isMatrixChanged = false;
 	isRotationChanged = false;
+	version = 0;
 }
 
 Transform::~Transform()
@@ -23,40 +24,64 @@ Transform::~Transform()
 
 void Transform::SetPosition(float x, float y, float z)
 {
+	if (position.x == x && position.y == y && position.z == z)
+		return;
+
 	position = XMFLOAT3(x, y, z);
 	isMatrixChanged = true;
+	version++;
 }
 
 void Transform::SetPosition(DirectX::XMFLOAT3 position)
 {
+	if (this->position.x == position.x && this->position.y == position.y && this->position.z == position.z)
+		return;
+
 	this->position = XMFLOAT3(position.x, position.y, position.z);
 	isMatrixChanged = true;
+	version++;
 }
 
 void Transform::SetRotation(float pitch, float yaw, float roll)
 {
+	if (pitchYawRoll.x == pitch && pitchYawRoll.y == yaw && pitchYawRoll.z == roll)
+		return;
+
 	pitchYawRoll = XMFLOAT3(pitch, yaw, roll);
 	isMatrixChanged = true;
+	version++;
 	isRotationChanged = true;
 }
 
 void Transform::SetRotation(DirectX::XMFLOAT3 rotation)
 {
+	if (pitchYawRoll.x == rotation.x && pitchYawRoll.y == rotation.y && pitchYawRoll.z == rotation.z)
+		return;
+
 	pitchYawRoll = XMFLOAT3(rotation.x, rotation.y, rotation.z);
 	isMatrixChanged = true;
+	version++;
 	isRotationChanged = true;
 }
 
 void Transform::SetScale(float x, float y, float z)
 {
+	if (scale.x == x && scale.y == y && scale.z == z)
+		return;
+
 	scale = XMFLOAT3(x, y, z);
 	isMatrixChanged = true;
+	version++;
 }
 
 void Transform::SetScale(DirectX::XMFLOAT3 scale)
 {
+	if (this->scale.x == scale.x && this->scale.y == scale.y && this->scale.z == scale.z)
+		return;
+
 	this->scale = XMFLOAT3(scale.x, scale.y, scale.z);
 	isMatrixChanged = true;
+	version++;
 }
 
 DirectX::XMFLOAT3 Transform::GetPosition()
@@ -141,16 +166,23 @@ DirectX::XMFLOAT3 Transform::GetForward()
 	return forward;
 }
 
+unsigned int Transform::GetVersion()
+{
+	return version;
+}
+
 void Transform::MoveAbsolute(float x, float y, float z)
 {
 	position = XMFLOAT3(position.x + x, position.y + y, position.z + z);
 	isMatrixChanged = true;
+	version++;
 }
 
 void Transform::MoveAbsolute(DirectX::XMFLOAT3 offset)
 {
 	position = XMFLOAT3(position.x + offset.x, position.y + offset.y, position.z + offset.z);
 	isMatrixChanged = true;
+	version++;
 }
 
 void Transform::MoveRelative(float x, float y, float z)
@@ -159,6 +191,7 @@ void Transform::MoveRelative(float x, float y, float z)
 	workspace = XMVector3Rotate(DirectX::XMVectorSet(x, y, z, 0.0f), workspace);
 	XMStoreFloat3(&position, XMVectorAdd(XMLoadFloat3(&position), workspace));
 	isMatrixChanged = true;
+	version++;
 }
 
 void Transform::MoveRelative(DirectX::XMFLOAT3 offset)
@@ -167,12 +200,14 @@ void Transform::MoveRelative(DirectX::XMFLOAT3 offset)
 	workspace = XMVector3Rotate(DirectX::XMVectorSet(offset.x, offset.y, offset.z, 0.0f), workspace);
 	XMStoreFloat3(&position, XMVectorAdd(XMLoadFloat3(&position), workspace));
 	isMatrixChanged = true;
+	version++;
 }
 
 void Transform::Rotate(float pitch, float yaw, float roll)
 {
 	pitchYawRoll = XMFLOAT3(pitchYawRoll.x + pitch, pitchYawRoll.y + yaw, pitchYawRoll.z + roll);
 	isMatrixChanged = true;
+	version++;
 	isRotationChanged = true;
 }
 
@@ -180,6 +215,7 @@ void Transform::Rotate(DirectX::XMFLOAT3 rotation)
 {
 	pitchYawRoll = XMFLOAT3(pitchYawRoll.x + rotation.x, pitchYawRoll.y + rotation.y, pitchYawRoll.z + rotation.z);
 	isMatrixChanged = true;
+	version++;
 	isRotationChanged = true;
 }
 
@@ -187,10 +223,12 @@ void Transform::Scale(float x, float y, float z)
 {
 	scale = XMFLOAT3(scale.x * x, scale.y * y, scale.z * z);
 	isMatrixChanged = true;
+	version++;
 }
 
 void Transform::Scale(DirectX::XMFLOAT3 scale)
 {
 	this->scale = XMFLOAT3(this->scale.x * scale.x, this->scale.y * scale.y, this->scale.z * scale.z);
 	isMatrixChanged = true;
+	version++;
 }
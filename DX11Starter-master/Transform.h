@@ -25,6 +25,7 @@ public:
 	DirectX::XMFLOAT3 GetRight();
 	DirectX::XMFLOAT3 GetUp();
 	DirectX::XMFLOAT3 GetForward();
+	unsigned int GetVersion();
 	
 
 	//Mutators
@@ -48,5 +49,6 @@ private:
 	DirectX::XMFLOAT4X4 worldInverseTranspose;
 	bool isMatrixChanged;
 	bool isRotationChanged;
+	unsigned int version; //Bumped whenever the world matrix actually changes
 };
 
@@ -1,15 +1,23 @@
 #include "ShaderHelper.hlsli"
 
-// Constant Buffer
-cbuffer ExternalData : register(b0)
+// Per instance data (input slot 1), one XMFLOAT4X4 row per register
+// - Stands in for a per object buffer, all worked out on the CPU
+//   (see InstanceData), so there's no matrix-matrix math here
+struct InstanceInput
 {
-    matrix world;
-    matrix worldInverseTranspose;
-    matrix view;
-    matrix projection;
-    matrix lightView;
-    matrix lightProjection;
-}
+    float4 worldViewProjection0 : WORLD_VIEW_PROJECTION_PER_INSTANCE0;
+    float4 worldViewProjection1 : WORLD_VIEW_PROJECTION_PER_INSTANCE1;
+    float4 worldViewProjection2 : WORLD_VIEW_PROJECTION_PER_INSTANCE2;
+    float4 worldViewProjection3 : WORLD_VIEW_PROJECTION_PER_INSTANCE3;
+    float4 world0 : WORLD_PER_INSTANCE0;
+    float4 world1 : WORLD_PER_INSTANCE1;
+    float4 world2 : WORLD_PER_INSTANCE2;
+    float4 world3 : WORLD_PER_INSTANCE3;
+    float4 worldInverseTranspose0 : WORLD_INVERSE_TRANSPOSE_PER_INSTANCE0;
+    float4 worldInverseTranspose1 : WORLD_INVERSE_TRANSPOSE_PER_INSTANCE1;
+    float4 worldInverseTranspose2 : WORLD_INVERSE_TRANSPOSE_PER_INSTANCE2;
+    float4 worldInverseTranspose3 : WORLD_INVERSE_TRANSPOSE_PER_INSTANCE3;
+};
 
 // --------------------------------------------------------
 // The entry point (main method) for our vertex shader
@@ -18,8 +26,16 @@ cbuffer ExternalData : register(b0)
 // - Output is a single struct of data to pass down the pipeline
 // - Named "main" because that's the default the shader compiler looks for
 // --------------------------------------------------------
-VertexToPixel main( VertexShaderInput input )
+VertexToPixel main( VertexShaderInput input, InstanceInput instance )
 {
+    //Rows arrive exactly as the XMFLOAT4X4 stores them, transpose to
+    //match how matrices come through constant buffers
+    matrix wvp = transpose(float4x4(instance.worldViewProjection0, instance.worldViewProjection1,
+        instance.worldViewProjection2, instance.worldViewProjection3));
+    matrix world = transpose(float4x4(instance.world0, instance.world1, instance.world2, instance.world3));
+    matrix worldInverseTranspose = transpose(float4x4(instance.worldInverseTranspose0, instance.worldInverseTranspose1,
+        instance.worldInverseTranspose2, instance.worldInverseTranspose3));
+
 	// Set up output struct
 	VertexToPixel output;
 
@@ -31,14 +47,11 @@ VertexToPixel main( VertexShaderInput input )
 	// - Each of these components is then automatically divided by the W component, 
 	//   which we're leaving at 1.0 for now (this is more useful when dealing with 
 	//   a perspective projection matrix, which we'll get to in the future).
-    matrix wvp = mul(projection, mul(view, world));
-	output.screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+	// - precise, so it matches DepthPrePassVS.hlsl bit for bit
+	precise float4 screenPosition = mul(wvp, float4(input.localPosition, 1.0f));
+	output.screenPosition = screenPosition;
     output.worldPosition = mul(world, float4(input.localPosition, 1)).xyz;
 	
-	//Shadow Map
-    matrix shadowWVP = mul(lightProjection, mul(lightView, world));
-    output.shadowMapPos = mul(shadowWVP, float4(input.localPosition, 1.0f));
-	
 	//Pass normals to the pipe
     output.normal = mul((float3x3)worldInverseTranspose, input.normal);
 